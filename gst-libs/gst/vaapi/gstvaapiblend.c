@@ -36,6 +36,7 @@ struct _GstVaapiBlend
 
   VAConfigID va_config;
   VAContextID va_context;
+  GstVaapiContextLock context_lock;
 
   guint32 flags;
 };
@@ -105,6 +106,7 @@ gst_vaapi_blend_finalize (GObject * object)
 {
   GstVaapiBlend *const blend = GST_VAAPI_BLEND (object);
 
+  gst_vaapi_context_lock_clear (&blend->context_lock, blend->display);
   if (!blend->display)
     goto bail;
 
@@ -152,6 +154,7 @@ gst_vaapi_blend_init (GstVaapiBlend * blend)
   blend->va_config = VA_INVALID_ID;
   blend->va_context = VA_INVALID_ID;
   blend->flags = 0;
+  gst_vaapi_context_lock_init (&blend->context_lock);
 }
 
 static gboolean
@@ -318,9 +321,9 @@ gst_vaapi_blend_process (GstVaapiBlend * blend, GstVaapiSurface * output,
   g_return_val_if_fail (output != NULL, FALSE);
   g_return_val_if_fail (next != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (blend->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (blend->display, &blend->context_lock);
   result = gst_vaapi_blend_process_unlocked (blend, output, next, user_data);
-  GST_VAAPI_DISPLAY_UNLOCK (blend->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (blend->display, &blend->context_lock);
 
   return result;
 }
@@ -0,0 +1,372 @@
+/*
+ *  gstvaapibuffercache.c - VA parameter buffer cache
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapibuffercache
+ * @short_description: VA parameter buffer cache
+ *
+ * Recycles the VA buffers holding picture, slice, quantization and
+ * other parameters, instead of creating and destroying them for every
+ * picture. Buffers are looked up by type and size.
+ *
+ * A released buffer may still be read by the driver until the picture
+ * it was rendered into is submitted, so it only becomes reusable after
+ * gst_vaapi_buffer_cache_commit(), which is meant to be called after
+ * vaEndPicture(). Slice data, coded and image buffers are never cached.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapibuffercache.h"
+#include "gstvaapiutils.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct
+{
+  VABufferID id;
+  VABufferType type;
+  guint size;
+} CachedBuffer;
+
+struct _GstVaapiBufferCache
+{
+  VADisplay va_display;
+  VAContextID va_context;
+  guint max_buffers;
+  GstVaapiBufferCacheVTable vtable;
+
+  GMutex lock;
+  GHashTable *live_buffers;     /* VABufferID -> CachedBuffer */
+  GQueue pending_buffers;       /* released, maybe still used by the driver */
+  GQueue free_buffers;          /* reusable, most recently released first */
+  GstVaapiBufferCacheStats stats;
+};
+
+static const GstVaapiBufferCacheVTable default_vtable = {
+  .create_buffer = vaCreateBuffer,
+  .destroy_buffer = vaDestroyBuffer,
+  .map_buffer = vaMapBuffer,
+  .unmap_buffer = vaUnmapBuffer,
+};
+
+static void
+cached_buffer_free (CachedBuffer * buffer)
+{
+  g_slice_free (CachedBuffer, buffer);
+}
+
+static void
+destroy_buffer (GstVaapiBufferCache * cache, CachedBuffer * buffer)
+{
+  cache->vtable.destroy_buffer (cache->va_display, buffer->id);
+  cached_buffer_free (buffer);
+}
+
+/**
+ * gst_vaapi_buffer_cache_new:
+ * @dpy: a VADisplay
+ * @context: the VAContextID the buffers are created for
+ * @max_buffers: the maximum number of buffers kept for reuse
+ * @vtable: (optional): the VA entry points, or %NULL for libva
+ *
+ * Creates a new #GstVaapiBufferCache.
+ *
+ * Return value: the newly allocated #GstVaapiBufferCache
+ */
+GstVaapiBufferCache *
+gst_vaapi_buffer_cache_new (VADisplay dpy, VAContextID context,
+    guint max_buffers, const GstVaapiBufferCacheVTable * vtable)
+{
+  GstVaapiBufferCache *cache;
+
+  cache = g_slice_new0 (GstVaapiBufferCache);
+  if (!cache)
+    return NULL;
+
+  cache->va_display = dpy;
+  cache->va_context = context;
+  cache->max_buffers = max_buffers;
+  cache->vtable = vtable ? *vtable : default_vtable;
+
+  g_mutex_init (&cache->lock);
+  cache->live_buffers = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) cached_buffer_free);
+  g_queue_init (&cache->pending_buffers);
+  g_queue_init (&cache->free_buffers);
+  return cache;
+}
+
+/**
+ * gst_vaapi_buffer_cache_free:
+ * @cache: a #GstVaapiBufferCache
+ *
+ * Destroys the buffers held for reuse and frees @cache. This shall be
+ * called before the VA context is destroyed. Buffers that are still
+ * in use are left to their owners, and released buffers the cache
+ * does not know about are simply destroyed.
+ */
+void
+gst_vaapi_buffer_cache_free (GstVaapiBufferCache * cache)
+{
+  CachedBuffer *buffer;
+
+  g_return_if_fail (cache != NULL);
+
+  GST_INFO ("context 0x%08x: %" G_GUINT64_FORMAT " buffer hits, %"
+      G_GUINT64_FORMAT " misses, %" G_GUINT64_FORMAT " evictions",
+      cache->va_context, cache->stats.num_hits, cache->stats.num_misses,
+      cache->stats.num_evictions);
+
+  while ((buffer = g_queue_pop_head (&cache->pending_buffers)))
+    destroy_buffer (cache, buffer);
+  while ((buffer = g_queue_pop_head (&cache->free_buffers)))
+    destroy_buffer (cache, buffer);
+  g_hash_table_unref (cache->live_buffers);
+
+  g_mutex_clear (&cache->lock);
+  g_slice_free (GstVaapiBufferCache, cache);
+}
+
+/**
+ * gst_vaapi_buffer_cache_is_cacheable:
+ * @type: a VABufferType
+ *
+ * Return value: %TRUE if buffers of @type are recycled by the cache
+ */
+gboolean
+gst_vaapi_buffer_cache_is_cacheable (VABufferType type)
+{
+  switch (type) {
+    case VASliceDataBufferType:
+    case VAEncCodedBufferType:
+    case VAImageBufferType:
+      return FALSE;
+    default:
+      break;
+  }
+  return TRUE;
+}
+
+/* Called with the cache lock held */
+static CachedBuffer *
+lookup_free_buffer (GstVaapiBufferCache * cache, VABufferType type,
+    guint size)
+{
+  GList *l;
+
+  for (l = cache->free_buffers.head; l != NULL; l = l->next) {
+    CachedBuffer *const buffer = l->data;
+
+    if (buffer->type == type && buffer->size == size) {
+      g_queue_delete_link (&cache->free_buffers, l);
+      return buffer;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * gst_vaapi_buffer_cache_create_buffer:
+ * @cache: a #GstVaapiBufferCache
+ * @type: the VABufferType
+ * @size: the buffer size, in bytes
+ * @data: (optional): the initial buffer contents
+ * @buf_id_ptr: return location for the VABufferID
+ * @mapped_data: (optional): return location for the mapped buffer
+ *
+ * Works like vaapi_create_buffer(), but recycles a released buffer of
+ * the same @type and @size if there is one. A recycled buffer without
+ * @data is cleared to zero.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_buffer_cache_create_buffer (GstVaapiBufferCache * cache,
+    VABufferType type, guint size, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data)
+{
+  CachedBuffer *buffer = NULL;
+  VAStatus status;
+  gpointer mem = NULL;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (buf_id_ptr != NULL, FALSE);
+
+  if (gst_vaapi_buffer_cache_is_cacheable (type)) {
+    g_mutex_lock (&cache->lock);
+    buffer = lookup_free_buffer (cache, type, size);
+    if (buffer)
+      cache->stats.num_hits++;
+    else
+      cache->stats.num_misses++;
+    g_mutex_unlock (&cache->lock);
+  }
+
+  if (buffer) {
+    GST_LOG ("reuse buffer 0x%08x (type %d, %u bytes)", buffer->id, type, size);
+
+    if (data || mapped_data) {
+      status = cache->vtable.map_buffer (cache->va_display, buffer->id, &mem);
+      if (!vaapi_check_status (status, "vaMapBuffer()"))
+        goto error;
+      if (data)
+        memcpy (mem, data, size);
+      else
+        memset (mem, 0, size);
+      if (!mapped_data)
+        cache->vtable.unmap_buffer (cache->va_display, buffer->id);
+    }
+  } else {
+    buffer = g_slice_new (CachedBuffer);
+    buffer->type = type;
+    buffer->size = size;
+
+    status = cache->vtable.create_buffer (cache->va_display,
+        cache->va_context, type, size, 1, (gpointer) data, &buffer->id);
+    if (!vaapi_check_status (status, "vaCreateBuffer()")) {
+      cached_buffer_free (buffer);
+      return FALSE;
+    }
+    GST_LOG ("create buffer 0x%08x (type %d, %u bytes)", buffer->id, type,
+        size);
+
+    if (mapped_data) {
+      status = cache->vtable.map_buffer (cache->va_display, buffer->id, &mem);
+      if (!vaapi_check_status (status, "vaMapBuffer()"))
+        goto error;
+    }
+  }
+
+  *buf_id_ptr = buffer->id;
+  if (mapped_data)
+    *mapped_data = mem;
+
+  /* Buffers that are not cacheable are not tracked either, so they
+     get destroyed when they are released */
+  if (!gst_vaapi_buffer_cache_is_cacheable (type)) {
+    cached_buffer_free (buffer);
+    return TRUE;
+  }
+
+  g_mutex_lock (&cache->lock);
+  g_hash_table_insert (cache->live_buffers, GUINT_TO_POINTER (buffer->id),
+      buffer);
+  g_mutex_unlock (&cache->lock);
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    destroy_buffer (cache, buffer);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_buffer_cache_release_buffer:
+ * @cache: a #GstVaapiBufferCache
+ * @buf_id_ptr: a pointer to the VABufferID to release
+ * @mapped_data: (optional): a pointer to the mapped buffer, if any
+ *
+ * Gives a buffer back to @cache, unmapping it first if *@mapped_data
+ * is set. The buffer becomes reusable on the next call to
+ * gst_vaapi_buffer_cache_commit(). Buffers not created by @cache are
+ * destroyed. *@buf_id_ptr is reset to %VA_INVALID_ID.
+ */
+void
+gst_vaapi_buffer_cache_release_buffer (GstVaapiBufferCache * cache,
+    VABufferID * buf_id_ptr, gpointer * mapped_data)
+{
+  const VABufferID buf_id = *buf_id_ptr;
+  CachedBuffer *buffer;
+
+  g_return_if_fail (cache != NULL);
+
+  if (buf_id == VA_INVALID_ID)
+    return;
+
+  if (mapped_data && *mapped_data) {
+    cache->vtable.unmap_buffer (cache->va_display, buf_id);
+    *mapped_data = NULL;
+  }
+
+  g_mutex_lock (&cache->lock);
+  buffer = g_hash_table_lookup (cache->live_buffers, GUINT_TO_POINTER (buf_id));
+  if (buffer) {
+    g_hash_table_steal (cache->live_buffers, GUINT_TO_POINTER (buf_id));
+    g_queue_push_tail (&cache->pending_buffers, buffer);
+  }
+  g_mutex_unlock (&cache->lock);
+
+  if (!buffer)
+    cache->vtable.destroy_buffer (cache->va_display, buf_id);
+  *buf_id_ptr = VA_INVALID_ID;
+}
+
+/**
+ * gst_vaapi_buffer_cache_commit:
+ * @cache: a #GstVaapiBufferCache
+ *
+ * Makes the buffers released since the last call reusable. This shall
+ * be called once the driver no longer reads them, i.e. after
+ * vaEndPicture(). The least recently released buffers beyond the
+ * cache capacity are destroyed.
+ */
+void
+gst_vaapi_buffer_cache_commit (GstVaapiBufferCache * cache)
+{
+  CachedBuffer *buffer;
+  GQueue evicted = G_QUEUE_INIT;
+
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->lock);
+  while ((buffer = g_queue_pop_head (&cache->pending_buffers)))
+    g_queue_push_head (&cache->free_buffers, buffer);
+  while (cache->free_buffers.length > cache->max_buffers) {
+    g_queue_push_tail (&evicted, g_queue_pop_tail (&cache->free_buffers));
+    cache->stats.num_evictions++;
+  }
+  g_mutex_unlock (&cache->lock);
+
+  while ((buffer = g_queue_pop_head (&evicted)))
+    destroy_buffer (cache, buffer);
+}
+
+/**
+ * gst_vaapi_buffer_cache_get_stats:
+ * @cache: a #GstVaapiBufferCache
+ * @stats: (out caller-allocates): the #GstVaapiBufferCacheStats
+ *
+ * Retrieves the hit and miss counters of @cache.
+ */
+void
+gst_vaapi_buffer_cache_get_stats (GstVaapiBufferCache * cache,
+    GstVaapiBufferCacheStats * stats)
+{
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&cache->lock);
+  *stats = cache->stats;
+  stats->num_cached = cache->free_buffers.length +
+      cache->pending_buffers.length;
+  g_mutex_unlock (&cache->lock);
+}
@@ -0,0 +1,105 @@
+/*
+ *  gstvaapibuffercache.h - VA parameter buffer cache
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_BUFFER_CACHE_H
+#define GST_VAAPI_BUFFER_CACHE_H
+
+#include <glib.h>
+#include <va/va.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiBufferCache GstVaapiBufferCache;
+typedef struct _GstVaapiBufferCacheVTable GstVaapiBufferCacheVTable;
+typedef struct _GstVaapiBufferCacheStats GstVaapiBufferCacheStats;
+
+/**
+ * GstVaapiBufferCacheVTable:
+ * @create_buffer: the vaCreateBuffer() implementation
+ * @destroy_buffer: the vaDestroyBuffer() implementation
+ * @map_buffer: the vaMapBuffer() implementation
+ * @unmap_buffer: the vaUnmapBuffer() implementation
+ *
+ * The VA entry points used by a #GstVaapiBufferCache. They default to
+ * libva, and can be replaced by stubs to test the cache logic.
+ */
+struct _GstVaapiBufferCacheVTable
+{
+  VAStatus (*create_buffer) (VADisplay dpy, VAContextID context,
+      VABufferType type, unsigned int size, unsigned int num_elements,
+      void *data, VABufferID * buf_id);
+  VAStatus (*destroy_buffer) (VADisplay dpy, VABufferID buf_id);
+  VAStatus (*map_buffer) (VADisplay dpy, VABufferID buf_id, void **pbuf);
+  VAStatus (*unmap_buffer) (VADisplay dpy, VABufferID buf_id);
+};
+
+/**
+ * GstVaapiBufferCacheStats:
+ * @num_hits: number of buffers recycled from the cache
+ * @num_misses: number of buffers created with vaCreateBuffer()
+ * @num_evictions: number of released buffers destroyed because the
+ *   cache was full
+ * @num_cached: number of buffers currently held for reuse
+ *
+ * Statistics of a #GstVaapiBufferCache.
+ */
+struct _GstVaapiBufferCacheStats
+{
+  guint64 num_hits;
+  guint64 num_misses;
+  guint64 num_evictions;
+  guint num_cached;
+};
+
+G_GNUC_INTERNAL
+GstVaapiBufferCache *
+gst_vaapi_buffer_cache_new (VADisplay dpy, VAContextID context,
+    guint max_buffers, const GstVaapiBufferCacheVTable * vtable);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_cache_free (GstVaapiBufferCache * cache);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_buffer_cache_is_cacheable (VABufferType type);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_buffer_cache_create_buffer (GstVaapiBufferCache * cache,
+    VABufferType type, guint size, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_cache_release_buffer (GstVaapiBufferCache * cache,
+    VABufferID * buf_id_ptr, gpointer * mapped_data);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_cache_commit (GstVaapiBufferCache * cache);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_cache_get_stats (GstVaapiBufferCache * cache,
+    GstVaapiBufferCacheStats * stats);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_BUFFER_CACHE_H */
@@ -25,6 +25,7 @@
 #include "gstvaapibufferproxy.h"
 #include "gstvaapibufferproxy_priv.h"
 #include "gstvaapisurface_priv.h"
+#include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils.h"
 
 #define DEBUG 1
@@ -45,10 +46,10 @@ gst_vaapi_buffer_proxy_acquire_handle (GstVaapiBufferProxy * proxy)
 
   display = GST_VAAPI_SURFACE_DISPLAY (GST_VAAPI_SURFACE (proxy->surface));
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   va_status = vaAcquireBufferHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
       proxy->va_buf, &proxy->va_info);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (va_status, "vaAcquireBufferHandle()"))
     return FALSE;
   if (proxy->va_info.mem_type != mem_type)
@@ -70,10 +71,10 @@ gst_vaapi_buffer_proxy_release_handle (GstVaapiBufferProxy * proxy)
 
   display = GST_VAAPI_SURFACE_DISPLAY (GST_VAAPI_SURFACE (proxy->surface));
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   va_status = vaReleaseBufferHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
       proxy->va_buf);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (va_status, "vaReleaseBufferHandle()"))
     return FALSE;
   return TRUE;
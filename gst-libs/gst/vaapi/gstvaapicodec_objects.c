@@ -69,14 +69,16 @@ gst_vaapi_codec_object_create (GstVaapiCodecObject * object,
 
 GstVaapiCodecObject *
 gst_vaapi_codec_object_new (const GstVaapiCodecObjectClass * object_class,
-    GstVaapiCodecBase * codec, gconstpointer param, guint param_size,
-    gconstpointer data, guint data_size, guint flags)
+    GstVaapiCodecBase * codec, GstVaapiMiniObjectCache * cache,
+    gconstpointer param, guint param_size, gconstpointer data,
+    guint data_size, guint flags)
 {
   GstVaapiCodecObject *obj;
   GstVaapiCodecObjectConstructorArgs args;
 
   obj = (GstVaapiCodecObject *)
-      gst_vaapi_mini_object_new0 (GST_VAAPI_MINI_OBJECT_CLASS (object_class));
+      gst_vaapi_mini_object_new0_with_cache (GST_VAAPI_MINI_OBJECT_CLASS
+      (object_class), cache);
   if (!obj)
     return NULL;
 
@@ -97,8 +99,7 @@ gst_vaapi_codec_object_new (const GstVaapiCodecObjectClass * object_class,
 }
 
 #define GET_DECODER(obj)    GST_VAAPI_DECODER_CAST((obj)->parent_instance.codec)
-#define GET_VA_DISPLAY(obj) GET_DECODER(obj)->va_display
-#define GET_VA_CONTEXT(obj) GET_DECODER(obj)->va_context
+#define GET_CONTEXT(obj)    GET_DECODER(obj)->context
 
 /* ------------------------------------------------------------------------- */
 /* --- Inverse Quantization Matrices                                     --- */
@@ -109,8 +110,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiIqMatrix, gst_vaapi_iq_matrix);
 void
 gst_vaapi_iq_matrix_destroy (GstVaapiIqMatrix * iq_matrix)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (iq_matrix), &iq_matrix->param_id);
-  iq_matrix->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (iq_matrix),
+      &iq_matrix->param_id, &iq_matrix->param);
 }
 
 gboolean
@@ -118,9 +119,9 @@ gst_vaapi_iq_matrix_create (GstVaapiIqMatrix * iq_matrix,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   iq_matrix->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (iq_matrix),
-      GET_VA_CONTEXT (iq_matrix), VAIQMatrixBufferType,
-      args->param_size, args->param, &iq_matrix->param_id, &iq_matrix->param);
+  return gst_vaapi_context_create_buffer (GET_CONTEXT (iq_matrix),
+      VAIQMatrixBufferType, args->param_size, args->param,
+      &iq_matrix->param_id, &iq_matrix->param);
 }
 
 GstVaapiIqMatrix *
@@ -130,7 +131,8 @@ gst_vaapi_iq_matrix_new (GstVaapiDecoder * decoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiIqMatrixClass,
-      GST_VAAPI_CODEC_BASE (decoder), param, param_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE (decoder),
+      param, param_size, NULL, 0, 0);
   if (!object)
     return NULL;
   return GST_VAAPI_IQ_MATRIX_CAST (object);
@@ -145,8 +147,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiBitPlane, gst_vaapi_bitplane);
 void
 gst_vaapi_bitplane_destroy (GstVaapiBitPlane * bitplane)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (bitplane), &bitplane->data_id);
-  bitplane->data = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (bitplane),
+      &bitplane->data_id, (void **) &bitplane->data);
 }
 
 gboolean
@@ -154,9 +156,9 @@ gst_vaapi_bitplane_create (GstVaapiBitPlane * bitplane,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   bitplane->data_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (bitplane),
-      GET_VA_CONTEXT (bitplane), VABitPlaneBufferType, args->param_size,
-      args->param, &bitplane->data_id, (void **) &bitplane->data);
+  return gst_vaapi_context_create_buffer (GET_CONTEXT (bitplane),
+      VABitPlaneBufferType, args->param_size, args->param,
+      &bitplane->data_id, (void **) &bitplane->data);
 }
 
 
@@ -167,7 +169,8 @@ gst_vaapi_bitplane_new (GstVaapiDecoder * decoder, guint8 * data,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiBitPlaneClass,
-      GST_VAAPI_CODEC_BASE (decoder), data, data_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE (decoder),
+      data, data_size, NULL, 0, 0);
   if (!object)
     return NULL;
   return GST_VAAPI_BITPLANE_CAST (object);
@@ -182,8 +185,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiHuffmanTable, gst_vaapi_huffman_table);
 void
 gst_vaapi_huffman_table_destroy (GstVaapiHuffmanTable * huf_table)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (huf_table), &huf_table->param_id);
-  huf_table->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (huf_table),
+      &huf_table->param_id, (void **) &huf_table->param);
 }
 
 gboolean
@@ -191,9 +194,9 @@ gst_vaapi_huffman_table_create (GstVaapiHuffmanTable * huf_table,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   huf_table->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (huf_table),
-      GET_VA_CONTEXT (huf_table), VAHuffmanTableBufferType, args->param_size,
-      args->param, &huf_table->param_id, (void **) &huf_table->param);
+  return gst_vaapi_context_create_buffer (GET_CONTEXT (huf_table),
+      VAHuffmanTableBufferType, args->param_size, args->param,
+      &huf_table->param_id, (void **) &huf_table->param);
 }
 
 GstVaapiHuffmanTable *
@@ -203,7 +206,8 @@ gst_vaapi_huffman_table_new (GstVaapiDecoder * decoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiHuffmanTableClass,
-      GST_VAAPI_CODEC_BASE (decoder), data, data_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE (decoder),
+      data, data_size, NULL, 0, 0);
   if (!object)
     return NULL;
   return GST_VAAPI_HUFFMAN_TABLE_CAST (object);
@@ -215,8 +219,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiProbabilityTable,
 void
 gst_vaapi_probability_table_destroy (GstVaapiProbabilityTable * prob_table)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (prob_table), &prob_table->param_id);
-  prob_table->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (prob_table),
+      &prob_table->param_id, &prob_table->param);
 }
 
 gboolean
@@ -224,10 +228,9 @@ gst_vaapi_probability_table_create (GstVaapiProbabilityTable * prob_table,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   prob_table->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (prob_table),
-      GET_VA_CONTEXT (prob_table),
-      VAProbabilityBufferType,
-      args->param_size, args->param, &prob_table->param_id, &prob_table->param);
+  return gst_vaapi_context_create_buffer (GET_CONTEXT (prob_table),
+      VAProbabilityBufferType, args->param_size, args->param,
+      &prob_table->param_id, &prob_table->param);
 }
 
 GstVaapiProbabilityTable *
@@ -237,7 +240,8 @@ gst_vaapi_probability_table_new (GstVaapiDecoder * decoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiProbabilityTableClass,
-      GST_VAAPI_CODEC_BASE (decoder), param, param_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE (decoder),
+      param, param_size, NULL, 0, 0);
   if (!object)
     return NULL;
   return GST_VAAPI_PROBABILITY_TABLE_CAST (object);
@@ -102,8 +102,9 @@ gst_vaapi_codec_object_get_class (GstVaapiCodecObject * object) G_GNUC_CONST;
 G_GNUC_INTERNAL
 GstVaapiCodecObject *
 gst_vaapi_codec_object_new (const GstVaapiCodecObjectClass * object_class,
-    GstVaapiCodecBase * codec, gconstpointer param, guint param_size,
-    gconstpointer data, guint data_size, guint flags);
+    GstVaapiCodecBase * codec, GstVaapiMiniObjectCache * cache,
+    gconstpointer param, guint param_size, gconstpointer data,
+    guint data_size, guint flags);
 
 #define gst_vaapi_codec_object_ref(object) \
   ((gpointer) gst_vaapi_mini_object_ref (GST_VAAPI_MINI_OBJECT (object)))
@@ -24,12 +24,17 @@
 #include "sysdeps.h"
 #include "gstvaapicodedbuffer.h"
 #include "gstvaapicodedbuffer_priv.h"
+#include "gstvaapidisplay_priv.h"
 #include "gstvaapiencoder_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiutils_h26x_priv.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
 
+/* Converted while it is still in the cache */
+#define NAL_CONVERT_CHUNK_SIZE 16384
+
 static gboolean
 coded_buffer_create (GstVaapiCodedBuffer * buf, guint buf_size,
     GstVaapiContext * context)
@@ -38,11 +43,11 @@ coded_buffer_create (GstVaapiCodedBuffer * buf, guint buf_size,
   VABufferID buf_id;
   gboolean success;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   success = vaapi_create_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_CONTEXT_ID (context), VAEncCodedBufferType, buf_size,
       NULL, &buf_id, NULL);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!success)
     return FALSE;
 
@@ -61,9 +66,9 @@ coded_buffer_free (GstVaapiCodedBuffer * buf)
   GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (buf_id));
 
   if (buf_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     vaapi_destroy_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display), &buf_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     GST_VAAPI_CODED_BUFFER_ID (buf) = VA_INVALID_ID;
   }
 
@@ -72,20 +77,26 @@ coded_buffer_free (GstVaapiCodedBuffer * buf)
   g_slice_free1 (sizeof (GstVaapiCodedBuffer), buf);
 }
 
+/* Mappings are counted: the coded buffer stays mapped until the last
+   one is released, possibly from another thread once its memory was
+   handed over to downstream */
 static gboolean
 coded_buffer_map (GstVaapiCodedBuffer * buf)
 {
   GstVaapiDisplay *const display = GST_VAAPI_CODED_BUFFER_DISPLAY (buf);
-
-  if (buf->segment_list)
-    return TRUE;
-
-  GST_VAAPI_DISPLAY_LOCK (display);
-  buf->segment_list =
-      vaapi_map_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_CODED_BUFFER_ID (buf));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
-  return buf->segment_list != NULL;
+  gboolean success = TRUE;
+
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  if (buf->map_count == 0) {
+    buf->segment_list =
+        vaapi_map_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        GST_VAAPI_CODED_BUFFER_ID (buf));
+    success = buf->segment_list != NULL;
+  }
+  if (success)
+    buf->map_count++;
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  return success;
 }
 
 static void
@@ -93,13 +104,12 @@ coded_buffer_unmap (GstVaapiCodedBuffer * buf)
 {
   GstVaapiDisplay *const display = GST_VAAPI_CODED_BUFFER_DISPLAY (buf);
 
-  if (!buf->segment_list)
-    return;
-
-  GST_VAAPI_DISPLAY_LOCK (display);
-  vaapi_unmap_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_CODED_BUFFER_ID (buf), (void **) &buf->segment_list);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  if (buf->map_count > 0 && --buf->map_count == 0) {
+    vaapi_unmap_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        GST_VAAPI_CODED_BUFFER_ID (buf), (void **) &buf->segment_list);
+  }
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
 }
 
 GST_DEFINE_MINI_OBJECT_TYPE (GstVaapiCodedBuffer, gst_vaapi_coded_buffer);
@@ -136,6 +146,7 @@ gst_vaapi_coded_buffer_new (GstVaapiContext * context, guint buf_size)
 
   GST_VAAPI_CODED_BUFFER_DISPLAY (buf) = gst_object_ref (display);
   GST_VAAPI_CODED_BUFFER_ID (buf) = VA_INVALID_ID;
+  buf->map_count = 0;
   buf->segment_list = NULL;
 
   if (!coded_buffer_create (buf, buf_size, context))
@@ -199,8 +210,28 @@ gst_vaapi_coded_buffer_unmap (GstVaapiCodedBuffer * buf)
  */
 gssize
 gst_vaapi_coded_buffer_get_size (GstVaapiCodedBuffer * buf)
+{
+  return gst_vaapi_coded_buffer_get_size_full (buf, NULL);
+}
+
+/**
+ * gst_vaapi_coded_buffer_get_size_full:
+ * @buf: a #GstVaapiCodedBuffer
+ * @overflow_ptr: (out) (allow-none): return location for whether the
+ *   coded data did not fit into @buf
+ *
+ * Returns the VA coded buffer size in bytes, as
+ * gst_vaapi_coded_buffer_get_size() does, and whether the driver
+ * reported a slice overflow, i.e. that the coded data got truncated.
+ *
+ * Return value: the size of the VA coded buffer, or -1 on error
+ */
+gssize
+gst_vaapi_coded_buffer_get_size_full (GstVaapiCodedBuffer * buf,
+    gboolean * overflow_ptr)
 {
   VACodedBufferSegment *segment;
+  gboolean overflow = FALSE;
   gssize size;
 
   g_return_val_if_fail (buf != NULL, -1);
@@ -209,10 +240,15 @@ gst_vaapi_coded_buffer_get_size (GstVaapiCodedBuffer * buf)
     return -1;
 
   size = 0;
-  for (segment = buf->segment_list; segment != NULL; segment = segment->next)
+  for (segment = buf->segment_list; segment != NULL; segment = segment->next) {
     size += segment->size;
+    if (segment->status & VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK)
+      overflow = TRUE;
+  }
 
   coded_buffer_unmap (buf);
+  if (overflow_ptr)
+    *overflow_ptr = overflow;
   return size;
 }
 
@@ -249,3 +285,66 @@ gst_vaapi_coded_buffer_copy_into (GstBuffer * dest, GstVaapiCodedBuffer * src)
   coded_buffer_unmap (src);
   return segment == NULL;
 }
+
+/**
+ * gst_vaapi_coded_buffer_copy_nal_units_into:
+ * @dest: the destination #GstBuffer
+ * @src: the source #GstVaapiCodedBuffer
+ *
+ * Copies the H.264 or H.265 byte-stream data from @src into the
+ * regular buffer @dest, with each start code replaced by the size of
+ * its NAL unit on four bytes, as in the avc and hvc1 stream formats.
+ * The conversion is done along with the copy, a chunk at a time, so
+ * that the data is only read once from memory.
+ *
+ * All the NAL units of @src must start with a four-byte start code,
+ * as the ones output by the encoders do.
+ *
+ * Return value: %TRUE if successful, %FALSE otherwise
+ */
+gboolean
+gst_vaapi_coded_buffer_copy_nal_units_into (GstBuffer * dest,
+    GstVaapiCodedBuffer * src)
+{
+  GstVaapiH26xConverter conv;
+  VACodedBufferSegment *segment;
+  GstMapInfo info;
+  gsize offset, pos, size;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (src != NULL, FALSE);
+  g_return_val_if_fail (dest != NULL, FALSE);
+
+  if (!coded_buffer_map (src))
+    return FALSE;
+  if (!gst_buffer_map (dest, &info, GST_MAP_WRITE))
+    goto error_map_dest;
+
+  gst_vaapi_utils_h26x_converter_init (&conv, info.data);
+  offset = 0;
+  for (segment = src->segment_list; segment != NULL; segment = segment->next) {
+    for (pos = 0; pos < segment->size; pos += size) {
+      size = MIN (segment->size - pos, NAL_CONVERT_CHUNK_SIZE);
+      if (offset + size > info.size)
+        goto done;
+      memcpy (info.data + offset, (guint8 *) segment->buf + pos, size);
+      offset += size;
+      if (!gst_vaapi_utils_h26x_converter_push (&conv, size))
+        goto done;
+    }
+  }
+  success = gst_vaapi_utils_h26x_converter_finish (&conv);
+
+done:
+  gst_buffer_unmap (dest, &info);
+  coded_buffer_unmap (src);
+  return success;
+
+  /* ERRORS */
+error_map_dest:
+  {
+    GST_ERROR ("failed to map destination buffer");
+    coded_buffer_unmap (src);
+    return FALSE;
+  }
+}
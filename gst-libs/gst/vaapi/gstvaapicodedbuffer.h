@@ -66,6 +66,10 @@ gst_vaapi_coded_buffer_get_size (GstVaapiCodedBuffer * buf);
 gboolean
 gst_vaapi_coded_buffer_copy_into (GstBuffer * dest, GstVaapiCodedBuffer * src);
 
+gboolean
+gst_vaapi_coded_buffer_copy_nal_units_into (GstBuffer * dest,
+    GstVaapiCodedBuffer * src);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiCodedBuffer, gst_vaapi_coded_buffer_unref)
 
 G_END_DECLS
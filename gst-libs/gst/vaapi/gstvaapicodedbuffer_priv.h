@@ -43,6 +43,7 @@ struct _GstVaapiCodedBuffer
   GstMiniObject         mini_object;
   GstVaapiDisplay      *display;
   GstVaapiID            object_id;
+  guint                 map_count;
 
   /*< public >*/
   VACodedBufferSegment *segment_list;
@@ -79,6 +80,11 @@ G_GNUC_INTERNAL
 void
 gst_vaapi_coded_buffer_unmap (GstVaapiCodedBuffer * buf);
 
+G_GNUC_INTERNAL
+gssize
+gst_vaapi_coded_buffer_get_size_full (GstVaapiCodedBuffer * buf,
+    gboolean * overflow_ptr);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_PRIV_H */
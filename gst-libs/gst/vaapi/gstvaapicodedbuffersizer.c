@@ -0,0 +1,262 @@
+/*
+ *  gstvaapicodedbuffersizer.c - Coded buffer size prediction
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapicodedbuffersizer
+ * @short_description: Coded buffer size prediction
+ *
+ * Encoders compute the coded buffer size for the worst case, which is
+ * about a raw frame, while coded frames are usually a small fraction
+ * of it. The sizer predicts a smaller size, first from the rate
+ * control target if any, then from a histogram of the coded frame
+ * sizes, with some headroom.
+ *
+ * The size grows as soon as a frame gets close to it, or to the worst
+ * case when a frame did not fit at all. It only shrinks every few
+ * seconds worth of frames, once the largest recent frames allow it.
+ * The histogram records the last window each bin was hit in, so that
+ * peaks are forgotten after a few windows, but sizes which recur, such
+ * as the ones of intra frames, are not.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapicodedbuffersizer.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Histogram bins are a quarter of an octave wide, from 4 KiB to 1 GiB */
+#define BIN_BASE_SHIFT 12
+#define HISTOGRAM_BINS 72
+
+/* Number of frames between two shrink decisions, and number of such
+   windows after which a bin which was not hit is forgotten */
+#define WINDOW_FRAMES 120
+#define DECAY_WINDOWS 4
+
+/* Coded buffers are at least that large, and page aligned */
+#define MIN_SIZE (64 * 1024)
+#define SIZE_ALIGNMENT 4096
+
+/* Intra frames can take that many times the average frame size */
+#define TARGET_FACTOR 8
+
+struct _GstVaapiCodedBufferSizer
+{
+  /* Window, plus one, in which each bin was last hit */
+  guint histogram[HISTOGRAM_BINS];
+  guint num_window_frames;
+  guint num_windows;
+  GstVaapiCodedBufferSizerStats stats;
+};
+
+static guint
+get_bin (guint size)
+{
+  guint octave, quarter;
+
+  if (size < (1U << BIN_BASE_SHIFT))
+    return 0;
+  octave = g_bit_storage (size >> BIN_BASE_SHIFT) - 1;
+  quarter = (size >> (octave + BIN_BASE_SHIFT - 2)) & 3;
+  return MIN (octave * 4 + quarter, HISTOGRAM_BINS - 1);
+}
+
+/* Returns the upper bound of the sizes counted in @bin */
+static guint64
+get_bin_limit (guint bin)
+{
+  return (guint64) (5 + bin % 4) << (bin / 4 + BIN_BASE_SHIFT - 2);
+}
+
+/* Adds headroom to @size, and clamps it to the allowed sizes */
+static guint
+get_buffer_size (GstVaapiCodedBufferSizer * sizer, guint64 size)
+{
+  size += size / 2;
+  size = (size + SIZE_ALIGNMENT - 1) / SIZE_ALIGNMENT * SIZE_ALIGNMENT;
+  size = MAX (size, MIN_SIZE);
+  return MIN (size, sizer->stats.max_size);
+}
+
+static gboolean
+set_size (GstVaapiCodedBufferSizer * sizer, guint size)
+{
+  if (size == sizer->stats.size)
+    return FALSE;
+
+  GST_DEBUG ("coded buffer size %u -> %u", sizer->stats.size, size);
+  sizer->stats.size = size;
+  sizer->stats.num_resizes++;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_coded_buffer_sizer_new:
+ * @max_size: the worst-case coded buffer size
+ *
+ * Creates a new #GstVaapiCodedBufferSizer. The predicted size is
+ * @max_size until a rate control target is set, or frames are seen.
+ *
+ * Return value: the newly allocated #GstVaapiCodedBufferSizer
+ */
+GstVaapiCodedBufferSizer *
+gst_vaapi_coded_buffer_sizer_new (guint max_size)
+{
+  GstVaapiCodedBufferSizer *sizer;
+
+  g_return_val_if_fail (max_size > 0, NULL);
+
+  sizer = g_slice_new0 (GstVaapiCodedBufferSizer);
+  if (!sizer)
+    return NULL;
+
+  sizer->stats.size = max_size;
+  sizer->stats.max_size = max_size;
+  return sizer;
+}
+
+/**
+ * gst_vaapi_coded_buffer_sizer_free:
+ * @sizer: a #GstVaapiCodedBufferSizer
+ *
+ * Frees @sizer.
+ */
+void
+gst_vaapi_coded_buffer_sizer_free (GstVaapiCodedBufferSizer * sizer)
+{
+  g_return_if_fail (sizer != NULL);
+
+  g_slice_free (GstVaapiCodedBufferSizer, sizer);
+}
+
+/**
+ * gst_vaapi_coded_buffer_sizer_set_target:
+ * @sizer: a #GstVaapiCodedBufferSizer
+ * @frame_size: the average frame size targeted by the rate control,
+ *   in bytes, or 0 if there is none (constant QP)
+ *
+ * Predicts the size from @frame_size until frames are seen.
+ */
+void
+gst_vaapi_coded_buffer_sizer_set_target (GstVaapiCodedBufferSizer * sizer,
+    guint frame_size)
+{
+  g_return_if_fail (sizer != NULL);
+
+  if (sizer->stats.num_frames > 0)
+    return;
+
+  sizer->stats.size = frame_size > 0 ?
+      get_buffer_size (sizer, (guint64) frame_size * TARGET_FACTOR) :
+      sizer->stats.max_size;
+}
+
+/**
+ * gst_vaapi_coded_buffer_sizer_get_size:
+ * @sizer: a #GstVaapiCodedBufferSizer
+ *
+ * Return value: the predicted coded buffer size
+ */
+guint
+gst_vaapi_coded_buffer_sizer_get_size (GstVaapiCodedBufferSizer * sizer)
+{
+  g_return_val_if_fail (sizer != NULL, 0);
+
+  return sizer->stats.size;
+}
+
+/**
+ * gst_vaapi_coded_buffer_sizer_push:
+ * @sizer: a #GstVaapiCodedBufferSizer
+ * @coded_size: the size of a coded frame
+ *
+ * Records @coded_size, and updates the predicted size.
+ *
+ * Return value: %TRUE if the predicted size changed
+ */
+gboolean
+gst_vaapi_coded_buffer_sizer_push (GstVaapiCodedBufferSizer * sizer,
+    guint coded_size)
+{
+  guint i, size;
+
+  g_return_val_if_fail (sizer != NULL, FALSE);
+
+  sizer->stats.num_frames++;
+  sizer->stats.max_coded_size = MAX (sizer->stats.max_coded_size, coded_size);
+  sizer->histogram[get_bin (coded_size)] = sizer->num_windows + 1;
+
+  /* Grow right away when a frame comes close to the size */
+  size = get_buffer_size (sizer, coded_size);
+  if (size > sizer->stats.size)
+    return set_size (sizer, size);
+
+  if (++sizer->num_window_frames < WINDOW_FRAMES)
+    return FALSE;
+  sizer->num_window_frames = 0;
+
+  sizer->num_windows++;
+
+  for (i = HISTOGRAM_BINS - 1; i > 0; i--) {
+    if (sizer->histogram[i] + DECAY_WINDOWS > sizer->num_windows)
+      break;
+  }
+  size = get_buffer_size (sizer, get_bin_limit (i));
+
+  /* Shrink only when it is worth a reallocation */
+  if (size < sizer->stats.size / 4 * 3)
+    return set_size (sizer, size);
+  return FALSE;
+}
+
+/**
+ * gst_vaapi_coded_buffer_sizer_overflow:
+ * @sizer: a #GstVaapiCodedBufferSizer
+ *
+ * Records that a coded frame did not fit, and falls back to the
+ * worst-case size. The frame encoded again shall then be pushed.
+ *
+ * Return value: %TRUE if the predicted size changed
+ */
+gboolean
+gst_vaapi_coded_buffer_sizer_overflow (GstVaapiCodedBufferSizer * sizer)
+{
+  g_return_val_if_fail (sizer != NULL, FALSE);
+
+  sizer->stats.num_overflows++;
+  return set_size (sizer, sizer->stats.max_size);
+}
+
+/**
+ * gst_vaapi_coded_buffer_sizer_get_stats:
+ * @sizer: a #GstVaapiCodedBufferSizer
+ * @stats: (out caller-allocates): the #GstVaapiCodedBufferSizerStats
+ *
+ * Fills in @stats with the current state of @sizer.
+ */
+void
+gst_vaapi_coded_buffer_sizer_get_stats (GstVaapiCodedBufferSizer * sizer,
+    GstVaapiCodedBufferSizerStats * stats)
+{
+  g_return_if_fail (sizer != NULL);
+  g_return_if_fail (stats != NULL);
+
+  *stats = sizer->stats;
+}
@@ -0,0 +1,82 @@
+/*
+ *  gstvaapicodedbuffersizer.h - Coded buffer size prediction
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_CODED_BUFFER_SIZER_H
+#define GST_VAAPI_CODED_BUFFER_SIZER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiCodedBufferSizer GstVaapiCodedBufferSizer;
+typedef struct _GstVaapiCodedBufferSizerStats GstVaapiCodedBufferSizerStats;
+
+/**
+ * GstVaapiCodedBufferSizerStats:
+ * @size: the current coded buffer size
+ * @max_size: the worst-case coded buffer size
+ * @max_coded_size: the largest coded frame seen
+ * @num_frames: the number of coded frames seen
+ * @num_resizes: the number of times the size changed
+ * @num_overflows: the number of coded frames which did not fit
+ */
+struct _GstVaapiCodedBufferSizerStats
+{
+  guint size;
+  guint max_size;
+  guint max_coded_size;
+  guint64 num_frames;
+  guint num_resizes;
+  guint num_overflows;
+};
+
+G_GNUC_INTERNAL
+GstVaapiCodedBufferSizer *
+gst_vaapi_coded_buffer_sizer_new (guint max_size);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_coded_buffer_sizer_free (GstVaapiCodedBufferSizer * sizer);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_coded_buffer_sizer_set_target (GstVaapiCodedBufferSizer * sizer,
+    guint frame_size);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_coded_buffer_sizer_get_size (GstVaapiCodedBufferSizer * sizer);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_coded_buffer_sizer_push (GstVaapiCodedBufferSizer * sizer,
+    guint coded_size);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_coded_buffer_sizer_overflow (GstVaapiCodedBufferSizer * sizer);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_coded_buffer_sizer_get_stats (GstVaapiCodedBufferSizer * sizer,
+    GstVaapiCodedBufferSizerStats * stats);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_CODED_BUFFER_SIZER_H */
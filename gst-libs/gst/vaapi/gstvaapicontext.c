@@ -43,6 +43,9 @@
 /* Number of scratch surfaces beyond those used as reference */
 #define SCRATCH_SURFACES_COUNT (4)
 
+/* Number of released parameter buffers kept for reuse */
+#define DEFAULT_BUFFER_CACHE_SIZE (64)
+
 /* Debug category for GstVaapiContext */
 GST_DEBUG_CATEGORY (gst_debug_vaapi_context);
 #define GST_CAT_DEFAULT gst_debug_vaapi_context
@@ -157,6 +160,12 @@ context_destroy (GstVaapiContext * context)
   context_id = GST_VAAPI_CONTEXT_ID (context);
   GST_DEBUG ("context 0x%08x / config 0x%08x", context_id, context->va_config);
 
+  /* Cached buffers belong to the VA context */
+  if (context->buffer_cache) {
+    gst_vaapi_buffer_cache_free (context->buffer_cache);
+    context->buffer_cache = NULL;
+  }
+
   if (context_id != VA_INVALID_ID) {
     GST_VAAPI_DISPLAY_LOCK (display);
     status = vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
@@ -198,7 +207,7 @@ context_ensure_surfaces (GstVaapiContext * context)
   for (i = context->surfaces->len; i < num_surfaces; i++) {
     if (format != GST_VIDEO_FORMAT_UNKNOWN) {
       surface = gst_vaapi_surface_new_with_format (display, format, cip->width,
-          cip->height, 0);
+          cip->height, cip->surface_alloc_flags);
     } else {
       surface = gst_vaapi_surface_new (display, cip->chroma_type, cip->width,
           cip->height);
@@ -233,10 +242,15 @@ context_create_surfaces (GstVaapiContext * context)
   if (!context->surfaces_pool) {
     context->surfaces_pool =
         gst_vaapi_surface_pool_new_with_chroma_type (display, cip->chroma_type,
-        cip->width, cip->height, 0);
+        cip->width, cip->height, cip->surface_alloc_flags);
 
     if (!context->surfaces_pool)
       return FALSE;
+
+    /* The surfaces are the ones the VA context was created with, so the
+       pool shall neither release them nor allocate others ahead */
+    gst_vaapi_video_pool_set_watermarks (context->surfaces_pool, 0,
+        G_MAXUINT, 0);
   }
   return context_ensure_surfaces (context);
 }
@@ -252,8 +266,9 @@ context_create (GstVaapiContext * context)
   VAStatus status;
   GArray *surfaces = NULL;
   gboolean success = FALSE;
-  guint i;
+  guint i, buffer_cache_size;
   gint num_surfaces = 0;
+  const gchar *env;
 
   if (!context->surfaces && !context_create_surfaces (context))
     goto cleanup;
@@ -294,6 +309,16 @@ context_create (GstVaapiContext * context)
   GST_VAAPI_CONTEXT_ID (context) = context_id;
   success = TRUE;
 
+  buffer_cache_size = DEFAULT_BUFFER_CACHE_SIZE;
+  env = g_getenv ("GST_VAAPI_BUFFER_CACHE_SIZE");
+  if (env)
+    buffer_cache_size = g_ascii_strtoull (env, NULL, 10);
+  if (buffer_cache_size > 0) {
+    context->buffer_cache =
+        gst_vaapi_buffer_cache_new (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        context_id, buffer_cache_size, NULL);
+  }
+
 cleanup:
   if (surfaces)
     g_array_unref (surfaces);
@@ -337,7 +362,30 @@ config_create (GstVaapiContext * context)
   attrib = &attribs[++attrib_index];
   g_assert (attrib_index < G_N_ELEMENTS (attribs));
 
+  context->dec_processing = FALSE;
   switch (cip->usage) {
+#if VA_CHECK_VERSION(1,0,0)
+    case GST_VAAPI_CONTEXT_USAGE_DECODE:
+    {
+      const GstVaapiConfigInfoDecoder *const config = &cip->config.decoder;
+
+      /* Video processing within the decoding context is optional: the
+         decoded surfaces are output as is if the driver cannot do it */
+      if (config->processing) {
+        attrib->type = VAConfigAttribDecProcessing;
+        if (context_get_attribute (context, attrib->type, &value)
+            && value == VA_DEC_PROCESSING) {
+          attrib->value = value;
+          attrib = &attribs[++attrib_index];
+          g_assert (attrib_index < G_N_ELEMENTS (attribs));
+          context->dec_processing = TRUE;
+        } else {
+          GST_INFO ("no video processing within the decoding context");
+        }
+      }
+      break;
+    }
+#endif
 #if USE_ENCODERS
     case GST_VAAPI_CONTEXT_USAGE_ENCODE:
     {
@@ -509,6 +557,7 @@ gst_vaapi_context_new (GstVaapiDisplay * display,
   g_atomic_int_set (&context->ref_count, 1);
   context->surfaces = NULL;
   context->surfaces_pool = NULL;
+  context->buffer_cache = NULL;
 
   gst_vaapi_context_init (context, cip);
 
@@ -588,6 +637,10 @@ gst_vaapi_context_reset (GstVaapiContext * context,
     grow_surfaces = TRUE;
   }
 
+  /* Takes effect when surfaces are added or reallocated: the current
+     ones may still be used as references */
+  cip->surface_alloc_flags = new_cip->surface_alloc_flags;
+
   if (cip->usage != new_cip->usage) {
     cip->usage = new_cip->usage;
     reset_config = TRUE;
@@ -598,6 +651,10 @@ gst_vaapi_context_reset (GstVaapiContext * context,
   } else if (new_cip->usage == GST_VAAPI_CONTEXT_USAGE_DECODE) {
     if ((reset_surfaces && context->reset_on_resize) || grow_surfaces)
       reset_config = TRUE;
+    if (cip->config.decoder.processing != new_cip->config.decoder.processing) {
+      cip->config.decoder.processing = new_cip->config.decoder.processing;
+      reset_config = TRUE;
+    }
   }
 
   if (reset_surfaces)
@@ -748,6 +805,80 @@ gst_vaapi_context_get_surface_attributes (GstVaapiContext * context,
   return TRUE;
 }
 
+/**
+ * gst_vaapi_context_create_buffer:
+ * @context: a #GstVaapiContext
+ * @type: the VABufferType
+ * @size: the buffer size, in bytes
+ * @data: (optional): the initial buffer contents
+ * @buf_id_ptr: return location for the VABufferID
+ * @mapped_data: (optional): return location for the mapped buffer
+ *
+ * Creates a VA buffer for @context, recycling a buffer previously
+ * released with gst_vaapi_context_release_buffer() if possible.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_context_create_buffer (GstVaapiContext * context,
+    VABufferType type, guint size, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data)
+{
+  g_return_val_if_fail (context != NULL, FALSE);
+
+  if (!context->buffer_cache) {
+    return vaapi_create_buffer (GST_VAAPI_DISPLAY_VADISPLAY
+        (GST_VAAPI_CONTEXT_DISPLAY (context)), GST_VAAPI_CONTEXT_ID (context),
+        type, size, data, buf_id_ptr, mapped_data);
+  }
+  return gst_vaapi_buffer_cache_create_buffer (context->buffer_cache, type,
+      size, data, buf_id_ptr, mapped_data);
+}
+
+/**
+ * gst_vaapi_context_release_buffer:
+ * @context: a #GstVaapiContext
+ * @buf_id_ptr: a pointer to the VABufferID to release
+ * @mapped_data: (optional): a pointer to the mapped buffer, if any
+ *
+ * Releases a VA buffer created with gst_vaapi_context_create_buffer().
+ * The buffer is only reused after gst_vaapi_context_commit_buffers().
+ */
+void
+gst_vaapi_context_release_buffer (GstVaapiContext * context,
+    VABufferID * buf_id_ptr, gpointer * mapped_data)
+{
+  g_return_if_fail (context != NULL);
+
+  if (!context->buffer_cache) {
+    VADisplay const va_display =
+        GST_VAAPI_DISPLAY_VADISPLAY (GST_VAAPI_CONTEXT_DISPLAY (context));
+
+    if (mapped_data && *mapped_data && *buf_id_ptr != VA_INVALID_ID)
+      vaapi_unmap_buffer (va_display, *buf_id_ptr, mapped_data);
+    vaapi_destroy_buffer (va_display, buf_id_ptr);
+    return;
+  }
+  gst_vaapi_buffer_cache_release_buffer (context->buffer_cache, buf_id_ptr,
+      mapped_data);
+}
+
+/**
+ * gst_vaapi_context_commit_buffers:
+ * @context: a #GstVaapiContext
+ *
+ * Makes the buffers released so far reusable. This shall be called
+ * after vaEndPicture().
+ */
+void
+gst_vaapi_context_commit_buffers (GstVaapiContext * context)
+{
+  g_return_if_fail (context != NULL);
+
+  if (context->buffer_cache)
+    gst_vaapi_buffer_cache_commit (context->buffer_cache);
+}
+
 /**
  * gst_vaapi_context_ref:
  * @context: a #GstVaapiContext
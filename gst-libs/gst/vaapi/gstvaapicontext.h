@@ -30,6 +30,7 @@
 #include "gstvaapisurface.h"
 #include "gstvaapiutils_core.h"
 #include "gstvaapivideopool.h"
+#include "gstvaapibuffercache.h"
 
 G_BEGIN_DECLS
 
@@ -37,6 +38,7 @@ G_BEGIN_DECLS
   ((GstVaapiContext *) (obj))
 
 typedef struct _GstVaapiConfigInfoEncoder GstVaapiConfigInfoEncoder;
+typedef struct _GstVaapiConfigInfoDecoder GstVaapiConfigInfoDecoder;
 typedef struct _GstVaapiContextInfo GstVaapiContextInfo;
 typedef struct _GstVaapiContext GstVaapiContext;
 
@@ -71,12 +73,25 @@ struct _GstVaapiConfigInfoEncoder
   guint roi_num_supported;
 };
 
+/**
+ * GstVaapiConfigInfoDecoder:
+ * @processing: if video processing is requested within the decoding
+ *   context (VAConfigAttribDecProcessing).
+ *
+ * Extra configuration for decoding.
+ */
+struct _GstVaapiConfigInfoDecoder
+{
+  gboolean processing;
+};
+
 /**
  * GstVaapiContextInfo:
  *
  * Structure holding VA context info like encoded size, decoder
  * profile and entry-point to use, and maximum number of reference
- * frames reported by the bitstream.
+ * frames reported by the bitstream. @surface_alloc_flags are the
+ * #GstVaapiSurfaceAllocFlags the context surfaces are allocated with.
  */
 struct _GstVaapiContextInfo
 {
@@ -87,15 +102,18 @@ struct _GstVaapiContextInfo
   guint width;
   guint height;
   guint ref_frames;
+  guint surface_alloc_flags;
   union _GstVaapiConfigInfo {
     GstVaapiConfigInfoEncoder encoder;
+    GstVaapiConfigInfoDecoder decoder;
   } config;
 };
 
 /**
  * GstVaapiContext:
  *
- * A VA context wrapper.
+ * A VA context wrapper. @dec_processing is set if the decoding
+ * configuration was created with video processing support.
  */
 struct _GstVaapiContext
 {
@@ -114,6 +132,8 @@ struct _GstVaapiContext
   gboolean reset_on_resize;
   GstVaapiConfigSurfaceAttributes *attribs;
   GstVideoFormat preferred_format;
+  GstVaapiBufferCache *buffer_cache;
+  gboolean dec_processing;
 };
 
 #define GST_VAAPI_CONTEXT_ID(context)        (((GstVaapiContext *)(context))->object_id)
@@ -155,6 +175,21 @@ gboolean
 gst_vaapi_context_get_surface_attributes (GstVaapiContext * context,
     GstVaapiConfigSurfaceAttributes * out_attribs);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_context_create_buffer (GstVaapiContext * context,
+    VABufferType type, guint size, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_release_buffer (GstVaapiContext * context,
+    VABufferID * buf_id_ptr, gpointer * mapped_data);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_commit_buffers (GstVaapiContext * context);
+
 G_GNUC_INTERNAL
 GstVaapiContext *
 gst_vaapi_context_ref (GstVaapiContext * context);
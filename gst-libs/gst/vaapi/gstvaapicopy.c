@@ -0,0 +1,399 @@
+/*
+ *  gstvaapicopy.c - Plane copy kernels
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapicopy
+ * @short_description: Plane copy kernels
+ *
+ * Mapped VA images usually live in write-combining memory, which is
+ * not cached: regular loads from it are very slow, and stores are
+ * only efficient when they fill whole cache lines. The SIMD kernels
+ * below read such memory with streaming loads (MOVNTDQA) and write it
+ * with non-temporal stores, a full cache line at a time. Copies
+ * between cached buffers simply use memcpy().
+ *
+ * The kernel is selected at runtime from the CPU features. It can be
+ * forced with the GST_VAAPI_COPY_KERNEL environment variable, set to
+ * one of "scalar", "sse4.1", "avx2" or "neon".
+ */
+
+#include "sysdeps.h"
+#include "gstvaapicopy.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define USE_X86_KERNELS 0
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_NEON_KERNELS 1
+#include <arm_neon.h>
+#else
+#define USE_NEON_KERNELS 0
+#endif
+
+typedef void (*CopyLineFunc) (guint8 * dst, const guint8 * src, gsize n,
+    guint flags);
+
+static const gchar *kernel_names[GST_VAAPI_COPY_KERNEL_COUNT] = {
+  "auto", "scalar", "sse4.1", "avx2", "neon",
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- x86 kernels                                                       --- */
+/* ------------------------------------------------------------------------- */
+
+#if USE_X86_KERNELS
+/* Copies @n bytes, aligning on the uncached side so that loads or
+   stores hitting write-combining memory can be non-temporal */
+__attribute__ ((target ("sse4.1")))
+static void
+copy_line_sse4_1 (guint8 * dst, const guint8 * src, gsize n, guint flags)
+{
+  const gboolean src_uncached = (flags & GST_VAAPI_COPY_FLAG_SRC_UNCACHED);
+  gboolean nt_load, nt_store;
+  gsize head;
+
+  head = src_uncached ? (16 - ((guintptr) src & 15)) & 15 :
+      (16 - ((guintptr) dst & 15)) & 15;
+  head = MIN (head, n);
+  memcpy (dst, src, head);
+  dst += head;
+  src += head;
+  n -= head;
+
+  nt_load = src_uncached && ((guintptr) src & 15) == 0;
+  nt_store = (flags & GST_VAAPI_COPY_FLAG_DST_UNCACHED) &&
+      ((guintptr) dst & 15) == 0;
+
+  for (; n >= 64; n -= 64, src += 64, dst += 64) {
+    __m128i x0, x1, x2, x3;
+
+    if (nt_load) {
+      x0 = _mm_stream_load_si128 ((__m128i *) src + 0);
+      x1 = _mm_stream_load_si128 ((__m128i *) src + 1);
+      x2 = _mm_stream_load_si128 ((__m128i *) src + 2);
+      x3 = _mm_stream_load_si128 ((__m128i *) src + 3);
+    } else {
+      x0 = _mm_loadu_si128 ((const __m128i *) src + 0);
+      x1 = _mm_loadu_si128 ((const __m128i *) src + 1);
+      x2 = _mm_loadu_si128 ((const __m128i *) src + 2);
+      x3 = _mm_loadu_si128 ((const __m128i *) src + 3);
+    }
+
+    if (nt_store) {
+      _mm_stream_si128 ((__m128i *) dst + 0, x0);
+      _mm_stream_si128 ((__m128i *) dst + 1, x1);
+      _mm_stream_si128 ((__m128i *) dst + 2, x2);
+      _mm_stream_si128 ((__m128i *) dst + 3, x3);
+    } else {
+      _mm_storeu_si128 ((__m128i *) dst + 0, x0);
+      _mm_storeu_si128 ((__m128i *) dst + 1, x1);
+      _mm_storeu_si128 ((__m128i *) dst + 2, x2);
+      _mm_storeu_si128 ((__m128i *) dst + 3, x3);
+    }
+  }
+
+  for (; n >= 16; n -= 16, src += 16, dst += 16) {
+    const __m128i x0 = nt_load ? _mm_stream_load_si128 ((__m128i *) src) :
+        _mm_loadu_si128 ((const __m128i *) src);
+
+    if (nt_store)
+      _mm_stream_si128 ((__m128i *) dst, x0);
+    else
+      _mm_storeu_si128 ((__m128i *) dst, x0);
+  }
+
+  memcpy (dst, src, n);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+copy_line_avx2 (guint8 * dst, const guint8 * src, gsize n, guint flags)
+{
+  const gboolean src_uncached = (flags & GST_VAAPI_COPY_FLAG_SRC_UNCACHED);
+  gboolean nt_load, nt_store;
+  gsize head;
+
+  head = src_uncached ? (32 - ((guintptr) src & 31)) & 31 :
+      (32 - ((guintptr) dst & 31)) & 31;
+  head = MIN (head, n);
+  memcpy (dst, src, head);
+  dst += head;
+  src += head;
+  n -= head;
+
+  nt_load = src_uncached && ((guintptr) src & 31) == 0;
+  nt_store = (flags & GST_VAAPI_COPY_FLAG_DST_UNCACHED) &&
+      ((guintptr) dst & 31) == 0;
+
+  for (; n >= 64; n -= 64, src += 64, dst += 64) {
+    __m256i y0, y1;
+
+    if (nt_load) {
+      y0 = _mm256_stream_load_si256 ((const __m256i *) src + 0);
+      y1 = _mm256_stream_load_si256 ((const __m256i *) src + 1);
+    } else {
+      y0 = _mm256_loadu_si256 ((const __m256i *) src + 0);
+      y1 = _mm256_loadu_si256 ((const __m256i *) src + 1);
+    }
+
+    if (nt_store) {
+      _mm256_stream_si256 ((__m256i *) dst + 0, y0);
+      _mm256_stream_si256 ((__m256i *) dst + 1, y1);
+    } else {
+      _mm256_storeu_si256 ((__m256i *) dst + 0, y0);
+      _mm256_storeu_si256 ((__m256i *) dst + 1, y1);
+    }
+  }
+
+  if (n >= 32) {
+    const __m256i y0 = nt_load ?
+        _mm256_stream_load_si256 ((const __m256i *) src) :
+        _mm256_loadu_si256 ((const __m256i *) src);
+
+    if (nt_store)
+      _mm256_stream_si256 ((__m256i *) dst, y0);
+    else
+      _mm256_storeu_si256 ((__m256i *) dst, y0);
+    n -= 32;
+    src += 32;
+    dst += 32;
+  }
+
+  memcpy (dst, src, n);
+}
+
+/* Orders the non-temporal stores before the image gets unmapped */
+static void
+copy_fence_x86 (void)
+{
+  _mm_sfence ();
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- ARM kernels                                                       --- */
+/* ------------------------------------------------------------------------- */
+
+#if USE_NEON_KERNELS
+/* NEON has no streaming loads: read whole cache lines at once, which
+   is what matters the most for write-combining memory */
+static void
+copy_line_neon (guint8 * dst, const guint8 * src, gsize n, guint flags)
+{
+  for (; n >= 64; n -= 64, src += 64, dst += 64) {
+    const uint8x16_t q0 = vld1q_u8 (src + 0);
+    const uint8x16_t q1 = vld1q_u8 (src + 16);
+    const uint8x16_t q2 = vld1q_u8 (src + 32);
+    const uint8x16_t q3 = vld1q_u8 (src + 48);
+
+    vst1q_u8 (dst + 0, q0);
+    vst1q_u8 (dst + 16, q1);
+    vst1q_u8 (dst + 32, q2);
+    vst1q_u8 (dst + 48, q3);
+  }
+
+  for (; n >= 16; n -= 16, src += 16, dst += 16)
+    vst1q_u8 (dst, vld1q_u8 (src));
+
+  memcpy (dst, src, n);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- Kernel selection                                                  --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_copy_kernel_is_supported:
+ * @kernel: a #GstVaapiCopyKernel
+ *
+ * Return value: %TRUE if @kernel was built in and can run on this CPU
+ */
+gboolean
+gst_vaapi_copy_kernel_is_supported (GstVaapiCopyKernel kernel)
+{
+  switch (kernel) {
+    case GST_VAAPI_COPY_KERNEL_AUTO:
+    case GST_VAAPI_COPY_KERNEL_SCALAR:
+      return TRUE;
+#if USE_X86_KERNELS
+    case GST_VAAPI_COPY_KERNEL_SSE4_1:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("sse4.1");
+    case GST_VAAPI_COPY_KERNEL_AVX2:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("avx2");
+#endif
+#if USE_NEON_KERNELS
+    case GST_VAAPI_COPY_KERNEL_NEON:
+      return TRUE;
+#endif
+    default:
+      break;
+  }
+  return FALSE;
+}
+
+/**
+ * gst_vaapi_copy_kernel_get_name:
+ * @kernel: a #GstVaapiCopyKernel
+ *
+ * Return value: the name of @kernel, as used by GST_VAAPI_COPY_KERNEL
+ */
+const gchar *
+gst_vaapi_copy_kernel_get_name (GstVaapiCopyKernel kernel)
+{
+  g_return_val_if_fail (kernel < GST_VAAPI_COPY_KERNEL_COUNT, NULL);
+
+  return kernel_names[kernel];
+}
+
+static GstVaapiCopyKernel
+detect_kernel (void)
+{
+  static const GstVaapiCopyKernel preferred[] = {
+    GST_VAAPI_COPY_KERNEL_AVX2,
+    GST_VAAPI_COPY_KERNEL_SSE4_1,
+    GST_VAAPI_COPY_KERNEL_NEON,
+  };
+  const gchar *env;
+  guint i;
+
+  env = g_getenv ("GST_VAAPI_COPY_KERNEL");
+  if (env) {
+    for (i = GST_VAAPI_COPY_KERNEL_SCALAR; i < GST_VAAPI_COPY_KERNEL_COUNT;
+        i++) {
+      if (g_ascii_strcasecmp (env, kernel_names[i]) != 0)
+        continue;
+      if (gst_vaapi_copy_kernel_is_supported (i))
+        return i;
+      break;
+    }
+    GST_WARNING ("unsupported copy kernel '%s', using autodetection", env);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (preferred); i++) {
+    if (gst_vaapi_copy_kernel_is_supported (preferred[i]))
+      return preferred[i];
+  }
+  return GST_VAAPI_COPY_KERNEL_SCALAR;
+}
+
+/**
+ * gst_vaapi_copy_get_default_kernel:
+ *
+ * Return value: the kernel used for %GST_VAAPI_COPY_KERNEL_AUTO
+ */
+GstVaapiCopyKernel
+gst_vaapi_copy_get_default_kernel (void)
+{
+  static gsize g_kernel = 0;
+
+  if (g_once_init_enter (&g_kernel)) {
+    const GstVaapiCopyKernel kernel = detect_kernel ();
+
+    GST_INFO ("using %s copy kernel", kernel_names[kernel]);
+    g_once_init_leave (&g_kernel, kernel);
+  }
+  return g_kernel;
+}
+
+/**
+ * gst_vaapi_copy_plane:
+ * @kernel: the #GstVaapiCopyKernel to use
+ * @flags: #GstVaapiCopyFlags
+ * @dst: the destination pixels
+ * @dst_stride: the destination stride, in bytes
+ * @src: the source pixels
+ * @src_stride: the source stride, in bytes
+ * @width: the number of bytes to copy per line
+ * @height: the number of lines
+ *
+ * Copies a rectangle of @width bytes by @height lines. An unsupported
+ * @kernel falls back to the scalar implementation.
+ */
+void
+gst_vaapi_copy_plane (GstVaapiCopyKernel kernel, guint flags,
+    guint8 * dst, guint dst_stride, const guint8 * src, guint src_stride,
+    guint width, guint height)
+{
+  CopyLineFunc copy_line = NULL;
+  void (*fence) (void) = NULL;
+  guint i;
+
+  if (width == 0 || height == 0)
+    return;
+
+  if (kernel == GST_VAAPI_COPY_KERNEL_AUTO)
+    kernel = gst_vaapi_copy_get_default_kernel ();
+  else if (!gst_vaapi_copy_kernel_is_supported (kernel))
+    kernel = GST_VAAPI_COPY_KERNEL_SCALAR;
+
+  /* Nothing beats memcpy() between cached buffers */
+  if (flags & (GST_VAAPI_COPY_FLAG_SRC_UNCACHED |
+          GST_VAAPI_COPY_FLAG_DST_UNCACHED)) {
+    switch (kernel) {
+#if USE_X86_KERNELS
+      case GST_VAAPI_COPY_KERNEL_SSE4_1:
+        copy_line = copy_line_sse4_1;
+        fence = copy_fence_x86;
+        break;
+      case GST_VAAPI_COPY_KERNEL_AVX2:
+        copy_line = copy_line_avx2;
+        fence = copy_fence_x86;
+        break;
+#endif
+#if USE_NEON_KERNELS
+      case GST_VAAPI_COPY_KERNEL_NEON:
+        copy_line = copy_line_neon;
+        break;
+#endif
+      default:
+        break;
+    }
+  }
+
+  if (!copy_line) {
+    if (dst_stride == width && src_stride == width) {
+      memcpy (dst, src, (gsize) width * height);
+      return;
+    }
+    for (i = 0; i < height; i++) {
+      memcpy (dst, src, width);
+      dst += dst_stride;
+      src += src_stride;
+    }
+    return;
+  }
+
+  for (i = 0; i < height; i++) {
+    copy_line (dst, src, width, flags);
+    dst += dst_stride;
+    src += src_stride;
+  }
+  if (fence)
+    fence ();
+}
@@ -0,0 +1,83 @@
+/*
+ *  gstvaapicopy.h - Plane copy kernels
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_COPY_H
+#define GST_VAAPI_COPY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstVaapiCopyKernel:
+ * @GST_VAAPI_COPY_KERNEL_AUTO: the best kernel supported by the CPU
+ * @GST_VAAPI_COPY_KERNEL_SCALAR: plain memcpy() of each line
+ * @GST_VAAPI_COPY_KERNEL_SSE4_1: 128-bit streaming loads and stores
+ * @GST_VAAPI_COPY_KERNEL_AVX2: 256-bit streaming loads and stores
+ * @GST_VAAPI_COPY_KERNEL_NEON: 128-bit NEON loads and stores
+ *
+ * The implementations of gst_vaapi_copy_plane().
+ */
+typedef enum
+{
+  GST_VAAPI_COPY_KERNEL_AUTO = 0,
+  GST_VAAPI_COPY_KERNEL_SCALAR,
+  GST_VAAPI_COPY_KERNEL_SSE4_1,
+  GST_VAAPI_COPY_KERNEL_AVX2,
+  GST_VAAPI_COPY_KERNEL_NEON,
+
+  GST_VAAPI_COPY_KERNEL_COUNT
+} GstVaapiCopyKernel;
+
+/**
+ * GstVaapiCopyFlags:
+ * @GST_VAAPI_COPY_FLAG_SRC_UNCACHED: the source is a mapped VA image,
+ *   likely living in uncached write-combining memory
+ * @GST_VAAPI_COPY_FLAG_DST_UNCACHED: the destination is a mapped VA
+ *   image, likely living in uncached write-combining memory
+ *
+ * Hints used to select non-temporal loads and stores.
+ */
+typedef enum
+{
+  GST_VAAPI_COPY_FLAG_SRC_UNCACHED = 1 << 0,
+  GST_VAAPI_COPY_FLAG_DST_UNCACHED = 1 << 1,
+} GstVaapiCopyFlags;
+
+G_GNUC_INTERNAL
+GstVaapiCopyKernel
+gst_vaapi_copy_get_default_kernel (void);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_copy_kernel_is_supported (GstVaapiCopyKernel kernel);
+
+G_GNUC_INTERNAL
+const gchar *
+gst_vaapi_copy_kernel_get_name (GstVaapiCopyKernel kernel);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_copy_plane (GstVaapiCopyKernel kernel, guint flags,
+    guint8 * dst, guint dst_stride, const guint8 * src, guint src_stride,
+    guint width, guint height);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_COPY_H */
@@ -33,7 +33,9 @@
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapiparser_frame.h"
 #include "gstvaapisurfaceproxy_priv.h"
+#include "gstvaapisurfacepool.h"
 #include "gstvaapiutils.h"
+#include "gstvaapitrace.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -46,10 +48,27 @@ enum
 };
 static GParamSpec *g_properties[N_PROPERTIES] = { NULL, };
 
+/* Output frames are drained after each decoded input buffer, so this
+ * is larger than the biggest DPB plus any dropped frame in between.
+ * Any further frame waits in the overflow queue */
+#define DECODER_FRAMES_QUEUE_SIZE 64
+
+/* Number of frames the parser thread may run ahead of the submit
+ * stage when the decoder is pipelined */
+#define DECODER_PARSED_FRAMES_QUEUE_SIZE 4
+
 G_DEFINE_TYPE (GstVaapiDecoder, gst_vaapi_decoder, GST_TYPE_OBJECT);
 
 static void drop_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame);
 
+/* Maps the offset of a unit in the output adapter to its offset in
+ * the original input buffer, for the zero-copy path */
+typedef struct
+{
+  guint output_offset;
+  guint input_offset;
+} UnitOffset;
+
 static void
 parser_state_reset (GstVaapiParserState * ps)
 {
@@ -60,6 +79,10 @@ parser_state_reset (GstVaapiParserState * ps)
     gst_adapter_clear (ps->output_adapter);
   ps->current_adapter = NULL;
 
+  gst_buffer_replace (&ps->input_buffer, NULL);
+  ps->input_buffer_id++;
+  ps->frame_buffer_id = 0;
+
   if (ps->next_unit_pending) {
     gst_vaapi_decoder_unit_clear (&ps->next_unit);
     ps->next_unit_pending = FALSE;
@@ -73,6 +96,17 @@ parser_state_reset (GstVaapiParserState * ps)
 static void
 parser_state_finalize (GstVaapiParserState * ps)
 {
+  if (ps->num_frames > 0)
+    GST_INFO ("parsed %" G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT
+        " without copy, %" G_GUINT64_FORMAT " bytes copied", ps->num_frames,
+        ps->num_zero_copy_frames, ps->bytes_copied);
+
+  gst_buffer_replace (&ps->input_buffer, NULL);
+  if (ps->unit_offsets) {
+    g_array_unref (ps->unit_offsets);
+    ps->unit_offsets = NULL;
+  }
+
   if (ps->input_adapter) {
     gst_adapter_clear (ps->input_adapter);
     g_object_unref (ps->input_adapter);
@@ -103,9 +137,156 @@ parser_state_init (GstVaapiParserState * ps)
   ps->output_adapter = gst_adapter_new ();
   if (!ps->output_adapter)
     return FALSE;
+
+  ps->unit_offsets = g_array_new (FALSE, FALSE, sizeof (UnitOffset));
+  if (!ps->unit_offsets)
+    return FALSE;
+  return TRUE;
+}
+
+/* Tracks the buffer pushed to the input adapter. It can only be
+   referenced directly if it is the only data held in there */
+static void
+parser_state_push_buffer (GstVaapiParserState * ps, GstBuffer * buffer)
+{
+  if (gst_adapter_available (ps->input_adapter) == 0) {
+    gst_buffer_replace (&ps->input_buffer, buffer);
+    ps->input_buffer_size = gst_buffer_get_size (buffer);
+  } else {
+    gst_buffer_replace (&ps->input_buffer, NULL);
+  }
+  /* zero is reserved for frames that can't use the zero-copy path */
+  if (++ps->input_buffer_id == 0)
+    ps->input_buffer_id++;
+
+  gst_adapter_push (ps->input_adapter, buffer);
+}
+
+/* Records where the next unit to be taken from the input adapter
+   lives, in the output adapter and in the original input buffer */
+static void
+parser_state_add_unit (GstVaapiParserState * ps, guint unit_size)
+{
+  UnitOffset uo;
+
+  uo.output_offset = gst_adapter_available (ps->output_adapter);
+  if (uo.output_offset == 0) {
+    ps->frame_buffer_id = ps->input_buffer ? ps->input_buffer_id : 0;
+    g_array_set_size (ps->unit_offsets, 0);
+  }
+
+  if (ps->frame_buffer_id != 0 && ps->frame_buffer_id == ps->input_buffer_id) {
+    uo.input_offset = ps->input_buffer_size -
+        gst_adapter_available (ps->input_adapter);
+    g_array_append_val (ps->unit_offsets, uo);
+  } else {
+    ps->frame_buffer_id = 0;
+  }
+
+  /* gst_adapter_take_buffer() merges data spanning several buffers */
+  if (gst_adapter_available_fast (ps->input_adapter) < unit_size)
+    ps->frame_bytes_copied += unit_size;
+}
+
+static gboolean
+remap_unit_offsets (GstVaapiParserState * ps, GArray * units, gboolean apply)
+{
+  guint i, j;
+
+  for (i = 0; i < units->len; i++) {
+    GstVaapiDecoderUnit *const unit =
+        &g_array_index (units, GstVaapiDecoderUnit, i);
+
+    if (unit->size == 0)
+      continue;
+
+    for (j = 0; j < ps->unit_offsets->len; j++) {
+      UnitOffset *const uo = &g_array_index (ps->unit_offsets, UnitOffset, j);
+      if (uo->output_offset == unit->offset)
+        break;
+    }
+    if (j == ps->unit_offsets->len)
+      return FALSE;
+    if (apply)
+      unit->offset =
+          g_array_index (ps->unit_offsets, UnitOffset, j).input_offset;
+  }
   return TRUE;
 }
 
+static void
+parser_state_end_frame (GstVaapiParserState * ps)
+{
+  GST_LOG ("frame %" G_GUINT64_FORMAT ": %u bytes copied", ps->num_frames,
+      ps->frame_bytes_copied);
+  ps->bytes_copied += ps->frame_bytes_copied;
+  ps->frame_bytes_copied = 0;
+  ps->num_frames++;
+}
+
+/* Fast path for frame-aligned input fed with gst_vaapi_decoder_put_buffer():
+   if all the units of the frame were parsed from a single input buffer,
+   reference that buffer as is and express the units as offsets into
+   it, instead of merging the units accumulated in the output adapter */
+static GstBuffer *
+parser_state_take_frame_buffer (GstVaapiParserState * ps,
+    GstVaapiParserFrame * frame)
+{
+  GstBuffer *buffer = NULL;
+  guint size;
+
+  if (ps->frame_buffer_id != 0 && ps->frame_buffer_id == ps->input_buffer_id
+      && ps->unit_offsets->len > 0) {
+    /* offsets are only rewritten once all units are known to map */
+    if (remap_unit_offsets (ps, frame->pre_units, FALSE) &&
+        remap_unit_offsets (ps, frame->units, FALSE) &&
+        remap_unit_offsets (ps, frame->post_units, FALSE)) {
+      remap_unit_offsets (ps, frame->pre_units, TRUE);
+      remap_unit_offsets (ps, frame->units, TRUE);
+      remap_unit_offsets (ps, frame->post_units, TRUE);
+      ps->num_zero_copy_frames++;
+      gst_adapter_clear (ps->output_adapter);
+      buffer = gst_buffer_ref (ps->input_buffer);
+    } else {
+      GST_WARNING ("failed to map units to the input buffer");
+    }
+  }
+
+  if (!buffer) {
+    size = gst_adapter_available (ps->output_adapter);
+    if (gst_adapter_available_fast (ps->output_adapter) < size)
+      ps->frame_bytes_copied += size;
+    buffer = gst_adapter_take_buffer (ps->output_adapter, size);
+  }
+
+  parser_state_end_frame (ps);
+  return buffer;
+}
+
+/* Frames parsed with gst_vaapi_decoder_parse() are assembled by the
+   caller. GstVideoDecoder takes the units of frame-aligned input as
+   sub-buffers of the input buffer, so mapping the frame only copies
+   if its memories are not contiguous parts of a single memory */
+static void
+parser_state_account_frame_buffer (GstVaapiParserState * ps,
+    GstBuffer * buffer)
+{
+  gsize offset;
+  guint i, n;
+
+  n = gst_buffer_n_memory (buffer);
+  for (i = 1; i < n; i++) {
+    if (!gst_memory_is_span (gst_buffer_peek_memory (buffer, i - 1),
+            gst_buffer_peek_memory (buffer, i), &offset)) {
+      ps->frame_bytes_copied += gst_buffer_get_size (buffer);
+      break;
+    }
+  }
+  if (ps->frame_bytes_copied == 0)
+    ps->num_zero_copy_frames++;
+  parser_state_end_frame (ps);
+}
+
 static void
 parser_state_prepare (GstVaapiParserState * ps, GstAdapter * adapter)
 {
@@ -133,7 +314,12 @@ push_buffer (GstVaapiDecoder * decoder, GstBuffer * buffer)
   GST_DEBUG ("queue encoded data buffer %p (%zu bytes)",
       buffer, gst_buffer_get_size (buffer));
 
+  /* The parser thread checks for pending buffers with the pipeline
+     lock held before going to sleep */
+  g_mutex_lock (&decoder->pipeline_lock);
   g_async_queue_push (decoder->buffers, buffer);
+  g_cond_broadcast (&decoder->pipeline_cond);
+  g_mutex_unlock (&decoder->pipeline_lock);
   return TRUE;
 }
 
@@ -168,8 +354,8 @@ do_parse (GstVaapiDecoder * decoder,
   frame = gst_video_codec_frame_get_user_data (base_frame);
   if (!frame) {
     GstVideoCodecState *const codec_state = decoder->codec_state;
-    frame = gst_vaapi_parser_frame_new (codec_state->info.width,
-        codec_state->info.height);
+    frame = gst_vaapi_parser_frame_new (decoder->object_cache,
+        codec_state->info.width, codec_state->info.height);
     if (!frame)
       return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
     gst_video_codec_frame_set_user_data (base_frame,
@@ -277,16 +463,17 @@ do_decode_1 (GstVaapiDecoder * decoder, GstVaapiParserFrame * frame)
 static inline GstVaapiDecoderStatus
 do_decode (GstVaapiDecoder * decoder, GstVideoCodecFrame * base_frame)
 {
-  GstVaapiParserState *const ps = &decoder->parser_state;
   GstVaapiParserFrame *const frame = base_frame->user_data;
   GstVaapiDecoderStatus status;
 
-  ps->current_frame = base_frame;
+  decoder->decode_frame = base_frame;
 
   gst_vaapi_parser_frame_ref (frame);
   status = do_decode_1 (decoder, frame);
   gst_vaapi_parser_frame_unref (frame);
 
+  decoder->decode_frame = NULL;
+
   switch ((guint) status) {
     case GST_VAAPI_DECODER_STATUS_DROP_FRAME:
       drop_frame (decoder, base_frame);
@@ -296,8 +483,10 @@ do_decode (GstVaapiDecoder * decoder, GstVideoCodecFrame * base_frame)
   return status;
 }
 
+/* Parses the queued buffers until a full frame is available, which
+ * is returned in *out_frame_ptr */
 static GstVaapiDecoderStatus
-decode_step (GstVaapiDecoder * decoder)
+parse_step (GstVaapiDecoder * decoder, GstVideoCodecFrame ** out_frame_ptr)
 {
   GstVaapiParserState *const ps = &decoder->parser_state;
   GstVaapiDecoderStatus status;
@@ -305,6 +494,8 @@ decode_step (GstVaapiDecoder * decoder)
   gboolean got_frame;
   guint got_unit_size, input_size;
 
+  *out_frame_ptr = NULL;
+
   /* Fill adapter with all buffers we have in the queue */
   for (;;) {
     buffer = pop_buffer (decoder);
@@ -313,7 +504,7 @@ decode_step (GstVaapiDecoder * decoder)
 
     ps->at_eos = GST_BUFFER_IS_EOS (buffer);
     if (!ps->at_eos)
-      gst_adapter_push (ps->input_adapter, buffer);
+      parser_state_push_buffer (ps, buffer);
   }
 
   /* Parse and decode all decode units */
@@ -343,6 +534,7 @@ decode_step (GstVaapiDecoder * decoder)
     }
 
     if (got_unit_size > 0) {
+      parser_state_add_unit (ps, got_unit_size);
       buffer = gst_adapter_take_buffer (ps->input_adapter, got_unit_size);
       input_size -= got_unit_size;
 
@@ -353,14 +545,9 @@ decode_step (GstVaapiDecoder * decoder)
     }
 
     if (got_frame) {
-      ps->current_frame->input_buffer =
-          gst_adapter_take_buffer (ps->output_adapter,
-          gst_adapter_available (ps->output_adapter));
-
-      status = do_decode (decoder, ps->current_frame);
-      GST_DEBUG ("decode frame (status = %d)", status);
-
-      gst_video_codec_frame_unref (ps->current_frame);
+      ps->current_frame->input_buffer = parser_state_take_frame_buffer (ps,
+          ps->current_frame->user_data);
+      *out_frame_ptr = ps->current_frame;
       ps->current_frame = NULL;
       break;
     }
@@ -368,6 +555,311 @@ decode_step (GstVaapiDecoder * decoder)
   return status;
 }
 
+static GstVaapiDecoderStatus
+submit_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
+{
+  GstVaapiDecoderStatus status;
+  gint64 start, elapsed;
+
+  /* The spans of the submit stage belong to this frame, whichever
+     thread submits it */
+  gst_vaapi_trace_set_frame (frame->system_frame_number);
+
+  start = g_get_monotonic_time ();
+  status = do_decode (decoder, frame);
+  elapsed = g_get_monotonic_time () - start;
+  GST_DEBUG ("decode frame (status = %d)", status);
+  gst_video_codec_frame_unref (frame);
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  decoder->stats.submit_time += elapsed;
+  decoder->stats.num_frames++;
+  g_mutex_unlock (&decoder->pipeline_lock);
+  return status;
+}
+
+static gpointer
+parse_thread_func (gpointer data)
+{
+  GstVaapiDecoder *const decoder = data;
+  GstVideoCodecFrame *frame;
+  GstVaapiDecoderStatus status;
+  gint64 start, elapsed;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  for (;;) {
+    if (g_queue_get_length (&decoder->parsed_frames) >=
+        DECODER_PARSED_FRAMES_QUEUE_SIZE) {
+      start = g_get_monotonic_time ();
+      while (!decoder->parse_stop && g_queue_get_length
+          (&decoder->parsed_frames) >= DECODER_PARSED_FRAMES_QUEUE_SIZE)
+        g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+      decoder->stats.parse_stall_time += g_get_monotonic_time () - start;
+    }
+    if (decoder->parse_stop)
+      break;
+    g_mutex_unlock (&decoder->pipeline_lock);
+
+    start = g_get_monotonic_time ();
+    status = parse_step (decoder, &frame);
+    elapsed = g_get_monotonic_time () - start;
+
+    g_mutex_lock (&decoder->pipeline_lock);
+    decoder->stats.parse_time += elapsed;
+    if (frame) {
+      g_queue_push_tail (&decoder->parsed_frames, frame);
+      g_cond_broadcast (&decoder->pipeline_cond);
+      continue;
+    }
+    if (status == GST_VAAPI_DECODER_STATUS_SUCCESS)
+      continue;
+    if (status != GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
+      /* End-of-stream or error: hold on until the submit stage has
+         drained the parsed frames and reported it, as decode_step()
+         would have done */
+      decoder->parse_status = status;
+      g_cond_broadcast (&decoder->pipeline_cond);
+      while (!decoder->parse_stop &&
+          decoder->parse_status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+        g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+      continue;
+    }
+
+    /* Buffers are only pushed with the pipeline lock held, so none can
+       be missed between this check and the wait */
+    decoder->parse_idle = TRUE;
+    g_cond_broadcast (&decoder->pipeline_cond);
+    while (!decoder->parse_stop &&
+        g_async_queue_length (decoder->buffers) == 0)
+      g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+    decoder->parse_idle = FALSE;
+  }
+  g_mutex_unlock (&decoder->pipeline_lock);
+  return NULL;
+}
+
+static gboolean
+pipeline_start (GstVaapiDecoder * decoder)
+{
+  if (decoder->parse_thread)
+    return TRUE;
+
+  decoder->parse_stop = FALSE;
+  decoder->parse_idle = FALSE;
+  decoder->parse_status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  decoder->parse_thread = g_thread_try_new ("vaapidecoder-parse",
+      parse_thread_func, decoder, NULL);
+  if (!decoder->parse_thread) {
+    GST_WARNING ("failed to create parser thread, decoding serially");
+    decoder->pipelined = FALSE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+pipeline_stop (GstVaapiDecoder * decoder)
+{
+  GstVideoCodecFrame *frame;
+
+  if (!decoder->parse_thread && !decoder->submit_thread)
+    return;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  decoder->parse_stop = TRUE;
+  g_cond_broadcast (&decoder->pipeline_cond);
+  g_mutex_unlock (&decoder->pipeline_lock);
+
+  if (decoder->parse_thread) {
+    g_thread_join (decoder->parse_thread);
+    decoder->parse_thread = NULL;
+  }
+  if (decoder->submit_thread) {
+    g_thread_join (decoder->submit_thread);
+    decoder->submit_thread = NULL;
+  }
+
+  while ((frame = g_queue_pop_head (&decoder->parsed_frames)))
+    gst_video_codec_frame_unref (frame);
+}
+
+/* Submit stage of the pipeline: takes the next frame parsed by the
+ * parser thread, waiting for it if the parser is still busy */
+static GstVaapiDecoderStatus
+pipeline_decode_step (GstVaapiDecoder * decoder)
+{
+  GstVideoCodecFrame *frame;
+  GstVaapiDecoderStatus status;
+  gint64 start;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  start = g_get_monotonic_time ();
+  for (;;) {
+    frame = g_queue_pop_head (&decoder->parsed_frames);
+    if (frame) {
+      /* Room for the parser thread */
+      g_cond_broadcast (&decoder->pipeline_cond);
+      status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+      break;
+    }
+    if (decoder->parse_status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
+      status = decoder->parse_status;
+      decoder->parse_status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+      g_cond_broadcast (&decoder->pipeline_cond);
+      break;
+    }
+    if (decoder->parse_idle && g_async_queue_length (decoder->buffers) == 0) {
+      status = GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+      break;
+    }
+    g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+  }
+  decoder->stats.submit_stall_time += g_get_monotonic_time () - start;
+  g_mutex_unlock (&decoder->pipeline_lock);
+
+  if (!frame)
+    return status;
+  return submit_frame (decoder, frame);
+}
+
+/* Submit stage for the frames parsed with gst_vaapi_decoder_parse(),
+ * which are queued by gst_vaapi_decoder_submit(). A frame which fails
+ * to decode is output as dropped, and the error is reported by the
+ * next gst_vaapi_decoder_submit() or gst_vaapi_decoder_wait_submitted() */
+static gpointer
+submit_thread_func (gpointer data)
+{
+  GstVaapiDecoder *const decoder = data;
+  GstVideoCodecFrame *frame;
+  GstVaapiDecoderStatus status;
+  gint64 start;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  for (;;) {
+    start = g_get_monotonic_time ();
+    while (!decoder->parse_stop && g_queue_is_empty (&decoder->parsed_frames))
+      g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+    decoder->stats.submit_stall_time += g_get_monotonic_time () - start;
+    if (decoder->parse_stop)
+      break;
+
+    frame = g_queue_pop_head (&decoder->parsed_frames);
+    decoder->submit_busy = TRUE;
+    g_cond_broadcast (&decoder->pipeline_cond);
+    g_mutex_unlock (&decoder->pipeline_lock);
+
+    status = submit_frame (decoder, gst_video_codec_frame_ref (frame));
+    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+      drop_frame (decoder, frame);
+    gst_video_codec_frame_unref (frame);
+
+    g_mutex_lock (&decoder->pipeline_lock);
+    decoder->submit_busy = FALSE;
+    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS &&
+        decoder->submit_status == GST_VAAPI_DECODER_STATUS_SUCCESS)
+      decoder->submit_status = status;
+    g_cond_broadcast (&decoder->pipeline_cond);
+  }
+  g_mutex_unlock (&decoder->pipeline_lock);
+  return NULL;
+}
+
+static gboolean
+submit_thread_start (GstVaapiDecoder * decoder)
+{
+  if (decoder->submit_thread)
+    return TRUE;
+
+  decoder->parse_stop = FALSE;
+  decoder->submit_busy = FALSE;
+  decoder->submit_status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  decoder->submit_thread = g_thread_try_new ("vaapidecoder-submit",
+      submit_thread_func, decoder, NULL);
+  if (!decoder->submit_thread) {
+    GST_WARNING ("failed to create submit thread, decoding serially");
+    decoder->pipelined = FALSE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static GstVaapiDecoderStatus
+decode_step (GstVaapiDecoder * decoder)
+{
+  GstVideoCodecFrame *frame;
+  GstVaapiDecoderStatus status;
+  gint64 start, elapsed;
+
+  if (decoder->pipelined && pipeline_start (decoder))
+    return pipeline_decode_step (decoder);
+
+  start = g_get_monotonic_time ();
+  status = parse_step (decoder, &frame);
+  elapsed = g_get_monotonic_time () - start;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  decoder->stats.parse_time += elapsed;
+  g_mutex_unlock (&decoder->pipeline_lock);
+
+  if (!frame)
+    return status;
+  return submit_frame (decoder, frame);
+}
+
+/* Frames which do not fit into the ring go to the overflow queue, and
+   so do all the next ones until it is drained, so that the frames are
+   output in order. The ring only shrinks meanwhile. Only the producer
+   adds frames to the overflow queue, so it is known to stay empty
+   while num_frames_overflow is zero */
+static void
+queue_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
+{
+  gst_video_codec_frame_ref (frame);
+
+  if (G_LIKELY (g_atomic_int_get (&decoder->num_frames_overflow) == 0)
+      && gst_vaapi_ring_queue_push (decoder->frames, frame))
+    return;
+
+  g_mutex_lock (&decoder->frames_overflow_lock);
+  if (!g_queue_is_empty (&decoder->frames_overflow)
+      || !gst_vaapi_ring_queue_push (decoder->frames, frame)) {
+    GST_DEBUG ("output queue full, holding frame %d",
+        frame->system_frame_number);
+    g_queue_push_tail (&decoder->frames_overflow, frame);
+    g_atomic_int_inc (&decoder->num_frames_overflow);
+  }
+  g_mutex_unlock (&decoder->frames_overflow_lock);
+}
+
+static GstVideoCodecFrame *
+pop_frame_overflow (GstVaapiDecoder * decoder)
+{
+  GstVideoCodecFrame *frame;
+
+  if (G_LIKELY (g_atomic_int_get (&decoder->num_frames_overflow) == 0))
+    return NULL;
+
+  g_mutex_lock (&decoder->frames_overflow_lock);
+  frame = gst_vaapi_ring_queue_try_pop (decoder->frames);
+  if (!frame) {
+    frame = g_queue_pop_head (&decoder->frames_overflow);
+    if (frame)
+      g_atomic_int_add (&decoder->num_frames_overflow, -1);
+  }
+  g_mutex_unlock (&decoder->frames_overflow_lock);
+  return frame;
+}
+
+static void
+clear_frames (GstVaapiDecoder * decoder)
+{
+  GstVideoCodecFrame *frame;
+
+  gst_vaapi_ring_queue_clear (decoder->frames);
+  while ((frame = pop_frame_overflow (decoder)))
+    gst_video_codec_frame_unref (frame);
+}
+
 static void
 drop_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
 {
@@ -380,7 +872,7 @@ drop_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
   GST_VIDEO_CODEC_FRAME_FLAG_SET (frame,
       GST_VIDEO_CODEC_FRAME_FLAG_DECODE_ONLY);
 
-  g_async_queue_push (decoder->frames, gst_video_codec_frame_ref (frame));
+  queue_frame (decoder, frame);
 }
 
 static inline void
@@ -391,7 +883,7 @@ push_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
   GST_DEBUG ("push frame %d (surface 0x%08x)", frame->system_frame_number,
       (guint32) GST_VAAPI_SURFACE_PROXY_SURFACE_ID (proxy));
 
-  g_async_queue_push (decoder->frames, gst_video_codec_frame_ref (frame));
+  queue_frame (decoder, frame);
 }
 
 static inline GstVideoCodecFrame *
@@ -400,10 +892,12 @@ pop_frame (GstVaapiDecoder * decoder, guint64 timeout)
   GstVideoCodecFrame *frame;
   GstVaapiSurfaceProxy *proxy;
 
-  if (G_LIKELY (timeout > 0))
-    frame = g_async_queue_timeout_pop (decoder->frames, timeout);
-  else
-    frame = g_async_queue_try_pop (decoder->frames);
+  /* Nothing is added to the overflow queue while the ring is empty */
+  frame = gst_vaapi_ring_queue_try_pop (decoder->frames);
+  if (!frame)
+    frame = pop_frame_overflow (decoder);
+  if (!frame && G_LIKELY (timeout > 0))
+    frame = gst_vaapi_ring_queue_timeout_pop (decoder->frames, timeout);
   if (!frame)
     return NULL;
 
@@ -459,6 +953,18 @@ gst_vaapi_decoder_finalize (GObject * object)
 {
   GstVaapiDecoder *const decoder = GST_VAAPI_DECODER (object);
 
+  pipeline_stop (decoder);
+  g_mutex_clear (&decoder->pipeline_lock);
+  g_cond_clear (&decoder->pipeline_cond);
+
+  if (decoder->stats.num_frames > 0) {
+    GST_INFO ("%" G_GUINT64_FORMAT " frames, parse %" G_GUINT64_FORMAT
+        " us (stalled %" G_GUINT64_FORMAT " us), submit %" G_GUINT64_FORMAT
+        " us (stalled %" G_GUINT64_FORMAT " us)", decoder->stats.num_frames,
+        decoder->stats.parse_time, decoder->stats.parse_stall_time,
+        decoder->stats.submit_time, decoder->stats.submit_stall_time);
+  }
+
   gst_video_codec_state_unref (decoder->codec_state);
   decoder->codec_state = NULL;
 
@@ -470,9 +976,13 @@ gst_vaapi_decoder_finalize (GObject * object)
   }
 
   if (decoder->frames) {
-    g_async_queue_unref (decoder->frames);
+    clear_frames (decoder);
+    gst_vaapi_ring_queue_free (decoder->frames);
     decoder->frames = NULL;
   }
+  g_mutex_clear (&decoder->frames_overflow_lock);
+
+  gst_vaapi_video_pool_replace (&decoder->processing_pool, NULL);
 
   if (decoder->context) {
     gst_vaapi_context_unref (decoder->context);
@@ -483,6 +993,16 @@ gst_vaapi_decoder_finalize (GObject * object)
   gst_vaapi_display_replace (&decoder->display, NULL);
   decoder->va_display = NULL;
 
+  if (decoder->object_cache) {
+    GstVaapiMiniObjectCacheStats stats;
+
+    gst_vaapi_mini_object_cache_get_stats (decoder->object_cache, &stats);
+    GST_INFO ("objects: %" G_GUINT64_FORMAT " allocated, %" G_GUINT64_FORMAT
+        " recycled", stats.num_allocs, stats.num_reuses);
+    gst_vaapi_mini_object_cache_unref (decoder->object_cache);
+    decoder->object_cache = NULL;
+  }
+
   G_OBJECT_CLASS (gst_vaapi_decoder_parent_class)->finalize (object);
 }
 
@@ -576,8 +1096,16 @@ gst_vaapi_decoder_init (GstVaapiDecoder * decoder)
   decoder->va_context = VA_INVALID_ID;
   decoder->codec_state = codec_state;
   decoder->buffers = g_async_queue_new_full ((GDestroyNotify) gst_buffer_unref);
-  decoder->frames = g_async_queue_new_full ((GDestroyNotify)
-      gst_video_codec_frame_unref);
+  decoder->frames = gst_vaapi_ring_queue_new (DECODER_FRAMES_QUEUE_SIZE,
+      (GDestroyNotify) gst_video_codec_frame_unref);
+  g_queue_init (&decoder->frames_overflow);
+  decoder->num_frames_overflow = 0;
+  g_mutex_init (&decoder->frames_overflow_lock);
+  decoder->object_cache = gst_vaapi_mini_object_cache_new_default ();
+
+  g_mutex_init (&decoder->pipeline_lock);
+  g_cond_init (&decoder->pipeline_cond);
+  g_queue_init (&decoder->parsed_frames);
 }
 
 /**
@@ -835,6 +1363,160 @@ gst_vaapi_decoder_get_frame_with_timeout (GstVaapiDecoder * decoder,
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
+/**
+ * gst_vaapi_decoder_set_pipelined:
+ * @decoder: a #GstVaapiDecoder
+ * @pipelined: %TRUE to parse and submit frames in separate threads
+ *
+ * If @pipelined is %TRUE, gst_vaapi_decoder_get_surface() submits
+ * the frames that a parser thread extracts from the buffers passed to
+ * gst_vaapi_decoder_put_buffer(). The next frames are then parsed
+ * while the current one is submitted to the hardware. The parser
+ * thread runs at most a few frames ahead.
+ *
+ * Likewise, the frames parsed with gst_vaapi_decoder_parse() and
+ * passed to gst_vaapi_decoder_submit() are submitted from a separate
+ * thread, while the caller parses the next ones.
+ *
+ * This is only supported by the H.264 and H.265 decoders, whose parse
+ * stage does not depend on the decode stage, and only before any
+ * buffer was decoded.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_decoder_set_pipelined (GstVaapiDecoder * decoder,
+    gboolean pipelined)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+  g_return_val_if_fail (decoder->parse_thread == NULL, FALSE);
+  g_return_val_if_fail (decoder->submit_thread == NULL, FALSE);
+
+  if (pipelined && decoder->codec != GST_VAAPI_CODEC_H264 &&
+      decoder->codec != GST_VAAPI_CODEC_H265) {
+    GST_WARNING_OBJECT (decoder, "pipelining not supported for codec %s",
+        gst_vaapi_codec_get_name (decoder->codec));
+    return FALSE;
+  }
+
+  decoder->pipelined = pipelined;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_decoder_get_stats:
+ * @decoder: a #GstVaapiDecoder
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Fills in @stats with the per-stage timing of the frames decoded so
+ * far through gst_vaapi_decoder_get_surface(). This tells whether
+ * the parsing or the submission to the hardware is the bottleneck.
+ */
+void
+gst_vaapi_decoder_get_stats (GstVaapiDecoder * decoder,
+    GstVaapiDecoderStats * stats)
+{
+  GstVaapiMiniObjectCacheStats cache_stats;
+
+  g_return_if_fail (decoder != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  *stats = decoder->stats;
+  g_mutex_unlock (&decoder->pipeline_lock);
+
+  gst_vaapi_mini_object_cache_get_stats (decoder->object_cache, &cache_stats);
+  stats->num_object_allocs = cache_stats.num_allocs;
+  stats->num_object_reuses = cache_stats.num_reuses;
+}
+
+/**
+ * gst_vaapi_decoder_set_surface_alloc_flags:
+ * @decoder: a #GstVaapiDecoder
+ * @surface_alloc_flags: #GstVaapiSurfaceAllocFlags
+ *
+ * Sets the flags the decoded surfaces are allocated with, e.g.
+ * %GST_VAAPI_SURFACE_ALLOC_FLAG_COMPRESSED when they are only consumed
+ * by VA elements. The surfaces already allocated are kept as is.
+ */
+void
+gst_vaapi_decoder_set_surface_alloc_flags (GstVaapiDecoder * decoder,
+    guint surface_alloc_flags)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->surface_alloc_flags = surface_alloc_flags;
+}
+
+/**
+ * gst_vaapi_decoder_set_processing:
+ * @decoder: a #GstVaapiDecoder
+ * @processing: %TRUE to request video processing within decoding
+ *
+ * Requests the decoding context to be created with video processing
+ * support, so that the frames can be scaled and color converted as
+ * part of the decoding rather than in a separate pass. This takes
+ * effect the next time the context is configured, e.g. for the first
+ * frame. Drivers without such support just decode as usual.
+ */
+void
+gst_vaapi_decoder_set_processing (GstVaapiDecoder * decoder,
+    gboolean processing)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->processing = processing;
+}
+
+/**
+ * gst_vaapi_decoder_set_processing_target:
+ * @decoder: a #GstVaapiDecoder
+ * @vinfo: (allow-none): the size and format to output, or %NULL
+ *
+ * Sets the size and format the decoded frames are scaled and converted
+ * to, if the decoding context supports it, see
+ * gst_vaapi_decoder_set_processing(). Passing %NULL outputs the decoded
+ * surfaces as is again.
+ *
+ * Field pictures, and every picture when the driver lacks support, are
+ * output as decoded: the frames which went through video processing
+ * carry %GST_VAAPI_SURFACE_PROXY_FLAG_PROCESSED.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_decoder_set_processing_target (GstVaapiDecoder * decoder,
+    const GstVideoInfo * vinfo)
+{
+  GstVaapiVideoPool *pool;
+
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  if (!vinfo) {
+    gst_vaapi_video_pool_replace (&decoder->processing_pool, NULL);
+    return TRUE;
+  }
+
+  if (decoder->processing_pool
+      && GST_VIDEO_INFO_FORMAT (&decoder->processing_info) ==
+      GST_VIDEO_INFO_FORMAT (vinfo)
+      && GST_VIDEO_INFO_WIDTH (&decoder->processing_info) ==
+      GST_VIDEO_INFO_WIDTH (vinfo)
+      && GST_VIDEO_INFO_HEIGHT (&decoder->processing_info) ==
+      GST_VIDEO_INFO_HEIGHT (vinfo))
+    return TRUE;
+
+  pool = gst_vaapi_surface_pool_new_full (decoder->display, vinfo,
+      decoder->surface_alloc_flags);
+  if (!pool)
+    return FALSE;
+  gst_vaapi_video_pool_replace (&decoder->processing_pool, pool);
+  gst_vaapi_video_pool_unref (pool);
+
+  decoder->processing_info = *vinfo;
+  return TRUE;
+}
+
 void
 gst_vaapi_decoder_set_picture_size (GstVaapiDecoder * decoder,
     guint width, guint height)
@@ -974,6 +1656,8 @@ gst_vaapi_decoder_ensure_context (GstVaapiDecoder * decoder,
   gst_vaapi_decoder_set_picture_size (decoder, cip->width, cip->height);
 
   cip->usage = GST_VAAPI_CONTEXT_USAGE_DECODE;
+  cip->surface_alloc_flags = decoder->surface_alloc_flags;
+  cip->config.decoder.processing = decoder->processing;
   if (decoder->context) {
     if (!gst_vaapi_context_reset (decoder->context, cip))
       return FALSE;
@@ -998,6 +1682,9 @@ gst_vaapi_decoder_parse (GstVaapiDecoder * decoder,
     GstVideoCodecFrame * base_frame, GstAdapter * adapter, gboolean at_eos,
     guint * got_unit_size_ptr, gboolean * got_frame_ptr)
 {
+  GstVaapiDecoderStatus status;
+  gint64 start;
+
   g_return_val_if_fail (decoder != NULL,
       GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
   g_return_val_if_fail (base_frame != NULL,
@@ -1009,8 +1696,11 @@ gst_vaapi_decoder_parse (GstVaapiDecoder * decoder,
   g_return_val_if_fail (got_frame_ptr != NULL,
       GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
 
-  return do_parse (decoder, base_frame, adapter, at_eos,
+  start = gst_vaapi_trace_begin ();
+  status = do_parse (decoder, base_frame, adapter, at_eos,
       got_unit_size_ptr, got_frame_ptr);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_PARSE, start, VA_INVALID_ID);
+  return status;
 }
 
 GstVaapiDecoderStatus
@@ -1023,9 +1713,105 @@ gst_vaapi_decoder_decode (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
   g_return_val_if_fail (frame->user_data != NULL,
       GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
 
+  if (frame->input_buffer)
+    parser_state_account_frame_buffer (&decoder->parser_state,
+        frame->input_buffer);
   return do_decode (decoder, frame);
 }
 
+/**
+ * gst_vaapi_decoder_submit:
+ * @decoder: a #GstVaapiDecoder
+ * @frame: a #GstVideoCodecFrame parsed with gst_vaapi_decoder_parse()
+ *
+ * Decodes @frame like gst_vaapi_decoder_decode() does, but from a
+ * separate thread if @decoder is pipelined, so that the next frames
+ * can be parsed meanwhile. This function only blocks while a few
+ * frames are already waiting to be decoded.
+ *
+ * The decoded frames are output in order through
+ * gst_vaapi_decoder_get_frame(). A frame which failed to decode is
+ * output with the %GST_VIDEO_CODEC_FRAME_FLAG_DECODE_ONLY flag, and
+ * the error is returned by the next call to this function, or to
+ * gst_vaapi_decoder_wait_submitted(), whichever comes first. If
+ * @decoder is not pipelined, that is the current call.
+ *
+ * Return value: a #GstVaapiDecoderStatus
+ */
+GstVaapiDecoderStatus
+gst_vaapi_decoder_submit (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
+{
+  GstVaapiDecoderStatus status;
+  gint64 start;
+
+  g_return_val_if_fail (decoder != NULL,
+      GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (frame != NULL,
+      GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (frame->user_data != NULL,
+      GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (decoder->parse_thread == NULL,
+      GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
+
+  if (!decoder->pipelined || !submit_thread_start (decoder)) {
+    status = gst_vaapi_decoder_decode (decoder, frame);
+    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+      drop_frame (decoder, frame);
+    return status;
+  }
+
+  if (frame->input_buffer)
+    parser_state_account_frame_buffer (&decoder->parser_state,
+        frame->input_buffer);
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  if (g_queue_get_length (&decoder->parsed_frames) >=
+      DECODER_PARSED_FRAMES_QUEUE_SIZE) {
+    start = g_get_monotonic_time ();
+    while (g_queue_get_length (&decoder->parsed_frames) >=
+        DECODER_PARSED_FRAMES_QUEUE_SIZE)
+      g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+    decoder->stats.parse_stall_time += g_get_monotonic_time () - start;
+  }
+  g_queue_push_tail (&decoder->parsed_frames, gst_video_codec_frame_ref (frame));
+  g_cond_broadcast (&decoder->pipeline_cond);
+
+  status = decoder->submit_status;
+  decoder->submit_status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  g_mutex_unlock (&decoder->pipeline_lock);
+  return status;
+}
+
+/**
+ * gst_vaapi_decoder_wait_submitted:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Waits until the frames passed to gst_vaapi_decoder_submit() are
+ * decoded, and are available through gst_vaapi_decoder_get_frame().
+ *
+ * Return value: the error of the last frame which failed to decode
+ *   since the last report, if any, or %GST_VAAPI_DECODER_STATUS_SUCCESS
+ */
+GstVaapiDecoderStatus
+gst_vaapi_decoder_wait_submitted (GstVaapiDecoder * decoder)
+{
+  GstVaapiDecoderStatus status;
+
+  g_return_val_if_fail (decoder != NULL,
+      GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
+
+  if (!decoder->submit_thread)
+    return GST_VAAPI_DECODER_STATUS_SUCCESS;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  while (!g_queue_is_empty (&decoder->parsed_frames) || decoder->submit_busy)
+    g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+  status = decoder->submit_status;
+  decoder->submit_status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  g_mutex_unlock (&decoder->pipeline_lock);
+  return status;
+}
+
 /* This function really marks the end of input,
  * so that the decoder will drain out any pending
  * frames on calls to gst_vaapi_decoder_get_frame_with_timeout() */
@@ -1033,16 +1819,25 @@ GstVaapiDecoderStatus
 gst_vaapi_decoder_flush (GstVaapiDecoder * decoder)
 {
   GstVaapiDecoderClass *klass;
+  GstVaapiDecoderStatus status = GST_VAAPI_DECODER_STATUS_SUCCESS;
 
   g_return_val_if_fail (decoder != NULL,
       GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
 
   klass = GST_VAAPI_DECODER_GET_CLASS (decoder);
 
+  /* The submit thread is the only one outputting frames meanwhile */
+  status = gst_vaapi_decoder_wait_submitted (decoder);
+  if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+    GST_WARNING ("failed to decode a frame (status = %d)", status);
+
+  status = GST_VAAPI_DECODER_STATUS_SUCCESS;
   if (klass->flush)
-    return klass->flush (decoder);
+    status = klass->flush (decoder);
 
-  return GST_VAAPI_DECODER_STATUS_SUCCESS;
+  /* No more objects are needed until new input arrives */
+  gst_vaapi_mini_object_cache_clear (decoder->object_cache);
+  return status;
 }
 
 /* Reset the decoder instance to a clean state,
@@ -1061,6 +1856,9 @@ gst_vaapi_decoder_reset (GstVaapiDecoder * decoder)
 
   GST_DEBUG ("Resetting decoder");
 
+  /* The parser thread is restarted on the next decode step */
+  pipeline_stop (decoder);
+
   if (klass->reset) {
     ret = klass->reset (decoder);
   } else {
@@ -1072,11 +1870,9 @@ gst_vaapi_decoder_reset (GstVaapiDecoder * decoder)
 
   /* Clear any buffers and frame in the queues */
   {
-    GstVideoCodecFrame *frame;
     GstBuffer *buffer;
 
-    while ((frame = g_async_queue_try_pop (decoder->frames)) != NULL)
-      gst_video_codec_frame_unref (frame);
+    clear_frames (decoder);
 
     while ((buffer = g_async_queue_try_pop (decoder->buffers)) != NULL)
       gst_buffer_unref (buffer);
@@ -1084,6 +1880,9 @@ gst_vaapi_decoder_reset (GstVaapiDecoder * decoder)
 
   parser_state_reset (&decoder->parser_state);
 
+  /* Give back the memory of the objects of the previous stream */
+  gst_vaapi_mini_object_cache_clear (decoder->object_cache);
+
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -77,6 +77,35 @@ typedef enum {
   GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN = -1
 } GstVaapiDecoderStatus;
 
+/**
+ * GstVaapiDecoderStats:
+ * @num_frames: number of frames submitted to the hardware
+ * @parse_time: time spent parsing frames, in microseconds
+ * @submit_time: time spent submitting frames to the hardware, in
+ *   microseconds
+ * @parse_stall_time: time the parser thread waited for the submit
+ *   stage to take a parsed frame, in microseconds
+ * @submit_stall_time: time the submit stage waited for the parser
+ *   thread to deliver a frame, in microseconds
+ * @num_object_allocs: number of parser and codec objects allocated
+ *   from the slice allocator
+ * @num_object_reuses: number of parser and codec objects recycled
+ *   from the decoder free-lists
+ *
+ * Per-stage timing of the frames decoded through
+ * gst_vaapi_decoder_get_surface(). The stall times are only measured
+ * when the decoder is pipelined, see gst_vaapi_decoder_set_pipelined().
+ */
+typedef struct {
+  guint64 num_frames;
+  guint64 parse_time;
+  guint64 submit_time;
+  guint64 parse_stall_time;
+  guint64 submit_stall_time;
+  guint64 num_object_allocs;
+  guint64 num_object_reuses;
+} GstVaapiDecoderStats;
+
 GType
 gst_vaapi_decoder_get_type (void) G_GNUC_CONST;
 
@@ -118,11 +147,38 @@ GstVaapiDecoderStatus
 gst_vaapi_decoder_get_frame_with_timeout (GstVaapiDecoder * decoder,
     GstVideoCodecFrame ** out_frame_ptr, guint64 timeout);
 
+gboolean
+gst_vaapi_decoder_set_pipelined (GstVaapiDecoder * decoder,
+    gboolean pipelined);
+
+void
+gst_vaapi_decoder_get_stats (GstVaapiDecoder * decoder,
+    GstVaapiDecoderStats * stats);
+
+void
+gst_vaapi_decoder_set_surface_alloc_flags (GstVaapiDecoder * decoder,
+    guint surface_alloc_flags);
+
+void
+gst_vaapi_decoder_set_processing (GstVaapiDecoder * decoder,
+    gboolean processing);
+
+gboolean
+gst_vaapi_decoder_set_processing_target (GstVaapiDecoder * decoder,
+    const GstVideoInfo * vinfo);
+
 GstVaapiDecoderStatus
 gst_vaapi_decoder_parse (GstVaapiDecoder * decoder,
     GstVideoCodecFrame * frame, GstAdapter * adapter, gboolean at_eos,
     guint * got_unit_size_ptr, gboolean * got_frame_ptr);
 
+GstVaapiDecoderStatus
+gst_vaapi_decoder_submit (GstVaapiDecoder * decoder,
+    GstVideoCodecFrame * frame);
+
+GstVaapiDecoderStatus
+gst_vaapi_decoder_wait_submitted (GstVaapiDecoder * decoder);
+
 GstVaapiDecoderStatus
 gst_vaapi_decoder_decode (GstVaapiDecoder * decoder,
     GstVideoCodecFrame * frame);
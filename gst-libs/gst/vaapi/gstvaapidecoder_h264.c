@@ -33,6 +33,7 @@
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils_h264_priv.h"
+#include "gstvaapiworkerpool.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -46,6 +47,7 @@ typedef struct _GstVaapiFrameStore GstVaapiFrameStore;
 typedef struct _GstVaapiFrameStoreClass GstVaapiFrameStoreClass;
 typedef struct _GstVaapiParserInfoH264 GstVaapiParserInfoH264;
 typedef struct _GstVaapiPictureH264 GstVaapiPictureH264;
+typedef struct _GstVaapiSliceJobH264 GstVaapiSliceJobH264;
 
 // Used for field_poc[]
 #define TOP_FIELD       0
@@ -93,11 +95,16 @@ struct _GstVaapiParserInfoH264
   guint flags;                  // Same as decoder unit flags (persistent)
   guint view_id;                // View ID of slice
   guint voc;                    // View order index (VOIdx) of slice
+  GstVaapiParserInfoH264 *pps_pi;       // PPS the slice was parsed with
+  GstVaapiParserInfoH264 *sps_pi;       // SPS the PPS was parsed with
 };
 
 static void
 gst_vaapi_parser_info_h264_finalize (GstVaapiParserInfoH264 * pi)
 {
+  gst_vaapi_mini_object_replace ((GstVaapiMiniObject **) & pi->pps_pi, NULL);
+  gst_vaapi_mini_object_replace ((GstVaapiMiniObject **) & pi->sps_pi, NULL);
+
   if (!pi->nalu.valid)
     return;
 
@@ -129,10 +136,11 @@ gst_vaapi_parser_info_h264_class (void)
 }
 
 static inline GstVaapiParserInfoH264 *
-gst_vaapi_parser_info_h264_new (void)
+gst_vaapi_parser_info_h264_new (GstVaapiDecoderH264 * decoder)
 {
   return (GstVaapiParserInfoH264 *)
-      gst_vaapi_mini_object_new (gst_vaapi_parser_info_h264_class ());
+      gst_vaapi_mini_object_new_with_cache (gst_vaapi_parser_info_h264_class (),
+      GST_VAAPI_DECODER_OBJECT_CACHE (decoder));
 }
 
 #define gst_vaapi_parser_info_h264_ref(pi) \
@@ -256,8 +264,8 @@ gst_vaapi_picture_h264_new (GstVaapiDecoderH264 * decoder)
 {
   return (GstVaapiPictureH264 *)
       gst_vaapi_codec_object_new (&GstVaapiPictureH264Class,
-      GST_VAAPI_CODEC_BASE (decoder), NULL,
-      sizeof (VAPictureParameterBufferH264), NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE (decoder),
+      NULL, sizeof (VAPictureParameterBufferH264), NULL, 0, 0);
 }
 
 static inline void
@@ -319,7 +327,8 @@ gst_vaapi_frame_store_finalize (gpointer object)
 }
 
 static GstVaapiFrameStore *
-gst_vaapi_frame_store_new (GstVaapiPictureH264 * picture)
+gst_vaapi_frame_store_new (GstVaapiDecoderH264 * decoder,
+    GstVaapiPictureH264 * picture)
 {
   GstVaapiFrameStore *fs;
 
@@ -329,7 +338,8 @@ gst_vaapi_frame_store_new (GstVaapiPictureH264 * picture)
   };
 
   fs = (GstVaapiFrameStore *)
-      gst_vaapi_mini_object_new (&GstVaapiFrameStoreClass);
+      gst_vaapi_mini_object_new_with_cache (&GstVaapiFrameStoreClass,
+      GST_VAAPI_DECODER_OBJECT_CACHE (decoder));
   if (!fs)
     return NULL;
 
@@ -489,6 +499,7 @@ struct _GstVaapiDecoderH264Private
   guint decoder_state;
   GstVaapiStreamAlignH264 stream_alignment;
   GstVaapiPictureH264 *current_picture;
+  /* Parameter sets as parsed, and the active ones as decoded */
   GstVaapiParserInfoH264 *sps[GST_H264_MAX_SPS_COUNT];
   GstVaapiParserInfoH264 *active_sps;
   GstVaapiParserInfoH264 *pps[GST_H264_MAX_PPS_COUNT];
@@ -539,6 +550,9 @@ struct _GstVaapiDecoderH264Private
 
   gboolean force_low_latency;
   gboolean base_only;
+
+  guint num_slice_threads;
+  GstVaapiWorkerPool *slice_workers;
 };
 
 /**
@@ -1115,7 +1129,7 @@ dpb_add (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
     dpb_output (decoder, fs);
 
   // Create new frame store, and split fields if necessary
-  fs = gst_vaapi_frame_store_new (picture);
+  fs = gst_vaapi_frame_store_new (decoder, picture);
   if (!fs)
     return FALSE;
   gst_vaapi_frame_store_replace (&priv->prev_frames[picture->base.voc], fs);
@@ -1262,6 +1276,9 @@ gst_vaapi_decoder_h264_close (GstVaapiDecoderH264 * decoder)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
 
+  if (priv->slice_workers)
+    gst_vaapi_worker_pool_wait (priv->slice_workers);
+
   gst_vaapi_picture_replace (&priv->current_picture, NULL);
   gst_vaapi_parser_info_h264_replace (&priv->prev_slice_pi, NULL);
   gst_vaapi_parser_info_h264_replace (&priv->prev_pi, NULL);
@@ -1303,6 +1320,8 @@ gst_vaapi_decoder_h264_destroy (GstVaapiDecoder * base_decoder)
   gst_vaapi_decoder_h264_close (decoder);
   priv->is_opened = FALSE;
 
+  g_clear_pointer (&priv->slice_workers, gst_vaapi_worker_pool_free);
+
   g_clear_pointer (&priv->dpb, g_free);
   priv->dpb_size_max = priv->dpb_size = 0;
 
@@ -1368,10 +1387,9 @@ gst_vaapi_decoder_h264_reset (GstVaapiDecoder * base_decoder)
 
 /* Activates the supplied PPS */
 static GstH264PPS *
-ensure_pps (GstVaapiDecoderH264 * decoder, GstH264PPS * pps)
+ensure_pps (GstVaapiDecoderH264 * decoder, GstVaapiParserInfoH264 * pi)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH264 *const pi = priv->pps[pps->id];
 
   gst_vaapi_parser_info_h264_replace (&priv->active_pps, pi);
   return pi ? &pi->data.pps : NULL;
@@ -1388,10 +1406,9 @@ get_pps (GstVaapiDecoderH264 * decoder)
 
 /* Activate the supplied SPS */
 static GstH264SPS *
-ensure_sps (GstVaapiDecoderH264 * decoder, GstH264SPS * sps)
+ensure_sps (GstVaapiDecoderH264 * decoder, GstVaapiParserInfoH264 * pi)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH264 *const pi = priv->sps[sps->id];
 
   /* Propagate "got I-frame" state to the next SPS unit if the
      current sequence was not ended */
@@ -1713,6 +1730,11 @@ decode_current_picture (GstVaapiDecoderH264 * decoder)
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   GstVaapiParserInfoH264 *const sps_pi = decoder->priv.active_sps;
   GstVaapiPictureH264 *const picture = priv->current_picture;
+  gboolean slices_filled = TRUE;
+
+  /* The workers may still be filling in the slice parameters */
+  if (priv->slice_workers)
+    slices_filled = gst_vaapi_worker_pool_wait (priv->slice_workers);
 
   if (!is_valid_state (priv->decoder_state, GST_H264_VIDEO_STATE_VALID_PICTURE))
     goto drop_frame;
@@ -1730,6 +1752,10 @@ decode_current_picture (GstVaapiDecoderH264 * decoder)
   if (!picture)
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
 
+  if (!slices_filled) {
+    GST_ERROR ("failed to fill in slice parameters");
+    goto error;
+  }
   if (!gst_vaapi_picture_decode (GST_VAAPI_PICTURE_CAST (picture)))
     goto error;
   if (!exec_ref_pic_marking (decoder, picture))
@@ -1778,6 +1804,7 @@ parse_sps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  gst_vaapi_parser_info_h264_replace (&priv->sps[sps->id], pi);
   priv->parser_state |= GST_H264_VIDEO_STATE_GOT_SPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1800,6 +1827,7 @@ parse_subset_sps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  gst_vaapi_parser_info_h264_replace (&priv->sps[sps->id], pi);
   priv->parser_state |= GST_H264_VIDEO_STATE_GOT_SPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1810,6 +1838,7 @@ parse_pps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   GstVaapiParserInfoH264 *const pi = unit->parsed_info;
   GstH264PPS *const pps = &pi->data.pps;
+  GstVaapiParserInfoH264 *sps_pi;
   GstH264ParserResult result;
 
   GST_DEBUG ("parse PPS");
@@ -1833,6 +1862,14 @@ parse_pps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  /* The parser's own SPS may be replaced before this PPS is decoded */
+  sps_pi = priv->sps[pps->sequence->id];
+  if (!sps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  gst_vaapi_parser_info_h264_replace (&pi->sps_pi, sps_pi);
+  pps->sequence = &sps_pi->data.sps;
+  gst_vaapi_parser_info_h264_replace (&priv->pps[pps->id], pi);
+
   priv->parser_state |= GST_H264_VIDEO_STATE_GOT_PPS;
 
   if (pps->num_slice_groups_minus1 > 0) {
@@ -1868,6 +1905,7 @@ parse_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiParserInfoH264 *const pi = unit->parsed_info;
   GstH264SliceHdr *const slice_hdr = &pi->data.slice_hdr;
   GstH264NalUnit *const nalu = &pi->nalu;
+  GstVaapiParserInfoH264 *pps_pi;
   GstH264SPS *sps;
   GstH264ParserResult result;
 
@@ -1913,6 +1951,13 @@ parse_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  /* The slice is decoded with the parameter sets it is parsed with,
+     while the parser may already be past newer ones */
+  pps_pi = priv->pps[slice_hdr->pps->id];
+  if (!pps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  gst_vaapi_parser_info_h264_replace (&pi->pps_pi, pps_pi);
+  slice_hdr->pps = &pps_pi->data.pps;
   sps = slice_hdr->pps->sequence;
 
   /* Update MVC data */
@@ -1925,42 +1970,29 @@ parse_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
+/* The parameter sets are recorded as they are parsed, and the slices
+   keep the ones they refer to, so there is nothing left to decode */
 static GstVaapiDecoderStatus
 decode_sps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
 {
-  GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH264 *const pi = unit->parsed_info;
-  GstH264SPS *const sps = &pi->data.sps;
-
   GST_DEBUG ("decode SPS");
 
-  gst_vaapi_parser_info_h264_replace (&priv->sps[sps->id], pi);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
 static GstVaapiDecoderStatus
 decode_subset_sps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
 {
-  GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH264 *const pi = unit->parsed_info;
-  GstH264SPS *const sps = &pi->data.sps;
-
   GST_DEBUG ("decode subset SPS");
 
-  gst_vaapi_parser_info_h264_replace (&priv->sps[sps->id], pi);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
 static GstVaapiDecoderStatus
 decode_pps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
 {
-  GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH264 *const pi = unit->parsed_info;
-  GstH264PPS *const pps = &pi->data.pps;
-
   GST_DEBUG ("decode PPS");
 
-  gst_vaapi_parser_info_h264_replace (&priv->pps[pps->id], pi);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -4002,9 +4034,8 @@ decode_picture (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   GstVaapiParserInfoH264 *const pi = unit->parsed_info;
-  GstH264SliceHdr *const slice_hdr = &pi->data.slice_hdr;
-  GstH264PPS *const pps = ensure_pps (decoder, slice_hdr->pps);
-  GstH264SPS *const sps = ensure_sps (decoder, slice_hdr->pps->sequence);
+  GstH264PPS *const pps = ensure_pps (decoder, pi->pps_pi);
+  GstH264SPS *const sps = ensure_sps (decoder, pi->pps_pi->sps_pi);
   GstVaapiPictureH264 *picture, *first_field;
   GstVaapiDecoderStatus status;
 
@@ -4075,13 +4106,79 @@ get_slice_data_bit_offset (GstH264SliceHdr * slice_hdr, guint nal_header_bytes)
   return 8 * nal_header_bytes + slice_hdr->header_size - epb_count * 8;
 }
 
+/*
+ * GstVaapiSliceJobH264:
+ *
+ * Everything fill_slice() reads, so that the slice parameters can be
+ * filled in by a worker thread while the next slices are parsed. The
+ * reference picture lists are copied since init_picture_refs() builds
+ * them again for each slice. The pictures they point to stay alive
+ * until the current picture is decoded, and decode_current_picture()
+ * waits for the workers first.
+ */
+struct _GstVaapiSliceJobH264
+{
+  GstVaapiSlice *slice;
+  GstVaapiParserInfoH264 *pi;
+  GstVaapiParserInfoH264 *pps_pi;
+  GstVaapiParserInfoH264 *sps_pi;
+  GstVaapiPictureH264 *RefPicList0[32];
+  guint RefPicList0_count;
+  GstVaapiPictureH264 *RefPicList1[32];
+  guint RefPicList1_count;
+};
+
+static void
+slice_job_init (GstVaapiSliceJobH264 * job, GstVaapiDecoderH264 * decoder,
+    GstVaapiSlice * slice, GstVaapiParserInfoH264 * pi)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+
+  job->slice = slice;
+  job->pi = pi;
+  job->pps_pi = priv->active_pps;
+  job->sps_pi = priv->active_sps;
+
+  job->RefPicList0_count = priv->RefPicList0_count;
+  memcpy (job->RefPicList0, priv->RefPicList0,
+      priv->RefPicList0_count * sizeof (GstVaapiPictureH264 *));
+  job->RefPicList1_count = priv->RefPicList1_count;
+  memcpy (job->RefPicList1, priv->RefPicList1,
+      priv->RefPicList1_count * sizeof (GstVaapiPictureH264 *));
+}
+
+static GstVaapiSliceJobH264 *
+slice_job_copy (const GstVaapiSliceJobH264 * src_job)
+{
+  GstVaapiSliceJobH264 *const job = g_slice_dup (GstVaapiSliceJobH264,
+      src_job);
+
+  gst_vaapi_mini_object_ref (GST_VAAPI_MINI_OBJECT (job->slice));
+  gst_vaapi_parser_info_h264_ref (job->pi);
+  gst_vaapi_parser_info_h264_ref (job->pps_pi);
+  gst_vaapi_parser_info_h264_ref (job->sps_pi);
+  return job;
+}
+
+static void
+slice_job_free (gpointer data)
+{
+  GstVaapiSliceJobH264 *const job = data;
+
+  gst_vaapi_mini_object_unref (GST_VAAPI_MINI_OBJECT (job->slice));
+  gst_vaapi_parser_info_h264_unref (job->pi);
+  gst_vaapi_parser_info_h264_unref (job->pps_pi);
+  gst_vaapi_parser_info_h264_unref (job->sps_pi);
+  g_slice_free (GstVaapiSliceJobH264, job);
+}
+
 static gboolean
-fill_pred_weight_table (GstVaapiDecoderH264 * decoder,
-    GstVaapiSlice * slice, GstH264SliceHdr * slice_hdr)
+fill_pred_weight_table (GstVaapiSliceJobH264 * job)
 {
-  VASliceParameterBufferH264 *const slice_param = slice->param;
-  GstH264PPS *const pps = get_pps (decoder);
-  GstH264SPS *const sps = get_sps (decoder);
+  VASliceParameterBufferH264 *const slice_param = job->slice->param;
+  GstH264SliceHdr *const slice_hdr = &job->pi->data.slice_hdr;
+  GstH264PPS *const pps = &job->pps_pi->data.pps;
+  GstH264SPS *const sps = &job->sps_pi->data.sps;
   GstH264PredWeightTable *const w = &slice_hdr->pred_weight_table;
   guint num_weight_tables = 0;
   gint i, j;
@@ -4145,11 +4242,10 @@ fill_pred_weight_table (GstVaapiDecoderH264 * decoder,
 }
 
 static gboolean
-fill_RefPicList (GstVaapiDecoderH264 * decoder,
-    GstVaapiSlice * slice, GstH264SliceHdr * slice_hdr)
+fill_RefPicList (GstVaapiSliceJobH264 * job)
 {
-  GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  VASliceParameterBufferH264 *const slice_param = slice->param;
+  VASliceParameterBufferH264 *const slice_param = job->slice->param;
+  GstH264SliceHdr *const slice_hdr = &job->pi->data.slice_hdr;
   guint i, num_ref_lists = 0;
 
   slice_param->num_ref_idx_l0_active_minus1 = 0;
@@ -4172,9 +4268,9 @@ fill_RefPicList (GstVaapiDecoderH264 * decoder,
   slice_param->num_ref_idx_l0_active_minus1 =
       slice_hdr->num_ref_idx_l0_active_minus1;
 
-  for (i = 0; i < priv->RefPicList0_count && priv->RefPicList0[i]; i++)
+  for (i = 0; i < job->RefPicList0_count && job->RefPicList0[i]; i++)
     vaapi_fill_picture_for_RefPicListX (&slice_param->RefPicList0[i],
-        priv->RefPicList0[i]);
+        job->RefPicList0[i]);
   if (i < 32)
     vaapi_init_picture (&slice_param->RefPicList0[i]);
 
@@ -4184,9 +4280,9 @@ fill_RefPicList (GstVaapiDecoderH264 * decoder,
   slice_param->num_ref_idx_l1_active_minus1 =
       slice_hdr->num_ref_idx_l1_active_minus1;
 
-  for (i = 0; i < priv->RefPicList1_count && priv->RefPicList1[i]; i++)
+  for (i = 0; i < job->RefPicList1_count && job->RefPicList1[i]; i++)
     vaapi_fill_picture_for_RefPicListX (&slice_param->RefPicList1[i],
-        priv->RefPicList1[i]);
+        job->RefPicList1[i]);
   if (i < 32)
     vaapi_init_picture (&slice_param->RefPicList1[i]);
 
@@ -4194,10 +4290,10 @@ fill_RefPicList (GstVaapiDecoderH264 * decoder,
 }
 
 static gboolean
-fill_slice (GstVaapiDecoderH264 * decoder,
-    GstVaapiSlice * slice, GstVaapiParserInfoH264 * pi)
+fill_slice (GstVaapiSliceJobH264 * job)
 {
-  VASliceParameterBufferH264 *const slice_param = slice->param;
+  GstVaapiParserInfoH264 *const pi = job->pi;
+  VASliceParameterBufferH264 *const slice_param = job->slice->param;
   GstH264SliceHdr *const slice_hdr = &pi->data.slice_hdr;
 
   /* Fill in VASliceParameterBufferH264 */
@@ -4215,13 +4311,45 @@ fill_slice (GstVaapiDecoderH264 * decoder,
       slice_hdr->slice_alpha_c0_offset_div2;
   slice_param->slice_beta_offset_div2 = slice_hdr->slice_beta_offset_div2;
 
-  if (!fill_RefPicList (decoder, slice, slice_hdr))
+  if (!fill_RefPicList (job))
     return FALSE;
-  if (!fill_pred_weight_table (decoder, slice, slice_hdr))
+  if (!fill_pred_weight_table (job))
     return FALSE;
   return TRUE;
 }
 
+static gboolean
+fill_slice_job (gpointer job, gpointer user_data)
+{
+  return fill_slice (job);
+}
+
+/* (Re)creates the slice workers at a picture boundary, so that no
+   job of the previous picture is left behind */
+static void
+ensure_slice_workers (GstVaapiDecoderH264 * decoder)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+
+  if (priv->slice_workers) {
+    gst_vaapi_worker_pool_wait (priv->slice_workers);
+    if (gst_vaapi_worker_pool_get_num_threads (priv->slice_workers) ==
+        priv->num_slice_threads)
+      return;
+    g_clear_pointer (&priv->slice_workers, gst_vaapi_worker_pool_free);
+  }
+
+  if (priv->num_slice_threads == 0)
+    return;
+
+  priv->slice_workers = gst_vaapi_worker_pool_new (priv->num_slice_threads,
+      fill_slice_job, slice_job_free, decoder);
+  if (!priv->slice_workers) {
+    GST_WARNING ("failed to create slice workers, filling slices serially");
+    priv->num_slice_threads = 0;
+  }
+}
+
 static GstVaapiDecoderStatus
 decode_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
 {
@@ -4229,6 +4357,7 @@ decode_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiParserInfoH264 *const pi = unit->parsed_info;
   GstVaapiPictureH264 *const picture = priv->current_picture;
   GstH264SliceHdr *const slice_hdr = &pi->data.slice_hdr;
+  GstVaapiSliceJobH264 job;
   GstVaapiSlice *slice;
   GstBuffer *const buffer =
       GST_VAAPI_DECODER_CODEC_FRAME (decoder)->input_buffer;
@@ -4241,12 +4370,12 @@ decode_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
   }
 
-  if (!ensure_pps (decoder, slice_hdr->pps)) {
+  if (!ensure_pps (decoder, pi->pps_pi)) {
     GST_ERROR ("failed to activate PPS");
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
 
-  if (!ensure_sps (decoder, slice_hdr->pps->sequence)) {
+  if (!ensure_sps (decoder, pi->pps_pi->sps_pi)) {
     GST_ERROR ("failed to activate SPS");
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
@@ -4275,7 +4404,19 @@ decode_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
 
-  if (!fill_slice (decoder, slice, pi)) {
+  slice_job_init (&job, decoder, slice, pi);
+  if (priv->slice_workers) {
+    /* Slices are still submitted in bitstream order, only their
+       parameters are filled in asynchronously */
+    gst_vaapi_picture_add_slice (GST_VAAPI_PICTURE_CAST (picture), slice);
+    if (!gst_vaapi_worker_pool_push (priv->slice_workers,
+            slice_job_copy (&job)))
+      return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+    picture->last_slice_hdr = slice_hdr;
+    return GST_VAAPI_DECODER_STATUS_SUCCESS;
+  }
+
+  if (!fill_slice (&job)) {
     gst_vaapi_mini_object_unref (GST_VAAPI_MINI_OBJECT (slice));
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
@@ -4379,7 +4520,7 @@ gst_vaapi_decoder_h264_decode_codec_data (GstVaapiDecoder * base_decoder,
   ofs = 6;
 
   for (i = 0; i < num_sps; i++) {
-    pi = gst_vaapi_parser_info_h264_new ();
+    pi = gst_vaapi_parser_info_h264_new (decoder);
     if (!pi)
       return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
     unit.parsed_info = pi;
@@ -4409,7 +4550,7 @@ gst_vaapi_decoder_h264_decode_codec_data (GstVaapiDecoder * base_decoder,
   ofs++;
 
   for (i = 0; i < num_pps; i++) {
-    pi = gst_vaapi_parser_info_h264_new ();
+    pi = gst_vaapi_parser_info_h264_new (decoder);
     if (!pi)
       return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
     unit.parsed_info = pi;
@@ -4559,7 +4700,7 @@ gst_vaapi_decoder_h264_parse (GstVaapiDecoder * base_decoder,
 
   unit->size = buf_size;
 
-  pi = gst_vaapi_parser_info_h264_new ();
+  pi = gst_vaapi_parser_info_h264_new (decoder);
   if (!pi)
     return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
 
@@ -4716,6 +4857,7 @@ gst_vaapi_decoder_h264_start_frame (GstVaapiDecoder * base_decoder,
   GstVaapiDecoderH264 *const decoder =
       GST_VAAPI_DECODER_H264_CAST (base_decoder);
 
+  ensure_slice_workers (decoder);
   return decode_picture (decoder, unit);
 }
 
@@ -4844,6 +4986,25 @@ gst_vaapi_decoder_h264_get_low_latency (GstVaapiDecoderH264 * decoder)
   return decoder->priv.force_low_latency;
 }
 
+/**
+ * gst_vaapi_decoder_h264_set_slice_threads:
+ * @decoder: a #GstVaapiDecoderH264
+ * @num_threads: the number of worker threads, or 0
+ *
+ * If @num_threads is not zero, the slice parameters of each picture
+ * are filled in by a pool of @num_threads threads, while the streaming
+ * thread carries on with the next slices. Slices are still submitted
+ * in bitstream order. The change takes effect on the next picture.
+ **/
+void
+gst_vaapi_decoder_h264_set_slice_threads (GstVaapiDecoderH264 * decoder,
+    guint num_threads)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->priv.num_slice_threads = num_threads;
+}
+
 /**
  * gst_vaapi_decoder_h264_new:
  * @display: a #GstVaapiDisplay
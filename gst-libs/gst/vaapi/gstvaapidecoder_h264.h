@@ -73,6 +73,10 @@ void
 gst_vaapi_decoder_h264_set_base_only(GstVaapiDecoderH264 * decoder,
     gboolean base_only);
 
+void
+gst_vaapi_decoder_h264_set_slice_threads(GstVaapiDecoderH264 * decoder,
+    guint num_threads);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiDecoderH264, gst_object_unref)
 
 G_END_DECLS
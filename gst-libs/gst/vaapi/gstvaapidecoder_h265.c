@@ -35,6 +35,7 @@
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils_h265_priv.h"
+#include "gstvaapiworkerpool.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -48,6 +49,7 @@ typedef struct _GstVaapiFrameStore GstVaapiFrameStore;
 typedef struct _GstVaapiFrameStoreClass GstVaapiFrameStoreClass;
 typedef struct _GstVaapiParserInfoH265 GstVaapiParserInfoH265;
 typedef struct _GstVaapiPictureH265 GstVaapiPictureH265;
+typedef struct _GstVaapiSliceJobH265 GstVaapiSliceJobH265;
 
 static gboolean nal_is_slice (guint8 nal_type);
 
@@ -88,11 +90,16 @@ struct _GstVaapiParserInfoH265
   } data;
   guint state;
   guint flags;                  // Same as decoder unit flags (persistent)
+  GstVaapiParserInfoH265 *pps_pi;       // PPS the slice was parsed with
+  GstVaapiParserInfoH265 *sps_pi;       // SPS the PPS was parsed with
 };
 
 static void
 gst_vaapi_parser_info_h265_finalize (GstVaapiParserInfoH265 * pi)
 {
+  gst_vaapi_mini_object_replace ((GstVaapiMiniObject **) & pi->pps_pi, NULL);
+  gst_vaapi_mini_object_replace ((GstVaapiMiniObject **) & pi->sps_pi, NULL);
+
   if (nal_is_slice (pi->nalu.type))
     gst_h265_slice_hdr_free (&pi->data.slice_hdr);
   else {
@@ -123,10 +130,11 @@ gst_vaapi_parser_info_h265_class (void)
 }
 
 static inline GstVaapiParserInfoH265 *
-gst_vaapi_parser_info_h265_new (void)
+gst_vaapi_parser_info_h265_new (GstVaapiDecoderH265 * decoder)
 {
   return (GstVaapiParserInfoH265 *)
-      gst_vaapi_mini_object_new (gst_vaapi_parser_info_h265_class ());
+      gst_vaapi_mini_object_new_with_cache (gst_vaapi_parser_info_h265_class (),
+      GST_VAAPI_DECODER_OBJECT_CACHE (decoder));
 }
 
 #define gst_vaapi_parser_info_h265_ref(pi) \
@@ -283,7 +291,8 @@ gst_vaapi_frame_store_finalize (gpointer object)
 }
 
 static GstVaapiFrameStore *
-gst_vaapi_frame_store_new (GstVaapiPictureH265 * picture)
+gst_vaapi_frame_store_new (GstVaapiDecoderH265 * decoder,
+    GstVaapiPictureH265 * picture)
 {
   GstVaapiFrameStore *fs;
 
@@ -293,7 +302,8 @@ gst_vaapi_frame_store_new (GstVaapiPictureH265 * picture)
   };
 
   fs = (GstVaapiFrameStore *)
-      gst_vaapi_mini_object_new (&GstVaapiFrameStoreClass);
+      gst_vaapi_mini_object_new_with_cache (&GstVaapiFrameStoreClass,
+      GST_VAAPI_DECODER_OBJECT_CACHE (decoder));
   if (!fs)
     return NULL;
 
@@ -350,6 +360,7 @@ struct _GstVaapiDecoderH265Private
   guint decoder_state;
   GstVaapiStreamAlignH265 stream_alignment;
   GstVaapiPictureH265 *current_picture;
+  /* Parameter sets as parsed, and the active ones as decoded */
   GstVaapiParserInfoH265 *vps[GST_H265_MAX_VPS_COUNT];
   GstVaapiParserInfoH265 *active_vps;
   GstVaapiParserInfoH265 *sps[GST_H265_MAX_SPS_COUNT];
@@ -411,6 +422,9 @@ struct _GstVaapiDecoderH265Private
   guint new_bitstream:1;
   guint prev_nal_is_eos:1;      /*previous nal type is EOS */
   guint associated_irap_NoRaslOutputFlag:1;
+
+  guint num_slice_threads;
+  GstVaapiWorkerPool *slice_workers;
 };
 
 /**
@@ -563,24 +577,24 @@ gst_vaapi_picture_h265_new (GstVaapiDecoderH265 * decoder)
 #if VA_CHECK_VERSION(1,2,0)
     return (GstVaapiPictureH265 *)
         gst_vaapi_codec_object_new (&GstVaapiPictureH265Class,
-        GST_VAAPI_CODEC_BASE (decoder), NULL,
-        sizeof (VAPictureParameterBufferHEVCExtension), NULL, 0, 0);
+        GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE
+        (decoder), NULL, sizeof (VAPictureParameterBufferHEVCExtension), NULL,
+        0, 0);
 #endif
     return NULL;
   } else {
     return (GstVaapiPictureH265 *)
         gst_vaapi_codec_object_new (&GstVaapiPictureH265Class,
-        GST_VAAPI_CODEC_BASE (decoder), NULL,
-        sizeof (VAPictureParameterBufferHEVC), NULL, 0, 0);
+        GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE
+        (decoder), NULL, sizeof (VAPictureParameterBufferHEVC), NULL, 0, 0);
   }
 }
 
 /* Activates the supplied PPS */
 static GstH265PPS *
-ensure_pps (GstVaapiDecoderH265 * decoder, GstH265PPS * pps)
+ensure_pps (GstVaapiDecoderH265 * decoder, GstVaapiParserInfoH265 * pi)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH265 *const pi = priv->pps[pps->id];
 
   gst_vaapi_parser_info_h265_replace (&priv->active_pps, pi);
   return pi ? &pi->data.pps : NULL;
@@ -597,10 +611,9 @@ get_pps (GstVaapiDecoderH265 * decoder)
 
 /* Activate the supplied SPS */
 static GstH265SPS *
-ensure_sps (GstVaapiDecoderH265 * decoder, GstH265SPS * sps)
+ensure_sps (GstVaapiDecoderH265 * decoder, GstVaapiParserInfoH265 * pi)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH265 *const pi = priv->sps[sps->id];
 
   /* Propagate "got I-frame" state to the next SPS unit if the current
    * sequence was not ended */
@@ -884,7 +897,7 @@ dpb_add (GstVaapiDecoderH265 * decoder, GstVaapiPictureH265 * picture)
   }
 
   /* Create new frame store */
-  fs = gst_vaapi_frame_store_new (picture);
+  fs = gst_vaapi_frame_store_new (decoder, picture);
   if (!fs)
     return FALSE;
   gst_vaapi_frame_store_replace (&priv->dpb[priv->dpb_count++], fs);
@@ -996,6 +1009,9 @@ gst_vaapi_decoder_h265_close (GstVaapiDecoderH265 * decoder)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
 
+  if (priv->slice_workers)
+    gst_vaapi_worker_pool_wait (priv->slice_workers);
+
   gst_vaapi_picture_replace (&priv->current_picture, NULL);
   gst_vaapi_parser_info_h265_replace (&priv->prev_slice_pi, NULL);
   gst_vaapi_parser_info_h265_replace (&priv->prev_independent_slice_pi, NULL);
@@ -1032,6 +1048,7 @@ gst_vaapi_decoder_h265_destroy (GstVaapiDecoder * base_decoder)
   guint i;
 
   gst_vaapi_decoder_h265_close (decoder);
+  g_clear_pointer (&priv->slice_workers, gst_vaapi_worker_pool_free);
   g_clear_pointer (&priv->dpb, g_free);
   priv->dpb_count = priv->dpb_size_max = priv->dpb_size = 0;
 
@@ -1343,6 +1360,11 @@ decode_current_picture (GstVaapiDecoderH265 * decoder)
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
   GstVaapiParserInfoH265 *const sps_pi = decoder->priv.active_sps;
   GstVaapiPictureH265 *const picture = priv->current_picture;
+  gboolean slices_filled = TRUE;
+
+  /* The workers may still be filling in the slice parameters */
+  if (priv->slice_workers)
+    slices_filled = gst_vaapi_worker_pool_wait (priv->slice_workers);
 
   if (!is_valid_state (priv->decoder_state, GST_H265_VIDEO_STATE_VALID_PICTURE)) {
     goto drop_frame;
@@ -1376,6 +1398,11 @@ decode_current_picture (GstVaapiDecoderH265 * decoder)
   if (!picture)
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
 
+  if (!slices_filled) {
+    GST_ERROR ("failed to fill in slice parameters");
+    goto error;
+  }
+
   if (!gst_vaapi_picture_decode (GST_VAAPI_PICTURE_CAST (picture)))
     goto error;
 
@@ -1416,6 +1443,8 @@ parse_vps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H265_PARSER_OK)
     return get_status (result);
 
+  gst_vaapi_parser_info_h265_replace (&priv->vps[vps->id], pi);
+
   priv->parser_state |= GST_H265_VIDEO_STATE_GOT_VPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1437,6 +1466,8 @@ parse_sps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H265_PARSER_OK)
     return get_status (result);
 
+  gst_vaapi_parser_info_h265_replace (&priv->sps[sps->id], pi);
+
   priv->parser_state |= GST_H265_VIDEO_STATE_GOT_SPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1447,6 +1478,7 @@ parse_pps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
   GstVaapiParserInfoH265 *const pi = unit->parsed_info;
   GstH265PPS *const pps = &pi->data.pps;
+  GstVaapiParserInfoH265 *sps_pi;
   GstH265ParserResult result;
   guint col_width[19], row_height[21];
 
@@ -1462,6 +1494,14 @@ parse_pps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H265_PARSER_OK)
     return get_status (result);
 
+  /* The parser's own SPS may be replaced before this PPS is decoded */
+  sps_pi = priv->sps[pps->sps->id];
+  if (!sps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  gst_vaapi_parser_info_h265_replace (&pi->sps_pi, sps_pi);
+  pps->sps = &sps_pi->data.sps;
+  gst_vaapi_parser_info_h265_replace (&priv->pps[pps->id], pi);
+
   priv->parser_state |= GST_H265_VIDEO_STATE_GOT_PPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1490,6 +1530,7 @@ parse_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
   GstVaapiParserInfoH265 *const pi = unit->parsed_info;
   GstH265SliceHdr *const slice_hdr = &pi->data.slice_hdr;
+  GstVaapiParserInfoH265 *pps_pi;
   GstH265ParserResult result;
 
   GST_DEBUG ("parse slice");
@@ -1504,21 +1545,25 @@ parse_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H265_PARSER_OK)
     return get_status (result);
 
+  /* The slice is decoded with the parameter sets it is parsed with,
+     while the parser may already be past newer ones */
+  pps_pi = priv->pps[slice_hdr->pps->id];
+  if (!pps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  gst_vaapi_parser_info_h265_replace (&pi->pps_pi, pps_pi);
+  slice_hdr->pps = &pps_pi->data.pps;
+
   priv->parser_state |= GST_H265_VIDEO_STATE_GOT_SLICE;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
+/* The parameter sets are recorded as they are parsed, and the slices
+   keep the ones they refer to */
 static GstVaapiDecoderStatus
 decode_vps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
 {
-  GstVaapiDecoderH265Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH265 *const pi = unit->parsed_info;
-  GstH265VPS *const vps = &pi->data.vps;
-
   GST_DEBUG ("decode VPS");
 
-  gst_vaapi_parser_info_h265_replace (&priv->vps[vps->id], pi);
-
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -1544,22 +1589,14 @@ decode_sps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   priv->WpOffsetHalfRangeC =
       1 << (high_precision_offsets_enabled_flag ? (bitdepthC - 1) : 7);
 
-  gst_vaapi_parser_info_h265_replace (&priv->sps[sps->id], pi);
-
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
 static GstVaapiDecoderStatus
 decode_pps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
 {
-  GstVaapiDecoderH265Private *const priv = &decoder->priv;
-  GstVaapiParserInfoH265 *const pi = unit->parsed_info;
-  GstH265PPS *const pps = &pi->data.pps;
-
   GST_DEBUG ("decode PPS");
 
-  gst_vaapi_parser_info_h265_replace (&priv->pps[pps->id], pi);
-
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -2434,9 +2471,8 @@ decode_picture (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
   GstVaapiParserInfoH265 *pi = unit->parsed_info;
-  GstH265SliceHdr *const slice_hdr = &pi->data.slice_hdr;
-  GstH265PPS *const pps = ensure_pps (decoder, slice_hdr->pps);
-  GstH265SPS *const sps = ensure_sps (decoder, slice_hdr->pps->sps);
+  GstH265PPS *const pps = ensure_pps (decoder, pi->pps_pi);
+  GstH265SPS *const sps = ensure_sps (decoder, pi->pps_pi->sps_pi);
   GstVaapiPictureH265 *picture;
   GstVaapiDecoderStatus status;
 
@@ -2507,21 +2543,101 @@ get_slice_data_byte_offset (GstH265SliceHdr * slice_hdr, guint nal_header_bytes)
   return nal_header_bytes + (slice_hdr->header_size + 7) / 8 - epb_count;
 }
 
-static gboolean
-fill_pred_weight_table (GstVaapiDecoderH265 * decoder,
-    GstVaapiSlice * slice, GstH265SliceHdr * slice_hdr)
+/*
+ * GstVaapiSliceJobH265:
+ *
+ * Everything fill_slice() reads, so that the slice parameters can be
+ * filled in by a worker thread while the next slices are parsed. The
+ * reference picture lists are copied since init_picture_refs() builds
+ * them again for each slice, and so is the AU end flag since it is
+ * set on the picture by the last slice only. The pictures the lists
+ * point to stay alive until the current picture is decoded, and
+ * decode_current_picture() waits for the workers first.
+ */
+struct _GstVaapiSliceJobH265
+{
+  GstVaapiPictureH265 *picture;
+  GstVaapiSlice *slice;
+  GstVaapiParserInfoH265 *pi;
+  GstVaapiParserInfoH265 *pps_pi;
+  GstVaapiParserInfoH265 *sps_pi;
+  GstVaapiProfile profile;
+  gint32 WpOffsetHalfRangeC;
+  gboolean is_last_slice;
+  GstVaapiPictureH265 *RefPicList0[16];
+  guint RefPicList0_count;
+  GstVaapiPictureH265 *RefPicList1[16];
+  guint RefPicList1_count;
+};
+
+static void
+slice_job_init (GstVaapiSliceJobH265 * job, GstVaapiDecoderH265 * decoder,
+    GstVaapiPictureH265 * picture, GstVaapiSlice * slice,
+    GstVaapiParserInfoH265 * pi)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
+
+  job->picture = picture;
+  job->slice = slice;
+  job->pi = pi;
+  job->pps_pi = priv->active_pps;
+  job->sps_pi = priv->active_sps;
+  job->profile = priv->profile;
+  job->WpOffsetHalfRangeC = priv->WpOffsetHalfRangeC;
+  job->is_last_slice =
+      GST_VAAPI_PICTURE_FLAG_IS_SET (picture, GST_VAAPI_PICTURE_FLAG_AU_END);
+
+  job->RefPicList0_count = priv->RefPicList0_count;
+  memcpy (job->RefPicList0, priv->RefPicList0,
+      priv->RefPicList0_count * sizeof (GstVaapiPictureH265 *));
+  job->RefPicList1_count = priv->RefPicList1_count;
+  memcpy (job->RefPicList1, priv->RefPicList1,
+      priv->RefPicList1_count * sizeof (GstVaapiPictureH265 *));
+}
+
+static GstVaapiSliceJobH265 *
+slice_job_copy (const GstVaapiSliceJobH265 * src_job)
+{
+  GstVaapiSliceJobH265 *const job = g_slice_dup (GstVaapiSliceJobH265,
+      src_job);
+
+  gst_vaapi_picture_ref (job->picture);
+  gst_vaapi_mini_object_ref (GST_VAAPI_MINI_OBJECT (job->slice));
+  gst_vaapi_parser_info_h265_ref (job->pi);
+  gst_vaapi_parser_info_h265_ref (job->pps_pi);
+  gst_vaapi_parser_info_h265_ref (job->sps_pi);
+  return job;
+}
+
+static void
+slice_job_free (gpointer data)
+{
+  GstVaapiSliceJobH265 *const job = data;
+
+  gst_vaapi_picture_unref (job->picture);
+  gst_vaapi_mini_object_unref (GST_VAAPI_MINI_OBJECT (job->slice));
+  gst_vaapi_parser_info_h265_unref (job->pi);
+  gst_vaapi_parser_info_h265_unref (job->pps_pi);
+  gst_vaapi_parser_info_h265_unref (job->sps_pi);
+  g_slice_free (GstVaapiSliceJobH265, job);
+}
+
+static gboolean
+fill_pred_weight_table (GstVaapiSliceJobH265 * job)
+{
+  GstVaapiSlice *const slice = job->slice;
+  GstH265SliceHdr *const slice_hdr = &job->pi->data.slice_hdr;
   VASliceParameterBufferHEVC *slice_param = slice->param;
-  GstH265PPS *const pps = get_pps (decoder);
-  GstH265SPS *const sps = get_sps (decoder);
+  GstH265PPS *const pps = &job->pps_pi->data.pps;
+  GstH265SPS *const sps = &job->sps_pi->data.sps;
   GstH265PredWeightTable *const w = &slice_hdr->pred_weight_table;
+  const gint32 WpOffsetHalfRangeC = job->WpOffsetHalfRangeC;
   gint chroma_weight, chroma_log2_weight_denom;
   gint i, j;
 
 #if VA_CHECK_VERSION(1,2,0)
   VASliceParameterBufferHEVCRext *slice_rext_param = NULL;
-  if (is_range_extension_profile (priv->profile)) {
+  if (is_range_extension_profile (job->profile)) {
     VASliceParameterBufferHEVCExtension *param = slice->param;
     slice_param = &param->base;
     slice_rext_param = &param->rext;
@@ -2592,17 +2708,17 @@ fill_pred_weight_table (GstVaapiDecoderH265 * decoder,
               (1 << chroma_log2_weight_denom) + w->delta_chroma_weight_l0[i][j];
           /* 7-56 */
           slice_param->ChromaOffsetL0[i][j] = CLAMP (
-              (priv->WpOffsetHalfRangeC + w->delta_chroma_offset_l0[i][j] -
-                  ((priv->WpOffsetHalfRangeC *
+              (WpOffsetHalfRangeC + w->delta_chroma_offset_l0[i][j] -
+                  ((WpOffsetHalfRangeC *
                           chroma_weight) >> chroma_log2_weight_denom)),
-              -priv->WpOffsetHalfRangeC, priv->WpOffsetHalfRangeC - 1);
+              -WpOffsetHalfRangeC, WpOffsetHalfRangeC - 1);
 #if VA_CHECK_VERSION(1,2,0)
           if (slice_rext_param)
             slice_rext_param->ChromaOffsetL0[i][j] = CLAMP (
-                (priv->WpOffsetHalfRangeC + w->delta_chroma_offset_l0[i][j] -
-                    ((priv->WpOffsetHalfRangeC *
+                (WpOffsetHalfRangeC + w->delta_chroma_offset_l0[i][j] -
+                    ((WpOffsetHalfRangeC *
                             chroma_weight) >> chroma_log2_weight_denom)),
-                -priv->WpOffsetHalfRangeC, priv->WpOffsetHalfRangeC - 1);
+                -WpOffsetHalfRangeC, WpOffsetHalfRangeC - 1);
 #endif
         }
       }
@@ -2628,19 +2744,19 @@ fill_pred_weight_table (GstVaapiDecoderH265 * decoder,
                 w->delta_chroma_weight_l1[i][j];
             /* 7-56 */
             slice_param->ChromaOffsetL1[i][j] =
-                CLAMP ((priv->WpOffsetHalfRangeC +
+                CLAMP ((WpOffsetHalfRangeC +
                     w->delta_chroma_offset_l1[i][j] -
-                    ((priv->WpOffsetHalfRangeC *
+                    ((WpOffsetHalfRangeC *
                             chroma_weight) >> chroma_log2_weight_denom)),
-                -priv->WpOffsetHalfRangeC, priv->WpOffsetHalfRangeC - 1);
+                -WpOffsetHalfRangeC, WpOffsetHalfRangeC - 1);
 #if VA_CHECK_VERSION(1,2,0)
             if (slice_rext_param)
               slice_rext_param->ChromaOffsetL1[i][j] =
-                  CLAMP ((priv->WpOffsetHalfRangeC +
+                  CLAMP ((WpOffsetHalfRangeC +
                       w->delta_chroma_offset_l1[i][j] -
-                      ((priv->WpOffsetHalfRangeC *
+                      ((WpOffsetHalfRangeC *
                               chroma_weight) >> chroma_log2_weight_denom)),
-                  -priv->WpOffsetHalfRangeC, priv->WpOffsetHalfRangeC - 1);
+                  -WpOffsetHalfRangeC, WpOffsetHalfRangeC - 1);
 #endif
           }
         }
@@ -2651,13 +2767,11 @@ fill_pred_weight_table (GstVaapiDecoderH265 * decoder,
 }
 
 static gboolean
-fill_RefPicList (GstVaapiDecoderH265 * decoder,
-    GstVaapiPictureH265 * picture, GstVaapiSlice * slice,
-    GstH265SliceHdr * slice_hdr)
+fill_RefPicList (GstVaapiSliceJobH265 * job)
 {
-  GstVaapiDecoderH265Private *const priv = &decoder->priv;
-  VASliceParameterBufferHEVC *const slice_param = slice->param;
-  GstVaapiPicture *const base_picture = &picture->base;
+  GstH265SliceHdr *const slice_hdr = &job->pi->data.slice_hdr;
+  VASliceParameterBufferHEVC *const slice_param = job->slice->param;
+  GstVaapiPicture *const base_picture = &job->picture->base;
   VAPictureParameterBufferHEVC *const pic_param = base_picture->param;
   guint i, num_ref_lists = 0, j;
 
@@ -2682,20 +2796,20 @@ fill_RefPicList (GstVaapiDecoderH265 * decoder,
   slice_param->num_ref_idx_l1_active_minus1 =
       slice_hdr->num_ref_idx_l1_active_minus1;
 
-  for (i = 0; i < priv->RefPicList0_count; i++)
+  for (i = 0; i < job->RefPicList0_count; i++)
     slice_param->RefPicList[0][i] =
         get_index_for_RefPicListX (pic_param->ReferenceFrames,
-        priv->RefPicList0[i]);
+        job->RefPicList0[i]);
   for (; i < 15; i++)
     slice_param->RefPicList[0][i] = 0xFF;
 
   if (num_ref_lists < 2)
     return TRUE;
 
-  for (i = 0; i < priv->RefPicList1_count; i++)
+  for (i = 0; i < job->RefPicList1_count; i++)
     slice_param->RefPicList[1][i] =
         get_index_for_RefPicListX (pic_param->ReferenceFrames,
-        priv->RefPicList1[i]);
+        job->RefPicList1[i]);
   for (; i < 15; i++)
     slice_param->RefPicList[1][i] = 0xFF;
 
@@ -2703,19 +2817,17 @@ fill_RefPicList (GstVaapiDecoderH265 * decoder,
 }
 
 static gboolean
-fill_slice (GstVaapiDecoderH265 * decoder,
-    GstVaapiPictureH265 * picture, GstVaapiSlice * slice,
-    GstVaapiParserInfoH265 * pi, GstVaapiDecoderUnit * unit)
+fill_slice (GstVaapiSliceJobH265 * job)
 {
+  GstVaapiParserInfoH265 *const pi = job->pi;
   GstH265SliceHdr *slice_hdr = &pi->data.slice_hdr;
-  VASliceParameterBufferHEVC *slice_param = slice->param;
+  VASliceParameterBufferHEVC *slice_param = job->slice->param;
 
 #if VA_CHECK_VERSION(1,2,0)
-  GstVaapiDecoderH265Private *const priv = &decoder->priv;
   VASliceParameterBufferHEVCRext *slice_rext_param = NULL;
-  if (is_range_extension_profile (priv->profile)
-      || is_scc_profile (priv->profile)) {
-    VASliceParameterBufferHEVCExtension *param = slice->param;
+  if (is_range_extension_profile (job->profile)
+      || is_scc_profile (job->profile)) {
+    VASliceParameterBufferHEVCExtension *param = job->slice->param;
     slice_param = &param->base;
     slice_rext_param = &param->rext;
   }
@@ -2731,7 +2843,7 @@ fill_slice (GstVaapiDecoderH265 * decoder,
 #define COPY_LFF(f) \
     slice_param->LongSliceFlags.fields.f = (slice_hdr)->f
 
-  if (GST_VAAPI_PICTURE_FLAG_IS_SET (picture, GST_VAAPI_PICTURE_FLAG_AU_END))
+  if (job->is_last_slice)
     slice_param->LongSliceFlags.fields.LastSliceOfPic = 1;
   else
     slice_param->LongSliceFlags.fields.LastSliceOfPic = 0;
@@ -2788,15 +2900,47 @@ fill_slice (GstVaapiDecoderH265 * decoder,
   }
 #endif
 
-  if (!fill_RefPicList (decoder, picture, slice, slice_hdr))
+  if (!fill_RefPicList (job))
     return FALSE;
 
-  if (!fill_pred_weight_table (decoder, slice, slice_hdr))
+  if (!fill_pred_weight_table (job))
     return FALSE;
 
   return TRUE;
 }
 
+static gboolean
+fill_slice_job (gpointer job, gpointer user_data)
+{
+  return fill_slice (job);
+}
+
+/* (Re)creates the slice workers at a picture boundary, so that no
+   job of the previous picture is left behind */
+static void
+ensure_slice_workers (GstVaapiDecoderH265 * decoder)
+{
+  GstVaapiDecoderH265Private *const priv = &decoder->priv;
+
+  if (priv->slice_workers) {
+    gst_vaapi_worker_pool_wait (priv->slice_workers);
+    if (gst_vaapi_worker_pool_get_num_threads (priv->slice_workers) ==
+        priv->num_slice_threads)
+      return;
+    g_clear_pointer (&priv->slice_workers, gst_vaapi_worker_pool_free);
+  }
+
+  if (priv->num_slice_threads == 0)
+    return;
+
+  priv->slice_workers = gst_vaapi_worker_pool_new (priv->num_slice_threads,
+      fill_slice_job, slice_job_free, decoder);
+  if (!priv->slice_workers) {
+    GST_WARNING ("failed to create slice workers, filling slices serially");
+    priv->num_slice_threads = 0;
+  }
+}
+
 static GstVaapiDecoderStatus
 decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
 {
@@ -2804,6 +2948,7 @@ decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiParserInfoH265 *const pi = unit->parsed_info;
   GstVaapiPictureH265 *const picture = priv->current_picture;
   GstH265SliceHdr *const slice_hdr = &pi->data.slice_hdr;
+  GstVaapiSliceJobH265 job;
   GstVaapiSlice *slice = NULL;
   GstBuffer *const buffer =
       GST_VAAPI_DECODER_CODEC_FRAME (decoder)->input_buffer;
@@ -2815,12 +2960,12 @@ decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
   }
 
-  if (!ensure_pps (decoder, slice_hdr->pps)) {
+  if (!ensure_pps (decoder, pi->pps_pi)) {
     GST_ERROR ("failed to activate PPS");
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
 
-  if (!ensure_sps (decoder, slice_hdr->pps->sps)) {
+  if (!ensure_sps (decoder, pi->pps_pi->sps_pi)) {
     GST_ERROR ("failed to activate SPS");
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
@@ -2855,7 +3000,19 @@ decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
 
   init_picture_refs (decoder, picture, slice_hdr);
 
-  if (!fill_slice (decoder, picture, slice, pi, unit)) {
+  slice_job_init (&job, decoder, picture, slice, pi);
+  if (priv->slice_workers) {
+    /* Slices are still submitted in bitstream order, only their
+       parameters are filled in asynchronously */
+    gst_vaapi_picture_add_slice (GST_VAAPI_PICTURE_CAST (picture), slice);
+    if (!gst_vaapi_worker_pool_push (priv->slice_workers,
+            slice_job_copy (&job)))
+      return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+    picture->last_slice_hdr = slice_hdr;
+    return GST_VAAPI_DECODER_STATUS_SUCCESS;
+  }
+
+  if (!fill_slice (&job)) {
     gst_vaapi_mini_object_unref (GST_VAAPI_MINI_OBJECT (slice));
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
@@ -2977,7 +3134,7 @@ gst_vaapi_decoder_h265_decode_codec_data (GstVaapiDecoder *
     ofs += 3;
 
     for (j = 0; j < num_nals; j++) {
-      pi = gst_vaapi_parser_info_h265_new ();
+      pi = gst_vaapi_parser_info_h265_new (decoder);
       if (!pi)
         return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
       unit.parsed_info = pi;
@@ -3155,7 +3312,7 @@ gst_vaapi_decoder_h265_parse (GstVaapiDecoder * base_decoder,
   if (!buf)
     return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
   unit->size = buf_size;
-  pi = gst_vaapi_parser_info_h265_new ();
+  pi = gst_vaapi_parser_info_h265_new (decoder);
   if (!pi)
     return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
   gst_vaapi_decoder_unit_set_parsed_info (unit,
@@ -3311,6 +3468,7 @@ gst_vaapi_decoder_h265_start_frame (GstVaapiDecoder * base_decoder,
   GstVaapiDecoderH265 *const decoder =
       GST_VAAPI_DECODER_H265_CAST (base_decoder);
 
+  ensure_slice_workers (decoder);
   return decode_picture (decoder, unit);
 }
 
@@ -3384,6 +3542,24 @@ gst_vaapi_decoder_h265_set_alignment (GstVaapiDecoderH265 * decoder,
   decoder->priv.stream_alignment = alignment;
 }
 
+/**
+ * gst_vaapi_decoder_h265_set_slice_threads:
+ * @decoder: a #GstVaapiDecoderH265
+ * @num_threads: the number of worker threads, or 0
+ *
+ * If @num_threads is not zero, the slice parameters of each picture
+ * are filled in by a pool of @num_threads threads, while the streaming
+ * thread carries on with the next slices. Slices are still submitted
+ * in bitstream order. The change takes effect on the next picture.
+ */
+void
+gst_vaapi_decoder_h265_set_slice_threads (GstVaapiDecoderH265 * decoder,
+    guint num_threads)
+{
+  g_return_if_fail (decoder != NULL);
+  decoder->priv.num_slice_threads = num_threads;
+}
+
 /**
  * gst_vaapi_decoder_h265_new:
  * @display: a #GstVaapiDisplay
@@ -63,6 +63,10 @@ void
 gst_vaapi_decoder_h265_set_alignment (GstVaapiDecoderH265 *decoder,
     GstVaapiStreamAlignH265 alignment);
 
+void
+gst_vaapi_decoder_h265_set_slice_threads (GstVaapiDecoderH265 *decoder,
+    guint num_threads);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiDecoderH265, gst_object_unref)
 
 G_END_DECLS
@@ -27,8 +27,10 @@
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapisurfaceproxy_priv.h"
+#include "gstvaapisurfacepool.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapitrace.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -76,11 +78,15 @@ gst_vaapi_picture_destroy (GstVaapiPicture * picture)
     gst_vaapi_surface_proxy_unref (picture->proxy);
     picture->proxy = NULL;
   }
+  if (picture->proc_proxy) {
+    gst_vaapi_surface_proxy_unref (picture->proc_proxy);
+    picture->proc_proxy = NULL;
+  }
   picture->surface_id = VA_INVALID_ID;
   picture->surface = NULL;
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (picture), &picture->param_id);
-  picture->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (picture),
+      &picture->param_id, &picture->param);
 
   gst_video_codec_frame_clear (&picture->frame);
   gst_vaapi_picture_replace (&picture->parent_picture, NULL);
@@ -100,6 +106,9 @@ gst_vaapi_picture_create (GstVaapiPicture * picture,
     picture->parent_picture = gst_vaapi_picture_ref (parent_picture);
 
     picture->proxy = gst_vaapi_surface_proxy_ref (parent_picture->proxy);
+    if (parent_picture->proc_proxy)
+      picture->proc_proxy =
+          gst_vaapi_surface_proxy_ref (parent_picture->proc_proxy);
     picture->type = parent_picture->type;
     picture->pts = parent_picture->pts;
     picture->poc = parent_picture->poc;
@@ -155,9 +164,9 @@ gst_vaapi_picture_create (GstVaapiPicture * picture,
   picture->surface = GST_VAAPI_SURFACE_PROXY_SURFACE (picture->proxy);
   picture->surface_id = GST_VAAPI_SURFACE_PROXY_SURFACE_ID (picture->proxy);
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (picture),
-      GET_VA_CONTEXT (picture), VAPictureParameterBufferType,
-      args->param_size, args->param, &picture->param_id, &picture->param);
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (picture),
+      VAPictureParameterBufferType, args->param_size, args->param,
+      &picture->param_id, &picture->param);
   if (!success)
     return FALSE;
   picture->param_size = args->param_size;
@@ -180,7 +189,8 @@ gst_vaapi_picture_new (GstVaapiDecoder * decoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiPictureClass,
-      GST_VAAPI_CODEC_BASE (decoder), param, param_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE (decoder),
+      param, param_size, NULL, 0, 0);
   if (!object)
     return NULL;
   return GST_VAAPI_PICTURE_CAST (object);
@@ -193,9 +203,9 @@ gst_vaapi_picture_new_field (GstVaapiPicture * picture)
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (gst_vaapi_codec_object_get_class
-      (&picture->parent_instance), GST_VAAPI_CODEC_BASE (decoder), NULL,
-      picture->param_size, picture, 0,
-      (GST_VAAPI_CREATE_PICTURE_FLAG_CLONE |
+      (&picture->parent_instance), GST_VAAPI_CODEC_BASE (decoder),
+      GST_VAAPI_DECODER_OBJECT_CACHE (decoder), NULL, picture->param_size,
+      picture, 0, (GST_VAAPI_CREATE_PICTURE_FLAG_CLONE |
           GST_VAAPI_CREATE_PICTURE_FLAG_FIELD));
   if (!object)
     return NULL;
@@ -209,8 +219,9 @@ gst_vaapi_picture_new_clone (GstVaapiPicture * picture)
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (gst_vaapi_codec_object_get_class
-      (&picture->parent_instance), GST_VAAPI_CODEC_BASE (decoder), NULL,
-      picture->param_size, picture, 0, GST_VAAPI_CREATE_PICTURE_FLAG_CLONE);
+      (&picture->parent_instance), GST_VAAPI_CODEC_BASE (decoder),
+      GST_VAAPI_DECODER_OBJECT_CACHE (decoder), NULL, picture->param_size,
+      picture, 0, GST_VAAPI_CREATE_PICTURE_FLAG_CLONE);
   if (!object)
     return NULL;
   return GST_VAAPI_PICTURE_CAST (object);
@@ -226,20 +237,83 @@ gst_vaapi_picture_add_slice (GstVaapiPicture * picture, GstVaapiSlice * slice)
 }
 
 static gboolean
-do_decode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
+do_decode (GstVaapiPicture * picture, VABufferID * buf_id, void **buf_ptr)
 {
+  VADisplay const dpy = GET_VA_DISPLAY (picture);
   VAStatus status;
 
   vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
 
-  status = vaRenderPicture (dpy, ctx, buf_id, 1);
+  status = vaRenderPicture (dpy, GET_VA_CONTEXT (picture), buf_id, 1);
   if (!vaapi_check_status (status, "vaRenderPicture()"))
     return FALSE;
 
-  /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
-  vaapi_destroy_buffer (dpy, buf_id);
+  /* The buffer is only recycled once vaEndPicture() was called */
+  gst_vaapi_context_release_buffer (GET_CONTEXT (picture), buf_id, NULL);
+  return TRUE;
+}
+
+#if VA_CHECK_VERSION(1,0,0)
+/* Scales and converts the frame into a surface of the decoder
+   processing pool while it is decoded. Fields, and any picture when
+   the context lacks video processing support, are output as decoded */
+static gboolean
+do_decode_processing (GstVaapiPicture * picture)
+{
+  GstVaapiDecoder *const decoder = GET_DECODER (picture);
+  VAProcPipelineParameterBuffer *pipeline_param;
+  VABufferID pipeline_param_id = VA_INVALID_ID;
+
+  if (!decoder->processing_pool || !GET_CONTEXT (picture)->dec_processing)
+    return TRUE;
+  if (!GST_VAAPI_PICTURE_IS_FRAME (picture)
+      || GST_VAAPI_PICTURE_IS_INTERLACED (picture))
+    return TRUE;
+
+  picture->proc_proxy =
+      gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
+      (decoder->processing_pool));
+  if (!picture->proc_proxy) {
+    GST_WARNING ("failed to allocate a surface for video processing");
+    return TRUE;
+  }
+  picture->proc_surface_id =
+      GST_VAAPI_SURFACE_PROXY_SURFACE_ID (picture->proc_proxy);
+
+  if (!gst_vaapi_context_create_buffer (GET_CONTEXT (picture),
+          VAProcPipelineParameterBufferType, sizeof (*pipeline_param), NULL,
+          &pipeline_param_id, (gpointer *) & pipeline_param))
+    goto error;
+
+  memset (pipeline_param, 0, sizeof (*pipeline_param));
+  pipeline_param->surface = picture->surface_id;
+  if (picture->has_crop_rect) {
+    picture->proc_rect.x = picture->crop_rect.x;
+    picture->proc_rect.y = picture->crop_rect.y;
+    picture->proc_rect.width = picture->crop_rect.width;
+    picture->proc_rect.height = picture->crop_rect.height;
+    pipeline_param->surface_region = &picture->proc_rect;
+  }
+  pipeline_param->output_background_color = 0xff000000;
+  pipeline_param->filter_flags = VA_FILTER_SCALING_DEFAULT;
+  pipeline_param->additional_outputs = &picture->proc_surface_id;
+  pipeline_param->num_additional_outputs = 1;
+
+  if (!do_decode (picture, &pipeline_param_id, (void **) &pipeline_param)) {
+    gst_vaapi_context_release_buffer (GET_CONTEXT (picture),
+        &pipeline_param_id, NULL);
+    goto error;
+  }
   return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    gst_vaapi_surface_proxy_replace (&picture->proc_proxy, NULL);
+    return FALSE;
+  }
 }
+#endif
 
 gboolean
 gst_vaapi_picture_decode (GstVaapiPicture * picture)
@@ -251,6 +325,7 @@ gst_vaapi_picture_decode (GstVaapiPicture * picture)
   VADisplay va_display;
   VAContextID va_context;
   VAStatus status;
+  gint64 start;
   guint i;
 
   g_return_val_if_fail (GST_VAAPI_IS_PICTURE (picture), FALSE);
@@ -260,30 +335,31 @@ gst_vaapi_picture_decode (GstVaapiPicture * picture)
 
   GST_DEBUG ("decode picture 0x%08x", picture->surface_id);
 
+  start = gst_vaapi_trace_begin ();
   status = vaBeginPicture (va_display, va_context, picture->surface_id);
   if (!vaapi_check_status (status, "vaBeginPicture()"))
     return FALSE;
 
-  if (!do_decode (va_display, va_context, &picture->param_id, &picture->param))
+  if (!do_decode (picture, &picture->param_id, &picture->param))
     return FALSE;
 
   iq_matrix = picture->iq_matrix;
-  if (iq_matrix && !do_decode (va_display, va_context,
+  if (iq_matrix && !do_decode (picture,
           &iq_matrix->param_id, &iq_matrix->param))
     return FALSE;
 
   bitplane = picture->bitplane;
-  if (bitplane && !do_decode (va_display, va_context,
+  if (bitplane && !do_decode (picture,
           &bitplane->data_id, (void **) &bitplane->data))
     return FALSE;
 
   huf_table = picture->huf_table;
-  if (huf_table && !do_decode (va_display, va_context,
+  if (huf_table && !do_decode (picture,
           &huf_table->param_id, (void **) &huf_table->param))
     return FALSE;
 
   prob_table = picture->prob_table;
-  if (prob_table && !do_decode (va_display, va_context,
+  if (prob_table && !do_decode (picture,
           &prob_table->param_id, (void **) &prob_table->param))
     return FALSE;
 
@@ -292,11 +368,11 @@ gst_vaapi_picture_decode (GstVaapiPicture * picture)
     VABufferID va_buffers[2];
 
     huf_table = slice->huf_table;
-    if (huf_table && !do_decode (va_display, va_context,
+    if (huf_table && !do_decode (picture,
             &huf_table->param_id, (void **) &huf_table->param))
       return FALSE;
 
-    vaapi_unmap_buffer (va_display, slice->param_id, NULL);
+    vaapi_unmap_buffer (va_display, slice->param_id, &slice->param);
     va_buffers[0] = slice->param_id;
     va_buffers[1] = slice->data_id;
 
@@ -305,14 +381,26 @@ gst_vaapi_picture_decode (GstVaapiPicture * picture)
       return FALSE;
   }
 
+#if VA_CHECK_VERSION(1,0,0)
+  if (!do_decode_processing (picture))
+    return FALSE;
+#endif
+
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_SUBMIT, start, picture->surface_id);
+
+  start = gst_vaapi_trace_begin ();
   status = vaEndPicture (va_display, va_context);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_END_PICTURE, start,
+      picture->surface_id);
 
   for (i = 0; i < picture->slices->len; i++) {
     GstVaapiSlice *const slice = g_ptr_array_index (picture->slices, i);
 
-    vaapi_destroy_buffer (va_display, &slice->param_id);
+    gst_vaapi_context_release_buffer (GET_CONTEXT (picture),
+        &slice->param_id, NULL);
     vaapi_destroy_buffer (va_display, &slice->data_id);
   }
+  gst_vaapi_context_commit_buffers (GET_CONTEXT (picture));
 
   if (!vaapi_check_status (status, "vaEndPicture()"))
     return FALSE;
@@ -343,10 +431,15 @@ do_output (GstVaapiPicture * picture)
   if (!picture->proxy)
     return FALSE;
 
-  proxy = gst_vaapi_surface_proxy_ref (picture->proxy);
-
-  if (picture->has_crop_rect)
-    gst_vaapi_surface_proxy_set_crop_rect (proxy, &picture->crop_rect);
+  /* The processed surface already holds the cropped frame */
+  if (picture->proc_proxy) {
+    proxy = gst_vaapi_surface_proxy_ref (picture->proc_proxy);
+    flags |= GST_VAAPI_SURFACE_PROXY_FLAG_PROCESSED;
+  } else {
+    proxy = gst_vaapi_surface_proxy_ref (picture->proxy);
+    if (picture->has_crop_rect)
+      gst_vaapi_surface_proxy_set_crop_rect (proxy, &picture->crop_rect);
+  }
 
   gst_video_codec_frame_set_user_data (out_frame,
       proxy, (GDestroyNotify) gst_vaapi_mini_object_unref);
@@ -437,8 +530,8 @@ gst_vaapi_slice_destroy (GstVaapiSlice * slice)
   gst_vaapi_codec_object_replace (&slice->huf_table, NULL);
 
   vaapi_destroy_buffer (va_display, &slice->data_id);
-  vaapi_destroy_buffer (va_display, &slice->param_id);
-  slice->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (slice), &slice->param_id,
+      &slice->param);
 }
 
 gboolean
@@ -457,7 +550,7 @@ gst_vaapi_slice_create (GstVaapiSlice * slice,
   if (!success)
     return FALSE;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (slice), GET_VA_CONTEXT (slice),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (slice),
       VASliceParameterBufferType, args->param_size, args->param,
       &slice->param_id, &slice->param);
   if (!success)
@@ -477,6 +570,7 @@ gst_vaapi_slice_new (GstVaapiDecoder * decoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiSliceClass,
-      GST_VAAPI_CODEC_BASE (decoder), param, param_size, data, data_size, 0);
+      GST_VAAPI_CODEC_BASE (decoder), GST_VAAPI_DECODER_OBJECT_CACHE (decoder),
+      param, param_size, data, data_size, 0);
   return GST_VAAPI_SLICE_CAST (object);
 }
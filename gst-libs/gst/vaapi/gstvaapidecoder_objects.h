@@ -145,6 +145,10 @@ struct _GstVaapiPicture
   GstVideoCodecFrame *frame;
   GstVaapiSurface *surface;
   GstVaapiSurfaceProxy *proxy;
+  GstVaapiSurfaceProxy *proc_proxy;
+  /* referenced by the pipeline parameters until vaEndPicture() */
+  VARectangle proc_rect;
+  VASurfaceID proc_surface_id;
   VABufferID param_id;
   guint param_size;
 
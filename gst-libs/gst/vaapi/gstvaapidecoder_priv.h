@@ -29,6 +29,7 @@
 #include <gst/vaapi/gstvaapidecoder.h>
 #include <gst/vaapi/gstvaapidecoder_unit.h>
 #include <gst/vaapi/gstvaapicontext.h>
+#include "gstvaapiringqueue.h"
 
 G_BEGIN_DECLS
 
@@ -114,17 +115,32 @@ typedef struct _GstVaapiDecoderClass GstVaapiDecoderClass;
 #define GST_VAAPI_DECODER_CODEC_DATA(decoder) \
     GST_VAAPI_DECODER_CODEC_STATE(decoder)->codec_data
 
+/**
+ * GST_VAAPI_DECODER_OBJECT_CACHE:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Macro that evaluates to the #GstVaapiMiniObjectCache the parser and
+ * codec objects of @decoder are allocated from.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#undef  GST_VAAPI_DECODER_OBJECT_CACHE
+#define GST_VAAPI_DECODER_OBJECT_CACHE(decoder) \
+    GST_VAAPI_DECODER_CAST(decoder)->object_cache
+
 /**
  * GST_VAAPI_DECODER_CODEC_FRAME:
  * @decoder: a #GstVaapiDecoder
  *
  * Macro that evaluates to the #GstVideoCodecFrame holding decoder
- * units for the current frame.
+ * units for the current frame, i.e. the frame being decoded if any,
+ * or else the frame being parsed.
  * This is an internal macro that does not do any run-time type check.
  */
 #undef  GST_VAAPI_DECODER_CODEC_FRAME
-#define GST_VAAPI_DECODER_CODEC_FRAME(decoder) \
-    GST_VAAPI_PARSER_STATE(decoder)->current_frame
+#define GST_VAAPI_DECODER_CODEC_FRAME(decoder)                  \
+    (GST_VAAPI_DECODER_CAST(decoder)->decode_frame ?            \
+        GST_VAAPI_DECODER_CAST(decoder)->decode_frame :         \
+        GST_VAAPI_PARSER_STATE(decoder)->current_frame)
 
 /**
  * GST_VAAPI_DECODER_WIDTH:
@@ -176,6 +192,20 @@ struct _GstVaapiParserState
   GstVaapiDecoderUnit next_unit;
   guint next_unit_pending:1;
   guint at_eos:1;
+
+  /* zero-copy path of gst_vaapi_decoder_put_buffer(): the only buffer
+     held in input_adapter, if any */
+  GstBuffer *input_buffer;
+  guint input_buffer_size;
+  guint32 input_buffer_id;
+  guint32 frame_buffer_id;
+  GArray *unit_offsets;
+
+  /* statistics, for both the put_buffer() and the parse() paths */
+  guint frame_bytes_copied;
+  guint64 num_frames;
+  guint64 num_zero_copy_frames;
+  guint64 bytes_copied;
 };
 
 /**
@@ -196,10 +226,38 @@ struct _GstVaapiDecoder
   GstVaapiCodec codec;
   GstVideoCodecState *codec_state;
   GAsyncQueue *buffers;
-  GAsyncQueue *frames;
+  GstVaapiRingQueue *frames;
+  GQueue frames_overflow;
+  volatile gint num_frames_overflow;
+  GMutex frames_overflow_lock;
   GstVaapiParserState parser_state;
+  GstVaapiMiniObjectCache *object_cache;
+  GstVideoCodecFrame *decode_frame;
   GstVaapiDecoderStateChangedFunc codec_state_changed_func;
   gpointer codec_state_changed_data;
+  guint surface_alloc_flags;
+
+  /* scaling and color conversion within the decoding context */
+  gboolean processing;
+  GstVideoInfo processing_info;
+  GstVaapiVideoPool *processing_pool;
+
+  /* two-stage pipeline: parse thread -> parsed_frames -> decode_step() */
+  gboolean pipelined;
+  GThread *parse_thread;
+  GMutex pipeline_lock;
+  GCond pipeline_cond;
+  GQueue parsed_frames;
+  GstVaapiDecoderStatus parse_status;
+  guint parse_stop:1;
+  guint parse_idle:1;
+
+  /* or, for gst_vaapi_decoder_parse() users:
+     gst_vaapi_decoder_submit() -> parsed_frames -> submit thread */
+  GThread *submit_thread;
+  GstVaapiDecoderStatus submit_status;
+  guint submit_busy:1;
+  GstVaapiDecoderStats stats;
 };
 
 /**
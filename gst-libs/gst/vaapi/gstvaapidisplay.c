@@ -34,6 +34,7 @@
 #include "gstvaapitexturemap.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiworkarounds.h"
+#include "gstvaapitrace.h"
 
 /* Debug category for all vaapi libs */
 GST_DEBUG_CATEGORY (gst_debug_vaapi);
@@ -462,10 +463,8 @@ static gboolean
 ensure_profiles (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
-  VAProfile *profiles = NULL;
-  VAEntrypoint *entrypoints = NULL;
-  gint i, j, n, num_entrypoints;
-  VAStatus status;
+  const GstVaapiDriverConfig *configs;
+  guint i, j, n;
   gboolean success = FALSE;
 
   GST_VAAPI_DISPLAY_LOCK (display);
@@ -488,39 +487,28 @@ ensure_profiles (GstVaapiDisplay * display)
   priv->has_profiles = TRUE;
 
   /* VA profiles */
-  profiles = g_new (VAProfile, vaMaxNumProfiles (priv->display));
-  if (!profiles)
-    goto cleanup;
-  entrypoints = g_new (VAEntrypoint, vaMaxNumEntrypoints (priv->display));
-  if (!entrypoints)
-    goto cleanup;
-
-  n = 0;
-  status = vaQueryConfigProfiles (priv->display, profiles, &n);
-  if (!vaapi_check_status (status, "vaQueryConfigProfiles()"))
+  configs = gst_vaapi_driver_cache_get_configs (priv->driver_cache, &n);
+  if (!configs)
     goto cleanup;
 
-  GST_DEBUG ("%d profiles", n);
-  for (i = 0; i < n; i++) {
-    if (profiles[i] == VAProfileNone)
-      continue;
-    GST_DEBUG ("  %s", string_of_VAProfile (profiles[i]));
-  }
-
   for (i = 0; i < n; i++) {
     GstVaapiProfileConfig config = { 0, };
 
-    config.profile = gst_vaapi_profile (profiles[i]);
-    if (!config.profile)
+    /* Video processing API */
+    if (configs[i].profile == VAProfileNone) {
+      if (configs[i].entrypoints & (1U << VAEntrypointVideoProc))
+        priv->has_vpp = TRUE;
       continue;
+    }
 
-    status = vaQueryConfigEntrypoints (priv->display,
-        profiles[i], entrypoints, &num_entrypoints);
-    if (!vaapi_check_status (status, "vaQueryConfigEntrypoints()"))
+    config.profile = gst_vaapi_profile (configs[i].profile);
+    if (!config.profile)
       continue;
 
-    for (j = 0; j < num_entrypoints; j++)
-      config.entrypoints |= (1U << gst_vaapi_entrypoint (entrypoints[j]));
+    for (j = 0; j < 32; j++) {
+      if (configs[i].entrypoints & (1U << j))
+        config.entrypoints |= (1U << gst_vaapi_entrypoint (j));
+    }
 
     priv->codecs = g_array_append_val (priv->codecs, config);
   }
@@ -544,21 +532,9 @@ ensure_profiles (GstVaapiDisplay * display)
 
   g_ptr_array_sort (priv->decoders, compare_profiles);
   g_ptr_array_sort (priv->encoders, compare_profiles);
-
-  /* Video processing API */
-  status = vaQueryConfigEntrypoints (priv->display, VAProfileNone,
-      entrypoints, &num_entrypoints);
-  if (vaapi_check_status (status, "vaQueryEntrypoints() [VAProfileNone]")) {
-    for (j = 0; j < num_entrypoints; j++) {
-      if (entrypoints[j] == VAEntrypointVideoProc)
-        priv->has_vpp = TRUE;
-    }
-  }
   success = TRUE;
 
 cleanup:
-  g_free (profiles);
-  g_free (entrypoints);
   GST_VAAPI_DISPLAY_UNLOCK (display);
   return success;
 }
@@ -651,9 +627,9 @@ static gboolean
 ensure_image_formats (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  const VAImageFormat *va_formats;
   VAImageFormat *formats = NULL;
-  VAStatus status;
-  gint i, n, max_images;
+  guint i, n;
   gboolean success = FALSE;
 
   GST_VAAPI_DISPLAY_LOCK (display);
@@ -666,16 +642,15 @@ ensure_image_formats (GstVaapiDisplay * display)
   if (!priv->image_formats)
     goto cleanup;
 
-  /* VA image formats */
-  max_images = vaMaxNumImageFormats (priv->display);
-  formats = g_new (VAImageFormat, max_images);
-  if (!formats)
+  /* VA image formats, with room for the RGBA quirk */
+  va_formats = gst_vaapi_driver_cache_get_image_formats (priv->driver_cache,
+      &n);
+  if (!va_formats)
     goto cleanup;
-
-  n = 0;
-  status = vaQueryImageFormats (priv->display, formats, &n);
-  if (!vaapi_check_status (status, "vaQueryImageFormats()"))
+  formats = g_new (VAImageFormat, n + 1);
+  if (!formats)
     goto cleanup;
+  memcpy (formats, va_formats, n * sizeof (*formats));
 
   /* XXX(victor): Force RGBA in i965 display formats.
    *
@@ -687,8 +662,6 @@ ensure_image_formats (GstVaapiDisplay * display)
    * 32bf6f1e */
   if (gst_vaapi_display_has_driver_quirks (display,
           GST_VAAPI_DRIVER_QUIRK_MISSING_RGBA_IMAGE_FORMAT)) {
-    formats = g_renew (VAImageFormat, formats, max_images + 1);
-
     formats[n].fourcc = VA_FOURCC_RGBA;
     formats[n].byte_order = VA_LSB_FIRST;
     formats[n].bits_per_pixel = 32;
@@ -700,7 +673,7 @@ ensure_image_formats (GstVaapiDisplay * display)
     n++;
   }
 
-  GST_DEBUG ("%d image formats", n);
+  GST_DEBUG ("%u image formats", n);
   for (i = 0; i < n; i++)
     GST_DEBUG ("  %" GST_FOURCC_FORMAT, GST_FOURCC_ARGS (formats[i].fourcc));
 
@@ -724,9 +697,9 @@ static gboolean
 ensure_subpicture_formats (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
-  VAImageFormat *formats = NULL;
-  unsigned int *flags = NULL;
-  VAStatus status;
+  const VAImageFormat *formats;
+  const guint *va_flags;
+  guint *flags = NULL;
   guint i, n;
   gboolean success = FALSE;
 
@@ -742,23 +715,18 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
     goto cleanup;
 
   /* VA subpicture formats */
-  n = vaMaxNumSubpictureFormats (priv->display);
-  formats = g_new (VAImageFormat, n);
+  formats = gst_vaapi_driver_cache_get_subpicture_formats (priv->driver_cache,
+      &va_flags, &n);
   if (!formats)
     goto cleanup;
-  flags = g_new (guint, n);
+  flags = g_new (guint, n + 1);
   if (!flags)
     goto cleanup;
 
-  n = 0;
-  status = vaQuerySubpictureFormats (priv->display, formats, flags, &n);
-  if (!vaapi_check_status (status, "vaQuerySubpictureFormats()"))
-    goto cleanup;
-
-  GST_DEBUG ("%d subpicture formats", n);
+  GST_DEBUG ("%u subpicture formats", n);
   for (i = 0; i < n; i++) {
     GST_DEBUG ("  %" GST_FOURCC_FORMAT, GST_FOURCC_ARGS (formats[i].fourcc));
-    flags[i] = to_GstVaapiSubpictureFlags (flags[i]);
+    flags[i] = to_GstVaapiSubpictureFlags (va_flags[i]);
   }
 
   append_formats (priv->subpicture_formats, formats, flags, n);
@@ -766,7 +734,6 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
   success = TRUE;
 
 cleanup:
-  g_free (formats);
   g_free (flags);
   GST_VAAPI_DISPLAY_UNLOCK (display);
   return success;
@@ -828,6 +795,30 @@ set_driver_quirks (GstVaapiDisplay * display)
       "(%#x)", priv->vendor_string, priv->driver_quirks);
 }
 
+/* Loads the capabilities of the driver saved by a previous process */
+static void
+ensure_driver_cache (GstVaapiDisplay * display, gint major_version,
+    gint minor_version)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  gchar *va_version;
+
+  if (priv->driver_cache)
+    return;
+
+  va_version = g_strdup_printf ("%d.%d", major_version, minor_version);
+  priv->driver_cache = gst_vaapi_driver_cache_new (priv->display, NULL,
+      priv->vendor_string, va_version,
+      priv->display_name ? priv->display_name : "default");
+  g_free (va_version);
+
+  priv->driver_cache_filename =
+      gst_vaapi_driver_cache_get_default_filename (priv->driver_cache);
+  if (priv->driver_cache_filename)
+    gst_vaapi_driver_cache_load (priv->driver_cache,
+        priv->driver_cache_filename);
+}
+
 static void
 gst_vaapi_display_calculate_pixel_aspect_ratio (GstVaapiDisplay * display)
 {
@@ -909,6 +900,15 @@ gst_vaapi_display_destroy (GstVaapiDisplay * display)
   g_clear_pointer (&priv->subpicture_formats, g_array_unref);
   g_clear_pointer (&priv->properties, g_array_unref);
 
+  if (priv->driver_cache) {
+    if (priv->driver_cache_filename)
+      gst_vaapi_driver_cache_save (priv->driver_cache,
+          priv->driver_cache_filename);
+    gst_vaapi_driver_cache_free (priv->driver_cache);
+    priv->driver_cache = NULL;
+  }
+  g_clear_pointer (&priv->driver_cache_filename, g_free);
+
   if (priv->display) {
     if (!priv->parent)
       vaTerminate (priv->display);
@@ -934,6 +934,7 @@ gst_vaapi_display_create (GstVaapiDisplay * display,
   GstVaapiDisplayInfo info = {
     .display = display,
   };
+  gint major_version = VA_MAJOR_VERSION, minor_version = VA_MINOR_VERSION;
 
   switch (init_type) {
     case GST_VAAPI_DISPLAY_INIT_FROM_VA_DISPLAY:{
@@ -969,7 +970,7 @@ gst_vaapi_display_create (GstVaapiDisplay * display,
     return FALSE;
 
   if (!priv->parent) {
-    if (!vaapi_initialize (priv->display))
+    if (!vaapi_initialize (priv->display, &major_version, &minor_version))
       return FALSE;
   }
 
@@ -978,6 +979,7 @@ gst_vaapi_display_create (GstVaapiDisplay * display,
   priv->display_name = g_strdup (info.display_name);
 
   set_driver_quirks (display);
+  ensure_driver_cache (display, major_version, minor_version);
 
   if (!ensure_image_formats (display)) {
     gst_vaapi_display_destroy (display);
@@ -987,23 +989,105 @@ gst_vaapi_display_create (GstVaapiDisplay * display,
   return TRUE;
 }
 
+/* Display locking
+ *
+ * In GST_VAAPI_DISPLAY_LOCK_MODE_GLOBAL, which is the default, the
+ * display lock serializes every VA call made by the library.
+ *
+ * In GST_VAAPI_DISPLAY_LOCK_MODE_FINE, the display lock is kept only
+ * where the library itself needs the serialization:
+ *
+ * - display state and driver queries: profiles, formats, properties,
+ *   driver cache (GST_VAAPI_DISPLAY_LOCK);
+ * - VA config and context creation and destruction, which drivers
+ *   track in per-display heaps (GST_VAAPI_DISPLAY_LOCK);
+ * - subpicture association, which updates the surface and subpicture
+ *   lists of the display (GST_VAAPI_DISPLAY_LOCK);
+ * - windowing: X11, GLX and EGL calls, which are not thread-safe
+ *   without the display lock (GST_VAAPI_DISPLAY_LOCK).
+ *
+ * Calls on a single surface, image or buffer - vaCreateSurfaces(),
+ * vaSyncSurface(), vaDeriveImage(), vaGetImage(), vaPutImage(),
+ * vaMapBuffer(), vaCreateBuffer(), vaAcquireBufferHandle() and their
+ * counterparts - go through GST_VAAPI_DISPLAY_VA_LOCK, which does not
+ * lock anything: the drivers protect their object heaps with their
+ * own locks.
+ *
+ * Submissions to a VA context only need to be serialized with the
+ * other users of that context. Decoders and encoders submit from one
+ * thread and never took the display lock for vaBeginPicture() and
+ * friends. Filters and blenders may be driven from several threads,
+ * so they use GST_VAAPI_DISPLAY_CONTEXT_LOCK with their own
+ * GstVaapiContextLock.
+ */
+
+static GstVaapiDisplayLockMode
+get_default_lock_mode (void)
+{
+  const gchar *const env = g_getenv ("GST_VAAPI_DISPLAY_LOCK_MODE");
+
+  if (env && g_ascii_strcasecmp (env, "fine") == 0)
+    return GST_VAAPI_DISPLAY_LOCK_MODE_FINE;
+  return GST_VAAPI_DISPLAY_LOCK_MODE_GLOBAL;
+}
+
+/* The display holding the lock and its statistics */
+static inline GstVaapiDisplayPrivate *
+get_lock_private (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  return priv->parent ? GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent) : priv;
+}
+
+static inline void
+lock_stats_add_hold_time (GstVaapiDisplayLockStats * stats, gint64 lock_time)
+{
+  const gint64 hold_time = g_get_monotonic_time () - lock_time;
+
+  stats->hold_time += hold_time;
+  if (stats->max_hold_time < hold_time)
+    stats->max_hold_time = hold_time;
+}
+
+static inline void
+lock_stats_add (GstVaapiDisplayLockStats * stats,
+    const GstVaapiDisplayLockStats * other)
+{
+  stats->num_locks += other->num_locks;
+  stats->num_contended += other->num_contended;
+  stats->wait_time += other->wait_time;
+  stats->hold_time += other->hold_time;
+  if (stats->max_hold_time < other->max_hold_time)
+    stats->max_hold_time = other->max_hold_time;
+}
+
 static void
 gst_vaapi_display_lock_default (GstVaapiDisplay * display)
 {
-  GstVaapiDisplayPrivate *priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  GstVaapiDisplayPrivate *const priv = get_lock_private (display);
 
-  if (priv->parent)
-    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
-  g_rec_mutex_lock (&priv->mutex);
+  if (!g_rec_mutex_trylock (&priv->mutex)) {
+    const gint64 start_time = g_get_monotonic_time ();
+
+    g_rec_mutex_lock (&priv->mutex);
+    priv->lock_stats.num_contended++;
+    priv->lock_stats.wait_time += g_get_monotonic_time () - start_time;
+  }
+
+  if (priv->lock_depth++ == 0) {
+    priv->lock_stats.num_locks++;
+    priv->lock_time = g_get_monotonic_time ();
+  }
 }
 
 static void
 gst_vaapi_display_unlock_default (GstVaapiDisplay * display)
 {
-  GstVaapiDisplayPrivate *priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  GstVaapiDisplayPrivate *const priv = get_lock_private (display);
 
-  if (priv->parent)
-    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  if (--priv->lock_depth == 0)
+    lock_stats_add_hold_time (&priv->lock_stats, priv->lock_time);
   g_rec_mutex_unlock (&priv->mutex);
 }
 
@@ -1016,6 +1100,8 @@ gst_vaapi_display_init (GstVaapiDisplay * display)
   display->priv = priv;
   priv->par_n = 1;
   priv->par_d = 1;
+  priv->lock_mode = get_default_lock_mode ();
+  gst_vaapi_trace_init ();
 
   g_rec_mutex_init (&priv->mutex);
 }
@@ -1143,6 +1229,26 @@ gst_vaapi_display_finalize (GObject * object)
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
 
   gst_vaapi_display_destroy (display);
+
+  if (priv->lock_stats.num_locks > 0) {
+    GST_INFO_OBJECT (display, "display lock (%s mode): %" G_GUINT64_FORMAT
+        " locks, %" G_GUINT64_FORMAT " contended, waited %" G_GINT64_FORMAT
+        " us, held %" G_GINT64_FORMAT " us (max %" G_GINT64_FORMAT " us)",
+        priv->lock_mode == GST_VAAPI_DISPLAY_LOCK_MODE_FINE ? "fine" :
+        "global", priv->lock_stats.num_locks, priv->lock_stats.num_contended,
+        priv->lock_stats.wait_time, priv->lock_stats.hold_time,
+        priv->lock_stats.max_hold_time);
+  }
+  if (priv->context_lock_stats.num_locks > 0) {
+    GST_INFO_OBJECT (display, "context locks: %" G_GUINT64_FORMAT
+        " locks, %" G_GUINT64_FORMAT " contended, waited %" G_GINT64_FORMAT
+        " us, held %" G_GINT64_FORMAT " us (max %" G_GINT64_FORMAT " us)",
+        priv->context_lock_stats.num_locks,
+        priv->context_lock_stats.num_contended,
+        priv->context_lock_stats.wait_time,
+        priv->context_lock_stats.hold_time,
+        priv->context_lock_stats.max_hold_time);
+  }
   g_rec_mutex_clear (&priv->mutex);
 
   G_OBJECT_CLASS (gst_vaapi_display_parent_class)->finalize (object);
@@ -1337,6 +1443,148 @@ gst_vaapi_display_unlock (GstVaapiDisplay * display)
     klass->unlock (display);
 }
 
+/**
+ * gst_vaapi_display_get_lock_mode:
+ * @display: a #GstVaapiDisplay
+ *
+ * Gets the locking policy of @display, see #GstVaapiDisplayLockMode.
+ *
+ * Return value: the #GstVaapiDisplayLockMode of @display
+ */
+GstVaapiDisplayLockMode
+gst_vaapi_display_get_lock_mode (GstVaapiDisplay * display)
+{
+  g_return_val_if_fail (display != NULL, GST_VAAPI_DISPLAY_LOCK_MODE_GLOBAL);
+
+  return get_lock_private (display)->lock_mode;
+}
+
+/**
+ * gst_vaapi_display_get_lock_stats:
+ * @display: a #GstVaapiDisplay
+ * @display_stats: (out) (allow-none): return location for the display
+ *   lock statistics
+ * @context_stats: (out) (allow-none): return location for the
+ *   statistics of the #GstVaapiContextLock released so far
+ *
+ * Gets the lock usage counters of @display. Reading them does not
+ * count as a lock.
+ */
+void
+gst_vaapi_display_get_lock_stats (GstVaapiDisplay * display,
+    GstVaapiDisplayLockStats * display_stats,
+    GstVaapiDisplayLockStats * context_stats)
+{
+  GstVaapiDisplayPrivate *priv;
+
+  g_return_if_fail (display != NULL);
+
+  priv = get_lock_private (display);
+  g_rec_mutex_lock (&priv->mutex);
+  if (display_stats)
+    *display_stats = priv->lock_stats;
+  if (context_stats)
+    *context_stats = priv->context_lock_stats;
+  g_rec_mutex_unlock (&priv->mutex);
+}
+
+/**
+ * gst_vaapi_display_va_lock:
+ * @display: a #GstVaapiDisplay
+ * @lock: (allow-none): a #GstVaapiContextLock, or %NULL
+ *
+ * Locks @display in %GST_VAAPI_DISPLAY_LOCK_MODE_GLOBAL. Otherwise,
+ * locks @lock if it is not %NULL, and does nothing if it is.
+ *
+ * Use GST_VAAPI_DISPLAY_VA_LOCK() or GST_VAAPI_DISPLAY_CONTEXT_LOCK()
+ * rather than calling this function directly.
+ */
+void
+gst_vaapi_display_va_lock (GstVaapiDisplay * display,
+    GstVaapiContextLock * lock)
+{
+  if (get_lock_private (display)->lock_mode !=
+      GST_VAAPI_DISPLAY_LOCK_MODE_FINE) {
+    gst_vaapi_display_lock (display);
+    return;
+  }
+  if (!lock)
+    return;
+
+  if (!g_mutex_trylock (&lock->mutex)) {
+    const gint64 start_time = g_get_monotonic_time ();
+
+    g_mutex_lock (&lock->mutex);
+    lock->stats.num_contended++;
+    lock->stats.wait_time += g_get_monotonic_time () - start_time;
+  }
+  lock->stats.num_locks++;
+  lock->lock_time = g_get_monotonic_time ();
+}
+
+/**
+ * gst_vaapi_display_va_unlock:
+ * @display: a #GstVaapiDisplay
+ * @lock: (allow-none): the #GstVaapiContextLock passed to
+ *   gst_vaapi_display_va_lock()
+ *
+ * Unlocks what gst_vaapi_display_va_lock() locked.
+ */
+void
+gst_vaapi_display_va_unlock (GstVaapiDisplay * display,
+    GstVaapiContextLock * lock)
+{
+  if (get_lock_private (display)->lock_mode !=
+      GST_VAAPI_DISPLAY_LOCK_MODE_FINE) {
+    gst_vaapi_display_unlock (display);
+    return;
+  }
+  if (!lock)
+    return;
+
+  lock_stats_add_hold_time (&lock->stats, lock->lock_time);
+  g_mutex_unlock (&lock->mutex);
+}
+
+/**
+ * gst_vaapi_context_lock_init:
+ * @lock: a #GstVaapiContextLock
+ *
+ * Initializes @lock.
+ */
+void
+gst_vaapi_context_lock_init (GstVaapiContextLock * lock)
+{
+  g_return_if_fail (lock != NULL);
+
+  memset (lock, 0, sizeof (*lock));
+  g_mutex_init (&lock->mutex);
+}
+
+/**
+ * gst_vaapi_context_lock_clear:
+ * @lock: a #GstVaapiContextLock
+ * @display: (allow-none): the #GstVaapiDisplay @lock was used with
+ *
+ * Releases the resources of @lock, and accumulates its statistics
+ * into the context lock statistics of @display.
+ */
+void
+gst_vaapi_context_lock_clear (GstVaapiContextLock * lock,
+    GstVaapiDisplay * display)
+{
+  g_return_if_fail (lock != NULL);
+
+  if (display && lock->stats.num_locks > 0) {
+    GstVaapiDisplayPrivate *const priv = get_lock_private (display);
+
+    g_rec_mutex_lock (&priv->mutex);
+    lock_stats_add (&priv->context_lock_stats, &lock->stats);
+    g_rec_mutex_unlock (&priv->mutex);
+  }
+  g_mutex_clear (&lock->mutex);
+}
+
 /**
  * gst_vaapi_display_sync:
  * @display: a #GstVaapiDisplay
@@ -1664,6 +1912,45 @@ gst_vaapi_display_has_encoder (GstVaapiDisplay * display,
       profile, entrypoint);
 }
 
+/**
+ * gst_vaapi_display_get_config_info:
+ * @display: a #GstVaapiDisplay
+ * @profile: a #GstVaapiProfile
+ * @entrypoint: a #GstVaapiEntrypoint
+ * @info: return location for the config capabilities
+ *
+ * Gets the RT formats and surface attributes of a VA config created
+ * for @profile and @entrypoint. They are queried from the driver only
+ * if the driver cache does not hold them yet.
+ *
+ * Return value: %TRUE if @info was filled in
+ */
+gboolean
+gst_vaapi_display_get_config_info (GstVaapiDisplay * display,
+    GstVaapiProfile profile, GstVaapiEntrypoint entrypoint,
+    GstVaapiDriverConfigInfo * info)
+{
+  GstVaapiDisplayPrivate *priv;
+  VAProfile va_profile;
+  VAEntrypoint va_entrypoint;
+  gboolean success;
+
+  g_return_val_if_fail (display != NULL, FALSE);
+  g_return_val_if_fail (info != NULL, FALSE);
+
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  va_profile = gst_vaapi_profile_get_va_profile (profile);
+  va_entrypoint = gst_vaapi_entrypoint_get_va_entrypoint (entrypoint);
+  if (va_profile == (VAProfile) - 1 || va_entrypoint == (VAEntrypoint) - 1)
+    return FALSE;
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  success = gst_vaapi_driver_cache_get_config_info (priv->driver_cache,
+      va_profile, va_entrypoint, info);
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  return success;
+}
+
 /**
  * gst_vaapi_display_get_image_formats:
  * @display: a #GstVaapiDisplay
@@ -54,6 +54,15 @@ static DRMDeviceType g_drm_device_type;
 static GMutex g_drm_device_type_lock;
 static const gchar *allowed_subsystems[] = { "pci", "platform", NULL };
 
+/* Process-wide registry of the displays handed out by
+ * gst_vaapi_display_drm_new_shared(). The registry does not own them:
+ * an entry dies with the last reference to its display */
+static GMutex g_shared_displays_lock;
+static GHashTable *g_shared_displays;   /* device path -> GWeakRef */
+static gchar *g_shared_default_path;
+static guint64 g_shared_num_hits;
+static guint64 g_shared_num_misses;
+
 static gboolean
 supports_vaapi (int fd)
 {
@@ -64,7 +73,7 @@ supports_vaapi (int fd)
   if (!va_dpy)
     return FALSE;
 
-  ret = vaapi_initialize (va_dpy);
+  ret = vaapi_initialize (va_dpy, NULL, NULL);
   vaTerminate (va_dpy);
   return ret;
 }
@@ -394,6 +403,124 @@ gst_vaapi_display_drm_new (const gchar * device_path)
   return display;
 }
 
+static void
+shared_display_ref_free (GWeakRef * ref)
+{
+  g_weak_ref_clear (ref);
+  g_slice_free (GWeakRef, ref);
+}
+
+/* Drops the entries of the finalized displays, and returns the number
+ * of live ones. Called with g_shared_displays_lock held */
+static guint
+prune_shared_displays (void)
+{
+  GHashTableIter iter;
+  GObject *object;
+  gpointer value;
+
+  if (!g_shared_displays)
+    return 0;
+
+  g_hash_table_iter_init (&iter, g_shared_displays);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    object = g_weak_ref_get (value);
+    if (object)
+      g_object_unref (object);
+    else
+      g_hash_table_iter_remove (&iter);
+  }
+  return g_hash_table_size (g_shared_displays);
+}
+
+/**
+ * gst_vaapi_display_drm_new_shared:
+ * @device_path: the DRM device path
+ *
+ * Returns a new reference to the #GstVaapiDisplay opened on
+ * @device_path by a previous call to this function, if it is still
+ * alive. Otherwise, opens it like gst_vaapi_display_drm_new() and
+ * registers it for the next callers in the process. A shared display
+ * saves the VA driver initialization and the queries of its
+ * capabilities, as well as the driver memory of a display per user.
+ *
+ * If @device_path is NULL, the display shared is the one opened on
+ * the default DRM device.
+ *
+ * Return value: a #GstVaapiDisplay object, possibly used elsewhere
+ */
+GstVaapiDisplay *
+gst_vaapi_display_drm_new_shared (const gchar * device_path)
+{
+  GstVaapiDisplay *display = NULL;
+  const gchar *key, *display_name;
+  GWeakRef *ref;
+  guint num_displays;
+
+  g_mutex_lock (&g_shared_displays_lock);
+  if (!g_shared_displays)
+    g_shared_displays = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) shared_display_ref_free);
+
+  key = device_path ? device_path : g_shared_default_path;
+  if (key) {
+    ref = g_hash_table_lookup (g_shared_displays, key);
+    if (ref)
+      display = g_weak_ref_get (ref);
+  }
+
+  if (display) {
+    g_shared_num_hits++;
+    GST_INFO ("sharing display %p on %s", display, key);
+    goto done;
+  }
+
+  display = gst_vaapi_display_drm_new (device_path);
+  if (!display)
+    goto done;
+  g_shared_num_misses++;
+
+  display_name = gst_vaapi_display_get_display_name (display);
+  if (!display_name)
+    goto done;
+  if (!device_path) {
+    g_free (g_shared_default_path);
+    g_shared_default_path = g_strdup (display_name);
+  }
+
+  ref = g_slice_new0 (GWeakRef);
+  g_weak_ref_init (ref, display);
+  g_hash_table_replace (g_shared_displays, g_strdup (display_name), ref);
+  num_displays = prune_shared_displays ();
+  GST_INFO ("shared display %p on %s, %u live shared displays", display,
+      display_name, num_displays);
+
+done:
+  g_mutex_unlock (&g_shared_displays_lock);
+  return display;
+}
+
+/**
+ * gst_vaapi_display_drm_get_shared_stats:
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Fills @stats with the number of displays shared through
+ * gst_vaapi_display_drm_new_shared() still alive, and the number of
+ * requests that reused or opened one since the process started.
+ */
+void
+gst_vaapi_display_drm_get_shared_stats (GstVaapiDisplayDRMSharedStats *
+    stats)
+{
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&g_shared_displays_lock);
+  stats->num_displays = prune_shared_displays ();
+  stats->num_hits = g_shared_num_hits;
+  stats->num_misses = g_shared_num_misses;
+  g_mutex_unlock (&g_shared_displays_lock);
+}
+
 /**
  * gst_vaapi_display_drm_new_with_device:
  * @device: an open DRM device (file descriptor)
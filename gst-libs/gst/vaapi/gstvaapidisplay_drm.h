@@ -32,6 +32,22 @@ G_BEGIN_DECLS
     (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_DISPLAY_DRM, GstVaapiDisplayDRM))
 
 typedef struct _GstVaapiDisplayDRM              GstVaapiDisplayDRM;
+typedef struct _GstVaapiDisplayDRMSharedStats   GstVaapiDisplayDRMSharedStats;
+
+/**
+ * GstVaapiDisplayDRMSharedStats:
+ * @num_displays: number of shared displays alive
+ * @num_hits: number of requests served with a live shared display
+ * @num_misses: number of requests that opened a new shared display
+ *
+ * Statistics of gst_vaapi_display_drm_new_shared().
+ */
+struct _GstVaapiDisplayDRMSharedStats
+{
+  guint num_displays;
+  guint64 num_hits;
+  guint64 num_misses;
+};
 
 GstVaapiDisplay *
 gst_vaapi_display_drm_new (const gchar * device_path);
@@ -39,6 +55,13 @@ gst_vaapi_display_drm_new (const gchar * device_path);
 GstVaapiDisplay *
 gst_vaapi_display_drm_new_with_device (gint device);
 
+GstVaapiDisplay *
+gst_vaapi_display_drm_new_shared (const gchar * device_path);
+
+void
+gst_vaapi_display_drm_get_shared_stats (GstVaapiDisplayDRMSharedStats *
+    stats);
+
 gint
 gst_vaapi_display_drm_get_device (GstVaapiDisplayDRM * display);
 
@@ -30,6 +30,7 @@
 #include <gst/vaapi/gstvaapitexture.h>
 #include <gst/vaapi/gstvaapitexturemap.h>
 #include "gstvaapiminiobject.h"
+#include "gstvaapidrivercache.h"
 
 G_BEGIN_DECLS
 
@@ -51,6 +52,9 @@ G_BEGIN_DECLS
 typedef struct _GstVaapiDisplayPrivate          GstVaapiDisplayPrivate;
 typedef struct _GstVaapiDisplayClass            GstVaapiDisplayClass;
 typedef enum _GstVaapiDisplayInitType           GstVaapiDisplayInitType;
+typedef enum _GstVaapiDisplayLockMode           GstVaapiDisplayLockMode;
+typedef struct _GstVaapiDisplayLockStats        GstVaapiDisplayLockStats;
+typedef struct _GstVaapiContextLock             GstVaapiContextLock;
 
 /**
  * GST_VAAPI_DISPLAY_GET_CLASS_TYPE:
@@ -107,6 +111,101 @@ typedef enum _GstVaapiDisplayInitType           GstVaapiDisplayInitType;
 #define GST_VAAPI_DISPLAY_HAS_VPP(display) \
   gst_vaapi_display_has_video_processing (GST_VAAPI_DISPLAY_CAST (display))
 
+/**
+ * GstVaapiDisplayLockMode:
+ * @GST_VAAPI_DISPLAY_LOCK_MODE_GLOBAL: every VA call is serialized by
+ *   the display lock
+ * @GST_VAAPI_DISPLAY_LOCK_MODE_FINE: the display lock is only taken
+ *   around display-wide VA calls; calls on a single surface, image or
+ *   buffer rely on the driver locking, and VA contexts shared by
+ *   several threads are protected by a #GstVaapiContextLock
+ *
+ * The locking policy of a display, selected at creation time with the
+ * GST_VAAPI_DISPLAY_LOCK_MODE environment variable ("global" or
+ * "fine").
+ */
+enum _GstVaapiDisplayLockMode
+{
+  GST_VAAPI_DISPLAY_LOCK_MODE_GLOBAL = 0,
+  GST_VAAPI_DISPLAY_LOCK_MODE_FINE,
+};
+
+/**
+ * GstVaapiDisplayLockStats:
+ * @num_locks: number of outermost lock acquisitions
+ * @num_contended: number of acquisitions that had to wait
+ * @wait_time: total time spent waiting for the lock, in microseconds
+ * @hold_time: total time the lock was held, in microseconds
+ * @max_hold_time: longest time the lock was held, in microseconds
+ *
+ * Lock usage counters, for the display lock or for the accumulated
+ * #GstVaapiContextLock of a display.
+ */
+struct _GstVaapiDisplayLockStats
+{
+  guint64 num_locks;
+  guint64 num_contended;
+  gint64 wait_time;
+  gint64 hold_time;
+  gint64 max_hold_time;
+};
+
+/**
+ * GstVaapiContextLock:
+ *
+ * Lock of an object owning a VA context which may be used by several
+ * threads, e.g. a #GstVaapiFilter. It is only used in
+ * %GST_VAAPI_DISPLAY_LOCK_MODE_FINE, the display lock is taken
+ * instead otherwise.
+ */
+struct _GstVaapiContextLock
+{
+  /*< private >*/
+  GMutex mutex;
+  gint64 lock_time;
+  GstVaapiDisplayLockStats stats;
+};
+
+/**
+ * GST_VAAPI_DISPLAY_VA_LOCK:
+ * @display: a #GstVaapiDisplay
+ *
+ * Locks @display around a VA call on a single surface, image or
+ * buffer. This is a no-op in %GST_VAAPI_DISPLAY_LOCK_MODE_FINE.
+ */
+#define GST_VAAPI_DISPLAY_VA_LOCK(display) \
+  gst_vaapi_display_va_lock (GST_VAAPI_DISPLAY_CAST (display), NULL)
+
+/**
+ * GST_VAAPI_DISPLAY_VA_UNLOCK:
+ * @display: a #GstVaapiDisplay
+ *
+ * Unlocks @display after GST_VAAPI_DISPLAY_VA_LOCK().
+ */
+#define GST_VAAPI_DISPLAY_VA_UNLOCK(display) \
+  gst_vaapi_display_va_unlock (GST_VAAPI_DISPLAY_CAST (display), NULL)
+
+/**
+ * GST_VAAPI_DISPLAY_CONTEXT_LOCK:
+ * @display: a #GstVaapiDisplay
+ * @lock: the #GstVaapiContextLock of the object owning the VA context
+ *
+ * Locks the VA context guarded by @lock, or @display in
+ * %GST_VAAPI_DISPLAY_LOCK_MODE_GLOBAL.
+ */
+#define GST_VAAPI_DISPLAY_CONTEXT_LOCK(display, lock) \
+  gst_vaapi_display_va_lock (GST_VAAPI_DISPLAY_CAST (display), (lock))
+
+/**
+ * GST_VAAPI_DISPLAY_CONTEXT_UNLOCK:
+ * @display: a #GstVaapiDisplay
+ * @lock: the #GstVaapiContextLock of the object owning the VA context
+ *
+ * Unlocks what GST_VAAPI_DISPLAY_CONTEXT_LOCK() locked.
+ */
+#define GST_VAAPI_DISPLAY_CONTEXT_UNLOCK(display, lock) \
+  gst_vaapi_display_va_unlock (GST_VAAPI_DISPLAY_CAST (display), (lock))
+
 struct _GstVaapiDisplayPrivate
 {
   GstVaapiDisplay *parent;
@@ -127,6 +226,16 @@ struct _GstVaapiDisplayPrivate
   GArray *subpicture_formats;
   GArray *properties;
   gchar *vendor_string;
+  GstVaapiDriverCache *driver_cache;
+  gchar *driver_cache_filename;
+  GstVaapiDisplayLockMode lock_mode;
+  guint lock_depth;
+  gint64 lock_time;
+  GstVaapiDisplayLockStats lock_stats;
+  GstVaapiDisplayLockStats context_lock_stats;
+  /* bitmask of the formats the driver allocates no compressed
+     surfaces for, see gst_vaapi_surface_init_full() */
+  volatile guint uncompressed_formats[8];
   guint use_foreign_display:1;
   guint has_vpp:1;
   guint has_profiles:1;
@@ -206,6 +315,41 @@ GstVaapiDisplay *
 gst_vaapi_display_config (GstVaapiDisplay * display,
     GstVaapiDisplayInitType init_type, gpointer init_value);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_display_get_config_info (GstVaapiDisplay * display,
+    GstVaapiProfile profile, GstVaapiEntrypoint entrypoint,
+    GstVaapiDriverConfigInfo * info);
+
+G_GNUC_INTERNAL
+GstVaapiDisplayLockMode
+gst_vaapi_display_get_lock_mode (GstVaapiDisplay * display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_get_lock_stats (GstVaapiDisplay * display,
+    GstVaapiDisplayLockStats * display_stats,
+    GstVaapiDisplayLockStats * context_stats);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_va_lock (GstVaapiDisplay * display,
+    GstVaapiContextLock * lock);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_va_unlock (GstVaapiDisplay * display,
+    GstVaapiContextLock * lock);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_lock_init (GstVaapiContextLock * lock);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_lock_clear (GstVaapiContextLock * lock,
+    GstVaapiDisplay * display);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DISPLAY_PRIV_H */
@@ -0,0 +1,337 @@
+/*
+ *  gstvaapidmabufimportcache.c - Cache of VA surfaces imported from DMABuf
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapidmabufimportcache
+ * @short_description: Cache of VA surfaces imported from DMABuf
+ *
+ * Keeps the VA surfaces created from upstream DMABufs, so that a
+ * buffer object which comes back, possibly through another fd and
+ * another #GstBuffer, is not imported again. Upstream pools recycle a
+ * few buffer objects, so the steady state creates no surface.
+ *
+ * A buffer object is identified by the device and inode numbers of its
+ * fd. These are not reused while the cache holds the surface, since
+ * the import keeps a reference to the buffer object. The layout the
+ * buffer is imported with is part of the key as well. Before Linux
+ * 5.3 every DMABuf shares one anonymous inode, so such fds bypass the
+ * cache.
+ *
+ * The cache holds a bounded number of surfaces, and evicts the least
+ * recently used one to make room for a new one.
+ */
+
+#include "sysdeps.h"
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+#include "gstvaapidmabufimportcache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct _CachedSurface CachedSurface;
+
+struct _CachedSurface
+{
+  GstVaapiDmaBufImportKey key;
+  GstMiniObject *surface;
+  GList link;                   /* in the LRU queue */
+};
+
+struct _GstVaapiDmaBufImportCache
+{
+  guint max_entries;
+
+  GMutex lock;
+  GHashTable *surfaces;         /* GstVaapiDmaBufImportKey -> CachedSurface */
+  GQueue lru;                   /* most recently used first */
+  GstVaapiDmaBufImportCacheStats stats;
+};
+
+static guint
+import_key_hash (gconstpointer data)
+{
+  const GstVaapiDmaBufImportKey *const key = data;
+
+  return (guint) key->ino ^ ((guint) key->dev << 16) ^
+      ((guint) key->offset[0] << 8) ^ (guint) key->stride[0];
+}
+
+static gboolean
+import_key_equal (gconstpointer a, gconstpointer b)
+{
+  return memcmp (a, b, sizeof (GstVaapiDmaBufImportKey)) == 0;
+}
+
+/* The magic of the DMABuf filesystem, see linux/magic.h */
+#define DMA_BUF_MAGIC 0x444d4142
+
+/* Whether the inode of @fd identifies its buffer object, i.e. @fd lives
+   on the DMABuf filesystem, which exists since Linux 5.3 */
+static gboolean
+has_dma_buf_inode (gint fd)
+{
+#ifdef __linux__
+  struct statfs st;
+
+  return fstatfs (fd, &st) == 0 && st.f_type == DMA_BUF_MAGIC;
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * gst_vaapi_dmabuf_import_key_init:
+ * @key: the #GstVaapiDmaBufImportKey to fill in
+ * @fd: the DMABuf file descriptor
+ * @vip: the layout the DMABuf is imported with
+ *
+ * Identifies the buffer object @fd refers to, along with its layout.
+ *
+ * Return value: %TRUE on success, %FALSE if @fd could not be queried
+ *   or its inode is shared with other buffer objects, in which case
+ *   the import shall not be cached
+ */
+gboolean
+gst_vaapi_dmabuf_import_key_init (GstVaapiDmaBufImportKey * key, gint fd,
+    const GstVideoInfo * vip)
+{
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (vip != NULL, FALSE);
+
+  if (fd < 0 || !has_dma_buf_inode (fd))
+    return FALSE;
+  return gst_vaapi_dmabuf_import_key_init_unchecked (key, fd, vip);
+}
+
+/**
+ * gst_vaapi_dmabuf_import_key_init_unchecked:
+ * @key: the #GstVaapiDmaBufImportKey to fill in
+ * @fd: a file descriptor
+ * @vip: the layout the file is imported with
+ *
+ * Same as gst_vaapi_dmabuf_import_key_init(), without checking that
+ * the inode of @fd identifies a single buffer object. This is for
+ * tests, which stand in other files for the DMABufs.
+ *
+ * Return value: %TRUE on success, %FALSE if @fd could not be queried
+ */
+gboolean
+gst_vaapi_dmabuf_import_key_init_unchecked (GstVaapiDmaBufImportKey * key,
+    gint fd, const GstVideoInfo * vip)
+{
+  struct stat st;
+  guint i;
+
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (vip != NULL, FALSE);
+
+  if (fd < 0 || fstat (fd, &st) != 0)
+    return FALSE;
+
+  /* Zeroed as a whole, padding included, for import_key_equal() */
+  memset (key, 0, sizeof (*key));
+  key->dev = st.st_dev;
+  key->ino = st.st_ino;
+  key->format = GST_VIDEO_INFO_FORMAT (vip);
+  key->width = GST_VIDEO_INFO_WIDTH (vip);
+  key->height = GST_VIDEO_INFO_HEIGHT (vip);
+  key->n_planes = GST_VIDEO_INFO_N_PLANES (vip);
+  for (i = 0; i < key->n_planes; i++) {
+    key->offset[i] = GST_VIDEO_INFO_PLANE_OFFSET (vip, i);
+    key->stride[i] = GST_VIDEO_INFO_PLANE_STRIDE (vip, i);
+  }
+  return TRUE;
+}
+
+/* Called with the cache lock held */
+static void
+remove_entry (GstVaapiDmaBufImportCache * cache, CachedSurface * entry)
+{
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_hash_table_remove (cache->surfaces, &entry->key);
+  gst_mini_object_unref (entry->surface);
+  g_slice_free (CachedSurface, entry);
+}
+
+/**
+ * gst_vaapi_dmabuf_import_cache_new:
+ * @max_entries: the maximal number of surfaces to hold
+ *
+ * Creates a new #GstVaapiDmaBufImportCache.
+ *
+ * Return value: the newly allocated #GstVaapiDmaBufImportCache
+ */
+GstVaapiDmaBufImportCache *
+gst_vaapi_dmabuf_import_cache_new (guint max_entries)
+{
+  GstVaapiDmaBufImportCache *cache;
+
+  g_return_val_if_fail (max_entries > 0, NULL);
+
+  cache = g_slice_new0 (GstVaapiDmaBufImportCache);
+  if (!cache)
+    return NULL;
+
+  cache->max_entries = max_entries;
+  g_mutex_init (&cache->lock);
+  cache->surfaces = g_hash_table_new (import_key_hash, import_key_equal);
+  g_queue_init (&cache->lru);
+  return cache;
+}
+
+/**
+ * gst_vaapi_dmabuf_import_cache_free:
+ * @cache: a #GstVaapiDmaBufImportCache
+ *
+ * Releases all the surfaces of @cache, and frees @cache.
+ */
+void
+gst_vaapi_dmabuf_import_cache_free (GstVaapiDmaBufImportCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_INFO ("%" G_GUINT64_FORMAT " import hits, %" G_GUINT64_FORMAT
+      " misses, %" G_GUINT64_FORMAT " evictions", cache->stats.num_hits,
+      cache->stats.num_misses, cache->stats.num_evictions);
+
+  gst_vaapi_dmabuf_import_cache_clear (cache);
+  g_hash_table_unref (cache->surfaces);
+  g_mutex_clear (&cache->lock);
+  g_slice_free (GstVaapiDmaBufImportCache, cache);
+}
+
+/**
+ * gst_vaapi_dmabuf_import_cache_lookup:
+ * @cache: a #GstVaapiDmaBufImportCache
+ * @key: the DMABuf to import
+ *
+ * Looks up the surface imported from the DMABuf identified by @key,
+ * and marks it most recently used.
+ *
+ * Return value: a new reference to the cached surface, or %NULL if the
+ *   caller needs to import the DMABuf and
+ *   gst_vaapi_dmabuf_import_cache_insert() the new surface
+ */
+GstMiniObject *
+gst_vaapi_dmabuf_import_cache_lookup (GstVaapiDmaBufImportCache * cache,
+    const GstVaapiDmaBufImportKey * key)
+{
+  CachedSurface *entry;
+  GstMiniObject *surface = NULL;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  g_mutex_lock (&cache->lock);
+  entry = g_hash_table_lookup (cache->surfaces, key);
+  if (entry) {
+    g_queue_unlink (&cache->lru, &entry->link);
+    g_queue_push_head_link (&cache->lru, &entry->link);
+    surface = gst_mini_object_ref (entry->surface);
+    cache->stats.num_hits++;
+  } else
+    cache->stats.num_misses++;
+  g_mutex_unlock (&cache->lock);
+  return surface;
+}
+
+/**
+ * gst_vaapi_dmabuf_import_cache_insert:
+ * @cache: a #GstVaapiDmaBufImportCache
+ * @key: the imported DMABuf
+ * @surface: the surface imported from the DMABuf
+ *
+ * Adds a reference to @surface to @cache, replacing the surface
+ * previously imported from the same DMABuf if any, and evicting the
+ * least recently used surface if @cache is full.
+ */
+void
+gst_vaapi_dmabuf_import_cache_insert (GstVaapiDmaBufImportCache * cache,
+    const GstVaapiDmaBufImportKey * key, GstMiniObject * surface)
+{
+  CachedSurface *entry;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (surface != NULL);
+
+  g_mutex_lock (&cache->lock);
+  entry = g_hash_table_lookup (cache->surfaces, key);
+  if (entry)
+    remove_entry (cache, entry);
+
+  while (g_queue_get_length (&cache->lru) >= cache->max_entries) {
+    entry = g_queue_peek_tail (&cache->lru);
+    GST_LOG ("evict surface %p", entry->surface);
+    remove_entry (cache, entry);
+    cache->stats.num_evictions++;
+  }
+
+  entry = g_slice_new (CachedSurface);
+  memcpy (&entry->key, key, sizeof (entry->key));
+  entry->surface = gst_mini_object_ref (surface);
+  entry->link.data = entry;
+  entry->link.prev = entry->link.next = NULL;
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  g_hash_table_insert (cache->surfaces, &entry->key, entry);
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * gst_vaapi_dmabuf_import_cache_clear:
+ * @cache: a #GstVaapiDmaBufImportCache
+ *
+ * Releases all the surfaces of @cache, e.g. because they belong to a
+ * VA display which is no longer used.
+ */
+void
+gst_vaapi_dmabuf_import_cache_clear (GstVaapiDmaBufImportCache * cache)
+{
+  CachedSurface *entry;
+
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->lock);
+  while ((entry = g_queue_peek_head (&cache->lru)))
+    remove_entry (cache, entry);
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * gst_vaapi_dmabuf_import_cache_get_stats:
+ * @cache: a #GstVaapiDmaBufImportCache
+ * @stats: return location for the statistics
+ *
+ * Gets the hit and miss counters of @cache.
+ */
+void
+gst_vaapi_dmabuf_import_cache_get_stats (GstVaapiDmaBufImportCache * cache,
+    GstVaapiDmaBufImportCacheStats * stats)
+{
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&cache->lock);
+  *stats = cache->stats;
+  stats->num_cached = g_queue_get_length (&cache->lru);
+  g_mutex_unlock (&cache->lock);
+}
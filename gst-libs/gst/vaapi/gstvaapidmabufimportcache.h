@@ -0,0 +1,110 @@
+/*
+ *  gstvaapidmabufimportcache.h - Cache of VA surfaces imported from DMABuf
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DMABUF_IMPORT_CACHE_H
+#define GST_VAAPI_DMABUF_IMPORT_CACHE_H
+
+#include <sys/types.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiDmaBufImportCache GstVaapiDmaBufImportCache;
+typedef struct _GstVaapiDmaBufImportKey GstVaapiDmaBufImportKey;
+typedef struct _GstVaapiDmaBufImportCacheStats GstVaapiDmaBufImportCacheStats;
+
+/**
+ * GstVaapiDmaBufImportKey:
+ *
+ * Identifies an imported DMABuf: the buffer object, whatever fd refers
+ * to it, and the layout it is imported with. Only
+ * gst_vaapi_dmabuf_import_key_init() fills it in.
+ */
+struct _GstVaapiDmaBufImportKey
+{
+  /*< private >*/
+  dev_t dev;
+  ino_t ino;
+  GstVideoFormat format;
+  guint width;
+  guint height;
+  guint n_planes;
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gint stride[GST_VIDEO_MAX_PLANES];
+};
+
+/**
+ * GstVaapiDmaBufImportCacheStats:
+ * @num_hits: number of imports served from the cache
+ * @num_misses: number of imports which needed a new surface
+ * @num_evictions: number of least recently used surfaces dropped to
+ *   make room for new ones
+ * @num_cached: number of surfaces currently held by the cache
+ *
+ * Statistics of a #GstVaapiDmaBufImportCache.
+ */
+struct _GstVaapiDmaBufImportCacheStats
+{
+  guint64 num_hits;
+  guint64 num_misses;
+  guint64 num_evictions;
+  guint num_cached;
+};
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_dmabuf_import_key_init (GstVaapiDmaBufImportKey * key, gint fd,
+    const GstVideoInfo * vip);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_dmabuf_import_key_init_unchecked (GstVaapiDmaBufImportKey * key,
+    gint fd, const GstVideoInfo * vip);
+
+G_GNUC_INTERNAL
+GstVaapiDmaBufImportCache *
+gst_vaapi_dmabuf_import_cache_new (guint max_entries);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_dmabuf_import_cache_free (GstVaapiDmaBufImportCache * cache);
+
+G_GNUC_INTERNAL
+GstMiniObject *
+gst_vaapi_dmabuf_import_cache_lookup (GstVaapiDmaBufImportCache * cache,
+    const GstVaapiDmaBufImportKey * key);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_dmabuf_import_cache_insert (GstVaapiDmaBufImportCache * cache,
+    const GstVaapiDmaBufImportKey * key, GstMiniObject * surface);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_dmabuf_import_cache_clear (GstVaapiDmaBufImportCache * cache);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_dmabuf_import_cache_get_stats (GstVaapiDmaBufImportCache * cache,
+    GstVaapiDmaBufImportCacheStats * stats);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DMABUF_IMPORT_CACHE_H */
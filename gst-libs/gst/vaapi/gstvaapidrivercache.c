@@ -0,0 +1,1013 @@
+/*
+ *  gstvaapidrivercache.c - Persistent VA driver capability cache
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapidrivercache
+ * @short_description: Persistent VA driver capability cache
+ *
+ * Holds the VA profiles, entrypoints, image and subpicture formats,
+ * and the per-config RT formats and surface attributes of a driver.
+ * Each item is queried from the driver the first time it is needed,
+ * unless it was loaded from a cache file written by a previous
+ * process.
+ *
+ * A cache file is only used by a process with the same driver vendor
+ * string, libva version and device. The vendor string of the common
+ * drivers embeds their version, so that driver updates invalidate the
+ * file too. The file is written again whenever new items were queried.
+ *
+ * The cache is disabled by the GST_VAAPI_DISABLE_DRIVER_CACHE
+ * environment variable, and its directory can be changed with
+ * GST_VAAPI_DRIVER_CACHE_DIR.
+ */
+
+#include "sysdeps.h"
+#include <glib/gstdio.h>
+#include "gstvaapidrivercache.h"
+#include "gstvaapiutils.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Bump whenever the file layout changes */
+#define DRIVER_CACHE_VERSION 1
+
+#define GROUP_HEADER "driver-cache"
+#define GROUP_CONFIGS "configs"
+#define GROUP_IMAGE_FORMATS "image-formats"
+#define GROUP_SUBPICTURE_FORMATS "subpicture-formats"
+#define GROUP_CONFIG_INFO "config %d.%d"
+
+/* Number of integers a VAImageFormat is saved as */
+#define IMAGE_FORMAT_FIELDS 8
+
+/* The RT formats of a profile/entrypoint pair are always known, zero
+ * meaning unsupported. The surface attributes are only known if
+ * has_surface_attribs is set, and were successfully queried if valid
+ * is set too */
+typedef struct
+{
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+  gboolean has_surface_attribs;
+  gboolean valid;
+  GstVaapiDriverConfigInfo info;
+} ConfigInfoEntry;
+
+struct _GstVaapiDriverCache
+{
+  VADisplay va_display;
+  GstVaapiDriverCacheVTable vtable;
+  gchar *vendor;
+  gchar *va_version;
+  gchar *device;
+
+  GArray *configs;              /* GstVaapiDriverConfig */
+  GArray *image_formats;        /* VAImageFormat */
+  GArray *subpicture_formats;   /* VAImageFormat */
+  GArray *subpicture_flags;     /* guint */
+  GArray *config_infos;         /* ConfigInfoEntry */
+
+  gboolean loaded;
+  gboolean dirty;
+  guint num_queries;
+};
+
+static const GstVaapiDriverCacheVTable default_vtable = {
+  .max_num_profiles = vaMaxNumProfiles,
+  .max_num_entrypoints = vaMaxNumEntrypoints,
+  .max_num_image_formats = vaMaxNumImageFormats,
+  .max_num_subpicture_formats = vaMaxNumSubpictureFormats,
+  .query_config_profiles = vaQueryConfigProfiles,
+  .query_config_entrypoints = vaQueryConfigEntrypoints,
+  .get_config_attributes = vaGetConfigAttributes,
+  .create_config = vaCreateConfig,
+  .destroy_config = vaDestroyConfig,
+  .query_surface_attributes = vaQuerySurfaceAttributes,
+  .query_image_formats = vaQueryImageFormats,
+  .query_subpicture_formats = vaQuerySubpictureFormats,
+};
+
+static void
+clear_data (GstVaapiDriverCache * cache)
+{
+  g_clear_pointer (&cache->configs, g_array_unref);
+  g_clear_pointer (&cache->image_formats, g_array_unref);
+  g_clear_pointer (&cache->subpicture_formats, g_array_unref);
+  g_clear_pointer (&cache->subpicture_flags, g_array_unref);
+  g_array_set_size (cache->config_infos, 0);
+}
+
+/**
+ * gst_vaapi_driver_cache_new:
+ * @dpy: a VADisplay
+ * @vtable: (nullable): the VA entry points, or %NULL for libva
+ * @vendor: the driver vendor string
+ * @va_version: the libva version
+ * @device: the device the display was opened on
+ *
+ * Creates an empty cache of the capabilities of the driver behind
+ * @dpy. The @vendor, @va_version and @device strings identify the
+ * driver: a cache file is only loaded if they all match.
+ *
+ * Return value: the newly allocated #GstVaapiDriverCache
+ */
+GstVaapiDriverCache *
+gst_vaapi_driver_cache_new (VADisplay dpy,
+    const GstVaapiDriverCacheVTable * vtable, const gchar * vendor,
+    const gchar * va_version, const gchar * device)
+{
+  GstVaapiDriverCache *cache;
+
+  cache = g_slice_new0 (GstVaapiDriverCache);
+  if (!cache)
+    return NULL;
+
+  cache->va_display = dpy;
+  cache->vtable = vtable ? *vtable : default_vtable;
+  cache->vendor = g_strdup (vendor ? vendor : "");
+  cache->va_version = g_strdup (va_version ? va_version : "");
+  cache->device = g_strdup (device ? device : "");
+  cache->config_infos = g_array_new (FALSE, FALSE, sizeof (ConfigInfoEntry));
+  return cache;
+}
+
+/**
+ * gst_vaapi_driver_cache_free:
+ * @cache: a #GstVaapiDriverCache
+ *
+ * Frees @cache. The items queried since the cache was loaded are lost
+ * unless gst_vaapi_driver_cache_save() was called.
+ */
+void
+gst_vaapi_driver_cache_free (GstVaapiDriverCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_INFO ("driver cache %s: %u VA queries", cache->loaded ? "hit" : "miss",
+      cache->num_queries);
+
+  clear_data (cache);
+  g_array_unref (cache->config_infos);
+  g_free (cache->vendor);
+  g_free (cache->va_version);
+  g_free (cache->device);
+  g_slice_free (GstVaapiDriverCache, cache);
+}
+
+/**
+ * gst_vaapi_driver_cache_get_default_filename:
+ * @cache: a #GstVaapiDriverCache
+ *
+ * Return value: (transfer full): the cache file of this driver in the
+ *   user cache directory, or %NULL if the cache is disabled
+ */
+gchar *
+gst_vaapi_driver_cache_get_default_filename (GstVaapiDriverCache * cache)
+{
+  const gchar *dir;
+  gchar *key, *checksum, *basename, *filename;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  if (g_getenv ("GST_VAAPI_DISABLE_DRIVER_CACHE"))
+    return NULL;
+
+  key = g_strdup_printf ("%s\n%s\n%s", cache->vendor, cache->va_version,
+      cache->device);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  basename = g_strdup_printf ("driver-%.16s.cache", checksum);
+
+  dir = g_getenv ("GST_VAAPI_DRIVER_CACHE_DIR");
+  if (dir)
+    filename = g_build_filename (dir, basename, NULL);
+  else
+    filename = g_build_filename (g_get_user_cache_dir (), "gstreamer-1.0",
+        "vaapi", basename, NULL);
+
+  g_free (basename);
+  g_free (checksum);
+  g_free (key);
+  return filename;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Driver queries                                                    --- */
+/* ------------------------------------------------------------------------- */
+
+static gboolean
+query_configs (GstVaapiDriverCache * cache)
+{
+  const GstVaapiDriverCacheVTable *const vtable = &cache->vtable;
+  VAProfile *profiles = NULL;
+  VAEntrypoint *entrypoints = NULL;
+  gint i, j, n, num_entrypoints;
+  VAStatus status;
+  gboolean success = FALSE;
+
+  profiles = g_new (VAProfile, vtable->max_num_profiles (cache->va_display));
+  entrypoints =
+      g_new (VAEntrypoint, vtable->max_num_entrypoints (cache->va_display));
+
+  n = 0;
+  cache->num_queries++;
+  status = vtable->query_config_profiles (cache->va_display, profiles, &n);
+  if (!vaapi_check_status (status, "vaQueryConfigProfiles()"))
+    goto cleanup;
+
+  GST_DEBUG ("%d profiles", n);
+  cache->configs = g_array_new (FALSE, FALSE, sizeof (GstVaapiDriverConfig));
+
+  /* The video processing entrypoints are queried for VAProfileNone,
+     which the driver does not necessarily report */
+  for (i = 0; i <= n; i++) {
+    GstVaapiDriverConfig config = { 0, };
+
+    if (i < n && profiles[i] == VAProfileNone)
+      continue;
+    config.profile = i < n ? profiles[i] : VAProfileNone;
+    GST_DEBUG ("  %s", string_of_VAProfile (config.profile));
+
+    num_entrypoints = 0;
+    cache->num_queries++;
+    status = vtable->query_config_entrypoints (cache->va_display,
+        config.profile, entrypoints, &num_entrypoints);
+    if (!vaapi_check_status (status, "vaQueryConfigEntrypoints()"))
+      continue;
+
+    for (j = 0; j < num_entrypoints; j++) {
+      if (entrypoints[j] < 32)
+        config.entrypoints |= 1U << entrypoints[j];
+    }
+    g_array_append_val (cache->configs, config);
+  }
+  cache->dirty = TRUE;
+  success = TRUE;
+
+cleanup:
+  g_free (profiles);
+  g_free (entrypoints);
+  return success;
+}
+
+static gboolean
+query_image_formats (GstVaapiDriverCache * cache)
+{
+  const GstVaapiDriverCacheVTable *const vtable = &cache->vtable;
+  VAImageFormat *formats;
+  VAStatus status;
+  gint n;
+
+  formats = g_new0 (VAImageFormat,
+      vtable->max_num_image_formats (cache->va_display));
+
+  n = 0;
+  cache->num_queries++;
+  status = vtable->query_image_formats (cache->va_display, formats, &n);
+  if (!vaapi_check_status (status, "vaQueryImageFormats()")) {
+    g_free (formats);
+    return FALSE;
+  }
+
+  cache->image_formats = g_array_sized_new (FALSE, FALSE,
+      sizeof (VAImageFormat), n);
+  g_array_append_vals (cache->image_formats, formats, n);
+  cache->dirty = TRUE;
+
+  g_free (formats);
+  return TRUE;
+}
+
+static gboolean
+query_subpicture_formats (GstVaapiDriverCache * cache)
+{
+  const GstVaapiDriverCacheVTable *const vtable = &cache->vtable;
+  VAImageFormat *formats;
+  guint *flags;
+  VAStatus status;
+  guint n;
+
+  n = vtable->max_num_subpicture_formats (cache->va_display);
+  formats = g_new0 (VAImageFormat, n);
+  flags = g_new0 (guint, n);
+
+  n = 0;
+  cache->num_queries++;
+  status = vtable->query_subpicture_formats (cache->va_display, formats,
+      flags, &n);
+  if (!vaapi_check_status (status, "vaQuerySubpictureFormats()")) {
+    g_free (formats);
+    g_free (flags);
+    return FALSE;
+  }
+
+  cache->subpicture_formats = g_array_sized_new (FALSE, FALSE,
+      sizeof (VAImageFormat), n);
+  g_array_append_vals (cache->subpicture_formats, formats, n);
+  cache->subpicture_flags = g_array_sized_new (FALSE, FALSE, sizeof (guint),
+      n);
+  g_array_append_vals (cache->subpicture_flags, flags, n);
+  cache->dirty = TRUE;
+
+  g_free (formats);
+  g_free (flags);
+  return TRUE;
+}
+
+static void
+parse_surface_attributes (GstVaapiDriverConfigInfo * info,
+    const VASurfaceAttrib * attribs, guint num_attribs)
+{
+  guint i;
+
+  for (i = 0; i < num_attribs; i++) {
+    const VASurfaceAttrib *const attrib = &attribs[i];
+
+    switch (attrib->type) {
+      case VASurfaceAttribPixelFormat:
+        if ((attrib->flags & VA_SURFACE_ATTRIB_SETTABLE) &&
+            info->num_formats < GST_VAAPI_DRIVER_CACHE_MAX_FORMATS)
+          info->formats[info->num_formats++] = attrib->value.value.i;
+        break;
+      case VASurfaceAttribMinWidth:
+        info->min_width = attrib->value.value.i;
+        break;
+      case VASurfaceAttribMinHeight:
+        info->min_height = attrib->value.value.i;
+        break;
+      case VASurfaceAttribMaxWidth:
+        info->max_width = attrib->value.value.i;
+        break;
+      case VASurfaceAttribMaxHeight:
+        info->max_height = attrib->value.value.i;
+        break;
+      case VASurfaceAttribMemoryType:
+        info->mem_types = attrib->value.value.i;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+static void
+query_rt_formats (GstVaapiDriverCache * cache, ConfigInfoEntry * entry)
+{
+  const GstVaapiDriverCacheVTable *const vtable = &cache->vtable;
+  VAConfigAttrib attrib;
+  VAStatus status;
+
+  cache->dirty = TRUE;
+  entry->info.rt_formats = 0;
+
+  attrib.type = VAConfigAttribRTFormat;
+  cache->num_queries++;
+  status = vtable->get_config_attributes (cache->va_display, entry->profile,
+      entry->entrypoint, &attrib, 1);
+  if (!vaapi_check_status (status, "vaGetConfigAttributes()"))
+    return;
+  if (attrib.value == VA_ATTRIB_NOT_SUPPORTED)
+    return;
+  entry->info.rt_formats = attrib.value;
+}
+
+/* Creates a config for the first chroma type of the profile, like a
+ * #GstVaapiContext would, and queries its surface attributes. Failures
+ * are cached as well */
+static void
+query_surface_attribs (GstVaapiDriverCache * cache, ConfigInfoEntry * entry)
+{
+  const GstVaapiDriverCacheVTable *const vtable = &cache->vtable;
+  GstVaapiDriverConfigInfo *const info = &entry->info;
+  VAConfigID config = VA_INVALID_ID;
+  VASurfaceAttrib *attribs = NULL;
+  VAConfigAttrib attrib;
+  guint num_attribs = 0;
+  VAStatus status;
+
+  cache->dirty = TRUE;
+  entry->has_surface_attribs = TRUE;
+  entry->valid = FALSE;
+
+  attrib.type = VAConfigAttribRTFormat;
+  attrib.value =
+      from_GstVaapiChromaType (to_GstVaapiChromaType (info->rt_formats));
+  if (!attrib.value)
+    goto cleanup;
+
+  cache->num_queries++;
+  status = vtable->create_config (cache->va_display, entry->profile,
+      entry->entrypoint, &attrib, 1, &config);
+  if (!vaapi_check_status (status, "vaCreateConfig()"))
+    goto cleanup;
+
+  cache->num_queries++;
+  status = vtable->query_surface_attributes (cache->va_display, config, NULL,
+      &num_attribs);
+  if (!vaapi_check_status (status, "vaQuerySurfaceAttributes()"))
+    goto cleanup;
+
+  attribs = g_new0 (VASurfaceAttrib, num_attribs);
+  cache->num_queries++;
+  status = vtable->query_surface_attributes (cache->va_display, config,
+      attribs, &num_attribs);
+  if (!vaapi_check_status (status, "vaQuerySurfaceAttributes()"))
+    goto cleanup;
+
+  parse_surface_attributes (info, attribs, num_attribs);
+  entry->valid = TRUE;
+
+cleanup:
+  if (config != VA_INVALID_ID)
+    vtable->destroy_config (cache->va_display, config);
+  g_free (attribs);
+}
+
+/**
+ * gst_vaapi_driver_cache_get_configs:
+ * @cache: a #GstVaapiDriverCache
+ * @num_configs: return location for the number of configs
+ *
+ * Return value: the VA profiles and their entrypoints, or %NULL on
+ *   error. The array is owned by @cache.
+ */
+const GstVaapiDriverConfig *
+gst_vaapi_driver_cache_get_configs (GstVaapiDriverCache * cache,
+    guint * num_configs)
+{
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (num_configs != NULL, NULL);
+
+  if (!cache->configs && !query_configs (cache))
+    return NULL;
+
+  *num_configs = cache->configs->len;
+  return (const GstVaapiDriverConfig *) cache->configs->data;
+}
+
+/**
+ * gst_vaapi_driver_cache_get_image_formats:
+ * @cache: a #GstVaapiDriverCache
+ * @num_formats: return location for the number of formats
+ *
+ * Return value: the VA image formats, or %NULL on error. The array is
+ *   owned by @cache.
+ */
+const VAImageFormat *
+gst_vaapi_driver_cache_get_image_formats (GstVaapiDriverCache * cache,
+    guint * num_formats)
+{
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (num_formats != NULL, NULL);
+
+  if (!cache->image_formats && !query_image_formats (cache))
+    return NULL;
+
+  *num_formats = cache->image_formats->len;
+  return (const VAImageFormat *) cache->image_formats->data;
+}
+
+/**
+ * gst_vaapi_driver_cache_get_subpicture_formats:
+ * @cache: a #GstVaapiDriverCache
+ * @flags: return location for the VA subpicture flags of each format
+ * @num_formats: return location for the number of formats
+ *
+ * Return value: the VA subpicture formats, or %NULL on error. The
+ *   arrays are owned by @cache.
+ */
+const VAImageFormat *
+gst_vaapi_driver_cache_get_subpicture_formats (GstVaapiDriverCache * cache,
+    const guint ** flags, guint * num_formats)
+{
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (flags != NULL, NULL);
+  g_return_val_if_fail (num_formats != NULL, NULL);
+
+  if (!cache->subpicture_formats && !query_subpicture_formats (cache))
+    return NULL;
+
+  *flags = (const guint *) cache->subpicture_flags->data;
+  *num_formats = cache->subpicture_formats->len;
+  return (const VAImageFormat *) cache->subpicture_formats->data;
+}
+
+static ConfigInfoEntry *
+ensure_config_info (GstVaapiDriverCache * cache, VAProfile profile,
+    VAEntrypoint entrypoint)
+{
+  ConfigInfoEntry *entry, new_entry = { 0, };
+  guint i;
+
+  for (i = 0; i < cache->config_infos->len; i++) {
+    entry = &g_array_index (cache->config_infos, ConfigInfoEntry, i);
+    if (entry->profile == profile && entry->entrypoint == entrypoint)
+      return entry;
+  }
+
+  new_entry.profile = profile;
+  new_entry.entrypoint = entrypoint;
+  query_rt_formats (cache, &new_entry);
+  g_array_append_val (cache->config_infos, new_entry);
+  return &g_array_index (cache->config_infos, ConfigInfoEntry,
+      cache->config_infos->len - 1);
+}
+
+/**
+ * gst_vaapi_driver_cache_get_rt_formats:
+ * @cache: a #GstVaapiDriverCache
+ * @profile: a VA profile
+ * @entrypoint: a VA entrypoint
+ * @rt_formats: return location for the VAConfigAttribRTFormat value
+ *
+ * Return value: %TRUE if the driver supports the RT format attribute
+ *   for the @profile/@entrypoint pair
+ */
+gboolean
+gst_vaapi_driver_cache_get_rt_formats (GstVaapiDriverCache * cache,
+    VAProfile profile, VAEntrypoint entrypoint, guint * rt_formats)
+{
+  ConfigInfoEntry *entry;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (rt_formats != NULL, FALSE);
+
+  entry = ensure_config_info (cache, profile, entrypoint);
+  if (!entry->info.rt_formats)
+    return FALSE;
+  *rt_formats = entry->info.rt_formats;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_driver_cache_get_config_info:
+ * @cache: a #GstVaapiDriverCache
+ * @profile: a VA profile
+ * @entrypoint: a VA entrypoint
+ * @info: return location for the config capabilities
+ *
+ * Return value: %TRUE if a config could be created for the
+ *   @profile/@entrypoint pair, and its capabilities were copied into
+ *   @info
+ */
+gboolean
+gst_vaapi_driver_cache_get_config_info (GstVaapiDriverCache * cache,
+    VAProfile profile, VAEntrypoint entrypoint,
+    GstVaapiDriverConfigInfo * info)
+{
+  ConfigInfoEntry *entry;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (info != NULL, FALSE);
+
+  entry = ensure_config_info (cache, profile, entrypoint);
+  if (!entry->info.rt_formats)
+    return FALSE;
+  if (!entry->has_surface_attribs)
+    query_surface_attribs (cache, entry);
+
+  if (!entry->valid)
+    return FALSE;
+  *info = entry->info;
+  return TRUE;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Cache file                                                        --- */
+/* ------------------------------------------------------------------------- */
+
+static void
+set_image_formats (GKeyFile * key_file, const gchar * group,
+    GArray * formats)
+{
+  gint *values;
+  guint i;
+
+  values = g_new (gint, formats->len * IMAGE_FORMAT_FIELDS + 1);
+  for (i = 0; i < formats->len; i++) {
+    const VAImageFormat *const f =
+        &g_array_index (formats, VAImageFormat, i);
+    gint *const v = &values[i * IMAGE_FORMAT_FIELDS];
+
+    v[0] = f->fourcc;
+    v[1] = f->byte_order;
+    v[2] = f->bits_per_pixel;
+    v[3] = f->depth;
+    v[4] = f->red_mask;
+    v[5] = f->green_mask;
+    v[6] = f->blue_mask;
+    v[7] = f->alpha_mask;
+  }
+  g_key_file_set_integer (key_file, group, "count", formats->len);
+  if (formats->len > 0)
+    g_key_file_set_integer_list (key_file, group, "formats", values,
+        formats->len * IMAGE_FORMAT_FIELDS);
+  g_free (values);
+}
+
+static GArray *
+get_image_formats (GKeyFile * key_file, const gchar * group)
+{
+  GArray *formats;
+  gint *values = NULL;
+  gsize length = 0;
+  gint i, count;
+
+  count = g_key_file_get_integer (key_file, group, "count", NULL);
+  if (count < 0)
+    return NULL;
+  if (count > 0) {
+    values = g_key_file_get_integer_list (key_file, group, "formats",
+        &length, NULL);
+    if (!values || length != (gsize) count * IMAGE_FORMAT_FIELDS) {
+      g_free (values);
+      return NULL;
+    }
+  }
+
+  formats = g_array_sized_new (FALSE, TRUE, sizeof (VAImageFormat), count);
+  g_array_set_size (formats, count);
+  for (i = 0; i < count; i++) {
+    VAImageFormat *const f = &g_array_index (formats, VAImageFormat, i);
+    const gint *const v = &values[i * IMAGE_FORMAT_FIELDS];
+
+    f->fourcc = v[0];
+    f->byte_order = v[1];
+    f->bits_per_pixel = v[2];
+    f->depth = v[3];
+    f->red_mask = v[4];
+    f->green_mask = v[5];
+    f->blue_mask = v[6];
+    f->alpha_mask = v[7];
+  }
+  g_free (values);
+  return formats;
+}
+
+static gboolean
+load_configs (GstVaapiDriverCache * cache, GKeyFile * key_file)
+{
+  gint *profiles, *entrypoints;
+  gsize i, num_profiles = 0, num_entrypoints = 0;
+  gboolean success = FALSE;
+
+  if (!g_key_file_has_group (key_file, GROUP_CONFIGS))
+    return TRUE;
+
+  profiles = g_key_file_get_integer_list (key_file, GROUP_CONFIGS,
+      "profiles", &num_profiles, NULL);
+  entrypoints = g_key_file_get_integer_list (key_file, GROUP_CONFIGS,
+      "entrypoints", &num_entrypoints, NULL);
+  if (!profiles || !entrypoints || num_profiles != num_entrypoints)
+    goto cleanup;
+
+  cache->configs = g_array_sized_new (FALSE, FALSE,
+      sizeof (GstVaapiDriverConfig), num_profiles);
+  for (i = 0; i < num_profiles; i++) {
+    GstVaapiDriverConfig config;
+
+    config.profile = profiles[i];
+    config.entrypoints = entrypoints[i];
+    g_array_append_val (cache->configs, config);
+  }
+  success = TRUE;
+
+cleanup:
+  g_free (profiles);
+  g_free (entrypoints);
+  return success;
+}
+
+static gboolean
+load_config_info (GstVaapiDriverCache * cache, GKeyFile * key_file,
+    const gchar * group)
+{
+  ConfigInfoEntry entry = { 0, };
+  GstVaapiDriverConfigInfo *const info = &entry.info;
+  gint *values = NULL;
+  gsize i, length = 0;
+  GError *error = NULL;
+
+  if (sscanf (group, GROUP_CONFIG_INFO, (gint *) & entry.profile,
+          (gint *) & entry.entrypoint) != 2)
+    return FALSE;
+
+  info->rt_formats = g_key_file_get_integer (key_file, group, "rt-formats",
+      &error);
+  if (error)
+    goto error;
+
+  entry.has_surface_attribs = g_key_file_has_key (key_file, group, "valid",
+      NULL);
+  if (entry.has_surface_attribs) {
+    entry.valid = g_key_file_get_boolean (key_file, group, "valid", &error);
+    if (error)
+      goto error;
+  }
+
+  if (entry.valid) {
+    info->mem_types = g_key_file_get_integer (key_file, group, "mem-types",
+        &error);
+    if (error)
+      goto error;
+
+    values = g_key_file_get_integer_list (key_file, group, "size", &length,
+        &error);
+    if (error || length != 4)
+      goto error;
+    info->min_width = values[0];
+    info->min_height = values[1];
+    info->max_width = values[2];
+    info->max_height = values[3];
+    g_clear_pointer (&values, g_free);
+
+    if (g_key_file_has_key (key_file, group, "pixel-formats", NULL)) {
+      values = g_key_file_get_integer_list (key_file, group, "pixel-formats",
+          &length, &error);
+      if (error || length > GST_VAAPI_DRIVER_CACHE_MAX_FORMATS)
+        goto error;
+      for (i = 0; i < length; i++)
+        info->formats[i] = values[i];
+      info->num_formats = length;
+      g_clear_pointer (&values, g_free);
+    }
+  }
+
+  g_array_append_val (cache->config_infos, entry);
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    g_clear_error (&error);
+    g_free (values);
+    return FALSE;
+  }
+}
+
+static gboolean
+check_header (GstVaapiDriverCache * cache, GKeyFile * key_file)
+{
+  gchar *vendor, *va_version, *device;
+  gboolean match;
+
+  if (g_key_file_get_integer (key_file, GROUP_HEADER, "version", NULL) !=
+      DRIVER_CACHE_VERSION)
+    return FALSE;
+
+  vendor = g_key_file_get_string (key_file, GROUP_HEADER, "vendor", NULL);
+  va_version = g_key_file_get_string (key_file, GROUP_HEADER, "libva", NULL);
+  device = g_key_file_get_string (key_file, GROUP_HEADER, "device", NULL);
+  match = g_strcmp0 (vendor, cache->vendor) == 0 &&
+      g_strcmp0 (va_version, cache->va_version) == 0 &&
+      g_strcmp0 (device, cache->device) == 0;
+
+  g_free (vendor);
+  g_free (va_version);
+  g_free (device);
+  return match;
+}
+
+/**
+ * gst_vaapi_driver_cache_load:
+ * @cache: a #GstVaapiDriverCache
+ * @filename: the cache file
+ *
+ * Replaces the contents of @cache with the items saved into
+ * @filename, if that file was written for the same driver, libva
+ * version and device.
+ *
+ * Return value: %TRUE if the file was loaded, %FALSE if it does not
+ *   exist, is stale or is corrupted
+ */
+gboolean
+gst_vaapi_driver_cache_load (GstVaapiDriverCache * cache,
+    const gchar * filename)
+{
+  GKeyFile *key_file;
+  gchar **groups = NULL;
+  GError *error = NULL;
+  guint i;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  key_file = g_key_file_new ();
+  if (!g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE,
+          &error))
+    goto error_open;
+  if (!check_header (cache, key_file))
+    goto error_stale;
+
+  clear_data (cache);
+  if (!load_configs (cache, key_file))
+    goto error_corrupted;
+
+  if (g_key_file_has_group (key_file, GROUP_IMAGE_FORMATS)) {
+    cache->image_formats = get_image_formats (key_file, GROUP_IMAGE_FORMATS);
+    if (!cache->image_formats)
+      goto error_corrupted;
+  }
+
+  if (g_key_file_has_group (key_file, GROUP_SUBPICTURE_FORMATS)) {
+    gint *flags;
+    gsize num_flags = 0;
+
+    cache->subpicture_formats =
+        get_image_formats (key_file, GROUP_SUBPICTURE_FORMATS);
+    if (!cache->subpicture_formats)
+      goto error_corrupted;
+
+    cache->subpicture_flags = g_array_new (FALSE, TRUE, sizeof (guint));
+    g_array_set_size (cache->subpicture_flags,
+        cache->subpicture_formats->len);
+    if (cache->subpicture_formats->len > 0) {
+      flags = g_key_file_get_integer_list (key_file, GROUP_SUBPICTURE_FORMATS,
+          "flags", &num_flags, NULL);
+      if (!flags || num_flags != cache->subpicture_formats->len) {
+        g_free (flags);
+        goto error_corrupted;
+      }
+      for (i = 0; i < num_flags; i++)
+        g_array_index (cache->subpicture_flags, guint, i) = flags[i];
+      g_free (flags);
+    }
+  }
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (i = 0; groups[i]; i++) {
+    if (!g_str_has_prefix (groups[i], "config "))
+      continue;
+    if (!load_config_info (cache, key_file, groups[i]))
+      goto error_corrupted;
+  }
+  g_strfreev (groups);
+  g_key_file_unref (key_file);
+
+  GST_INFO ("loaded driver cache %s", filename);
+  cache->loaded = TRUE;
+  cache->dirty = FALSE;
+  return TRUE;
+
+  /* ERRORS */
+error_open:
+  {
+    GST_DEBUG ("no driver cache: %s", error->message);
+    g_clear_error (&error);
+    g_key_file_unref (key_file);
+    return FALSE;
+  }
+error_stale:
+  {
+    GST_INFO ("driver cache %s is stale", filename);
+    g_key_file_unref (key_file);
+    return FALSE;
+  }
+error_corrupted:
+  {
+    GST_WARNING ("driver cache %s is corrupted", filename);
+    clear_data (cache);
+    g_strfreev (groups);
+    g_key_file_unref (key_file);
+    return FALSE;
+  }
+}
+
+static void
+save_config_info (GKeyFile * key_file, const ConfigInfoEntry * entry)
+{
+  const GstVaapiDriverConfigInfo *const info = &entry->info;
+  gchar *group;
+  gint values[GST_VAAPI_DRIVER_CACHE_MAX_FORMATS];
+  guint i;
+
+  group = g_strdup_printf (GROUP_CONFIG_INFO, entry->profile,
+      entry->entrypoint);
+  g_key_file_set_integer (key_file, group, "rt-formats", info->rt_formats);
+  if (entry->has_surface_attribs)
+    g_key_file_set_boolean (key_file, group, "valid", entry->valid);
+  if (entry->valid) {
+    g_key_file_set_integer (key_file, group, "mem-types", info->mem_types);
+
+    values[0] = info->min_width;
+    values[1] = info->min_height;
+    values[2] = info->max_width;
+    values[3] = info->max_height;
+    g_key_file_set_integer_list (key_file, group, "size", values, 4);
+
+    for (i = 0; i < info->num_formats; i++)
+      values[i] = info->formats[i];
+    if (info->num_formats > 0)
+      g_key_file_set_integer_list (key_file, group, "pixel-formats", values,
+          info->num_formats);
+  }
+  g_free (group);
+}
+
+/**
+ * gst_vaapi_driver_cache_save:
+ * @cache: a #GstVaapiDriverCache
+ * @filename: the cache file
+ *
+ * Atomically replaces @filename with the contents of @cache, if items
+ * were queried from the driver since the cache was created or loaded.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_driver_cache_save (GstVaapiDriverCache * cache,
+    const gchar * filename)
+{
+  GKeyFile *key_file;
+  gchar *data = NULL, *dirname;
+  gsize length;
+  GError *error = NULL;
+  guint i;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  if (!cache->dirty)
+    return TRUE;
+
+  key_file = g_key_file_new ();
+  g_key_file_set_integer (key_file, GROUP_HEADER, "version",
+      DRIVER_CACHE_VERSION);
+  g_key_file_set_string (key_file, GROUP_HEADER, "vendor", cache->vendor);
+  g_key_file_set_string (key_file, GROUP_HEADER, "libva", cache->va_version);
+  g_key_file_set_string (key_file, GROUP_HEADER, "device", cache->device);
+
+  if (cache->configs && cache->configs->len > 0) {
+    gint *profiles = g_new (gint, cache->configs->len);
+    gint *entrypoints = g_new (gint, cache->configs->len);
+
+    for (i = 0; i < cache->configs->len; i++) {
+      const GstVaapiDriverConfig *const config =
+          &g_array_index (cache->configs, GstVaapiDriverConfig, i);
+      profiles[i] = config->profile;
+      entrypoints[i] = config->entrypoints;
+    }
+    g_key_file_set_integer_list (key_file, GROUP_CONFIGS, "profiles",
+        profiles, cache->configs->len);
+    g_key_file_set_integer_list (key_file, GROUP_CONFIGS, "entrypoints",
+        entrypoints, cache->configs->len);
+    g_free (profiles);
+    g_free (entrypoints);
+  }
+
+  if (cache->image_formats)
+    set_image_formats (key_file, GROUP_IMAGE_FORMATS, cache->image_formats);
+
+  if (cache->subpicture_formats) {
+    set_image_formats (key_file, GROUP_SUBPICTURE_FORMATS,
+        cache->subpicture_formats);
+    if (cache->subpicture_flags->len > 0)
+      g_key_file_set_integer_list (key_file, GROUP_SUBPICTURE_FORMATS,
+          "flags", (gint *) cache->subpicture_flags->data,
+          cache->subpicture_flags->len);
+  }
+
+  for (i = 0; i < cache->config_infos->len; i++)
+    save_config_info (key_file,
+        &g_array_index (cache->config_infos, ConfigInfoEntry, i));
+
+  data = g_key_file_to_data (key_file, &length, NULL);
+  g_key_file_unref (key_file);
+
+  dirname = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dirname, 0700);
+  g_free (dirname);
+
+  if (!g_file_set_contents (filename, data, length, &error))
+    goto error_write;
+  g_free (data);
+
+  GST_INFO ("saved driver cache %s", filename);
+  cache->dirty = FALSE;
+  return TRUE;
+
+  /* ERRORS */
+error_write:
+  {
+    GST_WARNING ("failed to write driver cache: %s", error->message);
+    g_clear_error (&error);
+    g_free (data);
+    return FALSE;
+  }
+}
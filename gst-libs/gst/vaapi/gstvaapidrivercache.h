@@ -0,0 +1,161 @@
+/*
+ *  gstvaapidrivercache.h - Persistent VA driver capability cache
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DRIVER_CACHE_H
+#define GST_VAAPI_DRIVER_CACHE_H
+
+#include <glib.h>
+#include <va/va.h>
+
+G_BEGIN_DECLS
+
+#define GST_VAAPI_DRIVER_CACHE_MAX_FORMATS 32
+
+typedef struct _GstVaapiDriverCache GstVaapiDriverCache;
+typedef struct _GstVaapiDriverCacheVTable GstVaapiDriverCacheVTable;
+typedef struct _GstVaapiDriverConfig GstVaapiDriverConfig;
+typedef struct _GstVaapiDriverConfigInfo GstVaapiDriverConfigInfo;
+
+/**
+ * GstVaapiDriverCacheVTable:
+ *
+ * The VA entry points used to query the driver capabilities. They
+ * default to libva, and can be replaced by stubs to test the cache
+ * logic. Each member has the signature of the libva function of the
+ * same name.
+ */
+struct _GstVaapiDriverCacheVTable
+{
+  int (*max_num_profiles) (VADisplay dpy);
+  int (*max_num_entrypoints) (VADisplay dpy);
+  int (*max_num_image_formats) (VADisplay dpy);
+  int (*max_num_subpicture_formats) (VADisplay dpy);
+  VAStatus (*query_config_profiles) (VADisplay dpy, VAProfile * profiles,
+      int *num_profiles);
+  VAStatus (*query_config_entrypoints) (VADisplay dpy, VAProfile profile,
+      VAEntrypoint * entrypoints, int *num_entrypoints);
+  VAStatus (*get_config_attributes) (VADisplay dpy, VAProfile profile,
+      VAEntrypoint entrypoint, VAConfigAttrib * attribs, int num_attribs);
+  VAStatus (*create_config) (VADisplay dpy, VAProfile profile,
+      VAEntrypoint entrypoint, VAConfigAttrib * attribs, int num_attribs,
+      VAConfigID * config);
+  VAStatus (*destroy_config) (VADisplay dpy, VAConfigID config);
+  VAStatus (*query_surface_attributes) (VADisplay dpy, VAConfigID config,
+      VASurfaceAttrib * attribs, unsigned int *num_attribs);
+  VAStatus (*query_image_formats) (VADisplay dpy, VAImageFormat * formats,
+      int *num_formats);
+  VAStatus (*query_subpicture_formats) (VADisplay dpy,
+      VAImageFormat * formats, unsigned int *flags,
+      unsigned int *num_formats);
+};
+
+/**
+ * GstVaapiDriverConfig:
+ * @profile: a VA profile
+ * @entrypoints: the supported VA entrypoints, as a bitmask of
+ *   (1 << #VAEntrypoint)
+ *
+ * A VA profile and its entrypoints. The video processing entrypoints
+ * are reported for %VAProfileNone.
+ */
+struct _GstVaapiDriverConfig
+{
+  VAProfile profile;
+  guint32 entrypoints;
+};
+
+/**
+ * GstVaapiDriverConfigInfo:
+ * @rt_formats: the VAConfigAttribRTFormat value
+ * @min_width: minimal surface width in pixels
+ * @min_height: minimal surface height in pixels
+ * @max_width: maximal surface width in pixels
+ * @max_height: maximal surface height in pixels
+ * @mem_types: the supported surface memory types
+ * @num_formats: number of entries in @formats
+ * @formats: the settable surface pixel formats, as VA fourccs
+ *
+ * The capabilities of a VA config created for the first chroma type
+ * of @rt_formats, as a #GstVaapiContext would.
+ */
+struct _GstVaapiDriverConfigInfo
+{
+  guint rt_formats;
+  gint min_width;
+  gint min_height;
+  gint max_width;
+  gint max_height;
+  guint mem_types;
+  guint num_formats;
+  guint32 formats[GST_VAAPI_DRIVER_CACHE_MAX_FORMATS];
+};
+
+G_GNUC_INTERNAL
+GstVaapiDriverCache *
+gst_vaapi_driver_cache_new (VADisplay dpy,
+    const GstVaapiDriverCacheVTable * vtable, const gchar * vendor,
+    const gchar * va_version, const gchar * device);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_driver_cache_free (GstVaapiDriverCache * cache);
+
+G_GNUC_INTERNAL
+gchar *
+gst_vaapi_driver_cache_get_default_filename (GstVaapiDriverCache * cache);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_driver_cache_load (GstVaapiDriverCache * cache,
+    const gchar * filename);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_driver_cache_save (GstVaapiDriverCache * cache,
+    const gchar * filename);
+
+G_GNUC_INTERNAL
+const GstVaapiDriverConfig *
+gst_vaapi_driver_cache_get_configs (GstVaapiDriverCache * cache,
+    guint * num_configs);
+
+G_GNUC_INTERNAL
+const VAImageFormat *
+gst_vaapi_driver_cache_get_image_formats (GstVaapiDriverCache * cache,
+    guint * num_formats);
+
+G_GNUC_INTERNAL
+const VAImageFormat *
+gst_vaapi_driver_cache_get_subpicture_formats (GstVaapiDriverCache * cache,
+    const guint ** flags, guint * num_formats);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_driver_cache_get_rt_formats (GstVaapiDriverCache * cache,
+    VAProfile profile, VAEntrypoint entrypoint, guint * rt_formats);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_driver_cache_get_config_info (GstVaapiDriverCache * cache,
+    VAProfile profile, VAEntrypoint entrypoint,
+    GstVaapiDriverConfigInfo * info);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DRIVER_CACHE_H */
@@ -25,6 +25,7 @@
 #include "gstvaapicompat.h"
 #include "gstvaapiencoder.h"
 #include "gstvaapiencoder_priv.h"
+#include "gstvaapicodedbufferproxy_priv.h"
 #include "gstvaapicontext.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils.h"
@@ -34,6 +35,31 @@
 #define DEBUG 1
 #include "gstvaapidebug.h"
 
+/* Maximum number of coded buffers lent to downstream at a time, see
+ * gst_vaapi_encoder_wrap_coded_buffer() */
+#define ENCODER_MAX_CODEDBUF_LENT 2
+
+/* Maximum value of the async-depth property */
+#define ENCODER_MAX_ASYNC_DEPTH 16
+
+/* Coded buffers of both the reference and the non-reference pools
+ * may be queued, each pool holding up to the async-depth plus one,
+ * plus the ones lent to downstream. A pool replaced on resize keeps
+ * its buffers in flight until they are released, so the coded
+ * buffers allocated are also capped to the queue size, see
+ * gst_vaapi_encoder_create_coded_buffer() */
+#define ENCODER_CODEDBUF_QUEUE_SIZE \
+  (2 * (ENCODER_MAX_ASYNC_DEPTH + 1 + ENCODER_MAX_CODEDBUF_LENT))
+
+/* Tracks the release of a coded buffer, which may outlive the encoder
+ * once it is lent to downstream */
+typedef struct
+{
+  GWeakRef encoder;
+  gboolean lent;
+  gboolean queued;
+} CodedBufferOwner;
+
 gboolean
 gst_vaapi_encoder_ensure_param_quality_level (GstVaapiEncoder * encoder,
     GstVaapiEncPicture * picture)
@@ -239,40 +265,180 @@ gst_vaapi_encoder_replace (GstVaapiEncoder ** old_encoder_ptr,
 
 /* Notifies gst_vaapi_encoder_create_coded_buffer() that a new buffer is free */
 static void
-_coded_buffer_proxy_released_notify (GstVaapiEncoder * encoder)
+_coded_buffer_proxy_released_notify (CodedBufferOwner * owner)
 {
-  g_mutex_lock (&encoder->mutex);
-  g_cond_signal (&encoder->codedbuf_free);
-  g_mutex_unlock (&encoder->mutex);
+  GstVaapiEncoder *const encoder = g_weak_ref_get (&owner->encoder);
+
+  if (encoder) {
+    g_mutex_lock (&encoder->mutex);
+    if (owner->lent)
+      encoder->num_codedbuf_lent--;
+    if (owner->queued)
+      encoder->num_codedbuf_alloc--;
+    g_cond_signal (&encoder->codedbuf_free);
+    g_mutex_unlock (&encoder->mutex);
+    gst_object_unref (encoder);
+  }
+  g_weak_ref_clear (&owner->encoder);
+  g_slice_free (CodedBufferOwner, owner);
 }
 
-/* Creates a new VA coded buffer object proxy, backed from a pool */
+/* A @queued coded buffer is counted in num_codedbuf_alloc until it
+   is released */
+static void
+set_coded_buffer_owner (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy, gboolean queued)
+{
+  CodedBufferOwner *owner;
+
+  owner = g_slice_new (CodedBufferOwner);
+  g_weak_ref_init (&owner->encoder, encoder);
+  owner->lent = FALSE;
+  owner->queued = queued;
+  gst_vaapi_coded_buffer_proxy_set_destroy_notify (codedbuf_proxy,
+      (GDestroyNotify) _coded_buffer_proxy_released_notify, owner);
+}
+
+/* Allocates a coded buffer from the pool in @pool_ptr, unless the
+   coded buffer queue could not hold one more. Called with the encoder
+   mutex held */
 static GstVaapiCodedBufferProxy *
-gst_vaapi_encoder_create_coded_buffer (GstVaapiEncoder * encoder)
+alloc_queued_coded_buffer (GstVaapiEncoder * encoder,
+    GstVaapiVideoPool ** pool_ptr)
 {
-  GstVaapiCodedBufferPool *const pool =
-      GST_VAAPI_CODED_BUFFER_POOL (encoder->codedbuf_pool);
   GstVaapiCodedBufferProxy *codedbuf_proxy;
 
+  if (encoder->num_codedbuf_alloc >=
+      gst_vaapi_ring_queue_get_capacity (encoder->codedbuf_queue))
+    return NULL;
+
+  codedbuf_proxy =
+      gst_vaapi_coded_buffer_proxy_new_from_pool (GST_VAAPI_CODED_BUFFER_POOL
+      (*pool_ptr));
+  if (codedbuf_proxy)
+    encoder->num_codedbuf_alloc++;
+  return codedbuf_proxy;
+}
+
+/* Creates a new VA coded buffer object proxy, backed from a pool. A
+   @reference picture gets a worst-case buffer */
+static GstVaapiCodedBufferProxy *
+gst_vaapi_encoder_create_coded_buffer (GstVaapiEncoder * encoder,
+    gboolean reference)
+{
+  GstVaapiVideoPool **const pool_ptr = reference ?
+      &encoder->codedbuf_ref_pool : &encoder->codedbuf_pool;
+  GstVaapiCodedBufferProxy *codedbuf_proxy;
+
+  /* The pool may be replaced by the output thread, see
+     update_coded_buffer_size() */
   g_mutex_lock (&encoder->mutex);
   do {
-    codedbuf_proxy = gst_vaapi_coded_buffer_proxy_new_from_pool (pool);
+    codedbuf_proxy = alloc_queued_coded_buffer (encoder, pool_ptr);
     if (codedbuf_proxy)
       break;
 
     /* Wait for a free coded buffer to become available */
     g_cond_wait (&encoder->codedbuf_free, &encoder->mutex);
-    codedbuf_proxy = gst_vaapi_coded_buffer_proxy_new_from_pool (pool);
+    codedbuf_proxy = alloc_queued_coded_buffer (encoder, pool_ptr);
   } while (0);
   g_mutex_unlock (&encoder->mutex);
   if (!codedbuf_proxy)
     return NULL;
 
-  gst_vaapi_coded_buffer_proxy_set_destroy_notify (codedbuf_proxy,
-      (GDestroyNotify) _coded_buffer_proxy_released_notify, encoder);
+  set_coded_buffer_owner (encoder, codedbuf_proxy, TRUE);
+  return codedbuf_proxy;
+}
+
+/* Creates a new worst-case VA coded buffer object proxy, outside of
+   the pool so that the output thread never waits for a free one */
+static GstVaapiCodedBufferProxy *
+create_overflow_coded_buffer (GstVaapiEncoder * encoder)
+{
+  GstVaapiVideoPool *pool;
+  GstVaapiCodedBufferProxy *codedbuf_proxy;
+
+  pool = gst_vaapi_coded_buffer_pool_new (encoder, encoder->codedbuf_size);
+  if (!pool)
+    return NULL;
+  codedbuf_proxy =
+      gst_vaapi_coded_buffer_proxy_new_from_pool (GST_VAAPI_CODED_BUFFER_POOL
+      (pool));
+  gst_vaapi_video_pool_unref (pool);
+  if (!codedbuf_proxy)
+    return NULL;
+
+  set_coded_buffer_owner (encoder, codedbuf_proxy, FALSE);
   return codedbuf_proxy;
 }
 
+/* Returns the size of the coded buffers allocated from now on */
+static guint
+get_coded_buffer_size (GstVaapiEncoder * encoder)
+{
+  return encoder->codedbuf_sizer ?
+      gst_vaapi_coded_buffer_sizer_get_size (encoder->codedbuf_sizer) :
+      encoder->codedbuf_size;
+}
+
+/* Replaces the coded buffer pool in @pool_ptr if its buffers are not
+   @size bytes large. The buffers in use go back to the former pool,
+   which is released along with the last of them */
+static gboolean
+ensure_coded_buffer_pool (GstVaapiEncoder * encoder,
+    GstVaapiVideoPool ** pool_ptr, guint size)
+{
+  GstVaapiVideoPool *pool;
+
+  if (*pool_ptr && size ==
+      gst_vaapi_coded_buffer_pool_get_buffer_size (GST_VAAPI_CODED_BUFFER_POOL
+          (*pool_ptr)))
+    return TRUE;
+
+  pool = gst_vaapi_coded_buffer_pool_new (encoder, size);
+  if (!pool)
+    return FALSE;
+  gst_vaapi_video_pool_set_capacity (pool,
+      MAX (5, encoder->async_depth + 1) + ENCODER_MAX_CODEDBUF_LENT);
+
+  g_mutex_lock (&encoder->mutex);
+  gst_vaapi_video_pool_replace (pool_ptr, pool);
+  g_cond_signal (&encoder->codedbuf_free);
+  g_mutex_unlock (&encoder->mutex);
+  gst_vaapi_video_pool_unref (pool);
+  return TRUE;
+}
+
+/* Resizes the coded buffers of the non-reference pictures to what the
+   sizer predicts, the ones of the reference pictures stay worst-case */
+static gboolean
+update_coded_buffer_size (GstVaapiEncoder * encoder)
+{
+  return ensure_coded_buffer_pool (encoder, &encoder->codedbuf_pool,
+      get_coded_buffer_size (encoder))
+      && ensure_coded_buffer_pool (encoder, &encoder->codedbuf_ref_pool,
+      encoder->codedbuf_size);
+}
+
+/* Whether later pictures may predict from @picture. Such a picture
+   cannot be encoded again on overflow, since the pictures predicted
+   from the first reconstruction may already be submitted. Only the
+   H.264 encoder flags reference pictures */
+static gboolean
+is_reference_picture (GstVaapiEncoder * encoder, GstVaapiEncPicture * picture)
+{
+  switch (gst_vaapi_profile_get_codec (encoder->profile)) {
+    case GST_VAAPI_CODEC_JPEG:
+      return FALSE;
+    case GST_VAAPI_CODEC_MPEG2:
+      return picture->type != GST_VAAPI_PICTURE_TYPE_B;
+    case GST_VAAPI_CODEC_H264:
+      return GST_VAAPI_ENC_PICTURE_IS_REFRENCE (picture);
+    default:
+      return TRUE;
+  }
+}
+
 /* Notifies gst_vaapi_encoder_create_surface() that a new surface is free */
 static void
 _surface_proxy_released_notify (GstVaapiEncoder * encoder)
@@ -318,17 +484,25 @@ gst_vaapi_encoder_encode_and_queue (GstVaapiEncoder * encoder,
   GstVaapiCodedBufferProxy *codedbuf_proxy;
   GstVaapiEncoderStatus status;
 
-  codedbuf_proxy = gst_vaapi_encoder_create_coded_buffer (encoder);
+  codedbuf_proxy = gst_vaapi_encoder_create_coded_buffer (encoder,
+      is_reference_picture (encoder, picture));
   if (!codedbuf_proxy)
     goto error_create_coded_buffer;
 
+  /* A picture encoded into a smaller buffer than the worst case may
+     have to be encoded again, see check_coded_buffer() */
+  picture->keep_buffers =
+      gst_vaapi_coded_buffer_proxy_get_buffer_size (codedbuf_proxy) <
+      encoder->codedbuf_size;
+
   status = klass->encode (encoder, picture, codedbuf_proxy);
   if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
     goto error_encode;
 
   gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
       picture, (GDestroyNotify) gst_vaapi_mini_object_unref);
-  g_async_queue_push (encoder->codedbuf_queue, codedbuf_proxy);
+  if (!gst_vaapi_ring_queue_push (encoder->codedbuf_queue, codedbuf_proxy))
+    goto error_queue_overflow;
   encoder->num_codedbuf_queued++;
 
   return status;
@@ -345,21 +519,19 @@ error_encode:
     gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
     return status;
   }
+error_queue_overflow:
+  {
+    GST_ERROR ("coded buffer queue overflow");
+    /* the picture is owned by the coded buffer now */
+    gst_vaapi_enc_picture_ref (picture);
+    gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
+    return GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
 }
 
-/**
- * gst_vaapi_encoder_put_frame:
- * @encoder: a #GstVaapiEncoder
- * @frame: a #GstVideoCodecFrame
- *
- * Queues a #GstVideoCodedFrame to the HW encoder. The encoder holds
- * an extra reference to the @frame.
- *
- * Return value: a #GstVaapiEncoderStatus
- */
-GstVaapiEncoderStatus
-gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
-    GstVideoCodecFrame * frame)
+/* Reorders the frame, and encodes the pictures ready for encoding */
+static GstVaapiEncoderStatus
+reorder_and_encode (GstVaapiEncoder * encoder, GstVideoCodecFrame * frame)
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
   GstVaapiEncoderStatus status;
@@ -395,6 +567,227 @@ error_encode:
   }
 }
 
+/* Returns the luma plane of the frame surface into the look-ahead
+ * image, or NULL if the surface cannot be read back as 8-bit YUV */
+static const guint8 *
+map_lookahead_luma (GstVaapiEncoder * encoder, GstVideoCodecFrame * frame,
+    guint * stride)
+{
+  GstVaapiSurfaceProxy *const proxy =
+      gst_video_codec_frame_get_user_data (frame);
+  GstVaapiSurface *surface;
+  GstVideoFormat format;
+  guint width, height, image_width, image_height;
+
+  if (!proxy)
+    return NULL;
+  surface = GST_VAAPI_SURFACE_PROXY_SURFACE (proxy);
+
+  format = gst_vaapi_surface_get_format (surface);
+  if (format != GST_VIDEO_FORMAT_NV12 && format != GST_VIDEO_FORMAT_I420
+      && format != GST_VIDEO_FORMAT_YV12)
+    return NULL;
+
+  gst_vaapi_surface_get_size (surface, &width, &height);
+  if (encoder->lookahead_image) {
+    gst_vaapi_image_get_size (encoder->lookahead_image, &image_width,
+        &image_height);
+    if (gst_vaapi_image_get_format (encoder->lookahead_image) != format
+        || image_width != width || image_height != height)
+      gst_mini_object_replace ((GstMiniObject **) & encoder->lookahead_image,
+          NULL);
+  }
+  if (!encoder->lookahead_image) {
+    encoder->lookahead_image =
+        gst_vaapi_image_new (encoder->display, format, width, height);
+    if (!encoder->lookahead_image)
+      return NULL;
+  }
+
+  if (!gst_vaapi_surface_get_image (surface, encoder->lookahead_image))
+    return NULL;
+  if (!gst_vaapi_image_map (encoder->lookahead_image))
+    return NULL;
+
+  *stride = gst_vaapi_image_get_pitch (encoder->lookahead_image, 0);
+  return gst_vaapi_image_get_plane (encoder->lookahead_image, 0);
+}
+
+/* Pops the frames leaving the look-ahead window, and hands them over
+ * to the reordering along with their decisions */
+static GstVaapiEncoderStatus
+submit_lookahead_frames (GstVaapiEncoder * encoder, gboolean drain)
+{
+  GstVaapiEncoderStatus status = GST_VAAPI_ENCODER_STATUS_SUCCESS;
+  GstVideoCodecFrame *frame;
+
+  while (status == GST_VAAPI_ENCODER_STATUS_SUCCESS &&
+      (frame = gst_vaapi_lookahead_pop (encoder->lookahead, drain,
+              &encoder->lookahead_info))) {
+    encoder->has_lookahead_info = TRUE;
+    status = reorder_and_encode (encoder, frame);
+    encoder->has_lookahead_info = FALSE;
+    gst_video_codec_frame_unref (frame);
+  }
+  return status;
+}
+
+/* Releases the frames held in the look-ahead window */
+static void
+clear_lookahead (GstVaapiEncoder * encoder)
+{
+  GstVaapiLookaheadInfo info;
+  GstVideoCodecFrame *frame;
+
+  if (!encoder->lookahead)
+    return;
+
+  while ((frame = gst_vaapi_lookahead_pop (encoder->lookahead, TRUE, &info)))
+    gst_video_codec_frame_unref (frame);
+  gst_vaapi_lookahead_reset (encoder->lookahead);
+}
+
+/**
+ * gst_vaapi_encoder_put_frame:
+ * @encoder: a #GstVaapiEncoder
+ * @frame: a #GstVideoCodecFrame
+ *
+ * Queues a #GstVideoCodedFrame to the HW encoder. The encoder holds
+ * an extra reference to the @frame.
+ *
+ * Return value: a #GstVaapiEncoderStatus
+ */
+GstVaapiEncoderStatus
+gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
+    GstVideoCodecFrame * frame)
+{
+  const guint8 *luma;
+  guint stride = 0;
+
+  if (!encoder->lookahead)
+    return reorder_and_encode (encoder, frame);
+
+  luma = map_lookahead_luma (encoder, frame, &stride);
+  gst_vaapi_lookahead_push (encoder->lookahead,
+      gst_video_codec_frame_ref (frame), luma, stride,
+      GST_VAAPI_ENCODER_WIDTH (encoder), GST_VAAPI_ENCODER_HEIGHT (encoder));
+  if (luma)
+    gst_vaapi_image_unmap (encoder->lookahead_image);
+
+  return submit_lookahead_frames (encoder, FALSE);
+}
+
+/* Polling interval for asynchronous completion, in microseconds */
+#define ASYNC_POLL_INTERVAL 500
+
+/* Checks whether the encoded picture completed, without blocking */
+static gboolean
+is_picture_ready (GstVaapiEncPicture * picture)
+{
+  GstVaapiSurfaceStatus status;
+
+  if (!gst_vaapi_surface_query_status (picture->surface, &status))
+    return FALSE;
+  return !(status & GST_VAAPI_SURFACE_STATUS_RENDERING);
+}
+
+static void
+log_async_stats (GstVaapiEncoder * encoder)
+{
+  if (encoder->async_num_frames == 0)
+    return;
+
+  GST_INFO_OBJECT (encoder, "async-depth %u: %" G_GUINT64_FORMAT " frames, "
+      "queue depth avg %.2f max %u, %" G_GUINT64_FORMAT " polls, %"
+      G_GUINT64_FORMAT " blocking syncs", encoder->async_depth,
+      encoder->async_num_frames,
+      (gdouble) encoder->async_depth_sum / encoder->async_num_frames,
+      encoder->async_depth_max, encoder->async_num_polls,
+      encoder->async_num_syncs);
+}
+
+static void
+log_codedbuf_stats (GstVaapiEncoder * encoder)
+{
+  GstVaapiCodedBufferSizerStats stats;
+  guint capacity;
+
+  if (!encoder->codedbuf_sizer || !encoder->codedbuf_pool)
+    return;
+
+  gst_vaapi_coded_buffer_sizer_get_stats (encoder->codedbuf_sizer, &stats);
+  if (stats.num_frames == 0)
+    return;
+
+  capacity = gst_vaapi_video_pool_get_capacity (encoder->codedbuf_pool);
+  GST_INFO_OBJECT (encoder, "coded buffers: %u bytes instead of %u, "
+      "largest frame %u bytes, %u resizes, %u overflows in %"
+      G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT " bytes saved",
+      stats.size, stats.max_size, stats.max_coded_size, stats.num_resizes,
+      stats.num_overflows, stats.num_frames,
+      (guint64) (stats.max_size - stats.size) * capacity);
+}
+
+/* Feeds the coded frame size to the sizer, and encodes the picture
+ * again into a worst-case coded buffer if it did not fit, in which
+ * case *@codedbuf_proxy_ptr is replaced. Only non-reference pictures
+ * get smaller buffers, so no picture predicts from the first encode.
+ * Overflows should be rare enough that the rate control seeing the
+ * frame twice does not matter */
+static gboolean
+check_coded_buffer (GstVaapiEncoder * encoder, GstVaapiEncPicture * picture,
+    GstVaapiCodedBufferProxy ** codedbuf_proxy_ptr)
+{
+  GstVaapiCodedBufferProxy *codedbuf_proxy;
+  gboolean overflow;
+  gssize size;
+
+  size = gst_vaapi_coded_buffer_get_size_full
+      (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (*codedbuf_proxy_ptr), &overflow);
+  if (size < 0)
+    return FALSE;
+
+  if (overflow) {
+    GST_INFO ("coded frame did not fit into %" G_GSIZE_FORMAT " bytes, "
+        "encoding it again",
+        gst_vaapi_coded_buffer_proxy_get_buffer_size (*codedbuf_proxy_ptr));
+    if (gst_vaapi_coded_buffer_sizer_overflow (encoder->codedbuf_sizer))
+      update_coded_buffer_size (encoder);
+
+    codedbuf_proxy = create_overflow_coded_buffer (encoder);
+    if (!codedbuf_proxy)
+      return FALSE;
+    if (!gst_vaapi_enc_picture_resubmit (picture,
+            GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy))
+        || !gst_vaapi_surface_sync (picture->surface))
+      goto error_resubmit;
+
+    size = gst_vaapi_coded_buffer_get_size
+        (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy));
+    if (size < 0)
+      goto error_resubmit;
+
+    /* The picture is owned by the coded buffer */
+    gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
+        gst_vaapi_enc_picture_ref (picture),
+        (GDestroyNotify) gst_vaapi_mini_object_unref);
+    gst_vaapi_coded_buffer_proxy_unref (*codedbuf_proxy_ptr);
+    *codedbuf_proxy_ptr = codedbuf_proxy;
+  }
+
+  if (gst_vaapi_coded_buffer_sizer_push (encoder->codedbuf_sizer, size))
+    update_coded_buffer_size (encoder);
+  return TRUE;
+
+  /* ERRORS */
+error_resubmit:
+  {
+    GST_ERROR ("failed to encode the frame again");
+    gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
+    return FALSE;
+  }
+}
+
 /**
  * gst_vaapi_encoder_get_buffer_with_timeout:
  * @encoder: a #GstVaapiEncoder
@@ -419,14 +812,47 @@ gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
 {
   GstVaapiEncPicture *picture;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
+  gboolean ready = FALSE;
+  gint64 end_time;
+  guint depth;
 
-  codedbuf_proxy = g_async_queue_timeout_pop (encoder->codedbuf_queue, timeout);
+  end_time = g_get_monotonic_time () + timeout;
+  codedbuf_proxy =
+      gst_vaapi_ring_queue_timeout_pop (encoder->codedbuf_queue, timeout);
   if (!codedbuf_proxy)
     return GST_VAAPI_ENCODER_STATUS_NO_BUFFER;
 
-  /* Wait for completion of all operations and report any error that occurred */
   picture = gst_vaapi_coded_buffer_proxy_get_user_data (codedbuf_proxy);
-  if (!gst_vaapi_surface_sync (picture->surface))
+
+  /* In asynchronous mode, poll for completion without holding the
+   * display lock so that the next pictures can be submitted meanwhile,
+   * and only fall back to a blocking sync once async-depth pictures
+   * are in flight, or once the timeout expired */
+  if (encoder->async_depth > 0) {
+    depth = gst_vaapi_ring_queue_length (encoder->codedbuf_queue) + 1;
+    encoder->async_num_frames++;
+    encoder->async_depth_sum += depth;
+    encoder->async_depth_max = MAX (encoder->async_depth_max, depth);
+
+    while (!(ready = is_picture_ready (picture))) {
+      depth = gst_vaapi_ring_queue_length (encoder->codedbuf_queue) + 1;
+      if (depth >= encoder->async_depth
+          || g_get_monotonic_time () >= end_time)
+        break;
+      encoder->async_num_polls++;
+      g_usleep (ASYNC_POLL_INTERVAL);
+    }
+  }
+
+  /* Wait for completion of all operations and report any error that occurred */
+  if (!ready) {
+    encoder->async_num_syncs++;
+    if (!gst_vaapi_surface_sync (picture->surface))
+      goto error_invalid_buffer;
+  }
+
+  if (picture->keep_buffers
+      && !check_coded_buffer (encoder, picture, &codedbuf_proxy))
     goto error_invalid_buffer;
 
   gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
@@ -447,6 +873,124 @@ error_invalid_buffer:
   }
 }
 
+static void
+coded_buffer_memory_release (GstVaapiCodedBufferProxy * codedbuf_proxy)
+{
+  gst_vaapi_coded_buffer_unmap (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER
+      (codedbuf_proxy));
+  gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
+}
+
+/* Marks the coded buffer as lent, unless too many already are */
+static gboolean
+coded_buffer_owner_lend (GstVaapiEncoder * encoder, CodedBufferOwner * owner,
+    gboolean lend)
+{
+  gboolean success = TRUE;
+
+  g_mutex_lock (&encoder->mutex);
+  if (!lend)
+    encoder->num_codedbuf_lent--;
+  else if (encoder->num_codedbuf_lent < ENCODER_MAX_CODEDBUF_LENT)
+    encoder->num_codedbuf_lent++;
+  else
+    success = FALSE;
+  if (success)
+    owner->lent = lend;
+  g_mutex_unlock (&encoder->mutex);
+  return success;
+}
+
+/**
+ * gst_vaapi_encoder_wrap_coded_buffer:
+ * @encoder: a #GstVaapiEncoder
+ * @codedbuf_proxy: a coded buffer returned by
+ *   gst_vaapi_encoder_get_buffer_with_timeout()
+ *
+ * Wraps the coded data of @codedbuf_proxy into a new #GstBuffer
+ * without copying it, with one read-only memory per coded buffer
+ * segment. The VA coded buffer stays mapped, and is only given back
+ * to @encoder, once all the memories are released. The user-data of
+ * @codedbuf_proxy is released right away.
+ *
+ * Only a few coded buffers can be lent that way, so that @encoder
+ * does not run out of them: %NULL is returned beyond, and the coded
+ * data needs to be copied instead.
+ *
+ * Return value: (transfer full): the new #GstBuffer, or %NULL
+ */
+GstBuffer *
+gst_vaapi_encoder_wrap_coded_buffer (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy)
+{
+  GstVaapiCodedBuffer *coded_buf;
+  VACodedBufferSegment *segment, *segment_list;
+  CodedBufferOwner *owner;
+  GstBuffer *buf;
+  GstMemory *mem;
+
+  g_return_val_if_fail (encoder != NULL, NULL);
+  g_return_val_if_fail (codedbuf_proxy != NULL, NULL);
+
+  /* Only the coded buffers from gst_vaapi_encoder_create_coded_buffer()
+     track their release */
+  if (codedbuf_proxy->destroy_func !=
+      (GDestroyNotify) _coded_buffer_proxy_released_notify)
+    return NULL;
+  owner = codedbuf_proxy->destroy_data;
+  if (owner->lent || !coded_buffer_owner_lend (encoder, owner, TRUE))
+    return NULL;
+
+  coded_buf = GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy);
+  if (!gst_vaapi_coded_buffer_map (coded_buf, &segment_list))
+    goto error_map_buffer;
+
+  buf = gst_buffer_new ();
+  for (segment = segment_list; segment != NULL; segment = segment->next) {
+    if (segment->size == 0)
+      continue;
+
+    /* Each memory holds its own mapping */
+    if (!gst_vaapi_coded_buffer_map (coded_buf, &segment_list))
+      goto error_map_segment;
+    mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, segment->buf,
+        segment->size, 0, segment->size,
+        gst_vaapi_coded_buffer_proxy_ref (codedbuf_proxy),
+        (GDestroyNotify) coded_buffer_memory_release);
+    gst_buffer_append_memory (buf, mem);
+  }
+  gst_vaapi_coded_buffer_unmap (coded_buf);
+
+  if (gst_buffer_n_memory (buf) == 0)
+    goto error_empty_buffer;
+
+  /* The frame goes downstream on its own, with its input buffer */
+  gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy, NULL, NULL);
+  return buf;
+
+  /* ERRORS */
+error_map_buffer:
+  {
+    GST_ERROR ("failed to map coded buffer");
+    coded_buffer_owner_lend (encoder, owner, FALSE);
+    return NULL;
+  }
+error_map_segment:
+  {
+    GST_ERROR ("failed to map coded buffer segment");
+    gst_vaapi_coded_buffer_unmap (coded_buf);
+    gst_buffer_unref (buf);
+    coded_buffer_owner_lend (encoder, owner, FALSE);
+    return NULL;
+  }
+error_empty_buffer:
+  {
+    gst_buffer_unref (buf);
+    coded_buffer_owner_lend (encoder, owner, FALSE);
+    return NULL;
+  }
+}
+
 static inline gboolean
 _get_pending_reordered (GstVaapiEncoder * encoder,
     GstVaapiEncPicture ** picture, gpointer * state)
@@ -474,6 +1018,13 @@ gst_vaapi_encoder_flush (GstVaapiEncoder * encoder)
   GstVaapiEncoderStatus status;
   gpointer iter = NULL;
 
+  if (encoder->lookahead) {
+    status = submit_lookahead_frames (encoder, TRUE);
+    if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
+      return status;
+    gst_vaapi_lookahead_reset (encoder->lookahead);
+  }
+
   picture = NULL;
   while (_get_pending_reordered (encoder, &picture, &iter)) {
     if (!picture)
@@ -484,7 +1035,12 @@ gst_vaapi_encoder_flush (GstVaapiEncoder * encoder)
   }
   g_free (iter);
 
-  return klass->flush (encoder);
+  log_async_stats (encoder);
+  status = klass->flush (encoder);
+
+  /* No more objects are needed until new frames are submitted */
+  gst_vaapi_mini_object_cache_clear (encoder->object_cache);
+  return status;
 
   /* ERRORS */
 error_encode:
@@ -714,6 +1270,9 @@ init_context_info (GstVaapiEncoder * encoder, GstVaapiContextInfo * cip)
   cip->width = 0;
   cip->height = 0;
   cip->ref_frames = encoder->num_ref_frames;
+
+  /* The reconstructed surfaces never leave the encoder */
+  cip->surface_alloc_flags = gst_vaapi_surface_get_compressed_alloc_flags ();
 }
 
 /* Updates video context */
@@ -781,8 +1340,7 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
   GstVideoInfo *const vip = GST_VAAPI_ENCODER_VIDEO_INFO (encoder);
   GstVaapiEncoderStatus status;
-  GstVaapiVideoPool *pool;
-  guint codedbuf_size, target_percentage;
+  guint frame_size, target_percentage;
   guint fps_d, fps_n;
   guint quality_level_max = 0;
 
@@ -845,17 +1403,33 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
 #endif
   }
 
-  codedbuf_size = encoder->codedbuf_pool ?
-      gst_vaapi_coded_buffer_pool_get_buffer_size (GST_VAAPI_CODED_BUFFER_POOL
-      (encoder)) : 0;
-  if (codedbuf_size != encoder->codedbuf_size) {
-    pool = gst_vaapi_coded_buffer_pool_new (encoder, encoder->codedbuf_size);
-    if (!pool)
-      goto error_alloc_codedbuf_pool;
-    gst_vaapi_video_pool_set_capacity (pool, 5);
-    gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, pool);
-    gst_vaapi_video_pool_unref (pool);
+  /* Coded buffers start from the rate control target, if any */
+  if (encoder->codedbuf_sizer) {
+    GstVaapiCodedBufferSizerStats stats;
+
+    gst_vaapi_coded_buffer_sizer_get_stats (encoder->codedbuf_sizer, &stats);
+    if (stats.max_size != encoder->codedbuf_size) {
+      log_codedbuf_stats (encoder);
+      gst_vaapi_coded_buffer_sizer_free (encoder->codedbuf_sizer);
+      encoder->codedbuf_sizer = NULL;
+    }
   }
+  if (!encoder->codedbuf_sizer)
+    encoder->codedbuf_sizer =
+        gst_vaapi_coded_buffer_sizer_new (encoder->codedbuf_size);
+  if (!encoder->codedbuf_sizer)
+    goto error_alloc_codedbuf_pool;
+
+  frame_size = 0;
+  if (GST_VAAPI_ENCODER_RATE_CONTROL (encoder) != GST_VAAPI_RATECONTROL_CQP
+      && encoder->bitrate > 0 && fps_n > 0 && fps_d > 0)
+    frame_size = gst_util_uint64_scale (encoder->bitrate, 1000 / 8 * fps_d,
+        fps_n);
+  gst_vaapi_coded_buffer_sizer_set_target (encoder->codedbuf_sizer,
+      frame_size);
+
+  if (!update_coded_buffer_size (encoder))
+    goto error_alloc_codedbuf_pool;
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
 
   /* ERRORS */
@@ -1175,6 +1749,44 @@ error_operation_failed:
   }
 }
 
+/**
+ * gst_vaapi_encoder_set_async_depth:
+ * @encoder: a #GstVaapiEncoder
+ * @async_depth: the number of coded buffers allowed in flight
+ *
+ * Notifies the @encoder to keep up to @async_depth pictures submitted
+ * to the hardware while completion of the oldest one is polled
+ * with vaQuerySurfaceStatus(). A value of zero selects the
+ * synchronous mode, where each coded buffer is waited for with
+ * vaSyncSurface() as soon as it is dequeued.
+ *
+ * Note: the async depth can only be specified before the first frame
+ * is encoded. Afterwards, any change to this parameter causes
+ * gst_vaapi_encoder_set_async_depth() to return
+ * @GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED.
+ *
+ * Return value: a #GstVaapiEncoderStatus
+ */
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_async_depth (GstVaapiEncoder * encoder,
+    guint async_depth)
+{
+  g_return_val_if_fail (encoder != NULL, 0);
+
+  if (encoder->async_depth != async_depth && encoder->num_codedbuf_queued > 0)
+    goto error_operation_failed;
+
+  encoder->async_depth = async_depth;
+  return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_operation_failed:
+  {
+    GST_ERROR ("could not change async depth after encoding started");
+    return GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
+}
+
 G_DEFINE_ABSTRACT_TYPE (GstVaapiEncoder, gst_vaapi_encoder, GST_TYPE_OBJECT);
 
 /**
@@ -1188,6 +1800,8 @@ G_DEFINE_ABSTRACT_TYPE (GstVaapiEncoder, gst_vaapi_encoder, GST_TYPE_OBJECT);
  * @ENCODER_PROP_DEFAULT_ROI_VALUE: The default delta qp to apply
  *   to each region of interest.
  * @ENCODER_PROP_TRELLIS: Use trellis quantization method (gboolean).
+ * @ENCODER_PROP_ASYNC_DEPTH: Number of coded buffers kept in flight
+ *   before blocking on completion (uint).
  *
  * The set of configurable properties for the encoder.
  */
@@ -1200,6 +1814,7 @@ enum
   ENCODER_PROP_QUALITY_LEVEL,
   ENCODER_PROP_DEFAULT_ROI_VALUE,
   ENCODER_PROP_TRELLIS,
+  ENCODER_PROP_ASYNC_DEPTH,
   ENCODER_N_PROPERTIES
 };
 
@@ -1246,6 +1861,10 @@ gst_vaapi_encoder_set_property (GObject * object, guint prop_id,
       status =
           gst_vaapi_encoder_set_trellis (encoder, g_value_get_boolean (value));
       break;
+    case ENCODER_PROP_ASYNC_DEPTH:
+      status =
+          gst_vaapi_encoder_set_async_depth (encoder, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1284,6 +1903,9 @@ gst_vaapi_encoder_get_property (GObject * object, guint prop_id,
     case ENCODER_PROP_TRELLIS:
       g_value_set_boolean (value, encoder->trellis);
       break;
+    case ENCODER_PROP_ASYNC_DEPTH:
+      g_value_set_uint (value, encoder->async_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1300,9 +1922,12 @@ gst_vaapi_encoder_init (GstVaapiEncoder * encoder)
   g_mutex_init (&encoder->mutex);
   g_cond_init (&encoder->surface_free);
   g_cond_init (&encoder->codedbuf_free);
+  gst_vaapi_context_lock_init (&encoder->context_lock);
 
-  encoder->codedbuf_queue = g_async_queue_new_full ((GDestroyNotify)
-      gst_vaapi_coded_buffer_proxy_unref);
+  encoder->codedbuf_queue =
+      gst_vaapi_ring_queue_new (ENCODER_CODEDBUF_QUEUE_SIZE,
+      (GDestroyNotify) gst_vaapi_coded_buffer_proxy_unref);
+  encoder->object_cache = gst_vaapi_mini_object_cache_new_default ();
 }
 
 /* Base encoder cleanup (internal) */
@@ -1311,9 +1936,18 @@ gst_vaapi_encoder_finalize (GObject * object)
 {
   GstVaapiEncoder *encoder = GST_VAAPI_ENCODER (object);
 
+  clear_lookahead (encoder);
+  if (encoder->lookahead) {
+    gst_vaapi_lookahead_free (encoder->lookahead);
+    encoder->lookahead = NULL;
+  }
+  gst_mini_object_replace ((GstMiniObject **) & encoder->lookahead_image,
+      NULL);
+
   if (encoder->context)
     gst_vaapi_context_unref (encoder->context);
   encoder->context = NULL;
+  gst_vaapi_context_lock_clear (&encoder->context_lock, encoder->display);
   gst_vaapi_display_replace (&encoder->display, NULL);
   encoder->va_display = NULL;
 
@@ -1322,15 +1956,32 @@ gst_vaapi_encoder_finalize (GObject * object)
     encoder->properties = NULL;
   }
 
+  log_async_stats (encoder);
+  log_codedbuf_stats (encoder);
+  if (encoder->codedbuf_sizer) {
+    gst_vaapi_coded_buffer_sizer_free (encoder->codedbuf_sizer);
+    encoder->codedbuf_sizer = NULL;
+  }
   gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, NULL);
+  gst_vaapi_video_pool_replace (&encoder->codedbuf_ref_pool, NULL);
   if (encoder->codedbuf_queue) {
-    g_async_queue_unref (encoder->codedbuf_queue);
+    gst_vaapi_ring_queue_free (encoder->codedbuf_queue);
     encoder->codedbuf_queue = NULL;
   }
   g_cond_clear (&encoder->surface_free);
   g_cond_clear (&encoder->codedbuf_free);
   g_mutex_clear (&encoder->mutex);
 
+  if (encoder->object_cache) {
+    GstVaapiMiniObjectCacheStats stats;
+
+    gst_vaapi_mini_object_cache_get_stats (encoder->object_cache, &stats);
+    GST_INFO_OBJECT (encoder, "objects: %" G_GUINT64_FORMAT " allocated, %"
+        G_GUINT64_FORMAT " recycled", stats.num_allocs, stats.num_reuses);
+    gst_vaapi_mini_object_cache_unref (encoder->object_cache);
+    encoder->object_cache = NULL;
+  }
+
   G_OBJECT_CLASS (gst_vaapi_encoder_parent_class)->finalize (object);
 }
 
@@ -1442,6 +2093,22 @@ gst_vaapi_encoder_class_init (GstVaapiEncoderClass * klass)
       FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoder:async-depth:
+   *
+   * The number of pictures kept submitted to the hardware while the
+   * completion of the oldest one is polled. Coded buffers are still
+   * output in order, as soon as each one is ready. Zero disables
+   * polling and waits for every coded buffer synchronously.
+   */
+  properties[ENCODER_PROP_ASYNC_DEPTH] =
+      g_param_spec_uint ("async-depth",
+      "Async Depth",
+      "Number of pictures kept in flight before waiting for completion "
+      "(0: synchronous)", 0, ENCODER_MAX_ASYNC_DEPTH, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_N_PROPERTIES,
       properties);
 }
@@ -1717,6 +2384,68 @@ gst_vaapi_encoder_ensure_tile_support (GstVaapiEncoder * encoder,
   return tile > 0;
 }
 
+/**
+ * gst_vaapi_encoder_ensure_lookahead:
+ * @encoder: a #GstVaapiEncoder
+ * @depth: the number of frames to analyze ahead, or zero to disable
+ * @max_bframes: the maximum number of consecutive B-frames
+ *
+ * Sets up the look-ahead analysis of the input frames. This function
+ * is meant to be called by the derived classes while they are
+ * configured, once their number of B-frames is known. The decisions
+ * are then available through GST_VAAPI_ENCODER_LOOKAHEAD_INFO() in
+ * the reordering function.
+ *
+ * The look-ahead window is not reconfigured while it holds frames.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise.
+ **/
+gboolean
+gst_vaapi_encoder_ensure_lookahead (GstVaapiEncoder * encoder, guint depth,
+    guint max_bframes)
+{
+  if (encoder->lookahead) {
+    if (gst_vaapi_lookahead_get_length (encoder->lookahead) > 0) {
+      GST_WARNING_OBJECT (encoder, "look-ahead window is not empty, "
+          "keeping its configuration");
+      return TRUE;
+    }
+    gst_vaapi_lookahead_free (encoder->lookahead);
+    encoder->lookahead = NULL;
+  }
+
+  encoder->lookahead_depth = depth;
+  if (depth == 0)
+    return TRUE;
+
+  encoder->lookahead = gst_vaapi_lookahead_new (depth, max_bframes);
+  if (!encoder->lookahead) {
+    encoder->lookahead_depth = 0;
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (encoder, "look-ahead of %u frames, up to %u B-frames",
+      depth, max_bframes);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_encoder_get_lookahead_depth:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * The input frames held in the look-ahead window keep their buffers,
+ * so upstream shall allocate that many more.
+ *
+ * Returns: the number of frames analyzed ahead, or zero
+ **/
+guint
+gst_vaapi_encoder_get_lookahead_depth (GstVaapiEncoder * encoder)
+{
+  g_return_val_if_fail (encoder, 0);
+
+  return encoder->lookahead ? encoder->lookahead_depth : 0;
+}
+
 GstVaapiProfile
 gst_vaapi_encoder_get_profile (GstVaapiEncoder * encoder)
 {
@@ -173,10 +173,18 @@ gst_vaapi_encoder_set_quality_level (GstVaapiEncoder * encoder,
 GstVaapiEncoderStatus
 gst_vaapi_encoder_set_trellis (GstVaapiEncoder * encoder, gboolean trellis);
 
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_async_depth (GstVaapiEncoder * encoder,
+    guint async_depth);
+
 GstVaapiEncoderStatus
 gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
     GstVaapiCodedBufferProxy ** out_codedbuf_proxy_ptr, guint64 timeout);
 
+GstBuffer *
+gst_vaapi_encoder_wrap_coded_buffer (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy);
+
 GstVaapiEncoderStatus
 gst_vaapi_encoder_flush (GstVaapiEncoder * encoder);
 
@@ -195,6 +203,9 @@ gst_vaapi_encoder_get_entrypoint (GstVaapiEncoder * encoder,
 GArray *
 gst_vaapi_encoder_get_available_profiles (GstVaapiEncoder * encoder);
 
+guint
+gst_vaapi_encoder_get_lookahead_depth (GstVaapiEncoder * encoder);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiEncoder, gst_object_unref)
 
 G_END_DECLS
@@ -179,6 +179,7 @@ typedef struct _GstVaapiH264ViewReorderPool
   guint frame_count;            /* monotonically increasing with in every idr period */
   guint cur_frame_num;
   guint cur_present_index;
+  guint cur_num_bframes;        /* B-frames before the next P-frame */
   gboolean prev_frame_is_ref;   /* previous frame is ref or not */
 } GstVaapiH264ViewReorderPool;
 
@@ -756,6 +757,7 @@ struct _GstVaapiEncoderH264
   guint32 mb_width;
   guint32 mb_height;
   guint32 quality_factor;
+  guint lookahead_depth;
   gboolean use_cabac;
   gboolean use_dct8x8;
   guint temporal_levels;        /* Number of temporal levels */
@@ -2207,6 +2209,7 @@ fill_picture (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture,
   /* reference list,  */
   pic_param->CurrPic.picture_id = GST_VAAPI_SURFACE_PROXY_SURFACE_ID (surface);
   pic_param->CurrPic.TopFieldOrderCnt = picture->poc;
+  gst_vaapi_enc_picture_hold_surface (picture, surface);
   i = 0;
   if (picture->type != GST_VAAPI_PICTURE_TYPE_I) {
     for (reflist = g_queue_peek_head_link (&ref_pool->ref_list);
@@ -2221,6 +2224,7 @@ fill_picture (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture,
       pic_param->ReferenceFrames[i].flags |=
           VA_PICTURE_H264_SHORT_TERM_REFERENCE;
       pic_param->ReferenceFrames[i].frame_idx = ref_pic->frame_num;
+      gst_vaapi_enc_picture_hold_surface (picture, ref_pic->pic);
       ++i;
     }
     g_assert (i <= 16 && i <= ref_pool->max_ref_frames);
@@ -2228,7 +2232,7 @@ fill_picture (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture,
   for (; i < 16; ++i) {
     pic_param->ReferenceFrames[i].picture_id = VA_INVALID_ID;
   }
-  pic_param->coded_buf = GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+  GST_VAAPI_ENC_PICTURE_SET_CODED_BUFFER (picture, pic_param, codedbuf);
 
   pic_param->pic_parameter_set_id = encoder->view_idx;
   pic_param->seq_parameter_set_id = encoder->view_idx ? 1 : 0;
@@ -3158,11 +3162,26 @@ sort_hierarchical_b (gconstpointer a, gconstpointer b, gpointer user_data)
     return pic1->temporal_id - pic2->temporal_id;
 }
 
+/* Returns the number of B-frames to queue before the next P-frame. The
+ * look-ahead adapts it to the motion, except for hierarchical-b where
+ * the temporal layers need a fixed pattern */
+static guint
+get_num_bframes (GstVaapiEncoderH264 * encoder,
+    const GstVaapiLookaheadInfo * lookahead_info)
+{
+  if (!lookahead_info || !lookahead_info->analyzed ||
+      encoder->prediction_type != GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT)
+    return encoder->num_bframes;
+  return MIN (lookahead_info->num_bframes, encoder->num_bframes);
+}
+
 static GstVaapiEncoderStatus
 gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
     GstVideoCodecFrame * frame, GstVaapiEncPicture ** output)
 {
   GstVaapiEncoderH264 *const encoder = GST_VAAPI_ENCODER_H264 (base_encoder);
+  const GstVaapiLookaheadInfo *const lookahead_info =
+      GST_VAAPI_ENCODER_LOOKAHEAD_INFO (encoder);
   GstVaapiH264ViewReorderPool *reorder_pool = NULL;
   GstVaapiEncPicture *picture;
   gboolean is_idr = FALSE;
@@ -3221,6 +3240,10 @@ gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
   is_idr = (reorder_pool->frame_index == 0 ||
       reorder_pool->frame_index >= encoder->idr_period);
 
+  /* start a new GOP at scene cuts detected by the look-ahead */
+  if (lookahead_info && lookahead_info->scene_cut)
+    is_idr = TRUE;
+
   /* check key frames */
   if (is_idr || GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame) ||
       (reorder_pool->frame_index %
@@ -3265,20 +3288,23 @@ gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
 
   /* new p/b frames coming */
   ++reorder_pool->frame_index;
+  if (g_queue_is_empty (&reorder_pool->reorder_frame_list))
+    reorder_pool->cur_num_bframes = get_num_bframes (encoder, lookahead_info);
   if (reorder_pool->reorder_state == GST_VAAPI_ENC_H264_REORD_WAIT_FRAMES &&
       g_queue_get_length (&reorder_pool->reorder_frame_list) <
-      encoder->num_bframes) {
+      reorder_pool->cur_num_bframes) {
     g_queue_push_tail (&reorder_pool->reorder_frame_list, picture);
     return GST_VAAPI_ENCODER_STATUS_NO_SURFACE;
   }
 
   set_p_frame (picture, encoder);
 
-  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H264_REORD_WAIT_FRAMES) {
+  /* the look-ahead may have chosen no B-frame at all */
+  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H264_REORD_WAIT_FRAMES &&
+      !g_queue_is_empty (&reorder_pool->reorder_frame_list)) {
     g_queue_foreach (&reorder_pool->reorder_frame_list, (GFunc) set_b_frame,
         encoder);
     reorder_pool->reorder_state = GST_VAAPI_ENC_H264_REORD_DUMP_FRAMES;
-    g_assert (!g_queue_is_empty (&reorder_pool->reorder_frame_list));
   }
 
 end:
@@ -3387,6 +3413,12 @@ gst_vaapi_encoder_h264_reconfigure (GstVaapiEncoder * base_encoder)
 
   reset_properties (encoder);
   ensure_control_rate_params (encoder);
+
+  /* MVC views are interleaved, which the look-ahead cannot analyze */
+  if (!gst_vaapi_encoder_ensure_lookahead (base_encoder,
+          encoder->is_mvc ? 0 : encoder->lookahead_depth, encoder->num_bframes))
+    return GST_VAAPI_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
+
   return set_context_info (base_encoder);
 }
 
@@ -3424,6 +3456,7 @@ gst_vaapi_encoder_h264_init (GstVaapiEncoderH264 * encoder)
     reorder_pool->frame_index = 0;
     reorder_pool->cur_frame_num = 0;
     reorder_pool->cur_present_index = 0;
+    reorder_pool->cur_num_bframes = 0;
   }
 
   /* reference list info initialize */
@@ -3558,6 +3591,7 @@ get_view_ids (GstVaapiEncoderH264 * const encoder, GValue * value)
  * @ENCODER_H264_PROP_PREDICTION_TYPE: Reference picture selection modes
  * @ENCODER_H264_PROP_MAX_QP: Maximal quantizer value (uint).
  * @ENCODER_H264_PROP_QUALITY_FACTOR: Factor for ICQ/QVBR bitrate control mode.
+ * @ENCODER_H264_PROP_LOOK_AHEAD: Number of frames analyzed ahead (uint).
  *
  * The set of H.264 encoder specific configurable properties.
  */
@@ -3584,6 +3618,7 @@ enum
   ENCODER_H264_PROP_PREDICTION_TYPE,
   ENCODER_H264_PROP_MAX_QP,
   ENCODER_H264_PROP_QUALITY_FACTOR,
+  ENCODER_H264_PROP_LOOK_AHEAD,
   ENCODER_H264_N_PROPERTIES
 };
 
@@ -3667,6 +3702,9 @@ gst_vaapi_encoder_h264_set_property (GObject * object, guint prop_id,
     case ENCODER_H264_PROP_QUALITY_FACTOR:
       encoder->quality_factor = g_value_get_uint (value);
       break;
+    case ENCODER_H264_PROP_LOOK_AHEAD:
+      encoder->lookahead_depth = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3743,6 +3781,9 @@ gst_vaapi_encoder_h264_get_property (GObject * object, guint prop_id,
     case ENCODER_H264_PROP_QUALITY_FACTOR:
       g_value_set_uint (value, encoder->quality_factor);
       break;
+    case ENCODER_H264_PROP_LOOK_AHEAD:
+      g_value_set_uint (value, encoder->lookahead_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -4043,6 +4084,23 @@ gst_vaapi_encoder_h264_class_init (GstVaapiEncoderH264Class * klass)
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoderH264:look-ahead:
+   *
+   * The number of frames analyzed before they are encoded. IDR frames
+   * are inserted at the detected scene cuts, and the number of
+   * B-frames is lowered in fast motion, up to max-bframes. The
+   * analysis reads back the luma of every input frame. Zero disables
+   * the look-ahead.
+   */
+  properties[ENCODER_H264_PROP_LOOK_AHEAD] =
+      g_param_spec_uint ("look-ahead",
+      "Look-ahead",
+      "Number of frames analyzed for scene cuts and B-frame decisions "
+      "(0: disabled)", 0, 60, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_H264_N_PROPERTIES,
       properties);
 
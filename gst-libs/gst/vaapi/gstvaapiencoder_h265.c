@@ -82,6 +82,7 @@ typedef struct _GstVaapiH265ReorderPool
   guint reorder_state;
   guint frame_index;
   guint cur_present_index;
+  guint cur_num_bframes;        /* B-frames before the next P-frame */
 } GstVaapiH265ReorderPool;
 
 /* ------------------------------------------------------------------------- */
@@ -113,6 +114,7 @@ struct _GstVaapiEncoderH265
   guint32 luma_width;
   guint32 luma_height;
   guint32 quality_factor;
+  guint lookahead_depth;
   GstClockTime cts_offset;
   gboolean config_changed;
   /* Always need two reference lists for inter frame */
@@ -1753,6 +1755,7 @@ fill_picture (GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture,
       GST_VAAPI_SURFACE_PROXY_SURFACE_ID (surface);
   pic_param->decoded_curr_pic.pic_order_cnt = picture->poc;
   pic_param->decoded_curr_pic.flags = 0;
+  gst_vaapi_enc_picture_hold_surface (picture, surface);
 
   i = 0;
   if (picture->type != GST_VAAPI_PICTURE_TYPE_I) {
@@ -1765,6 +1768,7 @@ fill_picture (GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture,
       pic_param->reference_frames[i].picture_id =
           GST_VAAPI_SURFACE_PROXY_SURFACE_ID (ref_pic->pic);
       pic_param->reference_frames[i].pic_order_cnt = ref_pic->poc;
+      gst_vaapi_enc_picture_hold_surface (picture, ref_pic->pic);
       ++i;
     }
     g_assert (i <= 15 && i <= ref_pool->max_ref_frames);
@@ -1773,7 +1777,7 @@ fill_picture (GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture,
     pic_param->reference_frames[i].picture_id = VA_INVALID_SURFACE;
     pic_param->reference_frames[i].flags = VA_PICTURE_HEVC_INVALID;
   }
-  pic_param->coded_buf = GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+  GST_VAAPI_ENC_PICTURE_SET_CODED_BUFFER (picture, pic_param, codedbuf);
 
   /* slice_temporal_mvp_enable_flag == FALSE */
   pic_param->collocated_ref_pic_index = 0xFF;
@@ -2966,11 +2970,24 @@ error_alloc_buffer:
 /* The re-ordering algorithm is similar to what we implemented for
  * h264 encoder. But We could have a better algorithm for hevc encoder
  * by having B-frames as reference pictures */
+/* Returns the number of B-frames to queue before the next P-frame, as
+ * adapted to the motion by the look-ahead */
+static guint
+get_num_bframes (GstVaapiEncoderH265 * encoder,
+    const GstVaapiLookaheadInfo * lookahead_info)
+{
+  if (!lookahead_info || !lookahead_info->analyzed)
+    return encoder->num_bframes;
+  return MIN (lookahead_info->num_bframes, encoder->num_bframes);
+}
+
 static GstVaapiEncoderStatus
 gst_vaapi_encoder_h265_reordering (GstVaapiEncoder * base_encoder,
     GstVideoCodecFrame * frame, GstVaapiEncPicture ** output)
 {
   GstVaapiEncoderH265 *const encoder = GST_VAAPI_ENCODER_H265 (base_encoder);
+  const GstVaapiLookaheadInfo *const lookahead_info =
+      GST_VAAPI_ENCODER_LOOKAHEAD_INFO (encoder);
   GstVaapiH265ReorderPool *reorder_pool = NULL;
   GstVaapiEncPicture *picture;
   gboolean is_idr = FALSE;
@@ -3010,6 +3027,10 @@ gst_vaapi_encoder_h265_reordering (GstVaapiEncoder * base_encoder,
   is_idr = (reorder_pool->frame_index == 0 ||
       reorder_pool->frame_index >= encoder->idr_period);
 
+  /* start a new GOP at scene cuts detected by the look-ahead */
+  if (lookahead_info && lookahead_info->scene_cut)
+    is_idr = TRUE;
+
   /* check key frames */
   if (is_idr || GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame) ||
       (reorder_pool->frame_index %
@@ -3040,20 +3061,23 @@ gst_vaapi_encoder_h265_reordering (GstVaapiEncoder * base_encoder,
 
   /* new p/b frames coming */
   ++reorder_pool->frame_index;
+  if (g_queue_is_empty (&reorder_pool->reorder_frame_list))
+    reorder_pool->cur_num_bframes = get_num_bframes (encoder, lookahead_info);
   if (reorder_pool->reorder_state == GST_VAAPI_ENC_H265_REORD_WAIT_FRAMES &&
       g_queue_get_length (&reorder_pool->reorder_frame_list) <
-      encoder->num_bframes) {
+      reorder_pool->cur_num_bframes) {
     g_queue_push_tail (&reorder_pool->reorder_frame_list, picture);
     return GST_VAAPI_ENCODER_STATUS_NO_SURFACE;
   }
 
   set_p_frame (picture, encoder);
 
-  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H265_REORD_WAIT_FRAMES) {
+  /* the look-ahead may have chosen no B-frame at all */
+  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H265_REORD_WAIT_FRAMES &&
+      !g_queue_is_empty (&reorder_pool->reorder_frame_list)) {
     g_queue_foreach (&reorder_pool->reorder_frame_list, (GFunc) set_b_frame,
         encoder);
     reorder_pool->reorder_state = GST_VAAPI_ENC_H265_REORD_DUMP_FRAMES;
-    g_assert (!g_queue_is_empty (&reorder_pool->reorder_frame_list));
   }
 
 end:
@@ -3179,6 +3203,11 @@ gst_vaapi_encoder_h265_reconfigure (GstVaapiEncoder * base_encoder)
   if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
     return status;
   ensure_control_rate_params (encoder);
+
+  if (!gst_vaapi_encoder_ensure_lookahead (base_encoder,
+          encoder->lookahead_depth, encoder->num_bframes))
+    return GST_VAAPI_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
+
   return set_context_info (base_encoder);
 }
 
@@ -3202,6 +3231,7 @@ gst_vaapi_encoder_h265_init (GstVaapiEncoderH265 * encoder)
   reorder_pool->reorder_state = GST_VAAPI_ENC_H265_REORD_NONE;
   reorder_pool->frame_index = 0;
   reorder_pool->cur_present_index = 0;
+  reorder_pool->cur_num_bframes = 0;
 
   /* reference list info initialize */
   ref_pool = &encoder->ref_pool;
@@ -3276,6 +3306,7 @@ gst_vaapi_encoder_h265_finalize (GObject * object)
  * @ENCODER_H265_PROP_QP_IB: Difference of QP between I and B frame.
  * @ENCODER_H265_PROP_LOW_DELAY_B: use low delay b feature.
  * @ENCODER_H265_PROP_MAX_QP: Maximal quantizer value (uint).
+ * @ENCODER_H265_PROP_LOOK_AHEAD: Number of frames analyzed ahead (uint).
  *
  * The set of H.265 encoder specific configurable properties.
  */
@@ -3299,6 +3330,7 @@ enum
   ENCODER_H265_PROP_QUALITY_FACTOR,
   ENCODER_H265_PROP_NUM_TILE_COLS,
   ENCODER_H265_PROP_NUM_TILE_ROWS,
+  ENCODER_H265_PROP_LOOK_AHEAD,
   ENCODER_H265_N_PROPERTIES
 };
 
@@ -3377,6 +3409,9 @@ gst_vaapi_encoder_h265_set_property (GObject * object, guint prop_id,
     case ENCODER_H265_PROP_NUM_TILE_ROWS:
       encoder->num_tile_rows = g_value_get_uint (value);
       break;
+    case ENCODER_H265_PROP_LOOK_AHEAD:
+      encoder->lookahead_depth = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3440,6 +3475,9 @@ gst_vaapi_encoder_h265_get_property (GObject * object, guint prop_id,
     case ENCODER_H265_PROP_NUM_TILE_ROWS:
       g_value_set_uint (value, encoder->num_tile_rows);
       break;
+    case ENCODER_H265_PROP_LOOK_AHEAD:
+      g_value_set_uint (value, encoder->lookahead_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3674,6 +3712,23 @@ gst_vaapi_encoder_h265_class_init (GstVaapiEncoderH265Class * klass)
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoderH265:look-ahead:
+   *
+   * The number of frames analyzed before they are encoded. IDR frames
+   * are inserted at the detected scene cuts, and the number of
+   * B-frames is lowered in fast motion, up to max-bframes. The
+   * analysis reads back the luma of every input frame. Zero disables
+   * the look-ahead.
+   */
+  properties[ENCODER_H265_PROP_LOOK_AHEAD] =
+      g_param_spec_uint ("look-ahead",
+      "Look-ahead",
+      "Number of frames analyzed for scene cuts and B-frame decisions "
+      "(0: disabled)", 0, 60, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_H265_N_PROPERTIES,
       properties);
 
@@ -217,7 +217,8 @@ fill_picture (GstVaapiEncoderJpeg * encoder,
       GST_VAAPI_SURFACE_PROXY_SURFACE_ID (surface);
   pic_param->picture_width = GST_VAAPI_ENCODER_WIDTH (encoder);
   pic_param->picture_height = GST_VAAPI_ENCODER_HEIGHT (encoder);
-  pic_param->coded_buf = GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+  GST_VAAPI_ENC_PICTURE_SET_CODED_BUFFER (picture, pic_param, codedbuf);
+  gst_vaapi_enc_picture_hold_surface (picture, surface);
 
   pic_param->pic_flags.bits.profile = 0;        /* Profile = Baseline */
   pic_param->pic_flags.bits.progressive = 0;    /* Sequential encoding */
@@ -269,7 +269,8 @@ fill_picture (GstVaapiEncoderMpeg2 * encoder,
 
   pic_param->reconstructed_picture =
       GST_VAAPI_SURFACE_PROXY_SURFACE_ID (surface);
-  pic_param->coded_buf = GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+  GST_VAAPI_ENC_PICTURE_SET_CODED_BUFFER (picture, pic_param, codedbuf);
+  gst_vaapi_enc_picture_hold_surface (picture, surface);
   pic_param->picture_type = get_va_enc_picture_type (picture->type);
   pic_param->temporal_reference = picture->frame_num & (1024 - 1);
   pic_param->vbv_delay = 0xFFFF;
@@ -308,6 +309,7 @@ fill_picture (GstVaapiEncoderMpeg2 * encoder,
     pic_param->forward_reference_picture =
         GST_VAAPI_SURFACE_PROXY_SURFACE_ID (encoder->forward);
     pic_param->backward_reference_picture = VA_INVALID_SURFACE;
+    gst_vaapi_enc_picture_hold_surface (picture, encoder->forward);
   } else if (pic_param->picture_type == VAEncPictureTypeBidirectional) {
     pic_param->f_code[0][0] = f_code_x;
     pic_param->f_code[0][1] = f_code_y;
@@ -317,6 +319,8 @@ fill_picture (GstVaapiEncoderMpeg2 * encoder,
         GST_VAAPI_SURFACE_PROXY_SURFACE_ID (encoder->forward);
     pic_param->backward_reference_picture =
         GST_VAAPI_SURFACE_PROXY_SURFACE_ID (encoder->backward);
+    gst_vaapi_enc_picture_hold_surface (picture, encoder->forward);
+    gst_vaapi_enc_picture_hold_surface (picture, encoder->backward);
   } else {
     g_assert (0);
   }
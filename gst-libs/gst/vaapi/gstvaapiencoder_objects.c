@@ -24,13 +24,16 @@
 #include "gstvaapiencoder_objects.h"
 #include "gstvaapiencoder_priv.h"
 #include "gstvaapisurfaceproxy_priv.h"
+#include "gstvaapicodedbuffer_priv.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapitrace.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
 
 #define GET_ENCODER(obj)    GST_VAAPI_ENCODER_CAST((obj)->parent_instance.codec)
+#define GET_CONTEXT(obj)    GET_ENCODER(obj)->context
 #define GET_VA_DISPLAY(obj) GET_ENCODER(obj)->va_display
 #define GET_VA_CONTEXT(obj) GET_ENCODER(obj)->va_context
 
@@ -44,10 +47,10 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncPackedHeader,
 void
 gst_vaapi_enc_packed_header_destroy (GstVaapiEncPackedHeader * header)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (header), &header->param_id);
-  vaapi_destroy_buffer (GET_VA_DISPLAY (header), &header->data_id);
-  header->param = NULL;
-  header->data = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (header), &header->param_id,
+      &header->param);
+  gst_vaapi_context_release_buffer (GET_CONTEXT (header), &header->data_id,
+      &header->data);
 }
 
 gboolean
@@ -59,8 +62,7 @@ gst_vaapi_enc_packed_header_create (GstVaapiEncPackedHeader * header,
   header->param_id = VA_INVALID_ID;
   header->data_id = VA_INVALID_ID;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (header),
-      GET_VA_CONTEXT (header),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (header),
       VAEncPackedHeaderParameterBufferType,
       args->param_size, args->param, &header->param_id, &header->param);
   if (!success)
@@ -69,8 +71,7 @@ gst_vaapi_enc_packed_header_create (GstVaapiEncPackedHeader * header,
   if (!args->data_size)
     return TRUE;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (header),
-      GET_VA_CONTEXT (header),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (header),
       VAEncPackedHeaderDataBufferType,
       args->data_size, args->data, &header->data_id, &header->data);
   if (!success)
@@ -85,7 +86,8 @@ gst_vaapi_enc_packed_header_new (GstVaapiEncoder * encoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncPackedHeaderClass,
-      GST_VAAPI_CODEC_BASE (encoder), param, param_size, data, data_size, 0);
+      GST_VAAPI_CODEC_BASE (encoder), GST_VAAPI_ENCODER_OBJECT_CACHE (encoder),
+      param, param_size, data, data_size, 0);
   return GST_VAAPI_ENC_PACKED_HEADER (object);
 }
 
@@ -95,11 +97,10 @@ gst_vaapi_enc_packed_header_set_data (GstVaapiEncPackedHeader * header,
 {
   gboolean success;
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (header), &header->data_id);
-  header->data = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (header), &header->data_id,
+      &header->data);
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (header),
-      GET_VA_CONTEXT (header),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (header),
       VAEncPackedHeaderDataBufferType,
       data_size, data, &header->data_id, &header->data);
   if (!success)
@@ -116,8 +117,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncSequence, gst_vaapi_enc_sequence);
 void
 gst_vaapi_enc_sequence_destroy (GstVaapiEncSequence * sequence)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (sequence), &sequence->param_id);
-  sequence->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (sequence),
+      &sequence->param_id, &sequence->param);
 }
 
 gboolean
@@ -127,8 +128,7 @@ gst_vaapi_enc_sequence_create (GstVaapiEncSequence * sequence,
   gboolean success;
 
   sequence->param_id = VA_INVALID_ID;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (sequence),
-      GET_VA_CONTEXT (sequence),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (sequence),
       VAEncSequenceParameterBufferType,
       args->param_size, args->param, &sequence->param_id, &sequence->param);
   if (!success)
@@ -143,7 +143,8 @@ gst_vaapi_enc_sequence_new (GstVaapiEncoder * encoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncSequenceClass,
-      GST_VAAPI_CODEC_BASE (encoder), param, param_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (encoder), GST_VAAPI_ENCODER_OBJECT_CACHE (encoder),
+      param, param_size, NULL, 0, 0);
   return GST_VAAPI_ENC_SEQUENCE (object);
 }
 
@@ -161,8 +162,8 @@ gst_vaapi_enc_slice_destroy (GstVaapiEncSlice * slice)
     slice->packed_headers = NULL;
   }
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (slice), &slice->param_id);
-  slice->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (slice), &slice->param_id,
+      &slice->param);
 }
 
 gboolean
@@ -172,8 +173,7 @@ gst_vaapi_enc_slice_create (GstVaapiEncSlice * slice,
   gboolean success;
 
   slice->param_id = VA_INVALID_ID;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (slice),
-      GET_VA_CONTEXT (slice),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (slice),
       VAEncSliceParameterBufferType,
       args->param_size, args->param, &slice->param_id, &slice->param);
   if (!success)
@@ -194,7 +194,8 @@ gst_vaapi_enc_slice_new (GstVaapiEncoder * encoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncSliceClass,
-      GST_VAAPI_CODEC_BASE (encoder), param, param_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (encoder), GST_VAAPI_ENCODER_OBJECT_CACHE (encoder),
+      param, param_size, NULL, 0, 0);
   return GST_VAAPI_ENC_SLICE (object);
 }
 
@@ -207,8 +208,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncMiscParam, gst_vaapi_enc_misc_param);
 void
 gst_vaapi_enc_misc_param_destroy (GstVaapiEncMiscParam * misc)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (misc), &misc->param_id);
-  misc->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (misc), &misc->param_id,
+      &misc->param);
   misc->data = NULL;
 }
 
@@ -219,8 +220,7 @@ gst_vaapi_enc_misc_param_create (GstVaapiEncMiscParam * misc,
   gboolean success;
 
   misc->param_id = VA_INVALID_ID;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (misc),
-      GET_VA_CONTEXT (misc),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (misc),
       VAEncMiscParameterBufferType,
       args->param_size, args->param, &misc->param_id, &misc->param);
   if (!success)
@@ -237,7 +237,7 @@ gst_vaapi_enc_misc_param_new (GstVaapiEncoder * encoder,
   VAEncMiscParameterBuffer *va_misc;
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncMiscParamClass,
-      GST_VAAPI_CODEC_BASE (encoder),
+      GST_VAAPI_CODEC_BASE (encoder), GST_VAAPI_ENCODER_OBJECT_CACHE (encoder),
       NULL, sizeof (VAEncMiscParameterBuffer) + data_size, NULL, 0, 0);
   if (!object)
     return NULL;
@@ -258,8 +258,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncQMatrix, gst_vaapi_enc_q_matrix);
 void
 gst_vaapi_enc_q_matrix_destroy (GstVaapiEncQMatrix * q_matrix)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (q_matrix), &q_matrix->param_id);
-  q_matrix->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (q_matrix),
+      &q_matrix->param_id, &q_matrix->param);
 }
 
 gboolean
@@ -267,9 +267,9 @@ gst_vaapi_enc_q_matrix_create (GstVaapiEncQMatrix * q_matrix,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   q_matrix->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (q_matrix),
-      GET_VA_CONTEXT (q_matrix), VAQMatrixBufferType,
-      args->param_size, args->param, &q_matrix->param_id, &q_matrix->param);
+  return gst_vaapi_context_create_buffer (GET_CONTEXT (q_matrix),
+      VAQMatrixBufferType, args->param_size, args->param,
+      &q_matrix->param_id, &q_matrix->param);
 }
 
 GstVaapiEncQMatrix *
@@ -279,7 +279,8 @@ gst_vaapi_enc_q_matrix_new (GstVaapiEncoder * encoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncQMatrixClass,
-      GST_VAAPI_CODEC_BASE (encoder), param, param_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (encoder), GST_VAAPI_ENCODER_OBJECT_CACHE (encoder),
+      param, param_size, NULL, 0, 0);
   if (!object)
     return NULL;
   return GST_VAAPI_ENC_Q_MATRIX_CAST (object);
@@ -295,8 +296,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncHuffmanTable,
 void
 gst_vaapi_enc_huffman_table_destroy (GstVaapiEncHuffmanTable * huf_table)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (huf_table), &huf_table->param_id);
-  huf_table->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (huf_table),
+      &huf_table->param_id, (void **) &huf_table->param);
 }
 
 gboolean
@@ -304,9 +305,9 @@ gst_vaapi_enc_huffman_table_create (GstVaapiEncHuffmanTable * huf_table,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   huf_table->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (huf_table),
-      GET_VA_CONTEXT (huf_table), VAHuffmanTableBufferType, args->param_size,
-      args->param, &huf_table->param_id, (void **) &huf_table->param);
+  return gst_vaapi_context_create_buffer (GET_CONTEXT (huf_table),
+      VAHuffmanTableBufferType, args->param_size, args->param,
+      &huf_table->param_id, (void **) &huf_table->param);
 }
 
 GstVaapiEncHuffmanTable *
@@ -316,7 +317,8 @@ gst_vaapi_enc_huffman_table_new (GstVaapiEncoder * encoder,
   GstVaapiCodecObject *object;
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncHuffmanTableClass,
-      GST_VAAPI_CODEC_BASE (encoder), data, data_size, NULL, 0, 0);
+      GST_VAAPI_CODEC_BASE (encoder), GST_VAAPI_ENCODER_OBJECT_CACHE (encoder),
+      data, data_size, NULL, 0, 0);
   if (!object)
     return NULL;
   return GST_VAAPI_ENC_HUFFMAN_TABLE_CAST (object);
@@ -349,12 +351,16 @@ gst_vaapi_enc_picture_destroy (GstVaapiEncPicture * picture)
 
   gst_vaapi_codec_object_replace (&picture->sequence, NULL);
 
+  if (picture->held_surfaces) {
+    g_ptr_array_unref (picture->held_surfaces);
+    picture->held_surfaces = NULL;
+  }
   gst_vaapi_surface_proxy_replace (&picture->proxy, NULL);
   picture->surface_id = VA_INVALID_ID;
   picture->surface = NULL;
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (picture), &picture->param_id);
-  picture->param = NULL;
+  gst_vaapi_context_release_buffer (GET_CONTEXT (picture), &picture->param_id,
+      &picture->param);
 
   if (picture->frame) {
     gst_video_codec_frame_unref (picture->frame);
@@ -388,8 +394,7 @@ gst_vaapi_enc_picture_create (GstVaapiEncPicture * picture,
 
   picture->param_id = VA_INVALID_ID;
   picture->param_size = args->param_size;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (picture),
-      GET_VA_CONTEXT (picture),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (picture),
       VAEncPictureParameterBufferType,
       args->param_size, args->param, &picture->param_id, &picture->param);
   if (!success)
@@ -424,7 +429,8 @@ gst_vaapi_enc_picture_new (GstVaapiEncoder * encoder,
   g_return_val_if_fail (frame != NULL, NULL);
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncPictureClass,
-      GST_VAAPI_CODEC_BASE (encoder), param, param_size, frame, 0, 0);
+      GST_VAAPI_CODEC_BASE (encoder), GST_VAAPI_ENCODER_OBJECT_CACHE (encoder),
+      param, param_size, frame, 0, 0);
   return GST_VAAPI_ENC_PICTURE (object);
 }
 
@@ -479,24 +485,54 @@ gst_vaapi_enc_slice_add_packed_header (GstVaapiEncSlice * slice,
   g_ptr_array_add (slice->packed_headers, gst_vaapi_codec_object_ref (header));
 }
 
+/**
+ * gst_vaapi_enc_picture_hold_surface:
+ * @picture: a #GstVaapiEncPicture
+ * @proxy: (allow-none): a reconstructed or reference surface
+ *
+ * Keeps @proxy alive as long as @picture may be encoded again, i.e.
+ * if @picture keeps its buffers. Surfaces which @picture only reads
+ * could otherwise be recycled before gst_vaapi_enc_picture_resubmit().
+ */
+void
+gst_vaapi_enc_picture_hold_surface (GstVaapiEncPicture * picture,
+    GstVaapiSurfaceProxy * proxy)
+{
+  g_return_if_fail (picture != NULL);
+
+  if (!picture->keep_buffers || !proxy)
+    return;
+
+  if (!picture->held_surfaces)
+    picture->held_surfaces = g_ptr_array_new_with_free_func ((GDestroyNotify)
+        gst_vaapi_surface_proxy_unref);
+  g_ptr_array_add (picture->held_surfaces,
+      gst_vaapi_surface_proxy_ref (proxy));
+}
+
 static gboolean
-do_encode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
+do_encode (GstVaapiEncPicture * picture, VABufferID * buf_id, void **buf_ptr)
 {
+  VADisplay const dpy = GET_VA_DISPLAY (picture);
   VAStatus status;
 
-  vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
+  /* The buffers of a resubmitted picture are already unmapped */
+  if (*buf_ptr)
+    vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
 
-  status = vaRenderPicture (dpy, ctx, buf_id, 1);
+  status = vaRenderPicture (dpy, GET_VA_CONTEXT (picture), buf_id, 1);
   if (!vaapi_check_status (status, "vaRenderPicture()"))
     return FALSE;
 
-  /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
-  vaapi_destroy_buffer (dpy, buf_id);
+  /* The buffer is only recycled once vaEndPicture() was called, or
+     once the picture is destroyed if it may be submitted again */
+  if (!picture->keep_buffers)
+    gst_vaapi_context_release_buffer (GET_CONTEXT (picture), buf_id, NULL);
   return TRUE;
 }
 
-gboolean
-gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
+static gboolean
+encode_picture_unlocked (GstVaapiEncPicture * picture)
 {
   GstVaapiEncSequence *sequence;
   GstVaapiEncQMatrix *q_matrix;
@@ -504,35 +540,32 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
   VADisplay va_display;
   VAContextID va_context;
   VAStatus status;
+  gint64 start;
   guint i;
 
-  g_return_val_if_fail (picture != NULL, FALSE);
-  g_return_val_if_fail (picture->surface_id != VA_INVALID_SURFACE, FALSE);
-
   va_display = GET_VA_DISPLAY (picture);
   va_context = GET_VA_CONTEXT (picture);
 
   GST_DEBUG ("encode picture 0x%08x", picture->surface_id);
 
+  start = gst_vaapi_trace_begin ();
   status = vaBeginPicture (va_display, va_context, picture->surface_id);
   if (!vaapi_check_status (status, "vaBeginPicture()"))
     return FALSE;
 
   /* Submit Sequence parameter */
   sequence = picture->sequence;
-  if (sequence && !do_encode (va_display, va_context,
-          &sequence->param_id, &sequence->param))
+  if (sequence && !do_encode (picture, &sequence->param_id, &sequence->param))
     return FALSE;
 
   /* Submit Quantization matrix */
   q_matrix = picture->q_matrix;
-  if (q_matrix && !do_encode (va_display, va_context,
-          &q_matrix->param_id, &q_matrix->param))
+  if (q_matrix && !do_encode (picture, &q_matrix->param_id, &q_matrix->param))
     return FALSE;
 
   /* Submit huffman table */
   huf_table = picture->huf_table;
-  if (huf_table && !do_encode (va_display, va_context,
+  if (huf_table && !do_encode (picture,
           &huf_table->param_id, (void **) &huf_table->param))
     return FALSE;
 
@@ -540,21 +573,20 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
   for (i = 0; i < picture->packed_headers->len; i++) {
     GstVaapiEncPackedHeader *const header =
         g_ptr_array_index (picture->packed_headers, i);
-    if (!do_encode (va_display, va_context,
-            &header->param_id, &header->param) ||
-        !do_encode (va_display, va_context, &header->data_id, &header->data))
+    if (!do_encode (picture, &header->param_id, &header->param) ||
+        !do_encode (picture, &header->data_id, &header->data))
       return FALSE;
   }
 
   /* Submit Picture parameter */
-  if (!do_encode (va_display, va_context, &picture->param_id, &picture->param))
+  if (!do_encode (picture, &picture->param_id, &picture->param))
     return FALSE;
 
   /* Submit Misc Params */
   for (i = 0; i < picture->misc_params->len; i++) {
     GstVaapiEncMiscParam *const misc =
         g_ptr_array_index (picture->misc_params, i);
-    if (!do_encode (va_display, va_context, &misc->param_id, &misc->param))
+    if (!do_encode (picture, &misc->param_id, &misc->param))
       return FALSE;
   }
 
@@ -567,17 +599,77 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
     for (j = 0; j < slice->packed_headers->len; j++) {
       GstVaapiEncPackedHeader *const header =
           g_ptr_array_index (slice->packed_headers, j);
-      if (!do_encode (va_display, va_context,
-              &header->param_id, &header->param) ||
-          !do_encode (va_display, va_context, &header->data_id, &header->data))
+      if (!do_encode (picture, &header->param_id, &header->param) ||
+          !do_encode (picture, &header->data_id, &header->data))
         return FALSE;
     }
-    if (!do_encode (va_display, va_context, &slice->param_id, &slice->param))
+    if (!do_encode (picture, &slice->param_id, &slice->param))
       return FALSE;
   }
 
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_SUBMIT, start, picture->surface_id);
+
+  start = gst_vaapi_trace_begin ();
   status = vaEndPicture (va_display, va_context);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_END_PICTURE, start,
+      picture->surface_id);
+  gst_vaapi_context_commit_buffers (GET_CONTEXT (picture));
   if (!vaapi_check_status (status, "vaEndPicture()"))
     return FALSE;
   return TRUE;
 }
+
+gboolean
+gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
+{
+  GstVaapiEncoder *encoder;
+  gboolean success;
+
+  g_return_val_if_fail (picture != NULL, FALSE);
+  g_return_val_if_fail (picture->surface_id != VA_INVALID_SURFACE, FALSE);
+
+  /* Pictures are resubmitted from the output thread */
+  encoder = GET_ENCODER (picture);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (encoder->display, &encoder->context_lock);
+  success = encode_picture_unlocked (picture);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (encoder->display, &encoder->context_lock);
+  return success;
+}
+
+/**
+ * gst_vaapi_enc_picture_resubmit:
+ * @picture: a #GstVaapiEncPicture which kept its buffers
+ * @codedbuf: the #GstVaapiCodedBuffer to encode @picture into
+ *
+ * Encodes @picture again, with the same parameters, into @codedbuf.
+ * This is used when the coded data did not fit into the coded buffer
+ * @picture was first encoded into.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_enc_picture_resubmit (GstVaapiEncPicture * picture,
+    GstVaapiCodedBuffer * codedbuf)
+{
+  GstVaapiDisplay *display;
+  guint8 *param;
+
+  g_return_val_if_fail (picture != NULL, FALSE);
+  g_return_val_if_fail (picture->keep_buffers, FALSE);
+  g_return_val_if_fail (codedbuf != NULL, FALSE);
+
+  display = GET_ENCODER (picture)->display;
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  param = vaapi_map_buffer (GET_VA_DISPLAY (picture), picture->param_id);
+  if (param) {
+    *(VABufferID *) (param + picture->coded_buf_offset) =
+        GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+    vaapi_unmap_buffer (GET_VA_DISPLAY (picture), picture->param_id, NULL);
+  }
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  if (!param)
+    return FALSE;
+
+  GST_DEBUG ("resubmit picture 0x%08x", picture->surface_id);
+  return gst_vaapi_enc_picture_encode (picture);
+}
@@ -255,7 +255,12 @@ struct _GstVaapiEncPicture
   GPtrArray *packed_headers;
   GPtrArray *misc_params;
 
+  /* State to encode the picture again into another coded buffer */
+  guint coded_buf_offset;
+  GPtrArray *held_surfaces;
+
   /*< public >*/
+  gboolean keep_buffers;
   GstVaapiPictureType type;
   VASurfaceID surface_id;
   gpointer param;
@@ -298,10 +303,20 @@ void
 gst_vaapi_enc_slice_add_packed_header (GstVaapiEncSlice *slice,
     GstVaapiEncPackedHeader * header);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_enc_picture_hold_surface (GstVaapiEncPicture * picture,
+    GstVaapiSurfaceProxy * proxy);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_enc_picture_resubmit (GstVaapiEncPicture * picture,
+    GstVaapiCodedBuffer * codedbuf);
+
 #define gst_vaapi_enc_picture_ref(picture) \
   gst_vaapi_codec_object_ref (picture)
 #define gst_vaapi_enc_picture_unref(picture) \
@@ -341,6 +356,16 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture);
   gst_vaapi_enc_picture_new (GST_VAAPI_ENCODER_CAST (encoder),          \
       NULL, sizeof (G_PASTE (VAEncPictureParameterBuffer, codec)), frame)
 
+/* Sets the coded buffer of the picture parameter @pic_param, which
+   shall be the mapped picture->param, so that it can be changed by
+   gst_vaapi_enc_picture_resubmit() */
+#define GST_VAAPI_ENC_PICTURE_SET_CODED_BUFFER(picture, pic_param, codedbuf) \
+  G_STMT_START {                                                        \
+    (pic_param)->coded_buf = GST_VAAPI_CODED_BUFFER_ID (codedbuf);      \
+    (picture)->coded_buf_offset = (guint8 *) &(pic_param)->coded_buf -  \
+        (guint8 *) (picture)->param;                                    \
+  } G_STMT_END
+
 /* GstVaapiEncSlice */
 #define GST_VAAPI_ENC_SLICE_NEW(codec, encoder)                         \
   gst_vaapi_enc_slice_new (GST_VAAPI_ENCODER_CAST (encoder),            \
@@ -30,6 +30,10 @@
 #include <gst/vaapi/gstvaapivideopool.h>
 #include <gst/video/gstvideoutils.h>
 #include <gst/vaapi/gstvaapivalue.h>
+#include "gstvaapiringqueue.h"
+#include "gstvaapilookahead.h"
+#include "gstvaapicodedbuffersizer.h"
+#include "gstvaapidisplay_priv.h"
 
 G_BEGIN_DECLS
 
@@ -65,6 +69,18 @@ G_BEGIN_DECLS
 #define GST_VAAPI_ENCODER_DISPLAY(encoder) \
     GST_VAAPI_ENCODER_CAST(encoder)->display
 
+/**
+ * GST_VAAPI_ENCODER_OBJECT_CACHE:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Macro that evaluates to the #GstVaapiMiniObjectCache the codec
+ * objects of @encoder are allocated from.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#undef  GST_VAAPI_ENCODER_OBJECT_CACHE
+#define GST_VAAPI_ENCODER_OBJECT_CACHE(encoder) \
+    GST_VAAPI_ENCODER_CAST(encoder)->object_cache
+
 /**
  * GST_VAAPI_ENCODER_CONTEXT:
  * @encoder: a #GstVaapiEncoder
@@ -153,6 +169,20 @@ G_BEGIN_DECLS
 #define GST_VAAPI_ENCODER_KEYFRAME_PERIOD(encoder) \
   (GST_VAAPI_ENCODER_CAST (encoder)->keyframe_period)
 
+/**
+ * GST_VAAPI_ENCODER_LOOKAHEAD_INFO:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Macro that evaluates to the #GstVaapiLookaheadInfo of the frame
+ * being reordered, or %NULL if the look-ahead is disabled. This is
+ * only meaningful while a new frame is passed to the reordering
+ * function.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_ENCODER_LOOKAHEAD_INFO(encoder)                 \
+  (GST_VAAPI_ENCODER_CAST (encoder)->has_lookahead_info ?         \
+   &GST_VAAPI_ENCODER_CAST (encoder)->lookahead_info : NULL)
+
 /**
  * GST_VAAPI_ENCODER_TUNE:
  * @encoder: a #GstVaapiEncoder
@@ -230,6 +260,7 @@ struct _GstVaapiEncoder
   GstVaapiDisplay *display;
   GstVaapiContext *context;
   GstVaapiContextInfo context_info;
+  GstVaapiMiniObjectCache *object_cache;
   GstVaapiEncoderTune tune;
   guint packed_headers;
 
@@ -257,8 +288,36 @@ struct _GstVaapiEncoder
   GCond codedbuf_free;
   guint codedbuf_size;
   GstVaapiVideoPool *codedbuf_pool;
-  GAsyncQueue *codedbuf_queue;
+  GstVaapiRingQueue *codedbuf_queue;
   guint32 num_codedbuf_queued;
+  guint num_codedbuf_lent;
+  /* pool coded buffers not released yet, at most the queue capacity */
+  guint num_codedbuf_alloc;
+
+  /* adaptive coded buffers: codedbuf_size is the worst case, the pool
+   * allocates what the sizer predicts, and pictures encoded into
+   * smaller buffers are submitted again on overflow. Reference
+   * pictures use the worst-case buffers of codedbuf_ref_pool */
+  GstVaapiCodedBufferSizer *codedbuf_sizer;
+  GstVaapiVideoPool *codedbuf_ref_pool;
+  GstVaapiContextLock context_lock;
+
+  /* asynchronous completion: number of coded buffers allowed to be
+   * in flight before the output side blocks in vaSyncSurface() */
+  guint async_depth;
+  guint64 async_num_frames;
+  guint64 async_depth_sum;
+  guint async_depth_max;
+  guint64 async_num_polls;
+  guint64 async_num_syncs;
+
+  /* look-ahead: input frames are analyzed, then held for
+   * lookahead_depth frames before they reach the reordering */
+  guint lookahead_depth;
+  GstVaapiLookahead *lookahead;
+  GstVaapiImage *lookahead_image;
+  GstVaapiLookaheadInfo lookahead_info;
+  gboolean has_lookahead_info;
 
   guint got_packed_headers:1;
   guint got_rate_control_mask:1;
@@ -384,6 +443,11 @@ gboolean
 gst_vaapi_encoder_ensure_max_num_ref_frames (GstVaapiEncoder * encoder,
     GstVaapiProfile profile, GstVaapiEntrypoint entrypoint);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_encoder_ensure_lookahead (GstVaapiEncoder * encoder, guint depth,
+    guint max_bframes);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_encoder_ensure_tile_support (GstVaapiEncoder * encoder,
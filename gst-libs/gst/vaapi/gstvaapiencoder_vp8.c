@@ -307,7 +307,8 @@ fill_picture (GstVaapiEncoderVP8 * encoder,
   memset (pic_param, 0, sizeof (VAEncPictureParameterBufferVP8));
 
   pic_param->reconstructed_frame = GST_VAAPI_SURFACE_PROXY_SURFACE_ID (surface);
-  pic_param->coded_buf = GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+  GST_VAAPI_ENC_PICTURE_SET_CODED_BUFFER (picture, pic_param, codedbuf);
+  gst_vaapi_enc_picture_hold_surface (picture, surface);
 
   if (picture->type == GST_VAAPI_PICTURE_TYPE_P) {
     pic_param->pic_flags.bits.frame_type = 1;
@@ -317,6 +318,9 @@ fill_picture (GstVaapiEncoderVP8 * encoder,
         GST_VAAPI_SURFACE_PROXY_SURFACE_ID (encoder->golden_ref);
     pic_param->ref_last_frame =
         GST_VAAPI_SURFACE_PROXY_SURFACE_ID (encoder->last_ref);
+    gst_vaapi_enc_picture_hold_surface (picture, encoder->alt_ref);
+    gst_vaapi_enc_picture_hold_surface (picture, encoder->golden_ref);
+    gst_vaapi_enc_picture_hold_surface (picture, encoder->last_ref);
     pic_param->pic_flags.bits.refresh_last = 1;
     pic_param->pic_flags.bits.refresh_golden_frame = 0;
     pic_param->pic_flags.bits.copy_buffer_to_golden = 1;
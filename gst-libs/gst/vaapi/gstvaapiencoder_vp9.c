@@ -345,7 +345,8 @@ fill_picture (GstVaapiEncoderVP9 * encoder,
   memset (pic_param, 0, sizeof (VAEncPictureParameterBufferVP9));
 
   pic_param->reconstructed_frame = GST_VAAPI_SURFACE_PROXY_SURFACE_ID (surface);
-  pic_param->coded_buf = GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+  GST_VAAPI_ENC_PICTURE_SET_CODED_BUFFER (picture, pic_param, codedbuf);
+  gst_vaapi_enc_picture_hold_surface (picture, surface);
 
   /* Update Reference Frame list */
   if (picture->type == GST_VAAPI_PICTURE_TYPE_I)
@@ -355,6 +356,7 @@ fill_picture (GstVaapiEncoderVP9 * encoder,
     for (i = 0; i < G_N_ELEMENTS (pic_param->reference_frames); i++) {
       pic_param->reference_frames[i] =
           GST_VAAPI_SURFACE_PROXY_SURFACE_ID (encoder->ref_list[i]);
+      gst_vaapi_enc_picture_hold_surface (picture, encoder->ref_list[i]);
     }
   }
 
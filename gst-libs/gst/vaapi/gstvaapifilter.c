@@ -29,6 +29,7 @@
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapisurface_priv.h"
 #include "gstvaapiutils_core.h"
+#include "gstvaapitrace.h"
 
 #define GST_VAAPI_FILTER_CAST(obj) \
     ((GstVaapiFilter *)(obj))
@@ -58,6 +59,7 @@ struct _GstVaapiFilter
   VADisplay va_display;
   VAConfigID va_config;
   VAContextID va_context;
+  GstVaapiContextLock context_lock;
   GPtrArray *operations;
   GstVideoFormat format;
   GstVaapiScaleMethod scale_method;
@@ -228,9 +230,10 @@ vpp_get_filters (GstVaapiFilter * filter, guint * num_filters_ptr)
 {
   VAProcFilterType *filters;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   filters = vpp_get_filters_unlocked (filter, num_filters_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return filters;
 }
 
@@ -279,9 +282,10 @@ vpp_get_filter_caps (GstVaapiFilter * filter, VAProcFilterType type,
 {
   gpointer caps;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   caps = vpp_get_filter_caps_unlocked (filter, type, cap_size, num_caps_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return caps;
 }
 
@@ -308,9 +312,10 @@ vpp_get_pipeline_caps_unlocked (GstVaapiFilter * filter)
 static void
 vpp_get_pipeline_caps (GstVaapiFilter * filter)
 {
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   vpp_get_pipeline_caps_unlocked (filter);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -926,9 +931,10 @@ op_set_generic (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   success = op_set_generic_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return success;
 }
 
@@ -1031,9 +1037,10 @@ op_set_color_balance (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   success = op_set_color_balance_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return success;
 }
 
@@ -1080,9 +1087,10 @@ op_set_deinterlace (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   success = op_set_deinterlace_unlocked (filter, op_data, method, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return success;
 }
 
@@ -1113,9 +1121,10 @@ op_set_skintone_level (GstVaapiFilter * filter,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   success = op_set_skintone_level_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return success;
 }
 
@@ -1142,9 +1151,10 @@ op_set_skintone (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   success = op_set_skintone_unlocked (filter, op_data, enhance);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return success;
 }
 #endif
@@ -1189,9 +1199,10 @@ op_set_hdr_tone_map (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
     gboolean value)
 {
   gboolean success = FALSE;
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   success = op_set_hdr_tone_map_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
 
   return success;
 }
@@ -1272,6 +1283,7 @@ gst_vaapi_filter_init (GstVaapiFilter * filter)
   filter->va_config = VA_INVALID_ID;
   filter->va_context = VA_INVALID_ID;
   filter->format = DEFAULT_FORMAT;
+  gst_vaapi_context_lock_init (&filter->context_lock);
 
   filter->forward_references =
       g_array_sized_new (FALSE, FALSE, sizeof (VASurfaceID), 4);
@@ -1310,6 +1322,7 @@ gst_vaapi_filter_finalize (GObject * object)
   GstVaapiFilter *const filter = GST_VAAPI_FILTER (object);
   guint i;
 
+  gst_vaapi_context_lock_clear (&filter->context_lock, filter->display);
   if (!filter->display)
     goto bail;
 
@@ -1839,6 +1852,7 @@ gst_vaapi_filter_process (GstVaapiFilter * filter,
     GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface, guint flags)
 {
   GstVaapiFilterStatus status;
+  gint64 start;
 
   g_return_val_if_fail (filter != NULL,
       GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
@@ -1847,10 +1861,63 @@ gst_vaapi_filter_process (GstVaapiFilter * filter,
   g_return_val_if_fail (dst_surface != NULL,
       GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  start = gst_vaapi_trace_begin ();
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   status = gst_vaapi_filter_process_unlocked (filter,
       src_surface, dst_surface, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_VPP, start,
+      GST_VAAPI_SURFACE_ID (dst_surface));
+  return status;
+}
+
+/**
+ * gst_vaapi_filter_process_multiple:
+ * @filter: a #GstVaapiFilter
+ * @src_surface: the source @GstVaapiSurface
+ * @dst_surfaces: (array length=num_dst_surfaces): the target surfaces
+ * @num_dst_surfaces: the number of @dst_surfaces
+ * @flags: #GstVaapiSurfaceRenderFlags that apply to @src_surface
+ *
+ * Applies the operations currently defined in the @filter to
+ * @src_surface once per target surface, e.g. to scale it to several
+ * resolutions at once. This is equivalent to calling
+ * gst_vaapi_filter_process() for each of @dst_surfaces, except that
+ * the VA context is only locked once.
+ *
+ * Processing stops at the first failure.
+ *
+ * Return value: a #GstVaapiFilterStatus
+ */
+GstVaapiFilterStatus
+gst_vaapi_filter_process_multiple (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface ** dst_surfaces,
+    guint num_dst_surfaces, guint flags)
+{
+  GstVaapiFilterStatus status = GST_VAAPI_FILTER_STATUS_SUCCESS;
+  gint64 start;
+  guint i;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (src_surface != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (dst_surfaces != NULL || num_dst_surfaces == 0,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
+  for (i = 0; i < num_dst_surfaces; i++) {
+    start = gst_vaapi_trace_begin ();
+    status = gst_vaapi_filter_process_unlocked (filter,
+        src_surface, dst_surfaces[i], flags);
+    gst_vaapi_trace_end (GST_VAAPI_TRACE_VPP, start,
+        GST_VAAPI_SURFACE_ID (dst_surfaces[i]));
+    if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+      break;
+  }
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
   return status;
 }
 
@@ -2439,9 +2506,10 @@ gst_vaapi_filter_set_colorimetry (GstVaapiFilter * filter,
 
   g_return_val_if_fail (filter != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   result = gst_vaapi_filter_set_colorimetry_unlocked (filter, input, output);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
 
   return result;
 }
@@ -2534,10 +2602,11 @@ gst_vaapi_filter_set_hdr_tone_map_meta (GstVaapiFilter * filter,
   g_return_val_if_fail (minfo != NULL, FALSE);
   g_return_val_if_fail (linfo != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_LOCK (filter->display, &filter->context_lock);
   status =
       gst_vaapi_filter_set_hdr_tone_map_meta_unlocked (filter, minfo, linfo);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_CONTEXT_UNLOCK (filter->display,
+      &filter->context_lock);
 
   return status;
 }
@@ -32,6 +32,9 @@
 #include "gstvaapiutils.h"
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
+#include "gstvaapidisplay_priv.h"
+#include "gstvaapitrace.h"
+#include "gstvaapicopy.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -126,9 +129,9 @@ gst_vaapi_image_free (GstVaapiImage * image)
   GST_DEBUG ("image %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (image_id));
 
   if (image_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroyImage (GST_VAAPI_DISPLAY_VADISPLAY (display), image_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroyImage()"))
       GST_WARNING ("failed to destroy image %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (image_id));
@@ -154,11 +157,11 @@ _gst_vaapi_image_create (GstVaapiImage * image, GstVideoFormat format)
   if (!va_format)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       (VAImageFormat *) va_format,
       image->width, image->height, &image->internal_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (status != VA_STATUS_SUCCESS ||
       image->internal_image.format.fourcc != va_format->fourcc)
     return FALSE;
@@ -575,6 +578,7 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
 {
   GstVaapiDisplay *display;
   VAStatus status;
+  gint64 start;
   guint i;
 
   if (_gst_vaapi_image_is_mapped (image))
@@ -584,10 +588,13 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  start = gst_vaapi_trace_begin ();
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaMapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       image->image.buf, (void **) &image->image_data);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_IMAGE_MAP, start,
+      GST_VAAPI_IMAGE_ID (image));
   if (!vaapi_check_status (status, "vaMapBuffer()"))
     return FALSE;
 
@@ -637,10 +644,10 @@ _gst_vaapi_image_unmap (GstVaapiImage * image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaUnmapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       image->image.buf);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaUnmapBuffer()"))
     return FALSE;
 
@@ -741,110 +748,51 @@ init_image_from_buffer (GstVaapiImageRaw * raw_image, GstBuffer * buffer)
   return vmeta ? init_image_from_video_meta (raw_image, vmeta) : FALSE;
 }
 
-/* Copy N lines of an image */
-static inline void
-memcpy_pic (guchar * dst,
-    guint dst_stride,
-    const guchar * src, guint src_stride, guint len, guint height)
+/* Computes the part of @plane covered by @rect: the byte offset and
+   length of each line, then the first line and the number of lines */
+static gboolean
+get_plane_region (const GstVideoFormatInfo * finfo, guint plane,
+    const GstVaapiRectangle * rect, guint * x, guint * width, guint * y,
+    guint * height)
 {
-  guint i;
+  guint c, w_sub, h_sub, pstride;
+  guint x0 = G_MAXUINT, x1 = 0, y0 = G_MAXUINT, y1 = 0;
+
+  /* Packed formats hold several components per plane, the region has
+     to span all of them so that whole macropixels get copied */
+  for (c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); c++) {
+    if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, c) != plane)
+      continue;
+
+    w_sub = GST_VIDEO_FORMAT_INFO_W_SUB (finfo, c);
+    h_sub = GST_VIDEO_FORMAT_INFO_H_SUB (finfo, c);
+    pstride = GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, c);
+    if (pstride == 0)
+      return FALSE;
 
-  for (i = 0; i < height; i++) {
-    memcpy (dst, src, len);
-    dst += dst_stride;
-    src += src_stride;
+    x0 = MIN (x0, (rect->x >> w_sub) * pstride);
+    x1 = MAX (x1, GST_VIDEO_SUB_SCALE (w_sub, rect->x + rect->width) * pstride);
+    y0 = MIN (y0, rect->y >> h_sub);
+    y1 = MAX (y1, GST_VIDEO_SUB_SCALE (h_sub, rect->y + rect->height));
   }
-}
-
-/* Copy NV12 images */
-static void
-copy_image_NV12 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
-{
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-
-  /* Y plane */
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height);
-
-  /* UV plane */
-  dst_stride = dst_image->stride[1];
-  dst = dst_image->pixels[1] + (rect->y / 2) * dst_stride + (rect->x & -2);
-  src_stride = src_image->stride[1];
-  src = src_image->pixels[1] + (rect->y / 2) * src_stride + (rect->x & -2);
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height / 2);
-}
-
-/* Copy YV12 images */
-static void
-copy_image_YV12 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
-{
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-  guint i, x, y, w, h;
-
-  /* Y plane */
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height);
-
-  /* U/V planes */
-  x = rect->x / 2;
-  y = rect->y / 2;
-  w = rect->width / 2;
-  h = rect->height / 2;
-  for (i = 1; i < dst_image->num_planes; i++) {
-    dst_stride = dst_image->stride[i];
-    dst = dst_image->pixels[i] + y * dst_stride + x;
-    src_stride = src_image->stride[i];
-    src = src_image->pixels[i] + y * src_stride + x;
-    memcpy_pic (dst, dst_stride, src, src_stride, w, h);
-  }
-}
-
-/* Copy YUY2 images */
-static void
-copy_image_YUY2 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
-{
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-
-  /* YUV 4:2:2, full vertical resolution */
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x * 2;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x * 2;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width * 2, rect->height);
-}
+  if (x0 >= x1 || y0 >= y1)
+    return FALSE;
 
-/* Copy RGBA images */
-static void
-copy_image_RGBA (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
-{
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, 4 * rect->width, rect->height);
+  *x = x0;
+  *width = x1 - x0;
+  *y = y0;
+  *height = y1 - y0;
+  return TRUE;
 }
 
 static gboolean
 copy_image (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect,
+    GstVaapiCopyKernel kernel, guint flags)
 {
+  const GstVideoFormatInfo *finfo;
   GstVaapiRectangle default_rect;
+  guint i, n_planes, x, y, width, height;
 
   if (dst_image->format != src_image->format ||
       dst_image->width != src_image->width ||
@@ -864,30 +812,63 @@ copy_image (GstVaapiImageRaw * dst_image,
     default_rect.height = src_image->height;
     rect = &default_rect;
   }
+  if (rect->width == 0 || rect->height == 0)
+    return TRUE;
 
-  switch (dst_image->format) {
-    case GST_VIDEO_FORMAT_NV12:
-      copy_image_NV12 (dst_image, src_image, rect);
-      break;
-    case GST_VIDEO_FORMAT_YV12:
-    case GST_VIDEO_FORMAT_I420:
-      copy_image_YV12 (dst_image, src_image, rect);
-      break;
-    case GST_VIDEO_FORMAT_YUY2:
-    case GST_VIDEO_FORMAT_UYVY:
-      copy_image_YUY2 (dst_image, src_image, rect);
-      break;
-    case GST_VIDEO_FORMAT_ARGB:
-    case GST_VIDEO_FORMAT_RGBA:
-    case GST_VIDEO_FORMAT_ABGR:
-    case GST_VIDEO_FORMAT_BGRA:
-      copy_image_RGBA (dst_image, src_image, rect);
-      break;
-    default:
-      GST_ERROR ("unsupported image format for copy");
-      return FALSE;
+  finfo = gst_video_format_get_info (dst_image->format);
+  if (!finfo || GST_VIDEO_FORMAT_INFO_IS_COMPLEX (finfo) ||
+      GST_VIDEO_FORMAT_INFO_IS_TILED (finfo))
+    goto error_unsupported_format;
+
+  n_planes = GST_VIDEO_FORMAT_INFO_N_PLANES (finfo);
+  if (n_planes > G_N_ELEMENTS (dst_image->pixels) ||
+      n_planes > dst_image->num_planes || n_planes > src_image->num_planes)
+    goto error_unsupported_format;
+
+  for (i = 0; i < n_planes; i++) {
+    if (!get_plane_region (finfo, i, rect, &x, &width, &y, &height))
+      goto error_unsupported_format;
+
+    gst_vaapi_copy_plane (kernel, flags,
+        dst_image->pixels[i] + y * dst_image->stride[i] + x,
+        dst_image->stride[i],
+        src_image->pixels[i] + y * src_image->stride[i] + x,
+        src_image->stride[i], width, height);
   }
   return TRUE;
+
+  /* ERRORS */
+error_unsupported_format:
+  {
+    GST_ERROR ("unsupported image format for copy (%s)",
+        gst_video_format_to_string (dst_image->format));
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_image_raw_copy:
+ * @dst_image: the target #GstVaapiImageRaw
+ * @src_image: the source #GstVaapiImageRaw
+ * @rect: a #GstVaapiRectangle expressing a region, or %NULL for the
+ *   whole image
+ * @kernel: the #GstVaapiCopyKernel to use
+ * @flags: #GstVaapiCopyFlags describing where the images live
+ *
+ * Copies pixels data between two raw images, with the selected copy
+ * kernel. Both image structures shall have the same format and size.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_image_raw_copy (GstVaapiImageRaw * dst_image,
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect,
+    GstVaapiCopyKernel kernel, guint flags)
+{
+  g_return_val_if_fail (dst_image != NULL, FALSE);
+  g_return_val_if_fail (src_image != NULL, FALSE);
+
+  return copy_image (dst_image, src_image, rect, kernel, flags);
 }
 
 /**
@@ -907,7 +888,7 @@ gst_vaapi_image_get_buffer (GstVaapiImage * image,
     GstBuffer * buffer, GstVaapiRectangle * rect)
 {
   GstVaapiImageRaw dst_image, src_image;
-  gboolean success;
+  gboolean success, was_mapped;
 
   g_return_val_if_fail (image != NULL, FALSE);
   g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
@@ -919,12 +900,14 @@ gst_vaapi_image_get_buffer (GstVaapiImage * image,
   if (dst_image.width != image->width || dst_image.height != image->height)
     return FALSE;
 
+  was_mapped = _gst_vaapi_image_is_mapped (image);
   if (!_gst_vaapi_image_map (image, &src_image))
     return FALSE;
 
-  success = copy_image (&dst_image, &src_image, rect);
+  success = copy_image (&dst_image, &src_image, rect,
+      GST_VAAPI_COPY_KERNEL_AUTO, GST_VAAPI_COPY_FLAG_SRC_UNCACHED);
 
-  if (!_gst_vaapi_image_unmap (image))
+  if (!was_mapped && !_gst_vaapi_image_unmap (image))
     return FALSE;
 
   return success;
@@ -947,16 +930,18 @@ gst_vaapi_image_get_raw (GstVaapiImage * image,
     GstVaapiImageRaw * dst_image, GstVaapiRectangle * rect)
 {
   GstVaapiImageRaw src_image;
-  gboolean success;
+  gboolean success, was_mapped;
 
   g_return_val_if_fail (image != NULL, FALSE);
 
+  was_mapped = _gst_vaapi_image_is_mapped (image);
   if (!_gst_vaapi_image_map (image, &src_image))
     return FALSE;
 
-  success = copy_image (dst_image, &src_image, rect);
+  success = copy_image (dst_image, &src_image, rect,
+      GST_VAAPI_COPY_KERNEL_AUTO, GST_VAAPI_COPY_FLAG_SRC_UNCACHED);
 
-  if (!_gst_vaapi_image_unmap (image))
+  if (!was_mapped && !_gst_vaapi_image_unmap (image))
     return FALSE;
 
   return success;
@@ -994,7 +979,8 @@ gst_vaapi_image_update_from_buffer (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &dst_image))
     return FALSE;
 
-  success = copy_image (&dst_image, &src_image, rect);
+  success = copy_image (&dst_image, &src_image, rect,
+      GST_VAAPI_COPY_KERNEL_AUTO, GST_VAAPI_COPY_FLAG_DST_UNCACHED);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -1027,7 +1013,8 @@ gst_vaapi_image_update_from_raw (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &dst_image))
     return FALSE;
 
-  success = copy_image (&dst_image, src_image, rect);
+  success = copy_image (&dst_image, src_image, rect,
+      GST_VAAPI_COPY_KERNEL_AUTO, GST_VAAPI_COPY_FLAG_DST_UNCACHED);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -1059,10 +1046,58 @@ gst_vaapi_image_copy (GstVaapiImage * dst_image, GstVaapiImage * src_image)
   if (!_gst_vaapi_image_map (src_image, &src_image_raw))
     goto end;
 
-  success = copy_image (&dst_image_raw, &src_image_raw, NULL);
+  success = copy_image (&dst_image_raw, &src_image_raw, NULL,
+      GST_VAAPI_COPY_KERNEL_AUTO,
+      GST_VAAPI_COPY_FLAG_SRC_UNCACHED | GST_VAAPI_COPY_FLAG_DST_UNCACHED);
 
 end:
   _gst_vaapi_image_unmap (src_image);
   _gst_vaapi_image_unmap (dst_image);
   return success;
 }
+
+/**
+ * gst_vaapi_image_read_data:
+ * @image: a #GstVaapiImage
+ * @data: the destination buffer, in system memory
+ * @size: the size of @data, in bytes
+ *
+ * Reads back the pixels of @image into @data, with the same layout
+ * as the VA image: each plane lives at the same offset and has the
+ * same pitch. Mapped VA images generally live in uncached memory, so
+ * this is done with streaming loads, and downstream reads then hit a
+ * cached copy instead. Padding bytes are not copied.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_image_read_data (GstVaapiImage * image, guchar * data, gsize size)
+{
+  GstVaapiImageRaw dst_image, src_image;
+  const VAImage *va_image;
+  gboolean success, was_mapped;
+  guint i;
+
+  g_return_val_if_fail (image != NULL, FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  va_image = &image->image;
+  if (size < va_image->data_size)
+    return FALSE;
+
+  was_mapped = _gst_vaapi_image_is_mapped (image);
+  if (!_gst_vaapi_image_map (image, &src_image))
+    return FALSE;
+
+  dst_image = src_image;
+  for (i = 0; i < dst_image.num_planes; i++)
+    dst_image.pixels[i] = data + va_image->offsets[i];
+
+  success = copy_image (&dst_image, &src_image, NULL,
+      GST_VAAPI_COPY_KERNEL_AUTO, GST_VAAPI_COPY_FLAG_SRC_UNCACHED);
+
+  if (!was_mapped && !_gst_vaapi_image_unmap (image))
+    return FALSE;
+
+  return success;
+}
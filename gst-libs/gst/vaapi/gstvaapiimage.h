@@ -167,6 +167,9 @@ gst_vaapi_image_update_from_buffer(
 gboolean
 gst_vaapi_image_copy(GstVaapiImage *dst_image, GstVaapiImage *src_image);
 
+gboolean
+gst_vaapi_image_read_data(GstVaapiImage *image, guchar *data, gsize size);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiImage, gst_vaapi_image_unref)
 
 G_END_DECLS
@@ -26,6 +26,7 @@
 #define GST_VAAPI_IMAGE_PRIV_H
 
 #include <gst/vaapi/gstvaapiimage.h>
+#include "gstvaapicopy.h"
 
 G_BEGIN_DECLS
 
@@ -134,6 +135,16 @@ gst_vaapi_image_update_from_raw(
     GstVaapiRectangle *rect
 );
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_image_raw_copy(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    GstVaapiCopyKernel       kernel,
+    guint                    flags
+);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_IMAGE_PRIV_H */
@@ -0,0 +1,424 @@
+/*
+ *  gstvaapilookahead.c - Encoder look-ahead analysis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapilookahead
+ * @short_description: Encoder look-ahead analysis
+ *
+ * Holds the frames submitted to an encoder for a few frame periods,
+ * and analyzes their luma plane on the CPU meanwhile. The plane is
+ * downscaled by averaging 8x8 blocks, then compared to the previous
+ * frame with a sum of absolute differences and a histogram
+ * difference.
+ *
+ * A frame whose histogram and pixels both changed a lot is marked as
+ * a scene cut. The number of B-frames used after a frame is reduced
+ * as the motion in the next frames grows, relative to their spatial
+ * complexity, since B-frames stop paying off once the frames they
+ * interpolate are too different.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapilookahead.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Size of the blocks averaged into one downscaled sample */
+#define THUMB_BLOCK_SIZE 8
+
+#define HISTOGRAM_BINS 32
+
+/* Thresholds for a scene cut: both the histogram and the samples
+   have to change */
+#define SCENE_CUT_HISTOGRAM_DELTA 0.30
+#define SCENE_CUT_MOTION 12.0
+
+/* Scene cuts closer than this to the previous one are ignored, so
+   that flashes and fast cuts do not cause bursts of IDR frames */
+#define SCENE_CUT_MIN_DISTANCE 8
+
+/* Motion to complexity ratios between which the number of B-frames
+   goes from the maximum down to zero */
+#define BFRAMES_RATIO_LOW 0.25
+#define BFRAMES_RATIO_HIGH 1.0
+
+typedef struct
+{
+  gpointer user_data;
+  GstVaapiLookaheadInfo info;
+  gboolean has_motion;
+} LookaheadEntry;
+
+struct _GstVaapiLookahead
+{
+  guint depth;
+  guint max_bframes;
+
+  /* Frames waiting for a decision, as a ring of depth + 1 entries */
+  LookaheadEntry *entries;
+  guint head;
+  guint length;
+
+  guint8 *thumb;
+  guint8 *prev_thumb;
+  guint thumb_width;
+  guint thumb_height;
+  guint histogram[HISTOGRAM_BINS];
+  guint prev_histogram[HISTOGRAM_BINS];
+  gboolean has_prev_thumb;
+  guint frames_since_cut;
+
+  guint64 num_frames;
+  guint64 num_analyzed;
+  guint64 num_scene_cuts;
+  guint64 num_bframes;
+};
+
+/**
+ * gst_vaapi_lookahead_new:
+ * @depth: the number of frames held for analysis
+ * @max_bframes: the maximum number of consecutive B-frames
+ *
+ * Creates a new #GstVaapiLookahead. A frame is only given back once
+ * @depth newer frames were pushed, or when draining.
+ *
+ * Return value: the newly allocated #GstVaapiLookahead
+ */
+GstVaapiLookahead *
+gst_vaapi_lookahead_new (guint depth, guint max_bframes)
+{
+  GstVaapiLookahead *lookahead;
+
+  g_return_val_if_fail (depth > 0, NULL);
+
+  lookahead = g_slice_new0 (GstVaapiLookahead);
+  if (!lookahead)
+    return NULL;
+
+  lookahead->depth = depth;
+  lookahead->max_bframes = max_bframes;
+  lookahead->entries = g_new0 (LookaheadEntry, depth + 1);
+  lookahead->frames_since_cut = G_MAXUINT;
+  return lookahead;
+}
+
+/**
+ * gst_vaapi_lookahead_free:
+ * @lookahead: a #GstVaapiLookahead
+ *
+ * Frees @lookahead. It shall not hold any frame anymore.
+ */
+void
+gst_vaapi_lookahead_free (GstVaapiLookahead * lookahead)
+{
+  g_return_if_fail (lookahead != NULL);
+  g_warn_if_fail (lookahead->length == 0);
+
+  if (lookahead->num_frames > 0) {
+    GST_INFO ("look-ahead %u: %" G_GUINT64_FORMAT " frames, %"
+        G_GUINT64_FORMAT " analyzed, %" G_GUINT64_FORMAT " scene cuts, "
+        "%.2f B-frames per decision", lookahead->depth,
+        lookahead->num_frames, lookahead->num_analyzed,
+        lookahead->num_scene_cuts,
+        (gdouble) lookahead->num_bframes / lookahead->num_frames);
+  }
+
+  g_free (lookahead->entries);
+  g_free (lookahead->thumb);
+  g_free (lookahead->prev_thumb);
+  g_slice_free (GstVaapiLookahead, lookahead);
+}
+
+/**
+ * gst_vaapi_lookahead_get_length:
+ * @lookahead: a #GstVaapiLookahead
+ *
+ * Return value: the number of frames held by @lookahead
+ */
+guint
+gst_vaapi_lookahead_get_length (GstVaapiLookahead * lookahead)
+{
+  g_return_val_if_fail (lookahead != NULL, 0);
+
+  return lookahead->length;
+}
+
+/**
+ * gst_vaapi_lookahead_reset:
+ * @lookahead: a #GstVaapiLookahead
+ *
+ * Forgets the previous frame, e.g. after a flush, so that the next
+ * frame is not compared to it. @lookahead shall not hold any frame.
+ */
+void
+gst_vaapi_lookahead_reset (GstVaapiLookahead * lookahead)
+{
+  g_return_if_fail (lookahead != NULL);
+  g_warn_if_fail (lookahead->length == 0);
+
+  lookahead->has_prev_thumb = FALSE;
+  lookahead->frames_since_cut = G_MAXUINT;
+}
+
+static gboolean
+ensure_thumbnails (GstVaapiLookahead * lookahead, guint width, guint height)
+{
+  const guint thumb_width = width / THUMB_BLOCK_SIZE;
+  const guint thumb_height = height / THUMB_BLOCK_SIZE;
+
+  if (thumb_width == 0 || thumb_height == 0)
+    return FALSE;
+
+  if (thumb_width != lookahead->thumb_width ||
+      thumb_height != lookahead->thumb_height) {
+    g_free (lookahead->thumb);
+    g_free (lookahead->prev_thumb);
+    lookahead->thumb = g_malloc (thumb_width * thumb_height);
+    lookahead->prev_thumb = g_malloc (thumb_width * thumb_height);
+    lookahead->thumb_width = thumb_width;
+    lookahead->thumb_height = thumb_height;
+    lookahead->has_prev_thumb = FALSE;
+  }
+  return TRUE;
+}
+
+/* Averages the 8x8 blocks of the luma plane, and accumulates the
+   histogram of the result */
+static void
+downscale (GstVaapiLookahead * lookahead, const guint8 * luma, guint stride)
+{
+  guint8 *dst = lookahead->thumb;
+  guint x, y, i, j, sum;
+
+  memset (lookahead->histogram, 0, sizeof (lookahead->histogram));
+  for (y = 0; y < lookahead->thumb_height; y++) {
+    const guint8 *const src = luma + y * THUMB_BLOCK_SIZE * stride;
+
+    for (x = 0; x < lookahead->thumb_width; x++) {
+      const guint8 *const block = src + x * THUMB_BLOCK_SIZE;
+
+      sum = 0;
+      for (j = 0; j < THUMB_BLOCK_SIZE; j++) {
+        for (i = 0; i < THUMB_BLOCK_SIZE; i++)
+          sum += block[j * stride + i];
+      }
+      sum = (sum + THUMB_BLOCK_SIZE * THUMB_BLOCK_SIZE / 2) /
+          (THUMB_BLOCK_SIZE * THUMB_BLOCK_SIZE);
+      *dst++ = sum;
+      lookahead->histogram[sum * HISTOGRAM_BINS / 256]++;
+    }
+  }
+}
+
+/* Mean absolute difference to the right and bottom neighbours */
+static gdouble
+compute_complexity (GstVaapiLookahead * lookahead)
+{
+  const guint w = lookahead->thumb_width;
+  const guint h = lookahead->thumb_height;
+  const guint8 *const p = lookahead->thumb;
+  guint64 sum = 0;
+  guint x, y;
+
+  for (y = 0; y < h; y++) {
+    for (x = 0; x < w; x++) {
+      if (x + 1 < w)
+        sum += ABS ((gint) p[y * w + x] - p[y * w + x + 1]);
+      if (y + 1 < h)
+        sum += ABS ((gint) p[y * w + x] - p[(y + 1) * w + x]);
+    }
+  }
+  return (gdouble) sum / (w * h);
+}
+
+/* Mean absolute difference to the co-located previous samples */
+static gdouble
+compute_motion (GstVaapiLookahead * lookahead)
+{
+  const guint n = lookahead->thumb_width * lookahead->thumb_height;
+  guint64 sum = 0;
+  guint i;
+
+  for (i = 0; i < n; i++)
+    sum += ABS ((gint) lookahead->thumb[i] - lookahead->prev_thumb[i]);
+  return (gdouble) sum / n;
+}
+
+static gdouble
+compute_histogram_delta (GstVaapiLookahead * lookahead)
+{
+  const guint n = lookahead->thumb_width * lookahead->thumb_height;
+  guint sum = 0;
+  guint i;
+
+  for (i = 0; i < HISTOGRAM_BINS; i++)
+    sum += ABS ((gint) lookahead->histogram[i] -
+        (gint) lookahead->prev_histogram[i]);
+  return (gdouble) sum / (2 * n);
+}
+
+static void
+analyze (GstVaapiLookahead * lookahead, LookaheadEntry * entry,
+    const guint8 * luma, guint stride, guint width, guint height)
+{
+  GstVaapiLookaheadInfo *const info = &entry->info;
+  guint8 *thumb;
+
+  if (!luma || !ensure_thumbnails (lookahead, width, height)) {
+    lookahead->has_prev_thumb = FALSE;
+    return;
+  }
+
+  downscale (lookahead, luma, stride);
+  info->analyzed = TRUE;
+  info->complexity = compute_complexity (lookahead);
+
+  if (lookahead->has_prev_thumb) {
+    entry->has_motion = TRUE;
+    info->motion = compute_motion (lookahead);
+    info->histogram_delta = compute_histogram_delta (lookahead);
+    info->scene_cut = info->histogram_delta >= SCENE_CUT_HISTOGRAM_DELTA &&
+        info->motion >= SCENE_CUT_MOTION &&
+        lookahead->frames_since_cut >= SCENE_CUT_MIN_DISTANCE;
+  }
+
+  thumb = lookahead->prev_thumb;
+  lookahead->prev_thumb = lookahead->thumb;
+  lookahead->thumb = thumb;
+  memcpy (lookahead->prev_histogram, lookahead->histogram,
+      sizeof (lookahead->histogram));
+  lookahead->has_prev_thumb = TRUE;
+}
+
+/**
+ * gst_vaapi_lookahead_push:
+ * @lookahead: a #GstVaapiLookahead
+ * @user_data: the frame, given back by gst_vaapi_lookahead_pop()
+ * @luma: (optional): the 8-bit luma plane of the frame
+ * @stride: the @luma stride, in bytes
+ * @width: the frame width
+ * @height: the frame height
+ *
+ * Analyzes a new frame and queues it. Frames without @luma get the
+ * default decisions: no scene cut, and the maximum number of
+ * B-frames. There shall be room for the frame, i.e. any frame
+ * available from gst_vaapi_lookahead_pop() shall have been popped.
+ */
+void
+gst_vaapi_lookahead_push (GstVaapiLookahead * lookahead, gpointer user_data,
+    const guint8 * luma, guint stride, guint width, guint height)
+{
+  LookaheadEntry *entry;
+
+  g_return_if_fail (lookahead != NULL);
+  g_return_if_fail (lookahead->length <= lookahead->depth);
+
+  entry = &lookahead->entries[(lookahead->head + lookahead->length) %
+      (lookahead->depth + 1)];
+  memset (entry, 0, sizeof (*entry));
+  entry->user_data = user_data;
+  analyze (lookahead, entry, luma, stride, width, height);
+  lookahead->length++;
+
+  lookahead->num_frames++;
+  if (entry->info.analyzed)
+    lookahead->num_analyzed++;
+  if (entry->info.scene_cut) {
+    GST_DEBUG ("scene cut: motion %.2f, histogram delta %.2f",
+        entry->info.motion, entry->info.histogram_delta);
+    lookahead->num_scene_cuts++;
+    lookahead->frames_since_cut = 0;
+  } else if (lookahead->frames_since_cut < G_MAXUINT)
+    lookahead->frames_since_cut++;
+}
+
+/* Decides the number of B-frames following the head frame, from the
+   motion in the frames up to the next anchor */
+static guint
+decide_num_bframes (GstVaapiLookahead * lookahead)
+{
+  const guint n = MIN (lookahead->max_bframes + 1, lookahead->length);
+  gdouble ratio = 0.0, scale;
+  guint i, num_analyzed = 0;
+
+  if (lookahead->max_bframes == 0)
+    return 0;
+
+  for (i = 0; i < n; i++) {
+    const LookaheadEntry *const entry =
+        &lookahead->entries[(lookahead->head + i) % (lookahead->depth + 1)];
+
+    /* The next scene does not predict from this one, and the motion
+       of a scene cut is relative to the previous scene */
+    if (entry->info.scene_cut) {
+      if (i > 0)
+        break;
+      continue;
+    }
+    if (!entry->has_motion)
+      continue;
+    ratio += entry->info.motion / MAX (entry->info.complexity, 1.0);
+    num_analyzed++;
+  }
+  if (num_analyzed == 0)
+    return lookahead->max_bframes;
+  ratio /= num_analyzed;
+
+  scale = (BFRAMES_RATIO_HIGH - ratio) /
+      (BFRAMES_RATIO_HIGH - BFRAMES_RATIO_LOW);
+  scale = CLAMP (scale, 0.0, 1.0);
+  return (guint) (scale * lookahead->max_bframes + 0.5);
+}
+
+/**
+ * gst_vaapi_lookahead_pop:
+ * @lookahead: a #GstVaapiLookahead
+ * @drain: %TRUE to give back frames without waiting for newer ones
+ * @info: (out caller-allocates): the decisions for the frame
+ *
+ * Gives back the oldest frame, once the look-ahead window is full or
+ * if @drain is set, along with the decisions made for it.
+ *
+ * Return value: the user data of the frame, or %NULL if none is
+ *   available
+ */
+gpointer
+gst_vaapi_lookahead_pop (GstVaapiLookahead * lookahead, gboolean drain,
+    GstVaapiLookaheadInfo * info)
+{
+  LookaheadEntry *entry;
+
+  g_return_val_if_fail (lookahead != NULL, NULL);
+  g_return_val_if_fail (info != NULL, NULL);
+
+  if (lookahead->length == 0)
+    return NULL;
+  if (!drain && lookahead->length <= lookahead->depth)
+    return NULL;
+
+  entry = &lookahead->entries[lookahead->head];
+  entry->info.num_bframes = decide_num_bframes (lookahead);
+  lookahead->num_bframes += entry->info.num_bframes;
+  *info = entry->info;
+
+  lookahead->head = (lookahead->head + 1) % (lookahead->depth + 1);
+  lookahead->length--;
+  return entry->user_data;
+}
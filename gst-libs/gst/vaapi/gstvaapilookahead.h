@@ -0,0 +1,82 @@
+/*
+ *  gstvaapilookahead.h - Encoder look-ahead analysis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_LOOKAHEAD_H
+#define GST_VAAPI_LOOKAHEAD_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiLookahead GstVaapiLookahead;
+typedef struct _GstVaapiLookaheadInfo GstVaapiLookaheadInfo;
+
+/**
+ * GstVaapiLookaheadInfo:
+ * @analyzed: %TRUE if the frame pixels were analyzed
+ * @scene_cut: %TRUE if the frame starts a new scene
+ * @num_bframes: the number of B-frames to use from this frame on
+ * @complexity: the spatial complexity of the frame
+ * @motion: the mean absolute difference to the previous frame
+ * @histogram_delta: the luma histogram difference to the previous
+ *   frame, from 0 (same histogram) to 1 (disjoint histograms)
+ *
+ * The decisions made for a frame leaving the look-ahead window. The
+ * metrics are computed on a downscaled luma plane, in 8-bit sample
+ * units.
+ */
+struct _GstVaapiLookaheadInfo
+{
+  gboolean analyzed;
+  gboolean scene_cut;
+  guint num_bframes;
+  gdouble complexity;
+  gdouble motion;
+  gdouble histogram_delta;
+};
+
+G_GNUC_INTERNAL
+GstVaapiLookahead *
+gst_vaapi_lookahead_new (guint depth, guint max_bframes);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_lookahead_free (GstVaapiLookahead * lookahead);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_lookahead_get_length (GstVaapiLookahead * lookahead);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_lookahead_push (GstVaapiLookahead * lookahead, gpointer user_data,
+    const guint8 * luma, guint stride, guint width, guint height);
+
+G_GNUC_INTERNAL
+gpointer
+gst_vaapi_lookahead_pop (GstVaapiLookahead * lookahead, gboolean drain,
+    GstVaapiLookaheadInfo * info);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_lookahead_reset (GstVaapiLookahead * lookahead);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_LOOKAHEAD_H */
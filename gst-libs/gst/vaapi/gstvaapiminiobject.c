@@ -23,6 +23,110 @@
 #include <string.h>
 #include "gstvaapiminiobject.h"
 
+/* Number of object classes a single cache can hold free-lists for */
+#define MAX_CACHE_BUCKETS 16
+
+/* Number of released objects kept per class by default */
+#define DEFAULT_CACHE_SIZE 32
+
+typedef struct
+{
+  gconstpointer object_class;
+  gsize size;
+  gpointer free_list;
+  guint num_free;
+} GstVaapiMiniObjectCacheBucket;
+
+/**
+ * GstVaapiMiniObjectCache:
+ *
+ * Typed free-lists of #GstVaapiMiniObject memory. Objects allocated
+ * with gst_vaapi_mini_object_new_with_cache() hold a reference to the
+ * cache, and their memory goes back to the free-list of their class
+ * once the last reference to them is released. This avoids a trip to
+ * the slice allocator for objects created per frame or per slice.
+ */
+struct _GstVaapiMiniObjectCache
+{
+  volatile gint ref_count;
+  GMutex lock;
+  guint max_free_objects;
+  GstVaapiMiniObjectCacheBucket buckets[MAX_CACHE_BUCKETS];
+  guint num_buckets;
+  GstVaapiMiniObjectCacheStats stats;
+};
+
+/* Called with the cache lock held */
+static GstVaapiMiniObjectCacheBucket *
+cache_lookup_bucket (GstVaapiMiniObjectCache * cache,
+    const GstVaapiMiniObjectClass * object_class)
+{
+  GstVaapiMiniObjectCacheBucket *bucket;
+  guint i;
+
+  for (i = 0; i < cache->num_buckets; i++) {
+    bucket = &cache->buckets[i];
+    if (bucket->object_class == object_class)
+      return bucket;
+  }
+
+  if (cache->num_buckets == MAX_CACHE_BUCKETS)
+    return NULL;
+
+  bucket = &cache->buckets[cache->num_buckets++];
+  bucket->object_class = object_class;
+  bucket->size = object_class->size;
+  bucket->free_list = NULL;
+  bucket->num_free = 0;
+  return bucket;
+}
+
+static gpointer
+cache_acquire (GstVaapiMiniObjectCache * cache,
+    const GstVaapiMiniObjectClass * object_class)
+{
+  GstVaapiMiniObjectCacheBucket *bucket;
+  gpointer mem = NULL;
+
+  g_mutex_lock (&cache->lock);
+  bucket = cache_lookup_bucket (cache, object_class);
+  if (bucket && bucket->free_list) {
+    mem = bucket->free_list;
+    bucket->free_list = *(gpointer *) mem;
+    bucket->num_free--;
+    cache->stats.num_reuses++;
+  } else
+    cache->stats.num_allocs++;
+  g_mutex_unlock (&cache->lock);
+
+  if (!mem)
+    mem = g_slice_alloc (object_class->size);
+  return mem;
+}
+
+static void
+cache_release (GstVaapiMiniObjectCache * cache, GstVaapiMiniObject * object)
+{
+  const GstVaapiMiniObjectClass *const klass = object->object_class;
+  GstVaapiMiniObjectCacheBucket *bucket;
+  gboolean cached = FALSE;
+
+  g_mutex_lock (&cache->lock);
+  cache->stats.num_releases++;
+  bucket = cache_lookup_bucket (cache, klass);
+  if (bucket && bucket->num_free < cache->max_free_objects) {
+    *(gpointer *) object = bucket->free_list;
+    bucket->free_list = object;
+    bucket->num_free++;
+    cached = TRUE;
+  }
+  g_mutex_unlock (&cache->lock);
+
+  if (!cached)
+    g_slice_free1 (klass->size, object);
+  gst_vaapi_mini_object_cache_unref (cache);
+}
+
 static void
 gst_vaapi_mini_object_free (GstVaapiMiniObject * object)
 {
@@ -33,8 +137,12 @@ gst_vaapi_mini_object_free (GstVaapiMiniObject * object)
   if (klass->finalize)
     klass->finalize (object);
 
-  if (G_LIKELY (g_atomic_int_dec_and_test (&object->ref_count)))
-    g_slice_free1 (klass->size, object);
+  if (G_LIKELY (g_atomic_int_dec_and_test (&object->ref_count))) {
+    if (object->cache)
+      cache_release (object->cache, object);
+    else
+      g_slice_free1 (klass->size, object);
+  }
 }
 
 /**
@@ -53,6 +161,41 @@ gst_vaapi_mini_object_free (GstVaapiMiniObject * object)
  */
 GstVaapiMiniObject *
 gst_vaapi_mini_object_new (const GstVaapiMiniObjectClass * object_class)
+{
+  return gst_vaapi_mini_object_new_with_cache (object_class, NULL);
+}
+
+/**
+ * gst_vaapi_mini_object_new0:
+ * @object_class: (optional): The object class
+ *
+ * Creates a new #GstVaapiMiniObject. This function is similar to
+ * gst_vaapi_mini_object_new() but derived object data is initialized
+ * to zeroes.
+ *
+ * Returns: The newly allocated #GstVaapiMiniObject
+ */
+GstVaapiMiniObject *
+gst_vaapi_mini_object_new0 (const GstVaapiMiniObjectClass * object_class)
+{
+  return gst_vaapi_mini_object_new0_with_cache (object_class, NULL);
+}
+
+/**
+ * gst_vaapi_mini_object_new_with_cache:
+ * @object_class: (optional): The object class
+ * @cache: (optional): a #GstVaapiMiniObjectCache
+ *
+ * Creates a new #GstVaapiMiniObject, like gst_vaapi_mini_object_new(),
+ * but recycles the memory of a previously released object of the same
+ * @object_class from @cache if possible. The object memory goes back
+ * to @cache when it is free'd.
+ *
+ * Returns: The newly allocated #GstVaapiMiniObject
+ */
+GstVaapiMiniObject *
+gst_vaapi_mini_object_new_with_cache (const GstVaapiMiniObjectClass *
+    object_class, GstVaapiMiniObjectCache * cache)
 {
   GstVaapiMiniObject *object;
 
@@ -65,33 +208,39 @@ gst_vaapi_mini_object_new (const GstVaapiMiniObjectClass * object_class)
 
   g_return_val_if_fail (object_class->size >= sizeof (*object), NULL);
 
-  object = g_slice_alloc (object_class->size);
+  if (cache)
+    object = cache_acquire (cache, object_class);
+  else
+    object = g_slice_alloc (object_class->size);
   if (!object)
     return NULL;
 
   object->object_class = object_class;
   object->ref_count = 1;
   object->flags = 0;
+  object->cache = cache ? gst_vaapi_mini_object_cache_ref (cache) : NULL;
   return object;
 }
 
 /**
- * gst_vaapi_mini_object_new0:
+ * gst_vaapi_mini_object_new0_with_cache:
  * @object_class: (optional): The object class
+ * @cache: (optional): a #GstVaapiMiniObjectCache
  *
  * Creates a new #GstVaapiMiniObject. This function is similar to
- * gst_vaapi_mini_object_new() but derived object data is initialized
- * to zeroes.
+ * gst_vaapi_mini_object_new_with_cache() but derived object data is
+ * initialized to zeroes.
  *
  * Returns: The newly allocated #GstVaapiMiniObject
  */
 GstVaapiMiniObject *
-gst_vaapi_mini_object_new0 (const GstVaapiMiniObjectClass * object_class)
+gst_vaapi_mini_object_new0_with_cache (const GstVaapiMiniObjectClass *
+    object_class, GstVaapiMiniObjectCache * cache)
 {
   GstVaapiMiniObject *object;
   guint sub_size;
 
-  object = gst_vaapi_mini_object_new (object_class);
+  object = gst_vaapi_mini_object_new_with_cache (object_class, cache);
   if (!object)
     return NULL;
 
@@ -199,3 +348,144 @@ gst_vaapi_mini_object_replace (GstVaapiMiniObject ** old_object_ptr,
   if (old_object)
     gst_vaapi_mini_object_unref_internal (old_object);
 }
+
+/* ------------------------------------------------------------------------- */
+/* --- Object cache                                                      --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_mini_object_cache_new:
+ * @max_free_objects: the maximum number of released objects kept per
+ *   object class
+ *
+ * Creates a new #GstVaapiMiniObjectCache. If @max_free_objects is
+ * zero, no memory is recycled but the allocations are still counted.
+ *
+ * Returns: The newly allocated #GstVaapiMiniObjectCache
+ */
+GstVaapiMiniObjectCache *
+gst_vaapi_mini_object_cache_new (guint max_free_objects)
+{
+  GstVaapiMiniObjectCache *cache;
+
+  cache = g_slice_new0 (GstVaapiMiniObjectCache);
+  if (!cache)
+    return NULL;
+
+  cache->ref_count = 1;
+  g_mutex_init (&cache->lock);
+  cache->max_free_objects = max_free_objects;
+  return cache;
+}
+
+/**
+ * gst_vaapi_mini_object_cache_new_default:
+ *
+ * Creates a new #GstVaapiMiniObjectCache with the default number of
+ * free objects per class. This can be overridden with the
+ * GST_VAAPI_OBJECT_CACHE_SIZE environment variable, zero disabling
+ * the recycling of objects.
+ *
+ * Returns: The newly allocated #GstVaapiMiniObjectCache
+ */
+GstVaapiMiniObjectCache *
+gst_vaapi_mini_object_cache_new_default (void)
+{
+  const gchar *const env = g_getenv ("GST_VAAPI_OBJECT_CACHE_SIZE");
+  guint max_free_objects = DEFAULT_CACHE_SIZE;
+
+  if (env)
+    max_free_objects = g_ascii_strtoull (env, NULL, 10);
+  return gst_vaapi_mini_object_cache_new (max_free_objects);
+}
+
+/**
+ * gst_vaapi_mini_object_cache_ref:
+ * @cache: a #GstVaapiMiniObjectCache
+ *
+ * Atomically increases the reference count of the given @cache by one.
+ *
+ * Returns: The same @cache argument
+ */
+GstVaapiMiniObjectCache *
+gst_vaapi_mini_object_cache_ref (GstVaapiMiniObjectCache * cache)
+{
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  g_atomic_int_inc (&cache->ref_count);
+  return cache;
+}
+
+/**
+ * gst_vaapi_mini_object_cache_unref:
+ * @cache: a #GstVaapiMiniObjectCache
+ *
+ * Atomically decreases the reference count of the @cache by one. Every
+ * object allocated from @cache holds a reference to it, so the cache
+ * is only destroyed once all of them were free'd.
+ */
+void
+gst_vaapi_mini_object_cache_unref (GstVaapiMiniObjectCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  if (!g_atomic_int_dec_and_test (&cache->ref_count))
+    return;
+
+  gst_vaapi_mini_object_cache_clear (cache);
+  g_mutex_clear (&cache->lock);
+  g_slice_free (GstVaapiMiniObjectCache, cache);
+}
+
+/**
+ * gst_vaapi_mini_object_cache_clear:
+ * @cache: a #GstVaapiMiniObjectCache
+ *
+ * Releases the memory held in the free-lists of @cache. Objects that
+ * are still alive are not affected.
+ */
+void
+gst_vaapi_mini_object_cache_clear (GstVaapiMiniObjectCache * cache)
+{
+  guint i;
+
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->lock);
+  for (i = 0; i < cache->num_buckets; i++) {
+    GstVaapiMiniObjectCacheBucket *const bucket = &cache->buckets[i];
+
+    while (bucket->free_list) {
+      gpointer const mem = bucket->free_list;
+
+      bucket->free_list = *(gpointer *) mem;
+      g_slice_free1 (bucket->size, mem);
+    }
+    bucket->num_free = 0;
+  }
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * gst_vaapi_mini_object_cache_get_stats:
+ * @cache: a #GstVaapiMiniObjectCache
+ * @stats: (out caller-allocates): the #GstVaapiMiniObjectCacheStats
+ *
+ * Retrieves the allocation counters of @cache.
+ */
+void
+gst_vaapi_mini_object_cache_get_stats (GstVaapiMiniObjectCache * cache,
+    GstVaapiMiniObjectCacheStats * stats)
+{
+  guint i;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&cache->lock);
+  *stats = cache->stats;
+  stats->num_free = 0;
+  for (i = 0; i < cache->num_buckets; i++)
+    stats->num_free += cache->buckets[i].num_free;
+  g_mutex_unlock (&cache->lock);
+}
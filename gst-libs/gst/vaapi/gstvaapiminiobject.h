@@ -29,6 +29,8 @@ G_BEGIN_DECLS
 
 typedef struct _GstVaapiMiniObject              GstVaapiMiniObject;
 typedef struct _GstVaapiMiniObjectClass         GstVaapiMiniObjectClass;
+typedef struct _GstVaapiMiniObjectCache         GstVaapiMiniObjectCache;
+typedef struct _GstVaapiMiniObjectCacheStats    GstVaapiMiniObjectCacheStats;
 
 /**
  * GST_VAAPI_MINI_OBJECT:
@@ -112,6 +114,8 @@ typedef struct _GstVaapiMiniObjectClass         GstVaapiMiniObjectClass;
  *   through gst_vaapi_mini_object_ref() et al. helpers
  * @flags: set of flags that should be manipulated through
  *   GST_VAAPI_MINI_OBJECT_FLAG_*() functions
+ * @cache: the #GstVaapiMiniObjectCache the object memory is returned
+ *   to, or %NULL
  *
  * A #GstVaapiMiniObject represents a minimal reference counted data
  * structure that can hold a set of flags and user-provided data.
@@ -122,6 +126,7 @@ struct _GstVaapiMiniObject
   gconstpointer object_class;
   volatile gint ref_count;
   guint flags;
+  GstVaapiMiniObjectCache *cache;
 };
 
 /**
@@ -147,6 +152,14 @@ gst_vaapi_mini_object_new (const GstVaapiMiniObjectClass * object_class);
 GstVaapiMiniObject *
 gst_vaapi_mini_object_new0 (const GstVaapiMiniObjectClass * object_class);
 
+GstVaapiMiniObject *
+gst_vaapi_mini_object_new_with_cache (const GstVaapiMiniObjectClass *
+    object_class, GstVaapiMiniObjectCache * cache);
+
+GstVaapiMiniObject *
+gst_vaapi_mini_object_new0_with_cache (const GstVaapiMiniObjectClass *
+    object_class, GstVaapiMiniObjectCache * cache);
+
 GstVaapiMiniObject *
 gst_vaapi_mini_object_ref (GstVaapiMiniObject * object);
 
@@ -157,6 +170,42 @@ void
 gst_vaapi_mini_object_replace (GstVaapiMiniObject ** old_object_ptr,
     GstVaapiMiniObject * new_object);
 
+/**
+ * GstVaapiMiniObjectCacheStats:
+ * @num_allocs: number of objects allocated from the slice allocator
+ * @num_reuses: number of objects recycled from the free-lists
+ * @num_releases: number of objects returned to the cache
+ * @num_free: number of objects currently held in the free-lists
+ *
+ * Allocation counters of a #GstVaapiMiniObjectCache.
+ */
+struct _GstVaapiMiniObjectCacheStats
+{
+  guint64 num_allocs;
+  guint64 num_reuses;
+  guint64 num_releases;
+  guint num_free;
+};
+
+GstVaapiMiniObjectCache *
+gst_vaapi_mini_object_cache_new (guint max_free_objects);
+
+GstVaapiMiniObjectCache *
+gst_vaapi_mini_object_cache_new_default (void);
+
+GstVaapiMiniObjectCache *
+gst_vaapi_mini_object_cache_ref (GstVaapiMiniObjectCache * cache);
+
+void
+gst_vaapi_mini_object_cache_unref (GstVaapiMiniObjectCache * cache);
+
+void
+gst_vaapi_mini_object_cache_clear (GstVaapiMiniObjectCache * cache);
+
+void
+gst_vaapi_mini_object_cache_get_stats (GstVaapiMiniObjectCache * cache,
+    GstVaapiMiniObjectCacheStats * stats);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_MINI_OBJECT_H */
@@ -67,6 +67,7 @@ free_units (GArray ** units_ptr)
 
 /**
  * gst_vaapi_parser_frame_new:
+ * @cache: (optional): the #GstVaapiMiniObjectCache to allocate from
  * @width: frame width in pixels
  * @height: frame height in pixels
  *
@@ -75,13 +76,15 @@ free_units (GArray ** units_ptr)
  * Returns: The newly allocated #GstVaapiParserFrame
  */
 GstVaapiParserFrame *
-gst_vaapi_parser_frame_new (guint width, guint height)
+gst_vaapi_parser_frame_new (GstVaapiMiniObjectCache * cache,
+    guint width, guint height)
 {
   GstVaapiParserFrame *frame;
   guint num_slices;
 
   frame = (GstVaapiParserFrame *)
-      gst_vaapi_mini_object_new (gst_vaapi_parser_frame_class ());
+      gst_vaapi_mini_object_new_with_cache (gst_vaapi_parser_frame_class (),
+      cache);
   if (!frame)
     return NULL;
 
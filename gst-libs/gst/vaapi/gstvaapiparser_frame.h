@@ -61,7 +61,8 @@ struct _GstVaapiParserFrame {
 
 G_GNUC_INTERNAL
 GstVaapiParserFrame *
-gst_vaapi_parser_frame_new(guint width, guint height);
+gst_vaapi_parser_frame_new(GstVaapiMiniObjectCache *cache,
+    guint width, guint height);
 
 G_GNUC_INTERNAL
 void
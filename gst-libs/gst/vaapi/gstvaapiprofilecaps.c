@@ -28,69 +28,32 @@
 #include "sysdeps.h"
 #include "gstvaapicompat.h"
 #include "gstvaapicontext.h"
+#include "gstvaapidisplay_priv.h"
 #include "gstvaapiprofilecaps.h"
 #include "gstvaapiutils.h"
 
+/* The surface attributes come from the driver cache, so that no
+ * throwaway context is created */
 static gboolean
-init_context_info (GstVaapiDisplay * display, GstVaapiContextInfo * cip)
-{
-  guint value = 0;
-
-  /* XXX: Only try a context from he first RTFormat in config. */
-  if (!gst_vaapi_get_config_attribute (display,
-          gst_vaapi_profile_get_va_profile (cip->profile),
-          gst_vaapi_entrypoint_get_va_entrypoint (cip->entrypoint),
-          VAConfigAttribRTFormat, &value)) {
-    return FALSE;
-  }
-
-  cip->chroma_type = to_GstVaapiChromaType (value);
-  return cip->chroma_type != 0;
-}
-
-static GstVaapiContext *
-create_context (GstVaapiDisplay * display, GstVaapiContextInfo * cip)
-{
-  if (!init_context_info (display, cip))
-    return NULL;
-  return gst_vaapi_context_new (display, cip);
-}
-
-static gboolean
-append_caps (GstVaapiContext * context, GstStructure * structure)
+append_caps_with_context_info (GstVaapiDisplay * display,
+    GstVaapiContextInfo * cip, GstStructure * structure)
 {
-  GstVaapiConfigSurfaceAttributes attribs = { 0, };
+  GstVaapiDriverConfigInfo info;
 
-  if (!gst_vaapi_context_get_surface_attributes (context, &attribs))
+  if (!gst_vaapi_display_get_config_info (display, cip->profile,
+          cip->entrypoint, &info))
     return FALSE;
 
-  if (attribs.min_width >= attribs.max_width ||
-      attribs.min_height >= attribs.max_height)
+  if (info.min_width >= info.max_width || info.min_height >= info.max_height)
     return FALSE;
 
-  gst_structure_set (structure, "width", GST_TYPE_INT_RANGE, attribs.min_width,
-      attribs.max_width, "height", GST_TYPE_INT_RANGE, attribs.min_height,
-      attribs.max_height, NULL);
+  gst_structure_set (structure, "width", GST_TYPE_INT_RANGE, info.min_width,
+      info.max_width, "height", GST_TYPE_INT_RANGE, info.min_height,
+      info.max_height, NULL);
 
   return TRUE;
 }
 
-static gboolean
-append_caps_with_context_info (GstVaapiDisplay * display,
-    GstVaapiContextInfo * cip, GstStructure * structure)
-{
-  GstVaapiContext *context;
-  gboolean ret;
-
-  context = create_context (display, cip);
-  if (!context)
-    return FALSE;
-
-  ret = append_caps (context, structure);
-  gst_vaapi_context_unref (context);
-  return ret;
-}
-
 /**
  * gst_vaapi_decoder_add_profile_caps:
  * @display: a #GstVaapiDisplay
@@ -0,0 +1,249 @@
+/*
+ *  gstvaapiringqueue.c - Bounded single-producer ring queue
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiringqueue
+ * @short_description: Bounded single-producer ring queue
+ *
+ * A fixed-size ring of pointers meant to replace #GAsyncQueue on the
+ * decoder and encoder output paths. Pushing and popping only touch
+ * atomic indices. The internal mutex is only taken when a consumer
+ * actually has to sleep in gst_vaapi_ring_queue_timeout_pop(), and by
+ * the producer when such a consumer needs to be woken up.
+ *
+ * Only one thread may push at a time. Pops are safe from several
+ * threads, since the read index is advanced with a compare-and-swap.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiringqueue.h"
+
+/* Keeps the producer and consumer indices on separate cache lines */
+#define CACHE_LINE_SIZE 64
+
+struct _GstVaapiRingQueue
+{
+  /* consumer side */
+  volatile gint head;
+  guint8 _pad0[CACHE_LINE_SIZE - sizeof (gint)];
+
+  /* producer side */
+  volatile gint tail;
+  guint8 _pad1[CACHE_LINE_SIZE - sizeof (gint)];
+
+  volatile gint waiters;
+  guint mask;
+  gpointer *slots;
+  GDestroyNotify destroy_func;
+
+  GMutex lock;
+  GCond cond;
+};
+
+/**
+ * gst_vaapi_ring_queue_new:
+ * @capacity: the minimal number of elements the queue can hold
+ * @destroy_func: (nullable): function to free queued elements
+ *
+ * Creates a new ring queue. The @capacity is rounded up to the next
+ * power of two.
+ *
+ * Return value: the newly allocated #GstVaapiRingQueue
+ */
+GstVaapiRingQueue *
+gst_vaapi_ring_queue_new (guint capacity, GDestroyNotify destroy_func)
+{
+  GstVaapiRingQueue *queue;
+  guint size;
+
+  g_return_val_if_fail (capacity > 0 && capacity <= G_MAXINT / 2, NULL);
+
+  size = 1;
+  while (size < capacity)
+    size <<= 1;
+
+  queue = g_slice_new0 (GstVaapiRingQueue);
+  queue->mask = size - 1;
+  queue->slots = g_new0 (gpointer, size);
+  queue->destroy_func = destroy_func;
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+  return queue;
+}
+
+/**
+ * gst_vaapi_ring_queue_free:
+ * @queue: a #GstVaapiRingQueue
+ *
+ * Releases any queued element and frees @queue.
+ */
+void
+gst_vaapi_ring_queue_free (GstVaapiRingQueue * queue)
+{
+  if (!queue)
+    return;
+
+  gst_vaapi_ring_queue_clear (queue);
+  g_free (queue->slots);
+  g_mutex_clear (&queue->lock);
+  g_cond_clear (&queue->cond);
+  g_slice_free (GstVaapiRingQueue, queue);
+}
+
+/**
+ * gst_vaapi_ring_queue_push:
+ * @queue: a #GstVaapiRingQueue
+ * @data: the element to queue, must not be %NULL
+ *
+ * Appends @data to the @queue. This function never blocks.
+ *
+ * Return value: %TRUE on success, %FALSE if the @queue is full
+ */
+gboolean
+gst_vaapi_ring_queue_push (GstVaapiRingQueue * queue, gpointer data)
+{
+  guint head, tail;
+
+  g_return_val_if_fail (queue != NULL, FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  tail = (guint) queue->tail;
+  head = (guint) g_atomic_int_get (&queue->head);
+  if (tail - head > queue->mask)
+    return FALSE;
+
+  queue->slots[tail & queue->mask] = data;
+  g_atomic_int_set (&queue->tail, (gint) (tail + 1));
+
+  if (G_UNLIKELY (g_atomic_int_get (&queue->waiters) > 0)) {
+    g_mutex_lock (&queue->lock);
+    g_cond_signal (&queue->cond);
+    g_mutex_unlock (&queue->lock);
+  }
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_ring_queue_try_pop:
+ * @queue: a #GstVaapiRingQueue
+ *
+ * Removes the oldest element from @queue, without blocking.
+ *
+ * Return value: the oldest element, or %NULL if @queue is empty
+ */
+gpointer
+gst_vaapi_ring_queue_try_pop (GstVaapiRingQueue * queue)
+{
+  gpointer data;
+  guint head;
+
+  g_return_val_if_fail (queue != NULL, NULL);
+
+  do {
+    head = (guint) g_atomic_int_get (&queue->head);
+    if (head == (guint) g_atomic_int_get (&queue->tail))
+      return NULL;
+    data = queue->slots[head & queue->mask];
+  } while (!g_atomic_int_compare_and_exchange (&queue->head, (gint) head,
+          (gint) (head + 1)));
+  return data;
+}
+
+/**
+ * gst_vaapi_ring_queue_timeout_pop:
+ * @queue: a #GstVaapiRingQueue
+ * @timeout: the number of microseconds to wait, at most
+ *
+ * Removes the oldest element from @queue, waiting up to @timeout
+ * microseconds for one to be pushed.
+ *
+ * Return value: the oldest element, or %NULL on timeout
+ */
+gpointer
+gst_vaapi_ring_queue_timeout_pop (GstVaapiRingQueue * queue, guint64 timeout)
+{
+  gpointer data;
+  gint64 end_time;
+
+  data = gst_vaapi_ring_queue_try_pop (queue);
+  if (data || timeout == 0)
+    return data;
+
+  end_time = g_get_monotonic_time () + timeout;
+
+  g_mutex_lock (&queue->lock);
+  g_atomic_int_inc (&queue->waiters);
+  while (!(data = gst_vaapi_ring_queue_try_pop (queue))) {
+    if (!g_cond_wait_until (&queue->cond, &queue->lock, end_time)) {
+      data = gst_vaapi_ring_queue_try_pop (queue);
+      break;
+    }
+  }
+  g_atomic_int_add (&queue->waiters, -1);
+  g_mutex_unlock (&queue->lock);
+  return data;
+}
+
+/**
+ * gst_vaapi_ring_queue_length:
+ * @queue: a #GstVaapiRingQueue
+ *
+ * Return value: the number of elements currently held in @queue
+ */
+guint
+gst_vaapi_ring_queue_length (GstVaapiRingQueue * queue)
+{
+  g_return_val_if_fail (queue != NULL, 0);
+
+  return (guint) g_atomic_int_get (&queue->tail) -
+      (guint) g_atomic_int_get (&queue->head);
+}
+
+/**
+ * gst_vaapi_ring_queue_get_capacity:
+ * @queue: a #GstVaapiRingQueue
+ *
+ * Return value: the maximum number of elements @queue can hold
+ */
+guint
+gst_vaapi_ring_queue_get_capacity (GstVaapiRingQueue * queue)
+{
+  g_return_val_if_fail (queue != NULL, 0);
+
+  return queue->mask + 1;
+}
+
+/**
+ * gst_vaapi_ring_queue_clear:
+ * @queue: a #GstVaapiRingQueue
+ *
+ * Pops and destroys all the elements held in @queue.
+ */
+void
+gst_vaapi_ring_queue_clear (GstVaapiRingQueue * queue)
+{
+  gpointer data;
+
+  g_return_if_fail (queue != NULL);
+
+  while ((data = gst_vaapi_ring_queue_try_pop (queue)) != NULL) {
+    if (queue->destroy_func)
+      queue->destroy_func (data);
+  }
+}
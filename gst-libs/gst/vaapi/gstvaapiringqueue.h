@@ -0,0 +1,63 @@
+/*
+ *  gstvaapiringqueue.h - Bounded single-producer ring queue
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_RING_QUEUE_H
+#define GST_VAAPI_RING_QUEUE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiRingQueue GstVaapiRingQueue;
+
+G_GNUC_INTERNAL
+GstVaapiRingQueue *
+gst_vaapi_ring_queue_new (guint capacity, GDestroyNotify destroy_func);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_ring_queue_free (GstVaapiRingQueue * queue);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_ring_queue_push (GstVaapiRingQueue * queue, gpointer data);
+
+G_GNUC_INTERNAL
+gpointer
+gst_vaapi_ring_queue_try_pop (GstVaapiRingQueue * queue);
+
+G_GNUC_INTERNAL
+gpointer
+gst_vaapi_ring_queue_timeout_pop (GstVaapiRingQueue * queue, guint64 timeout);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_ring_queue_length (GstVaapiRingQueue * queue);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_ring_queue_get_capacity (GstVaapiRingQueue * queue);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_ring_queue_clear (GstVaapiRingQueue * queue);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_RING_QUEUE_H */
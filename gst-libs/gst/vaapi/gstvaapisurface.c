@@ -36,6 +36,8 @@
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapidisplay_priv.h"
+#include "gstvaapitrace.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -78,10 +80,10 @@ gst_vaapi_surface_free (GstVaapiSurface * surface)
   gst_vaapi_surface_destroy_subpictures (surface);
 
   if (surface_id != VA_INVALID_SURFACE) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroySurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
         &surface_id, 1);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroySurfaces()"))
       GST_WARNING ("failed to destroy surface %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (surface_id));
@@ -106,10 +108,10 @@ gst_vaapi_surface_init (GstVaapiSurface * surface,
   if (!va_chroma_format)
     goto error_unsupported_chroma_type;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       width, height, va_chroma_format, 1, &surface_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -128,6 +130,75 @@ error_unsupported_chroma_type:
   return FALSE;
 }
 
+#if HAVE_VA_DRM_FORMAT_MODIFIERS
+#define DRM_FORMAT_MOD_INTEL(n) ((G_GUINT64_CONSTANT (0x01) << 56) | (n))
+
+/* The layouts offered to the driver for the surfaces which are only
+   accessed through VA. Drivers already tile them by default, but only
+   use the compressed layouts when they are asked for. The driver picks
+   one it supports for the format, and a driver which rejects them all
+   gets the allocation again without them */
+static const guint64 compressed_modifiers[] = {
+  DRM_FORMAT_MOD_INTEL (14),    /* I915_FORMAT_MOD_4_TILED_MTL_MC_CCS */
+  DRM_FORMAT_MOD_INTEL (11),    /* I915_FORMAT_MOD_4_TILED_DG2_MC_CCS */
+  DRM_FORMAT_MOD_INTEL (7),     /* I915_FORMAT_MOD_Y_TILED_GEN12_MC_CCS */
+  DRM_FORMAT_MOD_INTEL (9),     /* I915_FORMAT_MOD_4_TILED */
+  DRM_FORMAT_MOD_INTEL (2),     /* I915_FORMAT_MOD_Y_TILED */
+};
+
+/* The formats the driver rejected all the compressed layouts for are
+   remembered per display, so that they are only offered once */
+static gboolean
+is_compression_rejected (GstVaapiDisplay * display, GstVideoFormat format)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  if ((guint) format >= 32 * G_N_ELEMENTS (priv->uncompressed_formats))
+    return FALSE;
+  return (g_atomic_int_get ((volatile gint *)
+          &priv->uncompressed_formats[format / 32]) & (1U << (format % 32)))
+      != 0;
+}
+
+static void
+set_compression_rejected (GstVaapiDisplay * display, GstVideoFormat format)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  if ((guint) format >= 32 * G_N_ELEMENTS (priv->uncompressed_formats))
+    return;
+  g_atomic_int_or (&priv->uncompressed_formats[format / 32],
+      1U << (format % 32));
+}
+#endif
+
+/**
+ * gst_vaapi_surface_get_compressed_alloc_flags:
+ *
+ * Returns the allocation flags of the surfaces which are only accessed
+ * through VA, i.e. %GST_VAAPI_SURFACE_ALLOC_FLAG_COMPRESSED unless the
+ * GST_VAAPI_DISABLE_SURFACE_COMPRESSION environment variable is set.
+ *
+ * Return value: the #GstVaapiSurfaceAllocFlags to allocate with
+ */
+guint
+gst_vaapi_surface_get_compressed_alloc_flags (void)
+{
+  static gsize flags = 0;
+
+  if (g_once_init_enter (&flags)) {
+    gsize value = GST_VAAPI_SURFACE_ALLOC_FLAG_COMPRESSED;
+
+    /* zero is reserved by g_once_init_enter() */
+    if (g_getenv ("GST_VAAPI_DISABLE_SURFACE_COMPRESSION")) {
+      GST_INFO ("surface compression disabled");
+      value = G_MAXSIZE;
+    }
+    g_once_init_leave (&flags, value);
+  }
+  return flags != G_MAXSIZE ? flags : 0;
+}
+
 static guint
 get_usage_hint (guint alloc_flags)
 {
@@ -153,9 +224,12 @@ gst_vaapi_surface_init_full (GstVaapiSurface * surface,
   VAStatus status;
   guint chroma_type, va_chroma_format, i;
   const VAImageFormat *va_format;
-  VASurfaceAttrib attribs[4], *attrib;
+  VASurfaceAttrib attribs[5], *attrib;
   VASurfaceAttribExternalBuffers extbuf = { 0, };
-  gboolean extbuf_needed = FALSE;
+  gboolean extbuf_needed = FALSE, compressed = FALSE;
+#if HAVE_VA_DRM_FORMAT_MODIFIERS
+  VADRMFormatModifierList modifier_list;
+#endif
 
   va_format = gst_vaapi_video_format_to_va_format (format);
   if (!va_format)
@@ -215,12 +289,39 @@ gst_vaapi_surface_init_full (GstVaapiSurface * surface,
     attrib->value.value.p = &extbuf;
     attrib++;
   }
+#if HAVE_VA_DRM_FORMAT_MODIFIERS
+  else if ((surface_allocation_flags & GST_VAAPI_SURFACE_ALLOC_FLAG_COMPRESSED)
+      && !is_compression_rejected (display, format)) {
+    modifier_list.num_modifiers = G_N_ELEMENTS (compressed_modifiers);
+    modifier_list.modifiers = (uint64_t *) compressed_modifiers;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+    /* Keep it last, so that it can be dropped below */
+    attrib->flags = VA_SURFACE_ATTRIB_SETTABLE;
+    attrib->type = VASurfaceAttribDRMFormatModifiers;
+    attrib->value.type = VAGenericValueTypePointer;
+    attrib->value.value.p = &modifier_list;
+    attrib++;
+    compressed = TRUE;
+  }
+#endif
+
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       va_chroma_format, extbuf.width, extbuf.height, &surface_id, 1,
       attribs, attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  if (status != VA_STATUS_SUCCESS && compressed) {
+    /* The driver may reject modifiers it does not know about */
+    GST_INFO ("no compressed layout for format %s, using the default one",
+        gst_vaapi_video_format_to_string (format));
+    status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        va_chroma_format, extbuf.width, extbuf.height, &surface_id, 1,
+        attribs, attrib - attribs - 1);
+#if HAVE_VA_DRM_FORMAT_MODIFIERS
+    if (status == VA_STATUS_SUCCESS)
+      set_compression_rejected (display, format);
+#endif
+  }
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -301,11 +402,11 @@ gst_vaapi_surface_init_from_buffer_proxy (GstVaapiSurface * surface,
       from_GstVaapiBufferMemoryType (GST_VAAPI_BUFFER_PROXY_TYPE (proxy));
   attrib++;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       va_chroma_format, width, height, &surface_id, 1, attribs,
       attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -662,10 +763,10 @@ gst_vaapi_surface_derive_image (GstVaapiSurface * surface)
   va_image.image_id = VA_INVALID_ID;
   va_image.buf = VA_INVALID_ID;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaDeriveImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), &va_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaDeriveImage()"))
     return NULL;
   if (va_image.image_id == VA_INVALID_ID || va_image.buf == VA_INVALID_ID)
@@ -694,6 +795,7 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
   VAImageID image_id;
   VAStatus status;
   guint width, height;
+  gint64 start;
 
   g_return_val_if_fail (surface != NULL, FALSE);
   g_return_val_if_fail (image != NULL, FALSE);
@@ -712,10 +814,13 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  start = gst_vaapi_trace_begin ();
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaGetImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), 0, 0, width, height, image_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_IMAGE_COPY, start,
+      GST_VAAPI_SURFACE_ID (surface));
   if (!vaapi_check_status (status, "vaGetImage()"))
     return FALSE;
 
@@ -739,6 +844,7 @@ gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
   VAImageID image_id;
   VAStatus status;
   guint width, height;
+  gint64 start;
 
   g_return_val_if_fail (surface != NULL, FALSE);
   g_return_val_if_fail (image != NULL, FALSE);
@@ -757,11 +863,14 @@ gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  start = gst_vaapi_trace_begin ();
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaPutImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), image_id, 0, 0, width, height, 0, 0,
       width, height);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_IMAGE_COPY, start,
+      GST_VAAPI_SURFACE_ID (surface));
   if (!vaapi_check_status (status, "vaPutImage()"))
     return FALSE;
 
@@ -946,6 +1055,7 @@ gst_vaapi_surface_sync (GstVaapiSurface * surface)
 {
   GstVaapiDisplay *display;
   VAStatus status;
+  gint64 start;
 
   g_return_val_if_fail (surface != NULL, FALSE);
 
@@ -953,10 +1063,13 @@ gst_vaapi_surface_sync (GstVaapiSurface * surface)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  start = gst_vaapi_trace_begin ();
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaSyncSurface (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_SYNC, start,
+      GST_VAAPI_SURFACE_ID (surface));
   if (!vaapi_check_status (status, "vaSyncSurface()"))
     return FALSE;
 
@@ -983,10 +1096,10 @@ gst_vaapi_surface_query_status (GstVaapiSurface * surface,
 
   g_return_val_if_fail (surface != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaQuerySurfaceStatus (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), &surface_status);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaQuerySurfaceStatus()"))
     return FALSE;
 
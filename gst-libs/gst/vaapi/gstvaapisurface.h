@@ -167,6 +167,10 @@ typedef enum
  * @GST_VAAPI_SURFACE_ALLOC_FLAG_HINT_DECODER: Surface used by video
  *   decoder
  * @GST_VAAPI_SURFACE_ALLOC_FLAG_HINT_ENCODER: Surface used by encoder
+ * @GST_VAAPI_SURFACE_ALLOC_FLAG_COMPRESSED: allows a tiled and
+ *   compressed layout, for surfaces which are only accessed through
+ *   VA, i.e. neither mapped nor exported. Ignored along with linear
+ *   storage, fixed strides or fixed offsets.
  *
  * The set of optional allocation flags for gst_vaapi_surface_new_full().
  */
@@ -177,6 +181,7 @@ typedef enum
   GST_VAAPI_SURFACE_ALLOC_FLAG_FIXED_OFFSETS    = 1 << 2,
   GST_VAAPI_SURFACE_ALLOC_FLAG_HINT_DECODER     = 1 << 3,
   GST_VAAPI_SURFACE_ALLOC_FLAG_HINT_ENCODER     = 1 << 4,
+  GST_VAAPI_SURFACE_ALLOC_FLAG_COMPRESSED       = 1 << 5,
 } GstVaapiSurfaceAllocFlags;
 
 #define GST_VAAPI_SURFACE(obj) \
@@ -209,6 +214,9 @@ gst_vaapi_surface_unref (GstVaapiSurface * surface)
 GstVaapiDisplay *
 gst_vaapi_surface_get_display (GstVaapiSurface * surface);
 
+guint
+gst_vaapi_surface_get_compressed_alloc_flags (void);
+
 GstVaapiSurface *
 gst_vaapi_surface_new (GstVaapiDisplay * display,
     GstVaapiChromaType chroma_type, guint width, guint height);
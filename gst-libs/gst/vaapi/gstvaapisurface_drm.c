@@ -25,6 +25,7 @@
 #include "gstvaapisurface_priv.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapitrace.h"
 
 static GstVaapiBufferProxy *
 gst_vaapi_surface_get_drm_buf_handle (GstVaapiSurface * surface, guint type)
@@ -74,14 +75,18 @@ GstVaapiBufferProxy *
 gst_vaapi_surface_peek_dma_buf_handle (GstVaapiSurface * surface)
 {
   GstVaapiBufferProxy *buf_proxy;
+  gint64 start;
 
   g_return_val_if_fail (surface != NULL, NULL);
 
   if (surface->extbuf_proxy)
     return surface->extbuf_proxy;
 
+  start = gst_vaapi_trace_begin ();
   buf_proxy = gst_vaapi_surface_get_drm_buf_handle (surface,
       GST_VAAPI_BUFFER_MEMORY_TYPE_DMA_BUF);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_EXPORT, start,
+      GST_VAAPI_SURFACE_ID (surface));
 
   if (buf_proxy) {
     gst_vaapi_surface_set_buffer_proxy (surface, buf_proxy);
@@ -40,6 +40,8 @@ G_BEGIN_DECLS
  *   view component of a MultiView Coded (MVC) frame
  * @GST_VAAPI_SURFACE_PROXY_FLAG_CORRUPTED: the underlying surface is
  *   corrupted somehow, e.g. reconstructed from invalid references
+ * @GST_VAAPI_SURFACE_PROXY_FLAG_PROCESSED: the underlying surface was
+ *   scaled or color converted within the decoding context
  * @GST_VAAPI_SURFACE_PROXY_FLAG_LAST: first flag that can be used by subclasses
  *
  * Flags for #GstVaapiDecoderFrame.
@@ -52,6 +54,7 @@ typedef enum
   GST_VAAPI_SURFACE_PROXY_FLAG_ONEFIELD = (1 << 3),
   GST_VAAPI_SURFACE_PROXY_FLAG_FFB = (1 << 4),
   GST_VAAPI_SURFACE_PROXY_FLAG_CORRUPTED = (1 << 5),
+  GST_VAAPI_SURFACE_PROXY_FLAG_PROCESSED = (1 << 6),
   GST_VAAPI_SURFACE_PROXY_FLAG_LAST = (1 << 8)
 } GstVaapiSurfaceProxyFlags;
 
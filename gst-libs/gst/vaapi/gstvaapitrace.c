@@ -0,0 +1,274 @@
+/*
+ *  gstvaapitrace.c - Per-frame timing spans
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapitrace
+ * @short_description: Per-frame timing spans
+ *
+ * Records how long each stage of the per-frame hot path takes, along
+ * with the VA surface and the frame number it applies to, so that the
+ * latency can be attributed per stage without the debug log overhead.
+ *
+ * Tracing is enabled by setting the GST_VAAPI_TRACE environment
+ * variable to the path of the trace file. Each thread gathers its
+ * spans in memory without locking, and hands them over in blocks to a
+ * writer thread, which writes them out. The spans not handed over yet
+ * are written out at exit. Each line of the file holds one span: the
+ * stage, a thread number, the start time and the duration in
+ * microseconds, the surface and the frame number. The lines are not
+ * sorted: scripts/vaapi-trace-to-chrome.py sorts them while converting
+ * a trace to the Chrome trace event format.
+ *
+ * The frame number is the one the calling thread set last through
+ * gst_vaapi_trace_set_frame(): elements set it when they start
+ * working on a frame, and the library spans inherit it.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapitrace.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Number of spans a thread gathers before handing them over */
+#define TRACE_BLOCK_SIZE 1024
+
+typedef struct
+{
+  gint64 start;
+  gint64 duration;
+  guint id;
+  guint frame;
+  GstVaapiTraceSpan span;
+} TraceRecord;
+
+typedef struct
+{
+  guint thread;
+  /* atomic, the records below are complete */
+  gint len;
+  TraceRecord records[TRACE_BLOCK_SIZE];
+} TraceBlock;
+
+typedef struct
+{
+  guint thread;
+  guint frame;
+  /* atomic, only replaced by the thread itself */
+  TraceBlock *block;
+} TraceThread;
+
+static const gchar *const trace_span_names[GST_VAAPI_TRACE_N_SPANS] = {
+  "parse",
+  "submit",
+  "end-picture",
+  "sync",
+  "image-copy",
+  "image-map",
+  "vpp",
+  "export",
+  "render",
+};
+
+gboolean gst_vaapi_trace_enabled;
+
+static void release_trace_thread (TraceThread * thread);
+
+static FILE *trace_file;
+static GAsyncQueue *trace_queue;
+static GThread *trace_writer;
+static TraceBlock trace_stop_block;
+static GMutex trace_threads_lock;
+static GList *trace_threads;
+static gint trace_num_threads;
+static GPrivate trace_thread_key =
+G_PRIVATE_INIT ((GDestroyNotify) release_trace_thread);
+
+static TraceBlock *
+new_trace_block (guint thread)
+{
+  TraceBlock *const block = g_new (TraceBlock, 1);
+
+  block->thread = thread;
+  block->len = 0;
+  return block;
+}
+
+static TraceThread *
+get_trace_thread (void)
+{
+  TraceThread *thread = g_private_get (&trace_thread_key);
+
+  if (!thread) {
+    thread = g_new0 (TraceThread, 1);
+    thread->thread = g_atomic_int_add (&trace_num_threads, 1) + 1;
+    thread->block = new_trace_block (thread->thread);
+    g_private_set (&trace_thread_key, thread);
+
+    g_mutex_lock (&trace_threads_lock);
+    trace_threads = g_list_prepend (trace_threads, thread);
+    g_mutex_unlock (&trace_threads_lock);
+  }
+  return thread;
+}
+
+/* Hands the spans of an exiting thread over to the writer */
+static void
+release_trace_thread (TraceThread * thread)
+{
+  g_mutex_lock (&trace_threads_lock);
+  trace_threads = g_list_remove (trace_threads, thread);
+  g_mutex_unlock (&trace_threads_lock);
+
+  if (thread->block->len > 0)
+    g_async_queue_push (trace_queue, thread->block);
+  else
+    g_free (thread->block);
+  g_free (thread);
+}
+
+static void
+write_block (const TraceBlock * block, guint len)
+{
+  guint i;
+
+  for (i = 0; i < len; i++) {
+    const TraceRecord *const r = &block->records[i];
+
+    fprintf (trace_file, "%s %u %" G_GINT64_FORMAT " %" G_GINT64_FORMAT
+        " 0x%08x %u\n", trace_span_names[r->span], block->thread, r->start,
+        r->duration, r->id, r->frame);
+  }
+}
+
+static gpointer
+trace_writer_func (gpointer data)
+{
+  TraceBlock *block;
+
+  while ((block = g_async_queue_pop (trace_queue)) != &trace_stop_block) {
+    write_block (block, block->len);
+    fflush (trace_file);
+    g_free (block);
+  }
+  return NULL;
+}
+
+/* Stops the writer, then writes out the spans the live threads did not
+   hand over yet. The spans recorded meanwhile by threads still running
+   may be lost */
+static void
+flush_at_exit (void)
+{
+  GList *l;
+
+  gst_vaapi_trace_enabled = FALSE;
+
+  g_async_queue_push (trace_queue, &trace_stop_block);
+  g_thread_join (trace_writer);
+
+  g_mutex_lock (&trace_threads_lock);
+  for (l = trace_threads; l; l = l->next) {
+    TraceThread *const thread = l->data;
+    TraceBlock *const block = g_atomic_pointer_get (&thread->block);
+
+    write_block (block, g_atomic_int_get (&block->len));
+  }
+  g_mutex_unlock (&trace_threads_lock);
+  fflush (trace_file);
+}
+
+/**
+ * gst_vaapi_trace_init:
+ *
+ * Enables tracing if GST_VAAPI_TRACE is set. This is called when a
+ * display is created, and only does something the first time.
+ */
+void
+gst_vaapi_trace_init (void)
+{
+  static gsize init_once;
+  const gchar *path;
+
+  if (!g_once_init_enter (&init_once))
+    return;
+
+  path = g_getenv ("GST_VAAPI_TRACE");
+  if (path && *path) {
+    trace_file = fopen (path, "w");
+    if (trace_file) {
+      fprintf (trace_file, "# gstreamer-vaapi trace\n");
+      trace_queue = g_async_queue_new ();
+      trace_writer = g_thread_new ("vaapi-trace", trace_writer_func, NULL);
+      atexit (flush_at_exit);
+      gst_vaapi_trace_enabled = TRUE;
+      GST_INFO ("tracing to %s", path);
+    } else
+      GST_WARNING ("failed to open trace file %s", path);
+  }
+  g_once_init_leave (&init_once, TRUE);
+}
+
+/**
+ * gst_vaapi_trace_set_frame:
+ * @frame: a frame number
+ *
+ * Sets the frame number the calling thread works on, which the next
+ * spans of this thread are recorded with.
+ */
+void
+gst_vaapi_trace_set_frame (guint frame)
+{
+  if (G_LIKELY (!gst_vaapi_trace_enabled))
+    return;
+  get_trace_thread ()->frame = frame;
+}
+
+/**
+ * gst_vaapi_trace_record:
+ * @span: the traced stage
+ * @start: the span start time
+ * @id: the VA surface or image the span applies to
+ *
+ * Records a span which ends now. Use gst_vaapi_trace_end() instead.
+ */
+void
+gst_vaapi_trace_record (GstVaapiTraceSpan span, gint64 start, guint id)
+{
+  const gint64 end = g_get_monotonic_time ();
+  TraceThread *const thread = get_trace_thread ();
+  TraceBlock *const block = thread->block;
+  TraceRecord *r;
+
+  g_return_if_fail (span < GST_VAAPI_TRACE_N_SPANS);
+
+  r = &block->records[block->len];
+  r->start = start;
+  r->duration = end - start;
+  r->id = id;
+  r->frame = thread->frame;
+  r->span = span;
+  /* the record is complete before flush_at_exit() may read it */
+  g_atomic_int_set (&block->len, block->len + 1);
+
+  if (block->len == TRACE_BLOCK_SIZE) {
+    g_atomic_pointer_set (&thread->block, new_trace_block (thread->thread));
+    g_async_queue_push (trace_queue, block);
+  }
+}
@@ -0,0 +1,103 @@
+/*
+ *  gstvaapitrace.h - Per-frame timing spans
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_TRACE_H
+#define GST_VAAPI_TRACE_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstVaapiTraceSpan:
+ * @GST_VAAPI_TRACE_PARSE: bitstream parsing
+ * @GST_VAAPI_TRACE_SUBMIT: VA buffers submission, from vaBeginPicture()
+ *   to the last vaRenderPicture()
+ * @GST_VAAPI_TRACE_END_PICTURE: vaEndPicture()
+ * @GST_VAAPI_TRACE_SYNC: wait for a surface to be ready
+ * @GST_VAAPI_TRACE_IMAGE_COPY: copy between a surface and an image
+ * @GST_VAAPI_TRACE_IMAGE_MAP: image mapping
+ * @GST_VAAPI_TRACE_VPP: video processing
+ * @GST_VAAPI_TRACE_EXPORT: surface export to a DMABuf
+ * @GST_VAAPI_TRACE_RENDER: surface rendering to a window
+ *
+ * The stages of the per-frame hot path which are traced.
+ */
+typedef enum
+{
+  GST_VAAPI_TRACE_PARSE,
+  GST_VAAPI_TRACE_SUBMIT,
+  GST_VAAPI_TRACE_END_PICTURE,
+  GST_VAAPI_TRACE_SYNC,
+  GST_VAAPI_TRACE_IMAGE_COPY,
+  GST_VAAPI_TRACE_IMAGE_MAP,
+  GST_VAAPI_TRACE_VPP,
+  GST_VAAPI_TRACE_EXPORT,
+  GST_VAAPI_TRACE_RENDER,
+  GST_VAAPI_TRACE_N_SPANS
+} GstVaapiTraceSpan;
+
+G_GNUC_INTERNAL
+extern gboolean gst_vaapi_trace_enabled;
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_trace_init (void);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_trace_set_frame (guint frame);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_trace_record (GstVaapiTraceSpan span, gint64 start, guint id);
+
+/**
+ * gst_vaapi_trace_begin:
+ *
+ * Starts a span, at no cost besides a test when tracing is disabled.
+ *
+ * Return value: the span start time, to be given to
+ *   gst_vaapi_trace_end(), or 0 if tracing is disabled
+ */
+static inline gint64
+gst_vaapi_trace_begin (void)
+{
+  return G_UNLIKELY (gst_vaapi_trace_enabled) ? g_get_monotonic_time () : 0;
+}
+
+/**
+ * gst_vaapi_trace_end:
+ * @span: the traced stage
+ * @start: the value returned by gst_vaapi_trace_begin()
+ * @id: the VA surface, or image for image mapping, the span applies to
+ *
+ * Ends a span, and records it along with the frame number the calling
+ * thread works on.
+ */
+static inline void
+gst_vaapi_trace_end (GstVaapiTraceSpan span, gint64 start, guint id)
+{
+  if (G_UNLIKELY (start != 0))
+    gst_vaapi_trace_record (span, start, id);
+}
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_TRACE_H */
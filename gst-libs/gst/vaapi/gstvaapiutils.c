@@ -97,8 +97,11 @@ gst_vaapi_log (
 }
 #endif
 
+/* Initializes the VA display, and optionally returns the version of
+ * the VA-API it supports */
 gboolean
-vaapi_initialize (VADisplay dpy)
+vaapi_initialize (VADisplay dpy, gint * major_version_ptr,
+    gint * minor_version_ptr)
 {
   gint major_version, minor_version;
   VAStatus status;
@@ -120,6 +123,10 @@ vaapi_initialize (VADisplay dpy)
     return FALSE;
 
   GST_INFO ("VA-API version %d.%d", major_version, minor_version);
+  if (major_version_ptr)
+    *major_version_ptr = major_version;
+  if (minor_version_ptr)
+    *minor_version_ptr = minor_version;
   return TRUE;
 }
 
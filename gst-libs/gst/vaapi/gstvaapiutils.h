@@ -32,7 +32,8 @@
 /** calls vaInitialize() redirecting the logging mechanism */
 G_GNUC_INTERNAL
 gboolean
-vaapi_initialize (VADisplay dpy);
+vaapi_initialize (VADisplay dpy, gint * major_version,
+    gint * minor_version);
 
 /** Check VA status for success or print out an error */
 G_GNUC_INTERNAL
@@ -57,12 +57,26 @@ gboolean
 gst_vaapi_get_config_attribute (GstVaapiDisplay * display, VAProfile profile,
     VAEntrypoint entrypoint, VAConfigAttribType type, guint * out_value_ptr)
 {
+  GstVaapiDisplayPrivate *priv;
   VAConfigAttrib attrib;
   VAStatus status;
 
   g_return_val_if_fail (display != NULL, FALSE);
 
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   GST_VAAPI_DISPLAY_LOCK (display);
+  /* The RT formats are part of the driver cache */
+  if (type == VAConfigAttribRTFormat && priv->driver_cache) {
+    gboolean success;
+
+    success = gst_vaapi_driver_cache_get_rt_formats (priv->driver_cache,
+        profile, entrypoint, &attrib.value);
+    GST_VAAPI_DISPLAY_UNLOCK (display);
+    if (success && out_value_ptr)
+      *out_value_ptr = attrib.value;
+    return success;
+  }
+
   attrib.type = type;
   status = vaGetConfigAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
       profile, entrypoint, &attrib, 1);
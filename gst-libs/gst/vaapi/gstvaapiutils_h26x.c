@@ -23,8 +23,23 @@
  *  Boston, MA 02110-1301 USA
  */
 
+#include "sysdeps.h"
 #include "gstvaapiutils_h26x_priv.h"
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#define USE_SSE2_SCANNER 1
+#include <emmintrin.h>
+#else
+#define USE_SSE2_SCANNER 0
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_NEON_SCANNER 1
+#include <arm_neon.h>
+#else
+#define USE_NEON_SCANNER 0
+#endif
+
 /* Write an unsigned integer Exp-Golomb-coded syntax element. i.e. ue(v) */
 gboolean
 bs_write_ue (GstBitWriter * bs, guint32 value)
@@ -145,3 +160,185 @@ bs_error:
     return FALSE;
   }
 }
+
+/* ------------------------------------------------------------------------- */
+/* --- Byte-Stream to Length-Prefixed Conversion                         --- */
+/* ------------------------------------------------------------------------- */
+
+/* Looks for a 0x000001 prefix from offset @i. A byte greater than one
+   cannot be part of a prefix, so up to three bytes are skipped at a
+   time */
+static inline gsize
+find_start_code_from (const guint8 * data, gsize size, gsize i)
+{
+  for (i += 2; i < size;) {
+    if (data[i] > 1)
+      i += 3;
+    else if (data[i - 1])
+      i += 2;
+    else if (data[i] != 1 || data[i - 2])
+      i++;
+    else
+      return i - 2;
+  }
+  return size;
+}
+
+#if USE_SSE2_SCANNER
+/* Checks 16 offsets at a time: zero bytes are rare in slice data, so
+   the match mask is almost always empty */
+static gsize
+find_start_code_sse2 (const guint8 * data, gsize size)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one = _mm_set1_epi8 (1);
+  __m128i m0, m1, m2;
+  guint mask;
+  gsize i;
+
+  for (i = 0; i + 18 <= size; i += 16) {
+    m0 = _mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) (data + i)), zero);
+    m1 = _mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) (data + i + 1)),
+        zero);
+    m2 = _mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) (data + i + 2)),
+        one);
+    mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_and_si128 (m0, m1), m2));
+    if (mask)
+      return i + __builtin_ctz (mask);
+  }
+  return find_start_code_from (data, size, i);
+}
+#endif
+
+#if USE_NEON_SCANNER
+static gsize
+find_start_code_neon (const guint8 * data, gsize size)
+{
+  uint8x16_t m;
+  uint8x8_t m8;
+  gsize i;
+
+  for (i = 0; i + 18 <= size; i += 16) {
+    m = vandq_u8 (vandq_u8 (vceqq_u8 (vld1q_u8 (data + i), vdupq_n_u8 (0)),
+            vceqq_u8 (vld1q_u8 (data + i + 1), vdupq_n_u8 (0))),
+        vceqq_u8 (vld1q_u8 (data + i + 2), vdupq_n_u8 (1)));
+    m8 = vorr_u8 (vget_low_u8 (m), vget_high_u8 (m));
+    if (vget_lane_u64 (vreinterpret_u64_u8 (m8), 0))
+      return find_start_code_from (data, i + 18, i);
+  }
+  return find_start_code_from (data, size, i);
+}
+#endif
+
+/**
+ * gst_vaapi_utils_h26x_find_start_code:
+ * @data: byte-stream data
+ * @size: size of @data, in bytes
+ *
+ * Looks for the first 0x000001 start code prefix held in full within
+ * @data. The byte before it is zero for a four-byte start code.
+ *
+ * Returns: the offset of the start code prefix, or @size if none
+ **/
+gsize
+gst_vaapi_utils_h26x_find_start_code (const guint8 * data, gsize size)
+{
+#if USE_SSE2_SCANNER
+  return find_start_code_sse2 (data, size);
+#elif USE_NEON_SCANNER
+  return find_start_code_neon (data, size);
+#else
+  return find_start_code_from (data, size, 0);
+#endif
+}
+
+/**
+ * gst_vaapi_utils_h26x_converter_init:
+ * @conv: a #GstVaapiH26xConverter
+ * @data: the buffer the byte-stream is written into
+ *
+ * Prepares @conv to convert the byte-stream written into @data.
+ **/
+void
+gst_vaapi_utils_h26x_converter_init (GstVaapiH26xConverter * conv,
+    guint8 * data)
+{
+  memset (conv, 0, sizeof (*conv));
+  conv->data = data;
+}
+
+/* Replaces the start code of the current NAL unit with its size, now
+   that it is known to end at @end */
+static gboolean
+converter_write_nal_size (GstVaapiH26xConverter * conv, gsize end)
+{
+  const gsize nal_size = end - conv->nal_offset - 4;
+
+  if (nal_size == 0 || nal_size > G_MAXUINT32)
+    return FALSE;
+  GST_WRITE_UINT32_BE (conv->data + conv->nal_offset, nal_size);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_utils_h26x_converter_push:
+ * @conv: a #GstVaapiH26xConverter
+ * @size: number of bytes just written
+ *
+ * Converts the start codes found in the @size bytes written after the
+ * previous ones. The size of a NAL unit is only written once the next
+ * start code is found, so a NAL unit can span several pushes.
+ *
+ * Returns: %FALSE if the byte-stream cannot be converted in place,
+ *   %TRUE otherwise
+ **/
+gboolean
+gst_vaapi_utils_h26x_converter_push (GstVaapiH26xConverter * conv,
+    gsize size)
+{
+  guint8 *const data = conv->data;
+  gsize offset;
+
+  conv->size += size;
+  while (conv->scan_offset + 3 <= conv->size) {
+    offset = conv->scan_offset +
+        gst_vaapi_utils_h26x_find_start_code (data + conv->scan_offset,
+        conv->size - conv->scan_offset);
+    if (offset + 3 > conv->size) {
+      /* The next start code may straddle the next push */
+      conv->scan_offset = conv->size - 2;
+      break;
+    }
+
+    /* Three-byte start codes would need the data to be moved */
+    if (offset == 0 || data[offset - 1] != 0)
+      return FALSE;
+    if (conv->has_nal) {
+      if (!converter_write_nal_size (conv, offset - 1))
+        return FALSE;
+    } else if (offset != 1)
+      return FALSE;
+
+    conv->nal_offset = offset - 1;
+    conv->has_nal = TRUE;
+    conv->scan_offset = offset + 3;
+  }
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_utils_h26x_converter_finish:
+ * @conv: a #GstVaapiH26xConverter
+ *
+ * Writes the size of the last NAL unit, which ends with the data.
+ *
+ * Returns: %TRUE if the whole byte-stream was converted, %FALSE
+ *   otherwise
+ **/
+gboolean
+gst_vaapi_utils_h26x_converter_finish (GstVaapiH26xConverter * conv)
+{
+  if (!conv->has_nal)
+    return FALSE;
+  return converter_write_nal_size (conv, conv->size);
+}
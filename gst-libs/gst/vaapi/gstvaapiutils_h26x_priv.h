@@ -82,6 +82,42 @@ G_GNUC_INTERNAL
 gboolean
 gst_vaapi_utils_h26x_write_nal_unit (GstBitWriter * bs, guint8 * nal, guint nal_size);
 
+/* ------------------------------------------------------------------------- */
+/* --- H.264/265 Byte-Stream to Length-Prefixed Conversion               --- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct _GstVaapiH26xConverter GstVaapiH26xConverter;
+
+/* Converts in place a byte-stream, as it gets written into @data, to
+   NAL units prefixed with their size on four bytes (avc, hvc1). Only
+   four-byte start codes can be converted in place */
+struct _GstVaapiH26xConverter
+{
+  guint8 *data;
+  gsize size;                   /* bytes written so far */
+  gsize scan_offset;            /* where to look for the next start code */
+  gsize nal_offset;             /* start code of the current NAL unit */
+  gboolean has_nal;
+};
+
+G_GNUC_INTERNAL
+gsize
+gst_vaapi_utils_h26x_find_start_code (const guint8 * data, gsize size);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_utils_h26x_converter_init (GstVaapiH26xConverter * conv,
+    guint8 * data);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h26x_converter_push (GstVaapiH26xConverter * conv,
+    gsize size);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h26x_converter_finish (GstVaapiH26xConverter * conv);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_UTILS_H26X_PRIV_H */
@@ -25,6 +25,12 @@
 /**
  * SECTION:gstvaapivideopool
  * @short_description: Video object pool abstraction
+ *
+ * Objects are allocated when requested and none is free, and are kept
+ * once released. Watermarks can be set so that the pool grows ahead of
+ * the requests, from a worker thread, and releases the objects which
+ * stay unused, from a timer thread, see
+ * gst_vaapi_video_pool_set_watermarks().
  */
 
 #include "sysdeps.h"
@@ -49,6 +55,193 @@ gst_vaapi_video_pool_alloc_object (GstVaapiVideoPool * pool)
   return GST_VAAPI_VIDEO_POOL_GET_CLASS (pool)->alloc_object (pool);
 }
 
+/* Called with the pool mutex held */
+static inline gboolean
+is_full (GstVaapiVideoPool * pool)
+{
+  return pool->capacity && pool->used_count +
+      g_queue_get_length (&pool->free_objects) >= pool->capacity;
+}
+
+/* Allocates free objects up to the low watermark, from a worker thread */
+static void
+grow_func (gpointer data, gpointer user_data)
+{
+  GstVaapiVideoPool *const pool = data;
+  gpointer object;
+
+  g_mutex_lock (&pool->mutex);
+  while (g_queue_get_length (&pool->free_objects) < pool->low_watermark &&
+      !is_full (pool)) {
+    g_mutex_unlock (&pool->mutex);
+    object = gst_vaapi_video_pool_alloc_object (pool);
+    g_mutex_lock (&pool->mutex);
+    if (!object)
+      break;
+
+    /* The pool was filled up meanwhile */
+    if (is_full (pool)) {
+      gst_mini_object_unref (object);
+      break;
+    }
+    g_queue_push_tail (&pool->free_objects, object);
+    pool->stats.num_preallocs++;
+  }
+  pool->growing = FALSE;
+  g_mutex_unlock (&pool->mutex);
+  gst_vaapi_video_pool_unref (pool);
+}
+
+static GThreadPool *
+get_grow_workers (void)
+{
+  static gsize workers;
+
+  if (g_once_init_enter (&workers)) {
+    GThreadPool *const thread_pool =
+        g_thread_pool_new (grow_func, NULL, 1, FALSE, NULL);
+    g_once_init_leave (&workers, (gsize) thread_pool);
+  }
+  return (GThreadPool *) workers;
+}
+
+/* Called with the pool mutex held, whenever free objects were taken */
+static void
+check_low_watermark (GstVaapiVideoPool * pool)
+{
+  const guint num_free = g_queue_get_length (&pool->free_objects);
+
+  pool->idle_min_free = MIN (pool->idle_min_free, num_free);
+
+  if (num_free >= pool->low_watermark || pool->growing || is_full (pool))
+    return;
+  pool->growing = TRUE;
+  g_thread_pool_push (get_grow_workers (), gst_vaapi_video_pool_ref (pool),
+      NULL);
+}
+
+/* Called with the pool mutex held. Once per idle timeout, releases the
+   free objects above the high watermark which stayed free all along.
+   Returns the objects to release once the mutex is unlocked */
+static GList *
+check_high_watermark (GstVaapiVideoPool * pool)
+{
+  GList *objects = NULL;
+  guint num_free, num_idle;
+  gint64 now;
+
+  if (!pool->idle_timeout)
+    return NULL;
+
+  now = g_get_monotonic_time ();
+  if (now - pool->idle_period_start < pool->idle_timeout)
+    return NULL;
+
+  num_free = g_queue_get_length (&pool->free_objects);
+  num_idle = MIN (pool->idle_min_free, num_free);
+  if (num_free > pool->high_watermark)
+    num_idle = MIN (num_idle, num_free - pool->high_watermark);
+  else
+    num_idle = 0;
+
+  for (; num_idle > 0; num_idle--) {
+    objects = g_list_prepend (objects,
+        g_queue_pop_tail (&pool->free_objects));
+    pool->stats.num_trims++;
+  }
+  if (objects)
+    GST_DEBUG ("releasing %u idle objects", g_list_length (objects));
+
+  pool->idle_period_start = now;
+  pool->idle_min_free = g_queue_get_length (&pool->free_objects);
+  return objects;
+}
+
+static inline void
+release_objects (GList * objects)
+{
+  g_list_free_full (objects, (GDestroyNotify) gst_mini_object_unref);
+}
+
+/* Releases the idle objects of a pool which is not used anymore */
+static gboolean
+trim_func (gpointer data)
+{
+  GstVaapiVideoPool *const pool = data;
+  GList *idle_objects;
+
+  g_mutex_lock (&pool->mutex);
+  /* The timer holds the last reference, the pool can go */
+  if (g_atomic_int_get (&GST_VAAPI_MINI_OBJECT (pool)->ref_count) == 1) {
+    g_source_unref (pool->trim_source);
+    pool->trim_source = NULL;
+    g_mutex_unlock (&pool->mutex);
+    return G_SOURCE_REMOVE;
+  }
+  idle_objects = check_high_watermark (pool);
+  g_mutex_unlock (&pool->mutex);
+  release_objects (idle_objects);
+  return G_SOURCE_CONTINUE;
+}
+
+static GMainContext *
+get_trim_context (void)
+{
+  static gsize context;
+
+  if (g_once_init_enter (&context)) {
+    GMainContext *const main_context = g_main_context_new ();
+    GMainLoop *const loop = g_main_loop_new (main_context, FALSE);
+
+    g_thread_unref (g_thread_new ("vaapi-pool-trim",
+            (GThreadFunc) g_main_loop_run, loop));
+    g_once_init_leave (&context, (gsize) main_context);
+  }
+  return (GMainContext *) context;
+}
+
+/* Called with the pool mutex held, or before the pool is shared.
+   Restarts the timer which calls check_high_watermark() once per idle
+   timeout. The timer holds a reference to the pool, dropped once it is
+   the last one, so a pool lives on for up to an idle timeout */
+static void
+update_trim_timer (GstVaapiVideoPool * pool)
+{
+  if (pool->trim_source) {
+    g_source_destroy (pool->trim_source);
+    g_source_unref (pool->trim_source);
+    pool->trim_source = NULL;
+  }
+  if (!pool->idle_timeout)
+    return;
+
+  pool->trim_source = g_timeout_source_new (pool->idle_timeout / 1000);
+  g_source_set_callback (pool->trim_source, trim_func,
+      gst_vaapi_video_pool_ref (pool),
+      (GDestroyNotify) gst_vaapi_video_pool_unref);
+  g_source_attach (pool->trim_source, get_trim_context ());
+}
+
+/* Sets the surface pools watermarks from GST_VAAPI_SURFACE_POOL_WATERMARKS,
+   as LOW:HIGH:IDLE-TIMEOUT */
+static void
+set_default_watermarks (GstVaapiVideoPool * pool)
+{
+  const gchar *const env = g_getenv ("GST_VAAPI_SURFACE_POOL_WATERMARKS");
+  guint low, high, idle_timeout;
+
+  if (!env)
+    return;
+  if (sscanf (env, "%u:%u:%u", &low, &high, &idle_timeout) != 3 ||
+      low > high) {
+    GST_WARNING ("invalid surface pool watermarks '%s'", env);
+    return;
+  }
+  pool->low_watermark = low;
+  pool->high_watermark = high;
+  pool->idle_timeout = (gint64) idle_timeout * 1000;
+}
+
 void
 gst_vaapi_video_pool_init (GstVaapiVideoPool * pool, GstVaapiDisplay * display,
     GstVaapiVideoPoolObjectType object_type)
@@ -61,11 +254,32 @@ gst_vaapi_video_pool_init (GstVaapiVideoPool * pool, GstVaapiDisplay * display,
 
   g_queue_init (&pool->free_objects);
   g_mutex_init (&pool->mutex);
+
+  pool->low_watermark = 0;
+  pool->high_watermark = G_MAXUINT;
+  pool->idle_timeout = 0;
+  pool->idle_period_start = g_get_monotonic_time ();
+  pool->growing = FALSE;
+  pool->trim_source = NULL;
+  memset (&pool->stats, 0, sizeof (pool->stats));
+  if (object_type == GST_VAAPI_VIDEO_POOL_OBJECT_TYPE_SURFACE) {
+    set_default_watermarks (pool);
+    update_trim_timer (pool);
+  }
 }
 
 void
 gst_vaapi_video_pool_finalize (GstVaapiVideoPool * pool)
 {
+  if (pool->stats.num_gets > 0) {
+    GST_INFO ("pool %p: %" G_GUINT64_FORMAT " gets, max %u used, %"
+        G_GUINT64_FORMAT " allocs, %" G_GUINT64_FORMAT " preallocs, %"
+        G_GUINT64_FORMAT " trims, %" G_GUINT64_FORMAT " exhausted", pool,
+        pool->stats.num_gets, pool->stats.max_used, pool->stats.num_allocs,
+        pool->stats.num_preallocs, pool->stats.num_trims,
+        pool->stats.num_exhausted);
+  }
+
   g_list_free_full (pool->used_objects, (GDestroyNotify) gst_mini_object_unref);
   g_queue_foreach (&pool->free_objects, (GFunc) gst_mini_object_unref, NULL);
   g_queue_clear (&pool->free_objects);
@@ -168,8 +382,10 @@ gst_vaapi_video_pool_get_object_unlocked (GstVaapiVideoPool * pool)
 {
   gpointer object;
 
-  if (pool->capacity && pool->used_count >= pool->capacity)
+  if (pool->capacity && pool->used_count >= pool->capacity) {
+    pool->stats.num_exhausted++;
     return NULL;
+  }
 
   object = g_queue_pop_head (&pool->free_objects);
   if (!object) {
@@ -179,16 +395,24 @@ gst_vaapi_video_pool_get_object_unlocked (GstVaapiVideoPool * pool)
     if (!object)
       return NULL;
 
-    /* Others already allocated a new one before us during we
-       release the mutex */
-    if (pool->capacity && pool->used_count >= pool->capacity) {
+    /* Others, e.g. the grow worker, allocated objects meanwhile: stay
+       within the capacity, taking one of theirs if any is free */
+    if (is_full (pool)) {
       gst_mini_object_unref (object);
-      return NULL;
-    }
+      object = g_queue_pop_head (&pool->free_objects);
+      if (!object) {
+        pool->stats.num_exhausted++;
+        return NULL;
+      }
+    } else
+      pool->stats.num_allocs++;
   }
 
   ++pool->used_count;
   pool->used_objects = g_list_prepend (pool->used_objects, object);
+  pool->stats.num_gets++;
+  pool->stats.max_used = MAX (pool->stats.max_used, pool->used_count);
+  check_low_watermark (pool);
   return gst_mini_object_ref (object);
 }
 
@@ -196,12 +420,15 @@ gpointer
 gst_vaapi_video_pool_get_object (GstVaapiVideoPool * pool)
 {
   gpointer object;
+  GList *idle_objects;
 
   g_return_val_if_fail (pool != NULL, NULL);
 
   g_mutex_lock (&pool->mutex);
   object = gst_vaapi_video_pool_get_object_unlocked (pool);
+  idle_objects = check_high_watermark (pool);
   g_mutex_unlock (&pool->mutex);
+  release_objects (idle_objects);
   return object;
 }
 
@@ -234,12 +461,16 @@ gst_vaapi_video_pool_put_object_unlocked (GstVaapiVideoPool * pool,
 void
 gst_vaapi_video_pool_put_object (GstVaapiVideoPool * pool, gpointer object)
 {
+  GList *idle_objects;
+
   g_return_if_fail (pool != NULL);
   g_return_if_fail (object != NULL);
 
   g_mutex_lock (&pool->mutex);
   gst_vaapi_video_pool_put_object_unlocked (pool, object);
+  idle_objects = check_high_watermark (pool);
   g_mutex_unlock (&pool->mutex);
+  release_objects (idle_objects);
 }
 
 /**
@@ -421,3 +652,70 @@ gst_vaapi_video_pool_set_capacity (GstVaapiVideoPool * pool, guint capacity)
   pool->capacity = capacity;
   g_mutex_unlock (&pool->mutex);
 }
+
+/**
+ * gst_vaapi_video_pool_set_watermarks:
+ * @pool: a #GstVaapiVideoPool
+ * @low_watermark: the number of free objects to keep ready
+ * @high_watermark: the number of free objects to keep when idle
+ * @idle_timeout: the idle time after which free objects are released,
+ *   in milliseconds, or 0 to never release them
+ *
+ * Sets how @pool adjusts its size to the demand. Whenever less than
+ * @low_watermark objects are free, @pool allocates new ones from a
+ * worker thread, within its capacity, so that requests seldom need to
+ * wait for an allocation. Whenever some free objects were not needed
+ * during @idle_timeout, they are released, down to @high_watermark
+ * free objects. This is checked by a timer too, so that a pool which
+ * is not used anymore shrinks as well. The timer holds a reference to
+ * @pool, so @pool is only released up to @idle_timeout after its last
+ * reference is dropped.
+ *
+ * For surface pools, the watermarks default to the ones set in the
+ * GST_VAAPI_SURFACE_POOL_WATERMARKS environment variable, as
+ * LOW:HIGH:IDLE-TIMEOUT. Otherwise, pools never allocate ahead nor
+ * release objects.
+ *
+ * The surface pools of a #GstVaapiContext do not support watermarks:
+ * their surfaces are the render targets the VA context was created
+ * with, so they can neither be released nor added to while the context
+ * lives. Their watermarks are reset, whatever the environment.
+ */
+void
+gst_vaapi_video_pool_set_watermarks (GstVaapiVideoPool * pool,
+    guint low_watermark, guint high_watermark, guint idle_timeout)
+{
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (low_watermark <= high_watermark);
+
+  g_mutex_lock (&pool->mutex);
+  pool->low_watermark = low_watermark;
+  pool->high_watermark = high_watermark;
+  pool->idle_timeout = (gint64) idle_timeout * 1000;
+  pool->idle_period_start = g_get_monotonic_time ();
+  pool->idle_min_free = g_queue_get_length (&pool->free_objects);
+  check_low_watermark (pool);
+  update_trim_timer (pool);
+  g_mutex_unlock (&pool->mutex);
+}
+
+/**
+ * gst_vaapi_video_pool_get_stats:
+ * @pool: a #GstVaapiVideoPool
+ * @stats: return location for the statistics
+ *
+ * Gets the occupancy of @pool, and how it was served so far.
+ */
+void
+gst_vaapi_video_pool_get_stats (GstVaapiVideoPool * pool,
+    GstVaapiVideoPoolStats * stats)
+{
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  *stats = pool->stats;
+  stats->num_free = g_queue_get_length (&pool->free_objects);
+  stats->num_used = pool->used_count;
+  g_mutex_unlock (&pool->mutex);
+}
@@ -50,6 +50,35 @@ typedef enum
   GST_VAAPI_VIDEO_POOL_OBJECT_TYPE_CODED_BUFFER
 } GstVaapiVideoPoolObjectType;
 
+typedef struct _GstVaapiVideoPoolStats GstVaapiVideoPoolStats;
+
+/**
+ * GstVaapiVideoPoolStats:
+ * @num_free: the number of free objects
+ * @num_used: the number of objects in use
+ * @max_used: the maximal number of objects used at once
+ * @num_gets: the number of objects handed out
+ * @num_allocs: the number of objects allocated when one was requested
+ * @num_preallocs: the number of objects allocated ahead, below the low
+ *   watermark
+ * @num_trims: the number of idle objects released
+ * @num_exhausted: the number of requests failed because the capacity
+ *   was reached
+ *
+ * The occupancy of a #GstVaapiVideoPool.
+ */
+struct _GstVaapiVideoPoolStats
+{
+  guint num_free;
+  guint num_used;
+  guint max_used;
+  guint64 num_gets;
+  guint64 num_allocs;
+  guint64 num_preallocs;
+  guint64 num_trims;
+  guint64 num_exhausted;
+};
+
 GstVaapiVideoPool *
 gst_vaapi_video_pool_ref (GstVaapiVideoPool * pool);
 
@@ -91,6 +120,14 @@ gst_vaapi_video_pool_get_capacity (GstVaapiVideoPool * pool);
 void
 gst_vaapi_video_pool_set_capacity (GstVaapiVideoPool * pool, guint capacity);
 
+void
+gst_vaapi_video_pool_set_watermarks (GstVaapiVideoPool * pool,
+    guint low_watermark, guint high_watermark, guint idle_timeout);
+
+void
+gst_vaapi_video_pool_get_stats (GstVaapiVideoPool * pool,
+    GstVaapiVideoPoolStats * stats);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_VIDEO_POOL_H */
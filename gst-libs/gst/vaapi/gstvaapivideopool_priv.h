@@ -26,6 +26,7 @@
 #define GST_VAAPI_VIDEO_POOL_PRIV_H
 
 #include "gstvaapiminiobject.h"
+#include "gstvaapivideopool.h"
 
 G_BEGIN_DECLS
 
@@ -53,6 +54,16 @@ struct _GstVaapiVideoPool
   guint used_count;
   guint capacity;
   GMutex mutex;
+
+  /* Watermarks, see gst_vaapi_video_pool_set_watermarks() */
+  guint low_watermark;
+  guint high_watermark;
+  gint64 idle_timeout;
+  gint64 idle_period_start;
+  guint idle_min_free;
+  gboolean growing;
+  GSource *trim_source;
+  GstVaapiVideoPoolStats stats;
 };
 
 /**
@@ -32,6 +32,7 @@
 #include "gstvaapiwindow_priv.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapisurface_priv.h"
+#include "gstvaapitrace.h"
 
 GST_DEBUG_CATEGORY (gst_debug_vaapi_window);
 #define GST_CAT_DEFAULT gst_debug_vaapi_window
@@ -625,6 +626,8 @@ gst_vaapi_window_put_surface (GstVaapiWindow * window,
 {
   const GstVaapiWindowClass *klass;
   GstVaapiRectangle src_rect_default, dst_rect_default;
+  gboolean success;
+  gint64 start;
 
   g_return_val_if_fail (GST_VAAPI_IS_WINDOW (window), FALSE);
   g_return_val_if_fail (surface != NULL, FALSE);
@@ -643,7 +646,11 @@ gst_vaapi_window_put_surface (GstVaapiWindow * window,
     get_window_rect (window, &dst_rect_default);
   }
 
-  return klass->render (window, surface, src_rect, dst_rect, flags);
+  start = gst_vaapi_trace_begin ();
+  success = klass->render (window, surface, src_rect, dst_rect, flags);
+  gst_vaapi_trace_end (GST_VAAPI_TRACE_RENDER, start,
+      GST_VAAPI_SURFACE_ID (surface));
+  return success;
 }
 
 /**
@@ -36,6 +36,7 @@
 #include "gstvaapiutils.h"
 #include "gstvaapifilter.h"
 #include "gstvaapisurfacepool.h"
+#include "gstvaapiwlbuffercache.h"
 
 #include <unistd.h>
 
@@ -64,6 +65,7 @@ struct _FrameState
   struct wl_buffer *buffer;
   struct wl_callback *callback;
   gboolean done;
+  gboolean cached;              /* buffer owned by the buffer cache */
 };
 
 static FrameState *
@@ -80,6 +82,7 @@ frame_state_new (GstVaapiWindow * window)
   frame->surface_pool = NULL;
   frame->callback = NULL;
   frame->done = FALSE;
+  frame->cached = FALSE;
   return frame;
 }
 
@@ -91,6 +94,7 @@ struct _GstVaapiWindowWaylandPrivate
   struct wl_surface *surface;
   struct wl_subsurface *video_subsurface;
   struct wl_event_queue *event_queue;
+  GstVaapiWlBufferCache *buffer_cache;
   GList *frames;
   FrameState *last_frame;
   GstPoll *poll;
@@ -159,7 +163,10 @@ frame_state_free (FrameState * frame)
   gst_vaapi_video_pool_replace (&frame->surface_pool, NULL);
 
   g_clear_pointer (&frame->callback, wl_callback_destroy);
-  wl_buffer_destroy (frame->buffer);
+  if (frame->cached)
+    gst_vaapi_wl_buffer_cache_release (priv->buffer_cache, frame->buffer);
+  else
+    wl_buffer_destroy (frame->buffer);
   g_slice_free (FrameState, frame);
 }
 
@@ -410,6 +417,9 @@ gst_vaapi_window_wayland_create (GstVaapiWindow * window,
   if (!priv->event_queue)
     return FALSE;
 
+  priv->buffer_cache =
+      gst_vaapi_wl_buffer_cache_new ((GDestroyNotify) wl_buffer_destroy);
+
   GST_VAAPI_WINDOW_LOCK_DISPLAY (window);
   priv->surface = wl_compositor_create_surface (priv_display->compositor);
   GST_VAAPI_WINDOW_UNLOCK_DISPLAY (window);
@@ -509,6 +519,7 @@ gst_vaapi_window_wayland_finalize (GObject * object)
 
   while (priv->frames)
     frame_state_free ((FrameState *) priv->frames->data);
+  g_clear_pointer (&priv->buffer_cache, gst_vaapi_wl_buffer_cache_free);
 
   g_clear_pointer (&priv->xdg_surface, xdg_surface_destroy);
   g_clear_pointer (&priv->wl_shell_surface, wl_shell_surface_destroy);
@@ -538,6 +549,13 @@ static gboolean
 gst_vaapi_window_wayland_resize (GstVaapiWindow * window,
     guint width, guint height)
 {
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
+
+  /* The buffers are created with the window size */
+  if (priv->buffer_cache)
+    gst_vaapi_wl_buffer_cache_invalidate (priv->buffer_cache);
+
   if (window->use_foreign_window)
     return TRUE;
 
@@ -599,6 +617,28 @@ static const struct wl_buffer_listener frame_buffer_listener = {
   frame_release_callback
 };
 
+/* Cached buffers outlive the frames, their listener gets the window */
+static void
+cached_buffer_release_callback (void *data, struct wl_buffer *wl_buffer)
+{
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (data);
+  GList *l;
+
+  for (l = priv->frames; l != NULL; l = l->next) {
+    FrameState *const frame = l->data;
+
+    if (frame->buffer == wl_buffer && frame->cached) {
+      frame_release_callback (frame, wl_buffer);
+      return;
+    }
+  }
+}
+
+static const struct wl_buffer_listener cached_buffer_listener = {
+  cached_buffer_release_callback
+};
+
 typedef enum
 {
   GST_VAAPI_DMABUF_SUCCESS,
@@ -694,11 +734,14 @@ choose_next_format (GstVaapiDisplay * const display, gint * next_index)
 
 static GstVaapiDmabufStatus
 dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
-    guint va_flags, struct wl_buffer **out_buffer)
+    guint va_flags, struct wl_buffer **out_buffer, gboolean * out_cached)
 {
   GstVaapiDisplay *const display = GST_VAAPI_WINDOW_DISPLAY (window);
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
   GstVaapiDisplayWaylandPrivate *const priv_display =
       GST_VAAPI_DISPLAY_WAYLAND_GET_PRIVATE (display);
+  const GstVideoFormat surface_format = gst_vaapi_surface_get_format (surface);
   struct zwp_linux_buffer_params_v1 *params;
   struct wl_buffer *buffer = NULL;
   VADRMPRIMESurfaceDescriptor desc;
@@ -712,6 +755,15 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
   if ((va_flags & (VA_TOP_FIELD | VA_BOTTOM_FIELD)) != VA_FRAME_PICTURE)
     return GST_VAAPI_DMABUF_BAD_FLAGS;
 
+  buffer = gst_vaapi_wl_buffer_cache_acquire (priv->buffer_cache,
+      GST_MINI_OBJECT_CAST (surface), surface_format, window->width,
+      window->height);
+  if (buffer) {
+    *out_buffer = buffer;
+    *out_cached = TRUE;
+    return GST_VAAPI_DMABUF_SUCCESS;
+  }
+
   GST_VAAPI_WINDOW_LOCK_DISPLAY (window);
   status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
@@ -758,6 +810,15 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
 
   if (!buffer)
     ret = GST_VAAPI_DMABUF_NOT_SUPPORTED;
+  else if (gst_vaapi_wl_buffer_cache_insert (priv->buffer_cache,
+          GST_MINI_OBJECT_CAST (surface), surface_format, window->width,
+          window->height, buffer)) {
+    GST_VAAPI_WINDOW_LOCK_DISPLAY (window);
+    wl_proxy_set_queue ((struct wl_proxy *) buffer, priv->event_queue);
+    wl_buffer_add_listener (buffer, &cached_buffer_listener, window);
+    GST_VAAPI_WINDOW_UNLOCK_DISPLAY (window);
+    *out_cached = TRUE;
+  }
 
 out:
   zwp_linux_buffer_params_v1_destroy (params);
@@ -772,7 +833,7 @@ out:
 static gboolean
 buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface ** surf,
     const GstVaapiRectangle * src_rect, const GstVaapiRectangle * dst_rect,
-    guint flags, struct wl_buffer **buffer)
+    guint flags, struct wl_buffer **buffer, gboolean * cached)
 {
   GstVaapiDisplay *const display = GST_VAAPI_WINDOW_DISPLAY (window);
   GstVaapiWindowWaylandPrivate *const priv =
@@ -784,6 +845,7 @@ buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface ** surf,
   gint format_index = -1;
 
   va_flags = from_GstVaapiSurfaceRenderFlags (flags);
+  *cached = FALSE;
 
 again:
   surface = *surf;
@@ -817,7 +879,8 @@ again:
     }
   }
   if (!priv->dmabuf_broken) {
-    ret = dmabuf_buffer_from_surface (window, surface, va_flags, buffer);
+    ret = dmabuf_buffer_from_surface (window, surface, va_flags, buffer,
+        cached);
     switch (ret) {
       case GST_VAAPI_DMABUF_SUCCESS:
         goto out;
@@ -905,7 +968,7 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
   struct wl_buffer *buffer;
   FrameState *frame;
   guint width, height;
-  gboolean ret;
+  gboolean ret, cached;
 
   /* Skip rendering without valid window size. This can happen with a foreign
      window if the render rectangle is not yet set. */
@@ -931,7 +994,7 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
     priv->need_vpp = TRUE;
 
   ret = buffer_from_surface (window, &surface, src_rect, dst_rect, flags,
-      &buffer);
+      &buffer, &cached);
   if (!ret)
     return FALSE;
 
@@ -946,13 +1009,17 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
     /* Release vpp surface if exists */
     if (priv->need_vpp && window->has_vpp)
       gst_vaapi_video_pool_put_object (window->surface_pool, surface);
-    wl_buffer_destroy (buffer);
+    if (cached)
+      gst_vaapi_wl_buffer_cache_release (priv->buffer_cache, buffer);
+    else
+      wl_buffer_destroy (buffer);
     return !priv->sync_failed;
   }
 
   frame = frame_state_new (window);
   if (!frame)
     return FALSE;
+  frame->cached = cached;
   g_atomic_pointer_set (&priv->last_frame, frame);
   g_atomic_int_inc (&priv->num_frames_pending);
 
@@ -978,8 +1045,10 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
   }
   g_mutex_unlock (&priv->opaque_mutex);
 
-  wl_proxy_set_queue ((struct wl_proxy *) buffer, priv->event_queue);
-  wl_buffer_add_listener (buffer, &frame_buffer_listener, frame);
+  if (!cached) {
+    wl_proxy_set_queue ((struct wl_proxy *) buffer, priv->event_queue);
+    wl_buffer_add_listener (buffer, &frame_buffer_listener, frame);
+  }
 
   frame->buffer = buffer;
   frame->callback = wl_surface_frame (priv->surface);
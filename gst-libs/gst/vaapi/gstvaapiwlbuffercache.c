@@ -0,0 +1,334 @@
+/*
+ *  gstvaapiwlbuffercache.c - Wayland buffer cache for VA surfaces
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiwlbuffercache
+ * @short_description: Wayland buffer cache for VA surfaces
+ *
+ * Keeps the wl_buffer built for a VA surface, so that a surface which
+ * is rendered again is attached without exporting it and creating a
+ * new buffer through the dmabuf protocol. Decoders render from a small
+ * pool of surfaces, so the steady state only hits the cache.
+ *
+ * A buffer is busy from the time it is acquired or inserted until the
+ * compositor releases it, and is not handed out twice meanwhile. A
+ * buffer is invalidated when its surface is destroyed, or when the
+ * surface is rendered with another format or window size. Busy buffers
+ * are only destroyed once the compositor releases them.
+ *
+ * The buffers are opaque to the cache, which only destroys them with
+ * the function given to gst_vaapi_wl_buffer_cache_new().
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiwlbuffercache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct _CachedBuffer CachedBuffer;
+
+struct _CachedBuffer
+{
+  GstVaapiWlBufferCache *cache;
+  GstMiniObject *surface;       /* weak, NULL once invalidated */
+  gpointer buffer;
+  guint format;
+  guint width;
+  guint height;
+  gboolean busy;
+};
+
+struct _GstVaapiWlBufferCache
+{
+  GDestroyNotify destroy_buffer;
+
+  GMutex lock;
+  GHashTable *surfaces;         /* GstMiniObject -> CachedBuffer */
+  GHashTable *buffers;          /* buffer -> CachedBuffer */
+  GstVaapiWlBufferCacheStats stats;
+};
+
+static void surface_finalized (gpointer data, GstMiniObject * surface);
+
+/* Called with the cache lock held */
+static void
+destroy_entry (GstVaapiWlBufferCache * cache, CachedBuffer * entry)
+{
+  g_hash_table_remove (cache->buffers, entry->buffer);
+  cache->destroy_buffer (entry->buffer);
+  g_slice_free (CachedBuffer, entry);
+}
+
+/* Called with the cache lock held. The buffer is destroyed now if the
+   compositor does not use it, or when it releases it otherwise */
+static void
+invalidate_entry (GstVaapiWlBufferCache * cache, CachedBuffer * entry,
+    gboolean surface_alive)
+{
+  g_hash_table_remove (cache->surfaces, entry->surface);
+  if (surface_alive)
+    gst_mini_object_weak_unref (entry->surface, surface_finalized, entry);
+  entry->surface = NULL;
+  cache->stats.num_invalidations++;
+
+  if (!entry->busy)
+    destroy_entry (cache, entry);
+}
+
+static void
+surface_finalized (gpointer data, GstMiniObject * surface)
+{
+  CachedBuffer *const entry = data;
+  GstVaapiWlBufferCache *const cache = entry->cache;
+
+  g_mutex_lock (&cache->lock);
+  GST_LOG ("surface %p destroyed, invalidate buffer %p", surface,
+      entry->buffer);
+  invalidate_entry (cache, entry, FALSE);
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * gst_vaapi_wl_buffer_cache_new:
+ * @destroy_buffer: the function destroying a buffer, e.g.
+ *   wl_buffer_destroy()
+ *
+ * Creates a new #GstVaapiWlBufferCache.
+ *
+ * Return value: the newly allocated #GstVaapiWlBufferCache
+ */
+GstVaapiWlBufferCache *
+gst_vaapi_wl_buffer_cache_new (GDestroyNotify destroy_buffer)
+{
+  GstVaapiWlBufferCache *cache;
+
+  g_return_val_if_fail (destroy_buffer != NULL, NULL);
+
+  cache = g_slice_new0 (GstVaapiWlBufferCache);
+  if (!cache)
+    return NULL;
+
+  cache->destroy_buffer = destroy_buffer;
+  g_mutex_init (&cache->lock);
+  cache->surfaces = g_hash_table_new (NULL, NULL);
+  cache->buffers = g_hash_table_new (NULL, NULL);
+  return cache;
+}
+
+/**
+ * gst_vaapi_wl_buffer_cache_free:
+ * @cache: a #GstVaapiWlBufferCache
+ *
+ * Destroys all the buffers of @cache, busy or not, and frees @cache.
+ * This shall be called once the compositor released the buffers it
+ * could, and before the Wayland event queue of the buffers is
+ * destroyed.
+ */
+void
+gst_vaapi_wl_buffer_cache_free (GstVaapiWlBufferCache * cache)
+{
+  GHashTableIter iter;
+  CachedBuffer *entry;
+
+  g_return_if_fail (cache != NULL);
+
+  GST_INFO ("%" G_GUINT64_FORMAT " buffer hits, %" G_GUINT64_FORMAT
+      " misses, %" G_GUINT64_FORMAT " invalidations", cache->stats.num_hits,
+      cache->stats.num_misses, cache->stats.num_invalidations);
+
+  g_mutex_lock (&cache->lock);
+  g_hash_table_iter_init (&iter, cache->buffers);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & entry)) {
+    if (entry->surface)
+      gst_mini_object_weak_unref (entry->surface, surface_finalized, entry);
+    cache->destroy_buffer (entry->buffer);
+    g_slice_free (CachedBuffer, entry);
+  }
+  g_mutex_unlock (&cache->lock);
+
+  g_hash_table_unref (cache->surfaces);
+  g_hash_table_unref (cache->buffers);
+  g_mutex_clear (&cache->lock);
+  g_slice_free (GstVaapiWlBufferCache, cache);
+}
+
+/**
+ * gst_vaapi_wl_buffer_cache_acquire:
+ * @cache: a #GstVaapiWlBufferCache
+ * @surface: the surface to render
+ * @format: the format @surface is rendered with
+ * @width: the buffer width, in pixels
+ * @height: the buffer height, in pixels
+ *
+ * Looks up the buffer built for @surface, and marks it busy until
+ * gst_vaapi_wl_buffer_cache_release() is called. A buffer built with
+ * another @format or size is invalidated.
+ *
+ * Return value: the cached buffer, or %NULL if the caller needs to
+ *   create one and gst_vaapi_wl_buffer_cache_insert() it
+ */
+gpointer
+gst_vaapi_wl_buffer_cache_acquire (GstVaapiWlBufferCache * cache,
+    GstMiniObject * surface, guint format, guint width, guint height)
+{
+  CachedBuffer *entry;
+  gpointer buffer = NULL;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (surface != NULL, NULL);
+
+  g_mutex_lock (&cache->lock);
+  entry = g_hash_table_lookup (cache->surfaces, surface);
+  if (entry && (entry->format != format || entry->width != width ||
+          entry->height != height)) {
+    GST_DEBUG ("surface %p changed, invalidate buffer %p", surface,
+        entry->buffer);
+    invalidate_entry (cache, entry, TRUE);
+    entry = NULL;
+  }
+
+  if (entry && !entry->busy) {
+    entry->busy = TRUE;
+    buffer = entry->buffer;
+    cache->stats.num_hits++;
+  } else
+    cache->stats.num_misses++;
+  g_mutex_unlock (&cache->lock);
+  return buffer;
+}
+
+/**
+ * gst_vaapi_wl_buffer_cache_insert:
+ * @cache: a #GstVaapiWlBufferCache
+ * @surface: the surface @buffer was built for
+ * @format: the format @surface is rendered with
+ * @width: the buffer width, in pixels
+ * @height: the buffer height, in pixels
+ * @buffer: the new buffer
+ *
+ * Hands @buffer over to @cache, busy until it is released. This fails
+ * if @surface already has a buffer, which is still busy: the caller
+ * then keeps the ownership of @buffer.
+ *
+ * Return value: %TRUE if @cache now owns @buffer
+ */
+gboolean
+gst_vaapi_wl_buffer_cache_insert (GstVaapiWlBufferCache * cache,
+    GstMiniObject * surface, guint format, guint width, guint height,
+    gpointer buffer)
+{
+  CachedBuffer *entry;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (surface != NULL, FALSE);
+  g_return_val_if_fail (buffer != NULL, FALSE);
+
+  g_mutex_lock (&cache->lock);
+  if (g_hash_table_contains (cache->surfaces, surface)) {
+    g_mutex_unlock (&cache->lock);
+    return FALSE;
+  }
+
+  entry = g_slice_new (CachedBuffer);
+  entry->cache = cache;
+  entry->surface = surface;
+  entry->buffer = buffer;
+  entry->format = format;
+  entry->width = width;
+  entry->height = height;
+  entry->busy = TRUE;
+  gst_mini_object_weak_ref (surface, surface_finalized, entry);
+  g_hash_table_insert (cache->surfaces, surface, entry);
+  g_hash_table_insert (cache->buffers, buffer, entry);
+  g_mutex_unlock (&cache->lock);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_wl_buffer_cache_release:
+ * @cache: a #GstVaapiWlBufferCache
+ * @buffer: a buffer released by the compositor
+ *
+ * Makes @buffer available again, or destroys it if it was invalidated
+ * while it was busy.
+ *
+ * Return value: %TRUE if @buffer belongs to @cache, %FALSE if the
+ *   caller owns it
+ */
+gboolean
+gst_vaapi_wl_buffer_cache_release (GstVaapiWlBufferCache * cache,
+    gpointer buffer)
+{
+  CachedBuffer *entry;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+
+  g_mutex_lock (&cache->lock);
+  entry = g_hash_table_lookup (cache->buffers, buffer);
+  if (entry) {
+    entry->busy = FALSE;
+    if (!entry->surface)
+      destroy_entry (cache, entry);
+  }
+  g_mutex_unlock (&cache->lock);
+  return entry != NULL;
+}
+
+/**
+ * gst_vaapi_wl_buffer_cache_invalidate:
+ * @cache: a #GstVaapiWlBufferCache
+ *
+ * Invalidates all the buffers of @cache, e.g. because the window was
+ * resized.
+ */
+void
+gst_vaapi_wl_buffer_cache_invalidate (GstVaapiWlBufferCache * cache)
+{
+  GList *entries, *l;
+
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->lock);
+  entries = g_hash_table_get_values (cache->surfaces);
+  for (l = entries; l != NULL; l = l->next)
+    invalidate_entry (cache, l->data, TRUE);
+  g_list_free (entries);
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * gst_vaapi_wl_buffer_cache_get_stats:
+ * @cache: a #GstVaapiWlBufferCache
+ * @stats: return location for the statistics
+ *
+ * Gets the hit and miss counters of @cache.
+ */
+void
+gst_vaapi_wl_buffer_cache_get_stats (GstVaapiWlBufferCache * cache,
+    GstVaapiWlBufferCacheStats * stats)
+{
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&cache->lock);
+  *stats = cache->stats;
+  stats->num_cached = g_hash_table_size (cache->buffers);
+  g_mutex_unlock (&cache->lock);
+}
@@ -0,0 +1,83 @@
+/*
+ *  gstvaapiwlbuffercache.h - Wayland buffer cache for VA surfaces
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_WL_BUFFER_CACHE_H
+#define GST_VAAPI_WL_BUFFER_CACHE_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiWlBufferCache GstVaapiWlBufferCache;
+typedef struct _GstVaapiWlBufferCacheStats GstVaapiWlBufferCacheStats;
+
+/**
+ * GstVaapiWlBufferCacheStats:
+ * @num_hits: number of frames attached with a cached buffer
+ * @num_misses: number of frames which needed a new buffer
+ * @num_invalidations: number of cached buffers dropped because their
+ *   surface was destroyed, or the window size or format changed
+ * @num_cached: number of buffers currently held by the cache
+ *
+ * Statistics of a #GstVaapiWlBufferCache.
+ */
+struct _GstVaapiWlBufferCacheStats
+{
+  guint64 num_hits;
+  guint64 num_misses;
+  guint64 num_invalidations;
+  guint num_cached;
+};
+
+G_GNUC_INTERNAL
+GstVaapiWlBufferCache *
+gst_vaapi_wl_buffer_cache_new (GDestroyNotify destroy_buffer);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_wl_buffer_cache_free (GstVaapiWlBufferCache * cache);
+
+G_GNUC_INTERNAL
+gpointer
+gst_vaapi_wl_buffer_cache_acquire (GstVaapiWlBufferCache * cache,
+    GstMiniObject * surface, guint format, guint width, guint height);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_wl_buffer_cache_insert (GstVaapiWlBufferCache * cache,
+    GstMiniObject * surface, guint format, guint width, guint height,
+    gpointer buffer);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_wl_buffer_cache_release (GstVaapiWlBufferCache * cache,
+    gpointer buffer);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_wl_buffer_cache_invalidate (GstVaapiWlBufferCache * cache);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_wl_buffer_cache_get_stats (GstVaapiWlBufferCache * cache,
+    GstVaapiWlBufferCacheStats * stats);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_WL_BUFFER_CACHE_H */
@@ -0,0 +1,228 @@
+/*
+ *  gstvaapiworkerpool.c - Pool of threads running independent jobs
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiworkerpool
+ * @short_description: Pool of threads running independent jobs
+ *
+ * A thin layer over #GThreadPool that lets the owner wait for all
+ * the jobs pushed so far, e.g. all the slices of the current picture,
+ * and learn whether any of them failed. Jobs may complete in any
+ * order, so they must not depend on each other.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiworkerpool.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+struct _GstVaapiWorkerPool
+{
+  GThreadPool *threads;
+  guint num_threads;
+  GstVaapiWorkerFunc func;
+  GDestroyNotify job_free_func;
+  gpointer user_data;
+
+  GMutex lock;
+  GCond cond;
+  guint pending;
+  gboolean failed;
+
+  /* statistics */
+  guint64 num_jobs;
+  guint64 num_waits;
+  gint64 wait_time;
+};
+
+static void
+worker_func (gpointer job, gpointer data)
+{
+  GstVaapiWorkerPool *const pool = data;
+  gboolean success;
+
+  success = pool->func (job, pool->user_data);
+  if (pool->job_free_func)
+    pool->job_free_func (job);
+
+  g_mutex_lock (&pool->lock);
+  if (!success)
+    pool->failed = TRUE;
+  if (--pool->pending == 0)
+    g_cond_broadcast (&pool->cond);
+  g_mutex_unlock (&pool->lock);
+}
+
+/**
+ * gst_vaapi_worker_pool_new:
+ * @num_threads: the number of threads
+ * @func: the function running each job
+ * @job_free_func: (nullable): function to free a job once it has run
+ * @user_data: data passed to @func
+ *
+ * Creates a new pool of @num_threads threads.
+ *
+ * Return value: the newly allocated #GstVaapiWorkerPool, or %NULL if
+ *   the threads could not be created
+ */
+GstVaapiWorkerPool *
+gst_vaapi_worker_pool_new (guint num_threads, GstVaapiWorkerFunc func,
+    GDestroyNotify job_free_func, gpointer user_data)
+{
+  GstVaapiWorkerPool *pool;
+  GError *error = NULL;
+
+  g_return_val_if_fail (num_threads > 0, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  pool = g_new0 (GstVaapiWorkerPool, 1);
+  pool->num_threads = num_threads;
+  pool->func = func;
+  pool->job_free_func = job_free_func;
+  pool->user_data = user_data;
+  g_mutex_init (&pool->lock);
+  g_cond_init (&pool->cond);
+
+  pool->threads = g_thread_pool_new (worker_func, pool, num_threads, TRUE,
+      &error);
+  if (!pool->threads)
+    goto error_create_threads;
+  return pool;
+
+  /* ERRORS */
+error_create_threads:
+  {
+    GST_ERROR ("failed to create %u worker threads: %s", num_threads,
+        error ? error->message : "unknown error");
+    g_clear_error (&error);
+    g_mutex_clear (&pool->lock);
+    g_cond_clear (&pool->cond);
+    g_free (pool);
+    return NULL;
+  }
+}
+
+/**
+ * gst_vaapi_worker_pool_free:
+ * @pool: a #GstVaapiWorkerPool
+ *
+ * Waits for the pending jobs, then stops the threads and frees @pool.
+ */
+void
+gst_vaapi_worker_pool_free (GstVaapiWorkerPool * pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  g_thread_pool_free (pool->threads, FALSE, TRUE);
+
+  GST_INFO ("%u threads ran %" G_GUINT64_FORMAT " jobs, waited %"
+      G_GUINT64_FORMAT " times for %" G_GINT64_FORMAT " us", pool->num_threads,
+      pool->num_jobs, pool->num_waits, pool->wait_time);
+
+  g_mutex_clear (&pool->lock);
+  g_cond_clear (&pool->cond);
+  g_free (pool);
+}
+
+/**
+ * gst_vaapi_worker_pool_get_num_threads:
+ * @pool: a #GstVaapiWorkerPool
+ *
+ * Return value: the number of threads of @pool
+ */
+guint
+gst_vaapi_worker_pool_get_num_threads (GstVaapiWorkerPool * pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
+
+  return pool->num_threads;
+}
+
+/**
+ * gst_vaapi_worker_pool_push:
+ * @pool: a #GstVaapiWorkerPool
+ * @job: the job to run
+ *
+ * Queues @job for one of the threads. The pool takes ownership of
+ * @job, which is freed once it has run.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_worker_pool_push (GstVaapiWorkerPool * pool, gpointer job)
+{
+  GError *error = NULL;
+
+  g_return_val_if_fail (pool != NULL, FALSE);
+
+  g_mutex_lock (&pool->lock);
+  pool->pending++;
+  pool->num_jobs++;
+  g_mutex_unlock (&pool->lock);
+
+  if (!g_thread_pool_push (pool->threads, job, &error))
+    goto error_push;
+  return TRUE;
+
+  /* ERRORS */
+error_push:
+  {
+    GST_ERROR ("failed to queue job: %s", error->message);
+    g_clear_error (&error);
+    if (pool->job_free_func)
+      pool->job_free_func (job);
+
+    g_mutex_lock (&pool->lock);
+    if (--pool->pending == 0)
+      g_cond_broadcast (&pool->cond);
+    g_mutex_unlock (&pool->lock);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_worker_pool_wait:
+ * @pool: a #GstVaapiWorkerPool
+ *
+ * Blocks until all the jobs pushed so far have run.
+ *
+ * Return value: %FALSE if any of those jobs failed, %TRUE otherwise
+ */
+gboolean
+gst_vaapi_worker_pool_wait (GstVaapiWorkerPool * pool)
+{
+  gboolean success;
+  gint64 start;
+
+  g_return_val_if_fail (pool != NULL, FALSE);
+
+  g_mutex_lock (&pool->lock);
+  if (pool->pending > 0) {
+    start = g_get_monotonic_time ();
+    while (pool->pending > 0)
+      g_cond_wait (&pool->cond, &pool->lock);
+    pool->wait_time += g_get_monotonic_time () - start;
+    pool->num_waits++;
+  }
+  success = !pool->failed;
+  pool->failed = FALSE;
+  g_mutex_unlock (&pool->lock);
+  return success;
+}
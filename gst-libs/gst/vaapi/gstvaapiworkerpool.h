@@ -0,0 +1,63 @@
+/*
+ *  gstvaapiworkerpool.h - Pool of threads running independent jobs
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_WORKER_POOL_H
+#define GST_VAAPI_WORKER_POOL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiWorkerPool GstVaapiWorkerPool;
+
+/**
+ * GstVaapiWorkerFunc:
+ * @job: the job pushed with gst_vaapi_worker_pool_push()
+ * @user_data: the data passed to gst_vaapi_worker_pool_new()
+ *
+ * Runs @job in one of the pool threads.
+ *
+ * Return value: %TRUE on success
+ */
+typedef gboolean (*GstVaapiWorkerFunc) (gpointer job, gpointer user_data);
+
+G_GNUC_INTERNAL
+GstVaapiWorkerPool *
+gst_vaapi_worker_pool_new (guint num_threads, GstVaapiWorkerFunc func,
+    GDestroyNotify job_free_func, gpointer user_data);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_worker_pool_free (GstVaapiWorkerPool * pool);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_worker_pool_get_num_threads (GstVaapiWorkerPool * pool);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_worker_pool_push (GstVaapiWorkerPool * pool, gpointer job);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_worker_pool_wait (GstVaapiWorkerPool * pool);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_WORKER_POOL_H */
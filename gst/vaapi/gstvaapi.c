@@ -26,6 +26,7 @@
 #include "gstvaapidecode.h"
 #include "gstvaapioverlay.h"
 #include "gstvaapipostproc.h"
+#include "gstvaapiscaleladder.h"
 #include "gstvaapisink.h"
 #include "gstvaapidecodebin.h"
 
@@ -203,8 +204,10 @@ plugin_init (GstPlugin * plugin)
     g_array_unref (decoders);
   }
 
-  if (_gst_vaapi_has_video_processing)
+  if (_gst_vaapi_has_video_processing) {
     gst_vaapioverlay_register (plugin, display);
+    gst_vaapiscaleladder_register (plugin, display);
+  }
 
   gst_element_register (plugin, "vaapipostproc",
       GST_RANK_PRIMARY, GST_TYPE_VAAPIPOSTPROC);
@@ -318,6 +318,72 @@ gst_vaapidecode_get_allowed_srcpad_caps (GstVaapiDecode * decode)
   return gst_pad_get_pad_template_caps (srcpad);
 }
 
+/* Looks for a fixed size, and optionally format, which downstream
+   asks for and which differs from the decoded frames */
+static gboolean
+gst_vaapidecode_get_processing_target (GstVaapiDecode * decode,
+    GstVideoInfo * vinfo)
+{
+  GstPad *const srcpad = GST_VIDEO_DECODER_SRC_PAD (decode);
+  GstVideoCodecState *const ref_state = decode->input_state;
+  GstVideoFormat format;
+  GstStructure *structure;
+  GstCaps *peer_caps;
+  const gchar *format_str;
+  gint width, height;
+  gboolean ret = FALSE;
+
+  if (!decode->vpp_in_decode || !ref_state)
+    return FALSE;
+
+  peer_caps = gst_pad_peer_query_caps (srcpad, NULL);
+  if (!peer_caps)
+    return FALSE;
+  if (gst_caps_is_any (peer_caps) || gst_caps_is_empty (peer_caps))
+    goto bail;
+
+  structure = gst_caps_get_structure (peer_caps, 0);
+  if (!gst_structure_get_int (structure, "width", &width)
+      || !gst_structure_get_int (structure, "height", &height))
+    goto bail;
+
+  format_str = gst_structure_get_string (structure, "format");
+  if (format_str)
+    format = gst_video_format_from_string (format_str);
+  else
+    format = GST_VIDEO_INFO_FORMAT (&decode->decoded_info);
+  if (format == GST_VIDEO_FORMAT_UNKNOWN)
+    format = GST_VIDEO_FORMAT_NV12;
+
+  if (!format_str && width == GST_VIDEO_INFO_WIDTH (&ref_state->info)
+      && height == GST_VIDEO_INFO_HEIGHT (&ref_state->info))
+    goto bail;
+
+  gst_video_info_set_format (vinfo, format, width, height);
+  ret = TRUE;
+
+bail:
+  gst_caps_unref (peer_caps);
+  return ret;
+}
+
+static void
+gst_vaapidecode_update_processing (GstVaapiDecode * decode)
+{
+  GstVideoInfo vinfo;
+
+  if (!gst_vaapidecode_get_processing_target (decode, &vinfo)) {
+    gst_vaapi_decoder_set_processing_target (decode->decoder, NULL);
+    return;
+  }
+
+  GST_INFO_OBJECT (decode, "decode to %ux%u %s",
+      GST_VIDEO_INFO_WIDTH (&vinfo), GST_VIDEO_INFO_HEIGHT (&vinfo),
+      gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&vinfo)));
+  if (!gst_vaapi_decoder_set_processing_target (decode->decoder, &vinfo))
+    GST_WARNING_OBJECT (decode, "failed to allocate the processed surfaces");
+}
+
 static gboolean
 gst_vaapidecode_update_src_caps (GstVaapiDecode * decode)
 {
@@ -348,6 +414,15 @@ gst_vaapidecode_update_src_caps (GstVaapiDecode * decode)
   if (feature == GST_VAAPI_CAPS_FEATURE_NOT_NEGOTIATED)
     return FALSE;
 
+  /* Applies to the surfaces allocated from now on, e.g. after a
+     resolution change */
+  gst_vaapi_decoder_set_surface_alloc_flags (decode->decoder,
+      gst_vaapi_caps_feature_get_surface_alloc_flags (feature));
+
+  /* Likewise for the video processing target, while the caps below
+     follow the frame being pushed, which may have been decoded before */
+  gst_vaapidecode_update_processing (decode);
+
 #if (!USE_GLX && !USE_EGL)
   /* This is a very pathological situation. Should not happen. */
   if (feature == GST_VAAPI_CAPS_FEATURE_GL_TEXTURE_UPLOAD_META)
@@ -485,6 +560,28 @@ is_surface_resolution_changed (GstVaapiDecode * decode,
   return TRUE;
 }
 
+/* check whether the frame was scaled or converted while decoded,
+ * unlike the previous one */
+static gboolean
+is_decode_processing_changed (GstVaapiDecode * decode,
+    GstVaapiSurfaceProxy * proxy)
+{
+  const gboolean processed = (gst_vaapi_surface_proxy_get_flags (proxy) &
+      GST_VAAPI_SURFACE_PROXY_FLAG_PROCESSED) != 0;
+
+  if (decode->vpp_in_decode_active == processed)
+    return FALSE;
+
+  GST_INFO_OBJECT (decode, "%s video processing within decoding",
+      processed ? "using" : "not using");
+  decode->vpp_in_decode_active = processed;
+  g_object_notify (G_OBJECT (decode), "vpp-in-decode-active");
+
+  /* the surface format is detected again from this frame */
+  gst_video_info_init (&decode->decoded_info);
+  return TRUE;
+}
+
 /* check whether display resolution changed */
 static gboolean
 is_display_resolution_changed (GstVaapiDecode * decode,
@@ -589,7 +686,8 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
      * we received notification from libgstvaapi, the frame we are going to
      * be pushed at this point might not have the notified resolution if there
      * are queued frames in decoded picture buffer. */
-    alloc_renegotiate = is_surface_resolution_changed (decode, surface);
+    alloc_renegotiate = is_decode_processing_changed (decode, proxy);
+    alloc_renegotiate |= is_surface_resolution_changed (decode, surface);
     caps_renegotiate = is_display_resolution_changed (decode, crop_rect);
 
     if (gst_pad_needs_reconfigure (GST_VIDEO_DECODER_SRC_PAD (vdec))
@@ -759,6 +857,18 @@ gst_vaapidecode_handle_frame (GstVideoDecoder * vdec,
   if (!decode->input_state)
     goto not_negotiated;
 
+  gst_vaapi_trace_set_frame (frame->system_frame_number);
+
+  /* Submit current frame. It is always output, as dropped if it failed
+     to decode, and the error may be the one of an earlier frame */
+  if (decode->pipelined) {
+    status = gst_vaapi_decoder_submit (decode->decoder, frame);
+    frame = NULL;
+    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+      goto error_decode;
+    return gst_vaapidecode_push_all_decoded_frames (decode);
+  }
+
   /* Decode current frame */
   for (;;) {
     status = gst_vaapi_decoder_decode (decode->decoder, frame);
@@ -794,7 +904,10 @@ error_decode:
                 FALSE, 0));
         break;
     }
-    gst_video_decoder_drop_frame (vdec, frame);
+    if (frame)
+      gst_video_decoder_drop_frame (vdec, frame);
+    else if (ret == GST_FLOW_OK)
+      ret = gst_vaapidecode_push_all_decoded_frames (decode);
     return ret;
   }
 not_negotiated:
@@ -820,6 +933,8 @@ static GstFlowReturn
 gst_vaapidecode_drain (GstVideoDecoder * vdec)
 {
   GstVaapiDecode *const decode = GST_VAAPIDECODE (vdec);
+  GstVaapiDecoderStatus status;
+  GstFlowReturn ret = GST_FLOW_OK;
 
   if (!decode->decoder)
     return GST_FLOW_NOT_NEGOTIATED;
@@ -827,6 +942,17 @@ gst_vaapidecode_drain (GstVideoDecoder * vdec)
   GST_LOG_OBJECT (decode, "drain");
 
   gst_vaapidecode_flush_output_adapter (decode);
+
+  /* The frames which failed to decode in pipelined mode were already
+     output as dropped, only the error is left to report */
+  status = gst_vaapi_decoder_wait_submitted (decode->decoder);
+  if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
+    GST_WARNING_OBJECT (decode, "decode error %d", status);
+    GST_VIDEO_DECODER_ERROR (vdec, 1, STREAM, DECODE, ("Decoding error"),
+        ("Decode error %d", status), ret);
+    if (ret != GST_FLOW_OK)
+      return ret;
+  }
   return gst_vaapidecode_push_all_decoded_frames (decode);
 }
 
@@ -892,9 +1018,24 @@ gst_vaapidecode_ensure_display (GstVaapiDecode * decode)
   return gst_vaapi_plugin_base_ensure_display (GST_VAAPI_PLUGIN_BASE (decode));
 }
 
+/* Number of threads filling in H.264 and H.265 slice parameters, off
+   by default. Only worth it for streams with many slices per picture */
+static guint
+gst_vaapidecode_get_slice_threads (void)
+{
+  const gchar *const str = g_getenv ("GST_VAAPI_DECODER_SLICE_THREADS");
+
+  if (!str)
+    return 0;
+  return MIN (g_ascii_strtoull (str, NULL, 10), g_get_num_processors ());
+}
+
 static gboolean
 gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
 {
+  GstPad *const srcpad = GST_VIDEO_DECODER_SRC_PAD (decode);
+  GstVaapiCapsFeature feature;
+  GstCaps *templ;
   GstVaapiDisplay *dpy;
 
   if (!gst_vaapidecode_ensure_display (decode))
@@ -911,6 +1052,10 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
       break;
     case GST_VAAPI_CODEC_H264:
       decode->decoder = gst_vaapi_decoder_h264_new (dpy, caps);
+      if (decode->decoder) {
+        gst_vaapi_decoder_h264_set_slice_threads (GST_VAAPI_DECODER_H264
+            (decode->decoder), gst_vaapidecode_get_slice_threads ());
+      }
 
       /* Set the stream buffer alignment for better optimizations */
       if (decode->decoder && caps) {
@@ -944,6 +1089,10 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
       break;
     case GST_VAAPI_CODEC_H265:
       decode->decoder = gst_vaapi_decoder_h265_new (dpy, caps);
+      if (decode->decoder) {
+        gst_vaapi_decoder_h265_set_slice_threads (GST_VAAPI_DECODER_H265
+            (decode->decoder), gst_vaapidecode_get_slice_threads ());
+      }
 
       /* Set the stream buffer alignment for better optimizations */
       if (decode->decoder && caps) {
@@ -986,6 +1135,32 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
   if (!decode->decoder)
     return FALSE;
 
+  /* The first surfaces are allocated before the source caps are
+     negotiated, so check right away whether they only go to VA
+     elements */
+  templ = gst_pad_get_pad_template_caps (srcpad);
+  feature = gst_vaapi_find_preferred_caps_feature (srcpad, templ, NULL);
+  gst_caps_unref (templ);
+  gst_vaapi_decoder_set_surface_alloc_flags (decode->decoder,
+      gst_vaapi_caps_feature_get_surface_alloc_flags (feature));
+
+  /* The decoding context only gets video processing support when it
+     is configured, so request it before the first frame */
+  gst_vaapi_decoder_set_processing (decode->decoder, decode->vpp_in_decode);
+  gst_vaapidecode_update_processing (decode);
+
+  /* Only the H.264 and H.265 parsers can run ahead of decoding */
+  if (decode->pipelined) {
+    switch (gst_vaapi_decoder_get_codec (decode->decoder)) {
+      case GST_VAAPI_CODEC_H264:
+      case GST_VAAPI_CODEC_H265:
+        gst_vaapi_decoder_set_pipelined (decode->decoder, TRUE);
+        break;
+      default:
+        break;
+    }
+  }
+
   gst_vaapi_decoder_set_codec_state_changed_func (decode->decoder,
       gst_vaapi_decoder_state_changed, decode);
 
@@ -1068,6 +1243,7 @@ gst_vaapidecode_open (GstVideoDecoder * vdec)
 
   decode->display_width = 0;
   decode->display_height = 0;
+  decode->vpp_in_decode_active = FALSE;
   gst_video_info_init (&decode->decoded_info);
 
   return TRUE;
@@ -1168,6 +1344,7 @@ gst_vaapidecode_parse_frame (GstVideoDecoder * vdec,
   guint got_unit_size;
   gboolean got_frame;
 
+  gst_vaapi_trace_set_frame (frame->system_frame_number);
   status = gst_vaapi_decoder_parse (decode->decoder, frame,
       adapter, at_eos, &got_unit_size, &got_frame);
 
@@ -1544,6 +1721,7 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   g_free (longname);
   g_free (description);
 
+  gst_vaapi_decode_install_properties (object_class);
   if (map->install_properties)
     map->install_properties (object_class);
 
@@ -54,6 +54,10 @@ struct _GstVaapiDecode {
     GstVideoCodecState *input_state;
 
     gboolean            do_renego;
+
+    gboolean            vpp_in_decode;
+    gboolean            vpp_in_decode_active;
+    gboolean            pipelined;
 };
 
 struct _GstVaapiDecodeClass {
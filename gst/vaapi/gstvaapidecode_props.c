@@ -28,12 +28,92 @@
 
 enum
 {
-  GST_VAAPI_DECODER_H264_PROP_FORCE_LOW_LATENCY = 1,
+  GST_VAAPI_DECODE_PROP_VPP_IN_DECODE = 1,
+  GST_VAAPI_DECODE_PROP_VPP_IN_DECODE_ACTIVE,
+  GST_VAAPI_DECODE_PROP_PIPELINED,
+
+  GST_VAAPI_DECODE_N_PROPERTIES
+};
+
+enum
+{
+  GST_VAAPI_DECODER_H264_PROP_FORCE_LOW_LATENCY =
+      GST_VAAPI_DECODE_N_PROPERTIES,
   GST_VAAPI_DECODER_H264_PROP_BASE_ONLY,
 };
 
 static gint h264_private_offset;
 
+static void
+gst_vaapi_decode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case GST_VAAPI_DECODE_PROP_VPP_IN_DECODE:
+      g_value_set_boolean (value, decode->vpp_in_decode);
+      break;
+    case GST_VAAPI_DECODE_PROP_VPP_IN_DECODE_ACTIVE:
+      g_value_set_boolean (value, decode->vpp_in_decode_active);
+      break;
+    case GST_VAAPI_DECODE_PROP_PIPELINED:
+      g_value_set_boolean (value, decode->pipelined);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_decode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case GST_VAAPI_DECODE_PROP_VPP_IN_DECODE:
+      decode->vpp_in_decode = g_value_get_boolean (value);
+      break;
+    case GST_VAAPI_DECODE_PROP_PIPELINED:
+      decode->pipelined = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vaapi_decode_install_properties (GObjectClass * klass)
+{
+  klass->get_property = gst_vaapi_decode_get_property;
+  klass->set_property = gst_vaapi_decode_set_property;
+
+  g_object_class_install_property (klass, GST_VAAPI_DECODE_PROP_VPP_IN_DECODE,
+      g_param_spec_boolean ("vpp-in-decode",
+          "Video processing within decoding",
+          "When downstream asks for another size or format, scale and "
+          "convert the frames while they are decoded, if the driver can",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (klass,
+      GST_VAAPI_DECODE_PROP_VPP_IN_DECODE_ACTIVE,
+      g_param_spec_boolean ("vpp-in-decode-active",
+          "Video processing within decoding is active",
+          "Whether the last output frame was scaled or converted while "
+          "it was decoded", FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (klass, GST_VAAPI_DECODE_PROP_PIPELINED,
+      g_param_spec_boolean ("pipelined",
+          "Pipelined decoding",
+          "Submit the frames to the hardware from a separate thread, while "
+          "the next ones are parsed (H.264 and H.265 only). Applies from "
+          "the next stream start", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
 static void
 gst_vaapi_decode_h264_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
@@ -50,7 +130,7 @@ gst_vaapi_decode_h264_get_property (GObject * object, guint prop_id,
       g_value_set_boolean (value, priv->base_only);
       break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      gst_vaapi_decode_get_property (object, prop_id, value, pspec);
       break;
   }
 }
@@ -78,7 +158,7 @@ gst_vaapi_decode_h264_set_property (GObject * object, guint prop_id,
         gst_vaapi_decoder_h264_set_base_only (decoder, priv->base_only);
       break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      gst_vaapi_decode_set_property (object, prop_id, value, pspec);
       break;
   }
 }
@@ -36,6 +36,9 @@ struct _GstVaapiDecodeH264Private
   gboolean base_only;
 };
 
+void
+gst_vaapi_decode_install_properties (GObjectClass * klass);
+
 void
 gst_vaapi_decode_h264_install_properties (GObjectClass * klass);
 
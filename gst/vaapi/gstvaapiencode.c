@@ -184,7 +184,10 @@ gst_vaapiencode_default_alloc_buffer (GstVaapiEncode * encode,
       buf_size);
   if (!buf)
     goto error_create_buffer;
-  if (!gst_vaapi_coded_buffer_copy_into (buf, coded_buf))
+  if (encode->need_nal_length_prefix) {
+    if (!gst_vaapi_coded_buffer_copy_nal_units_into (buf, coded_buf))
+      goto error_convert_buffer;
+  } else if (!gst_vaapi_coded_buffer_copy_into (buf, coded_buf))
     goto error_copy_buffer;
 
   *outbuf_ptr = buf;
@@ -207,6 +210,33 @@ error_copy_buffer:
     gst_buffer_unref (buf);
     return GST_VAAPI_ENCODE_FLOW_MEM_ERROR;
   }
+error_convert_buffer:
+  {
+    GST_ERROR ("failed to convert from byte-stream format to length-prefixed"
+        " NAL units");
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* Checks whether the coded data can be handed over to downstream in
+   read-only system memory, rather than copied into its own memory */
+static gboolean
+can_wrap_coded_buffer (GstVaapiEncode * encode)
+{
+  GstAllocator *allocator = NULL;
+  gboolean ret;
+
+  if (encode->need_nal_length_prefix)
+    return FALSE;
+
+  gst_video_encoder_get_allocator (GST_VIDEO_ENCODER_CAST (encode),
+      &allocator, NULL);
+  ret = !allocator
+      || g_strcmp0 (allocator->mem_type, GST_ALLOCATOR_SYSMEM) == 0;
+  if (allocator)
+    gst_object_unref (allocator);
+  return ret;
 }
 
 static gboolean
@@ -273,10 +303,17 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
     goto error_output_state;
   GST_VIDEO_ENCODER_STREAM_UNLOCK (encode);
 
-  /* Allocate and copy buffer into system memory */
+  /* Hand the coded buffer over to downstream if possible, otherwise
+     allocate and copy buffer into system memory */
   out_buffer = NULL;
-  ret = klass->alloc_buffer (encode,
-      GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy), &out_buffer);
+  if (can_wrap_coded_buffer (encode))
+    out_buffer = gst_vaapi_encoder_wrap_coded_buffer (encode->encoder,
+        codedbuf_proxy);
+  if (out_buffer)
+    ret = GST_FLOW_OK;
+  else
+    ret = klass->alloc_buffer (encode,
+        GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy), &out_buffer);
 
   gst_vaapi_coded_buffer_proxy_replace (&codedbuf_proxy, NULL);
   if (ret != GST_FLOW_OK)
@@ -642,6 +679,8 @@ gst_vaapiencode_handle_frame (GstVideoEncoder * venc,
             (GstTaskFunction) gst_vaapiencode_buffer_loop, encode, NULL))
       goto error_task_failed;
 
+  gst_vaapi_trace_set_frame (frame->system_frame_number);
+
   buf = NULL;
   ret = gst_vaapi_plugin_base_get_input_buffer (GST_VAAPI_PLUGIN_BASE (encode),
       frame->input_buffer, &buf);
@@ -766,9 +805,25 @@ static gboolean
 gst_vaapiencode_propose_allocation (GstVideoEncoder * venc, GstQuery * query)
 {
   GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (venc);
+  GstVaapiEncode *const encode = GST_VAAPIENCODE_CAST (venc);
+  GstBufferPool *pool;
+  guint depth, size, min, max;
 
   if (!gst_vaapi_plugin_base_propose_allocation (plugin, query))
     return FALSE;
+
+  /* The input buffers stay in the look-ahead window until encoded */
+  depth = encode->encoder ?
+      gst_vaapi_encoder_get_lookahead_depth (encode->encoder) : 0;
+  if (depth > 0 && gst_query_get_n_allocation_pools (query) > 0) {
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+    min += depth;
+    if (max > 0)
+      max = MAX (max, min);
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+    if (pool)
+      gst_object_unref (pool);
+  }
   return TRUE;
 }
 
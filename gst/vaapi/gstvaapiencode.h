@@ -171,6 +171,10 @@ struct _GstVaapiEncode
   gboolean input_state_changed;
   /* needs to be set by the subclass implementation */
   gboolean need_codec_data;
+  /* set by the subclass implementation when the NAL units are output
+     prefixed with their size rather than with a start code (avc, hvc1),
+     which needs a copy of the coded data */
+  gboolean need_nal_length_prefix;
   GstVideoCodecState *output_state;
   GPtrArray *prop_values;
   GstCaps *allowed_sinkpad_caps;
@@ -193,6 +193,7 @@ gst_vaapiencode_h265_get_caps (GstVaapiEncode * base_encode)
       encode->is_hvc ? "hvc1" : "byte-stream", NULL);
 
   base_encode->need_codec_data = encode->is_hvc;
+  base_encode->need_nal_length_prefix = encode->is_hvc;
 
   gst_vaapi_encoder_h265_get_profile_tier_level (encoder,
       &profile, &tier, &level);
@@ -220,135 +221,6 @@ gst_vaapiencode_h265_alloc_encoder (GstVaapiEncode * base,
   return gst_vaapi_encoder_h265_new (display);
 }
 
-/* h265 NAL byte stream operations */
-static guint8 *
-_h265_byte_stream_next_nal (guint8 * buffer, guint32 len, guint32 * nal_size)
-{
-  const guint8 *cur = buffer;
-  const guint8 *const end = buffer + len;
-  guint8 *nal_start = NULL;
-  guint32 flag = 0xFFFFFFFF;
-  guint32 nal_start_len = 0;
-
-  g_assert (len != 0U && buffer && nal_size);
-  if (len < 3) {
-    *nal_size = len;
-    nal_start = (len ? buffer : NULL);
-    return nal_start;
-  }
-
-  /*locate head postion */
-  if (!buffer[0] && !buffer[1]) {
-    if (buffer[2] == 1) {       /* 0x000001 */
-      nal_start_len = 3;
-    } else if (!buffer[2] && len >= 4 && buffer[3] == 1) {      /* 0x00000001 */
-      nal_start_len = 4;
-    }
-  }
-  nal_start = buffer + nal_start_len;
-  cur = nal_start;
-
-  /*find next nal start position */
-  while (cur < end) {
-    flag = ((flag << 8) | ((*cur++) & 0xFF));
-    if ((flag & 0x00FFFFFF) == 0x00000001) {
-      if (flag == 0x00000001)
-        *nal_size = cur - 4 - nal_start;
-      else
-        *nal_size = cur - 3 - nal_start;
-      break;
-    }
-  }
-  if (cur >= end) {
-    *nal_size = end - nal_start;
-    if (nal_start >= end) {
-      nal_start = NULL;
-    }
-  }
-  return nal_start;
-}
-
-static inline void
-_start_code_to_size (guint8 nal_start_code[4], guint32 nal_size)
-{
-  nal_start_code[0] = ((nal_size >> 24) & 0xFF);
-  nal_start_code[1] = ((nal_size >> 16) & 0xFF);
-  nal_start_code[2] = ((nal_size >> 8) & 0xFF);
-  nal_start_code[3] = (nal_size & 0xFF);
-}
-
-static gboolean
-_h265_convert_byte_stream_to_hvc (GstBuffer * buf)
-{
-  GstMapInfo info;
-  guint32 nal_size;
-  guint8 *nal_start_code, *nal_body;
-  guint8 *frame_end;
-
-  g_assert (buf);
-
-  if (!gst_buffer_map (buf, &info, GST_MAP_READ | GST_MAP_WRITE))
-    return FALSE;
-
-  nal_start_code = info.data;
-  frame_end = info.data + info.size;
-  nal_size = 0;
-
-  while ((frame_end > nal_start_code) &&
-      (nal_body = _h265_byte_stream_next_nal (nal_start_code,
-              frame_end - nal_start_code, &nal_size)) != NULL) {
-    if (!nal_size)
-      goto error;
-
-    g_assert (nal_body - nal_start_code == 4);
-    _start_code_to_size (nal_start_code, nal_size);
-    nal_start_code = nal_body + nal_size;
-  }
-  gst_buffer_unmap (buf, &info);
-  return TRUE;
-
-  /* ERRORS */
-error:
-  {
-    gst_buffer_unmap (buf, &info);
-    return FALSE;
-  }
-}
-
-static GstFlowReturn
-gst_vaapiencode_h265_alloc_buffer (GstVaapiEncode * base_encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** out_buffer_ptr)
-{
-  GstVaapiEncodeH265 *const encode = GST_VAAPIENCODE_H265_CAST (base_encode);
-  GstVaapiEncoderH265 *const encoder =
-      GST_VAAPI_ENCODER_H265 (base_encode->encoder);
-  GstFlowReturn ret;
-
-  g_return_val_if_fail (encoder != NULL, GST_FLOW_ERROR);
-
-  ret =
-      GST_VAAPIENCODE_CLASS (gst_vaapiencode_h265_parent_class)->alloc_buffer
-      (base_encode, coded_buf, out_buffer_ptr);
-  if (ret != GST_FLOW_OK)
-    return ret;
-
-  if (!encode->is_hvc)
-    return GST_FLOW_OK;
-
-  /* Convert to hvcC format */
-  if (!_h265_convert_byte_stream_to_hvc (*out_buffer_ptr))
-    goto error_convert_buffer;
-  return GST_FLOW_OK;
-
-  /* ERRORS */
-error_convert_buffer:
-  {
-    GST_ERROR ("failed to convert from bytestream format to hvcC format");
-    gst_buffer_replace (out_buffer_ptr, NULL);
-    return GST_FLOW_ERROR;
-  }
-}
-
 static void
 gst_vaapiencode_h265_class_init (GstVaapiEncodeH265Class * klass, gpointer data)
 {
@@ -370,7 +242,6 @@ gst_vaapiencode_h265_class_init (GstVaapiEncodeH265Class * klass, gpointer data)
   encode_class->set_config = gst_vaapiencode_h265_set_config;
   encode_class->get_caps = gst_vaapiencode_h265_get_caps;
   encode_class->alloc_encoder = gst_vaapiencode_h265_alloc_encoder;
-  encode_class->alloc_buffer = gst_vaapiencode_h265_alloc_buffer;
 
   gst_element_class_set_static_metadata (element_class,
       "VA-API H265 encoder",
@@ -40,6 +40,10 @@ GST_DEBUG_CATEGORY_STATIC (CAT_PERFORMANCE);
 
 #define BUFFER_POOL_SINK_MIN_BUFFERS 2
 
+/* Number of imported DMABufs kept per sink pad, more than upstream
+ * pools usually allocate */
+#define DMABUF_IMPORT_CACHE_SIZE 32
+
 #define GST_VAAPI_PAD_PRIVATE(pad) \
   (GST_VAAPI_PLUGIN_BASE_GET_CLASS(plugin)->get_vaapi_pad_private(plugin, pad))
 
@@ -68,6 +72,9 @@ gst_vaapi_pad_private_reset (GstVaapiPadPrivate * priv)
   priv->caps_is_raw = FALSE;
 
   g_clear_object (&priv->other_allocator);
+
+  g_clear_pointer (&priv->dmabuf_import_cache,
+      gst_vaapi_dmabuf_import_cache_free);
 }
 
 void
@@ -143,19 +150,41 @@ default_display_changed (GstVaapiPluginBase * plugin)
 {
 }
 
+/* Gets the VA surface imported from the buffer object @fd refers to,
+ * whatever buffer wraps it, and imports it otherwise */
 static GstVaapiSurface *
-_get_cached_surface (GstBuffer * buf)
+plugin_import_dma_buf (GstVaapiPluginBase * plugin,
+    GstVaapiPadPrivate * sinkpriv, gint fd)
 {
-  return gst_mini_object_get_qdata (GST_MINI_OBJECT (buf),
-      g_quark_from_static_string ("GstVaapiDMABufSurface"));
-}
+  const GstVideoInfo *const vip = &sinkpriv->info;
+  GstVaapiDmaBufImportKey key;
+  GstVaapiSurface *surface = NULL;
+  gboolean has_key;
+
+  has_key = gst_vaapi_dmabuf_import_key_init (&key, fd, vip);
+  if (has_key) {
+    if (!sinkpriv->dmabuf_import_cache)
+      sinkpriv->dmabuf_import_cache =
+          gst_vaapi_dmabuf_import_cache_new (DMABUF_IMPORT_CACHE_SIZE);
+    surface = (GstVaapiSurface *)
+        gst_vaapi_dmabuf_import_cache_lookup (sinkpriv->dmabuf_import_cache,
+        &key);
+    /* The surfaces belong to the previous display */
+    if (surface && GST_VAAPI_SURFACE_DISPLAY (surface) != plugin->display) {
+      gst_vaapi_surface_unref (surface);
+      gst_vaapi_dmabuf_import_cache_clear (sinkpriv->dmabuf_import_cache);
+      surface = NULL;
+    }
+    if (surface)
+      return surface;
+  }
 
-static void
-_set_cached_surface (GstBuffer * buf, GstVaapiSurface * surface)
-{
-  return gst_mini_object_set_qdata (GST_MINI_OBJECT (buf),
-      g_quark_from_static_string ("GstVaapiDMABufSurface"), surface,
-      (GDestroyNotify) gst_vaapi_surface_unref);
+  surface = gst_vaapi_surface_new_with_dma_buf_handle (plugin->display, fd,
+      vip);
+  if (surface && has_key)
+    gst_vaapi_dmabuf_import_cache_insert (sinkpriv->dmabuf_import_cache, &key,
+        GST_MINI_OBJECT_CAST (surface));
+  return surface;
 }
 
 static gboolean
@@ -199,6 +228,27 @@ is_dma_buffer (GstBuffer * buf)
   return TRUE;
 }
 
+/* Gets the VA surface @mem was exported from, when a VA-API element
+ * on the same VA display exported it with the same layout, so that it
+ * is used directly rather than imported again */
+static GstVaapiSurface *
+plugin_get_exported_surface (GstVaapiPluginBase * plugin, GstMemory * mem,
+    const GstVideoInfo * vip)
+{
+  GstVaapiSurface *const surface = gst_vaapi_dmabuf_memory_peek_surface (mem);
+
+  if (!surface)
+    return NULL;
+  if (gst_vaapi_display_get_display (GST_VAAPI_SURFACE_DISPLAY (surface)) !=
+      gst_vaapi_display_get_display (plugin->display))
+    return NULL;
+  if (gst_vaapi_surface_get_format (surface) != GST_VIDEO_INFO_FORMAT (vip) ||
+      gst_vaapi_surface_get_width (surface) != GST_VIDEO_INFO_WIDTH (vip) ||
+      gst_vaapi_surface_get_height (surface) != GST_VIDEO_INFO_HEIGHT (vip))
+    return NULL;
+  return surface;
+}
+
 static gboolean
 plugin_bind_dma_to_vaapi_buffer (GstVaapiPluginBase * plugin, GstPad * sinkpad,
     GstBuffer * inbuf, GstBuffer * outbuf)
@@ -220,18 +270,21 @@ plugin_bind_dma_to_vaapi_buffer (GstVaapiPluginBase * plugin, GstPad * sinkpad,
   meta = gst_buffer_get_vaapi_video_meta (outbuf);
   g_return_val_if_fail (meta != NULL, FALSE);
 
-  /* Check for a VASurface cached in the buffer */
-  surface = _get_cached_surface (inbuf);
-  if (!surface) {
-    /* otherwise create one and cache it */
-    surface =
-        gst_vaapi_surface_new_with_dma_buf_handle (plugin->display, fd, vip);
+  /* Check for a VASurface exported upstream, or imported already */
+  surface = plugin_get_exported_surface (plugin,
+      gst_buffer_peek_memory (inbuf, 0), vip);
+  if (surface) {
+    GST_LOG_OBJECT (plugin, "use exported surface %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (gst_vaapi_surface_get_id (surface)));
+    gst_vaapi_surface_ref (surface);
+  } else {
+    surface = plugin_import_dma_buf (plugin, sinkpriv, fd);
     if (!surface)
       goto error_create_surface;
-    _set_cached_surface (inbuf, surface);
   }
 
   proxy = gst_vaapi_surface_proxy_new (surface);
+  gst_vaapi_surface_unref (surface);
   if (!proxy)
     goto error_create_proxy;
   gst_vaapi_video_meta_set_surface_proxy (meta, proxy);
@@ -308,6 +361,8 @@ gst_vaapi_plugin_base_init (GstVaapiPluginBase * plugin,
 
   plugin->enable_direct_rendering =
       (g_getenv ("GST_VAAPI_ENABLE_DIRECT_RENDERING") != NULL);
+  plugin->enable_readback_shadow =
+      (g_getenv ("GST_VAAPI_ENABLE_READBACK_SHADOW") != NULL);
 }
 
 void
@@ -603,14 +658,26 @@ ensure_srcpad_allocator (GstVaapiPluginBase * plugin, GstPad * srcpad,
   if (!srcpriv->allocator) {
     GstVaapiImageUsageFlags usage_flag =
         GST_VAAPI_IMAGE_USAGE_FLAG_NATIVE_FORMATS;
+    guint surface_alloc_flags = 0;
 
     if (plugin->enable_direct_rendering) {
       usage_flag = GST_VAAPI_IMAGE_USAGE_FLAG_DIRECT_RENDER;
       GST_INFO_OBJECT (plugin, "enabling direct rendering in source allocator");
+    } else if (caps && !plugin->enable_readback_shadow
+        && gst_vaapi_caps_feature_contains (caps,
+            GST_VAAPI_CAPS_FEATURE_VAAPI_SURFACE)) {
+      /* Not mapped here, and only VA elements downstream */
+      surface_alloc_flags = gst_vaapi_caps_feature_get_surface_alloc_flags
+          (GST_VAAPI_CAPS_FEATURE_VAAPI_SURFACE);
     }
 
-    srcpriv->allocator =
-        gst_vaapi_video_allocator_new (plugin->display, vinfo, 0, usage_flag);
+    srcpriv->allocator = gst_vaapi_video_allocator_new (plugin->display,
+        vinfo, surface_alloc_flags, usage_flag);
+
+    if (srcpriv->allocator && plugin->enable_readback_shadow) {
+      gst_vaapi_video_allocator_set_readback_shadow (srcpriv->allocator, TRUE);
+      GST_INFO_OBJECT (plugin, "enabling readback shadow in source allocator");
+    }
   }
 
   if (!srcpriv->allocator)
@@ -30,6 +30,8 @@
 #include <gst/video/gstvideoencoder.h>
 #include <gst/video/gstvideosink.h>
 #include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapidmabufimportcache.h>
+#include <gst/vaapi/gstvaapitrace.h>
 
 G_BEGIN_DECLS
 
@@ -136,6 +138,8 @@ struct _GstVaapiPadPrivate
 
   GstAllocator *other_allocator;
   GstAllocationParams other_allocator_params;
+
+  GstVaapiDmaBufImportCache *dmabuf_import_cache;
 };
 
 G_GNUC_INTERNAL
@@ -183,7 +187,11 @@ struct _GstVaapiPluginBase
   GstCaps *allowed_raw_caps;
 
   gboolean enable_direct_rendering;
+  gboolean enable_readback_shadow;
   gboolean copy_output_frame;
+
+  /* Traced frame number, for elements without codec frames */
+  guint trace_frame_number;
 };
 
 struct _GstVaapiPluginBaseClass
@@ -53,6 +53,11 @@
 /* Environment variable for disable driver white-list */
 #define GST_VAAPI_ALL_DRIVERS_ENV "GST_VAAPI_ALL_DRIVERS"
 
+/* Environment variable listing the elements, by name or factory name,
+ * that open their own DRM display instead of sharing the display of
+ * their device with the rest of the process. "all" disables sharing */
+#define GST_VAAPI_UNSHARED_DISPLAY_ENV "GST_VAAPI_UNSHARED_DISPLAY"
+
 typedef GstVaapiDisplay *(*GstVaapiDisplayCreateFunc) (const gchar *);
 typedef GstVaapiDisplay *(*GstVaapiDisplayCreateFromHandleFunc) (gpointer);
 
@@ -98,7 +103,7 @@ static const DisplayMap g_display_map[] = {
 
 static GstVaapiDisplay *
 gst_vaapi_create_display (GstVaapiDisplayType display_type,
-    const gchar * display_name)
+    const gchar * display_name, gboolean shared)
 {
   GstVaapiDisplay *display = NULL;
   const DisplayMap *m;
@@ -107,7 +112,12 @@ gst_vaapi_create_display (GstVaapiDisplayType display_type,
     if (display_type != GST_VAAPI_DISPLAY_TYPE_ANY && display_type != m->type)
       continue;
 
-    display = m->create_display (display_name);
+#if USE_DRM
+    if (shared && m->type == GST_VAAPI_DISPLAY_TYPE_DRM)
+      display = gst_vaapi_display_drm_new_shared (display_name);
+    else
+#endif
+      display = m->create_display (display_name);
     if (display || display_type != GST_VAAPI_DISPLAY_TYPE_ANY)
       break;
   }
@@ -371,6 +381,40 @@ no_valid_gl_display:
 #endif
 }
 
+/* Whether @element may use the DRM display shared by the process */
+static gboolean
+gst_vaapi_use_shared_display (GstElement * element)
+{
+  GstElementFactory *const factory = gst_element_get_factory (element);
+  const gchar *env;
+  gchar **names, *element_name;
+  gboolean shared = TRUE;
+  guint i;
+
+  env = g_getenv (GST_VAAPI_UNSHARED_DISPLAY_ENV);
+  if (!env)
+    return TRUE;
+  if (g_strcmp0 (env, "all") == 0)
+    return FALSE;
+
+  element_name = gst_element_get_name (element);
+  names = g_strsplit (env, ",", -1);
+  for (i = 0; names[i] && shared; i++) {
+    g_strstrip (names[i]);
+    if (g_strcmp0 (names[i], element_name) == 0)
+      shared = FALSE;
+    else if (factory && g_strcmp0 (names[i],
+            GST_OBJECT_NAME (factory)) == 0)
+      shared = FALSE;
+  }
+  g_strfreev (names);
+  g_free (element_name);
+
+  if (!shared)
+    GST_INFO_OBJECT (element, "not sharing the DRM display");
+  return shared;
+}
+
 gboolean
 gst_vaapi_ensure_display (GstElement * element, GstVaapiDisplayType type)
 {
@@ -400,7 +444,8 @@ gst_vaapi_ensure_display (GstElement * element, GstVaapiDisplayType type)
           GST_VAAPI_DISPLAY_TYPE_ANY);
   }
   if (!display)
-    display = gst_vaapi_create_display (type, plugin->display_name);
+    display = gst_vaapi_create_display (type, plugin->display_name,
+        gst_vaapi_use_shared_display (element));
   if (!display)
     return FALSE;
 
@@ -761,6 +806,18 @@ gst_vaapi_caps_feature_to_string (GstVaapiCapsFeature feature)
   return str;
 }
 
+/* Returns the allocation flags of the surfaces pushed downstream with
+   the negotiated @feature. Only VA elements accept VA surfaces, so
+   these may use a compressed layout, whereas the ones which are mapped
+   or exported as dmabuf keep the default or a linear one */
+guint
+gst_vaapi_caps_feature_get_surface_alloc_flags (GstVaapiCapsFeature feature)
+{
+  if (feature != GST_VAAPI_CAPS_FEATURE_VAAPI_SURFACE)
+    return 0;
+  return gst_vaapi_surface_get_compressed_alloc_flags ();
+}
+
 gboolean
 gst_caps_set_interlaced (GstCaps * caps, GstVideoInfo * vip)
 {
@@ -929,7 +986,7 @@ gst_vaapi_create_test_display (void)
   };
 
   for (i = 0; i < G_N_ELEMENTS (test_display_map); i++) {
-    display = gst_vaapi_create_display (test_display_map[i], NULL);
+    display = gst_vaapi_create_display (test_display_map[i], NULL, FALSE);
     if (display)
       break;
   }
@@ -96,6 +96,10 @@ G_GNUC_INTERNAL
 const gchar *
 gst_vaapi_caps_feature_to_string (GstVaapiCapsFeature feature);
 
+G_GNUC_INTERNAL
+guint
+gst_vaapi_caps_feature_get_surface_alloc_flags (GstVaapiCapsFeature feature);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_caps_feature_contains (const GstCaps * caps,
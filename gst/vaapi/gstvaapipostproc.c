@@ -1542,6 +1542,7 @@ gst_vaapipostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
   GstBuffer *buf, *sys_buf = NULL;
   GstFlowReturn ret;
 
+  gst_vaapi_trace_set_frame (plugin->trace_frame_number++);
   ret = gst_vaapi_plugin_base_get_input_buffer (plugin, inbuf, &buf);
   if (ret != GST_FLOW_OK)
     return GST_FLOW_ERROR;
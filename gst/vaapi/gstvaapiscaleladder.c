@@ -0,0 +1,964 @@
+/*
+ *  gstvaapiscaleladder.c - VA-API scaling ladder
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+/**
+ * SECTION:element-vaapiscaleladder
+ * @title: vaapiscaleladder
+ * @short_description: scales a video into several renditions at once
+ *
+ * The vaapiscaleladder element scales every input frame into one
+ * rendition per requested source pad, e.g. to feed the encoders of an
+ * adaptive streaming ladder. All the renditions are processed by a
+ * single VA-API VPP context, which is locked once per input frame,
+ * instead of one vaapipostproc per rendition behind a tee.
+ *
+ * The size of each rendition is set with the width and height
+ * properties of its source pad. If both are zero, the size is
+ * negotiated with downstream. If only one of them is set, the other
+ * one keeps the aspect ratio of the input.
+ *
+ * ## Example launch line
+ *
+ * |[
+ *   gst-launch-1.0 -e filesrc location=input.mp4 ! qtdemux ! h264parse \
+ *     ! vaapih264dec ! vaapiscaleladder name=ladder                    \
+ *       src_0::height=1080 src_1::height=720 src_2::height=360         \
+ *     ladder.src_0 ! queue ! vaapih264enc ! h264parse ! mp4mux         \
+ *       ! filesink location=1080p.mp4                                  \
+ *     ladder.src_1 ! queue ! vaapih264enc ! h264parse ! mp4mux         \
+ *       ! filesink location=720p.mp4                                   \
+ *     ladder.src_2 ! queue ! vaapih264enc ! h264parse ! mp4mux         \
+ *       ! filesink location=360p.mp4
+ * ]|
+ */
+
+#include "gstcompat.h"
+#include "gstvaapiscaleladder.h"
+#include "gstvaapipluginutil.h"
+#include "gstvaapivideobuffer.h"
+#include "gstvaapivideomemory.h"
+
+#define GST_PLUGIN_NAME "vaapiscaleladder"
+#define GST_PLUGIN_DESC "A VA-API video scaler with several renditions"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapi_scale_ladder);
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT gst_debug_vaapi_scale_ladder
+#else
+#define GST_CAT_DEFAULT NULL
+#endif
+
+/* Default templates */
+/* *INDENT-OFF* */
+static const char gst_vaapi_scale_ladder_sink_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ";"
+  GST_VIDEO_CAPS_MAKE (GST_VAAPI_FORMATS_ALL);
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static const char gst_vaapi_scale_ladder_src_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS;
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_scale_ladder_sink_factory =
+  GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (gst_vaapi_scale_ladder_sink_caps_str));
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_scale_ladder_src_factory =
+  GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (gst_vaapi_scale_ladder_src_caps_str));
+/* *INDENT-ON* */
+
+G_DEFINE_TYPE (GstVaapiScaleLadderSrcPad, gst_vaapi_scale_ladder_src_pad,
+    GST_TYPE_PAD);
+
+#define DEFAULT_PAD_WIDTH  0
+#define DEFAULT_PAD_HEIGHT 0
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_WIDTH,
+  PROP_PAD_HEIGHT,
+};
+
+static void
+gst_vaapi_scale_ladder_src_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadderSrcPad *pad = GST_VAAPI_SCALE_LADDER_SRC_PAD (object);
+
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      GST_OBJECT_LOCK (pad);
+      g_value_set_uint (value, pad->width);
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    case PROP_PAD_HEIGHT:
+      GST_OBJECT_LOCK (pad);
+      g_value_set_uint (value, pad->height);
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadderSrcPad *pad = GST_VAAPI_SCALE_LADDER_SRC_PAD (object);
+
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      GST_OBJECT_LOCK (pad);
+      pad->width = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (pad);
+      gst_pad_mark_reconfigure (GST_PAD (pad));
+      break;
+    case PROP_PAD_HEIGHT:
+      GST_OBJECT_LOCK (pad);
+      pad->height = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (pad);
+      gst_pad_mark_reconfigure (GST_PAD (pad));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_reset (GstVaapiScaleLadderSrcPad * pad)
+{
+  gst_vaapi_video_pool_replace (&pad->pool, NULL);
+  gst_video_info_init (&pad->info);
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_finalize (GObject * object)
+{
+  gst_vaapi_scale_ladder_src_pad_reset (GST_VAAPI_SCALE_LADDER_SRC_PAD
+      (object));
+
+  G_OBJECT_CLASS (gst_vaapi_scale_ladder_src_pad_parent_class)->finalize
+      (object);
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_class_init (GstVaapiScaleLadderSrcPadClass *
+    klass)
+{
+  GObjectClass *const gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gst_vaapi_scale_ladder_src_pad_finalize;
+  gobject_class->set_property = gst_vaapi_scale_ladder_src_pad_set_property;
+  gobject_class->get_property = gst_vaapi_scale_ladder_src_pad_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_PAD_WIDTH,
+      g_param_spec_uint ("width", "Width",
+          "Width of the rendition (0: negotiated with downstream)",
+          0, G_MAXINT, DEFAULT_PAD_WIDTH,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PAD_HEIGHT,
+      g_param_spec_uint ("height", "Height",
+          "Height of the rendition (0: negotiated with downstream)",
+          0, G_MAXINT, DEFAULT_PAD_HEIGHT,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_init (GstVaapiScaleLadderSrcPad * pad)
+{
+  pad->width = DEFAULT_PAD_WIDTH;
+  pad->height = DEFAULT_PAD_HEIGHT;
+  gst_video_info_init (&pad->info);
+}
+
+enum
+{
+  PROP_0,
+  PROP_SCALE_METHOD,
+};
+
+static void
+gst_vaapi_scale_ladder_child_proxy_init (gpointer g_iface,
+    gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (GstVaapiScaleLadder, gst_vaapi_scale_ladder,
+    GST_TYPE_ELEMENT, GST_VAAPI_PLUGIN_BASE_INIT_INTERFACES
+    G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY,
+        gst_vaapi_scale_ladder_child_proxy_init));
+
+GST_VAAPI_PLUGIN_BASE_DEFINE_SET_CONTEXT (gst_vaapi_scale_ladder_parent_class);
+
+static gboolean
+gst_vaapi_scale_ladder_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+
+static GstPad *
+gst_vaapi_scale_ladder_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * req_name, const GstCaps * caps)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+  GstPad *newpad;
+  gchar *name;
+  guint index;
+
+  GST_OBJECT_LOCK (ladder);
+  if (req_name && g_str_has_prefix (req_name, "src_") && req_name[4]) {
+    index = g_ascii_strtoull (&req_name[4], NULL, 10);
+    if (index >= ladder->next_pad_index)
+      ladder->next_pad_index = index + 1;
+  } else {
+    index = ladder->next_pad_index++;
+  }
+  GST_OBJECT_UNLOCK (ladder);
+
+  name = g_strdup_printf ("src_%u", index);
+  newpad = g_object_new (GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD, "name", name,
+      "direction", templ->direction, "template", templ, NULL);
+  g_free (name);
+
+  gst_pad_set_query_function (newpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_src_query));
+
+  if (!gst_element_add_pad (element, newpad)) {
+    GST_DEBUG_OBJECT (element, "could not create/add pad");
+    gst_object_unref (newpad);
+    return NULL;
+  }
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_add_pad (ladder->flow_combiner, newpad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  gst_child_proxy_child_added (GST_CHILD_PROXY (element), G_OBJECT (newpad),
+      GST_OBJECT_NAME (newpad));
+
+  return newpad;
+}
+
+static void
+gst_vaapi_scale_ladder_release_pad (GstElement * element, GstPad * pad)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+
+  gst_child_proxy_child_removed (GST_CHILD_PROXY (ladder), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_remove_pad (ladder->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+}
+
+static inline gboolean
+gst_vaapi_scale_ladder_ensure_display (GstVaapiScaleLadder * ladder)
+{
+  return gst_vaapi_plugin_base_ensure_display (GST_VAAPI_PLUGIN_BASE (ladder));
+}
+
+static gboolean
+gst_vaapi_scale_ladder_start (GstVaapiScaleLadder * ladder)
+{
+  if (!gst_vaapi_plugin_base_open (GST_VAAPI_PLUGIN_BASE (ladder)))
+    return FALSE;
+
+  if (!gst_vaapi_scale_ladder_ensure_display (ladder))
+    return FALSE;
+
+  ladder->filter =
+      gst_vaapi_filter_new (GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+  if (!ladder->filter)
+    return FALSE;
+
+  ladder->num_frames = 0;
+  ladder->num_renditions = 0;
+  return TRUE;
+}
+
+static gboolean
+_reset_srcpad (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  gst_vaapi_scale_ladder_src_pad_reset (GST_VAAPI_SCALE_LADDER_SRC_PAD (pad));
+
+  return TRUE;
+}
+
+static void
+gst_vaapi_scale_ladder_stop (GstVaapiScaleLadder * ladder)
+{
+  if (ladder->num_frames > 0) {
+    GST_INFO_OBJECT (ladder, "scaled %" G_GUINT64_FORMAT " frames into %"
+        G_GUINT64_FORMAT " renditions", ladder->num_frames,
+        ladder->num_renditions);
+  }
+
+  gst_element_foreach_src_pad (GST_ELEMENT (ladder), _reset_srcpad, NULL);
+  gst_vaapi_filter_replace (&ladder->filter, NULL);
+
+  gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (ladder));
+}
+
+/* Computes the size of the rendition requested on @pad. A zero size
+   is left to downstream, unless the other dimension is set, in which
+   case it follows the aspect ratio of @in_info */
+static void
+get_rendition_size (GstVaapiScaleLadderSrcPad * pad,
+    const GstVideoInfo * in_info, guint * width_ptr, guint * height_ptr)
+{
+  const guint in_width = GST_VIDEO_INFO_WIDTH (in_info);
+  const guint in_height = GST_VIDEO_INFO_HEIGHT (in_info);
+  guint width, height;
+
+  GST_OBJECT_LOCK (pad);
+  width = pad->width;
+  height = pad->height;
+  GST_OBJECT_UNLOCK (pad);
+
+  if (width && !height)
+    height = GST_ROUND_UP_2 (gst_util_uint64_scale_int (width, in_height,
+            in_width));
+  else if (height && !width)
+    width = GST_ROUND_UP_2 (gst_util_uint64_scale_int (height, in_width,
+            in_height));
+
+  *width_ptr = width;
+  *height_ptr = height;
+}
+
+static gboolean
+copy_sticky_event (GstPad * pad, GstEvent ** event, gpointer user_data)
+{
+  GstPad *const srcpad = GST_PAD (user_data);
+
+  if (GST_EVENT_TYPE (*event) != GST_EVENT_CAPS)
+    gst_pad_store_sticky_event (srcpad, *event);
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_scale_ladder_negotiate_pad (GstVaapiScaleLadder * ladder,
+    GstVaapiScaleLadderSrcPad * pad)
+{
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+  const GstVideoInfo *const in_info =
+      GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (ladder);
+  GstVideoFormat format;
+  GstStructure *structure;
+  GstCaps *caps, *peercaps, *current_caps;
+  GstVideoInfo info;
+  guint width, height;
+  gboolean success = TRUE;
+
+  if (!GST_VAAPI_PLUGIN_BASE_SINK_PAD_CAPS (ladder))
+    return FALSE;
+
+  format = GST_VIDEO_INFO_FORMAT (in_info);
+  if (format == GST_VIDEO_FORMAT_ENCODED)
+    format = GST_VIDEO_FORMAT_NV12;
+
+  get_rendition_size (pad, in_info, &width, &height);
+
+  caps = gst_caps_new_simple ("video/x-raw",
+      "format", G_TYPE_STRING, gst_video_format_to_string (format),
+      "framerate", GST_TYPE_FRACTION, GST_VIDEO_INFO_FPS_N (in_info),
+      GST_VIDEO_INFO_FPS_D (in_info),
+      "pixel-aspect-ratio", GST_TYPE_FRACTION, GST_VIDEO_INFO_PAR_N (in_info),
+      GST_VIDEO_INFO_PAR_D (in_info), NULL);
+  structure = gst_caps_get_structure (caps, 0);
+  if (width)
+    gst_structure_set (structure, "width", G_TYPE_INT, width, NULL);
+  else
+    gst_structure_set (structure, "width", GST_TYPE_INT_RANGE, 1, G_MAXINT,
+        NULL);
+  if (height)
+    gst_structure_set (structure, "height", G_TYPE_INT, height, NULL);
+  else
+    gst_structure_set (structure, "height", GST_TYPE_INT_RANGE, 1, G_MAXINT,
+        NULL);
+  gst_caps_set_features (caps, 0,
+      gst_caps_features_new (GST_CAPS_FEATURE_MEMORY_VAAPI_SURFACE, NULL));
+
+  peercaps = gst_pad_peer_query_caps (GST_PAD (pad), caps);
+  gst_caps_unref (caps);
+  if (gst_caps_is_empty (peercaps)) {
+    gst_caps_unref (peercaps);
+    goto error_no_caps;
+  }
+
+  /* Stay as close as possible to the input size */
+  peercaps = gst_caps_truncate (peercaps);
+  structure = gst_caps_get_structure (peercaps, 0);
+  gst_structure_fixate_field_nearest_int (structure, "width",
+      GST_VIDEO_INFO_WIDTH (in_info));
+  gst_structure_fixate_field_nearest_int (structure, "height",
+      GST_VIDEO_INFO_HEIGHT (in_info));
+  caps = gst_caps_fixate (peercaps);
+
+  if (!gst_video_info_from_caps (&info, caps))
+    goto error_invalid_caps;
+
+  if (!pad->pool || !gst_video_info_is_equal (&info, &pad->info)) {
+    GstVaapiVideoPool *const pool =
+        gst_vaapi_surface_pool_new_full (GST_VAAPI_PLUGIN_BASE_DISPLAY
+        (ladder), &info, 0);
+    if (!pool)
+      goto error_create_pool;
+    gst_vaapi_video_pool_replace (&pad->pool, pool);
+    gst_vaapi_video_pool_unref (pool);
+    pad->info = info;
+  }
+
+  /* A pad requested while streaming still misses the stream-start,
+     segment, etc. events: they must reach downstream around the caps,
+     in their original order */
+  current_caps = gst_pad_get_current_caps (GST_PAD (pad));
+  if (!current_caps)
+    gst_pad_sticky_events_foreach (plugin->sinkpad, copy_sticky_event, pad);
+
+  if (!current_caps || !gst_caps_is_equal (caps, current_caps)) {
+    GST_DEBUG_OBJECT (pad, "rendition caps %" GST_PTR_FORMAT, caps);
+    success = gst_pad_push_event (GST_PAD (pad), gst_event_new_caps (caps));
+  }
+
+  if (current_caps)
+    gst_caps_unref (current_caps);
+  gst_caps_unref (caps);
+  return success;
+
+  /* ERRORS */
+error_no_caps:
+  {
+    GST_WARNING_OBJECT (pad, "downstream does not accept any rendition size");
+    return FALSE;
+  }
+error_invalid_caps:
+  {
+    GST_ERROR_OBJECT (pad, "invalid rendition caps %" GST_PTR_FORMAT, caps);
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+error_create_pool:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create surface pool");
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+}
+
+static gboolean
+_negotiate_srcpad (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+
+  /* Retried from the chain function, once downstream is linked */
+  if (!gst_vaapi_scale_ladder_negotiate_pad (ladder,
+          GST_VAAPI_SCALE_LADDER_SRC_PAD (pad)))
+    gst_pad_mark_reconfigure (pad);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_scale_ladder_set_caps (GstVaapiScaleLadder * ladder, GstCaps * caps)
+{
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+  GstVideoFormat format;
+
+  if (!gst_vaapi_scale_ladder_ensure_display (ladder))
+    return FALSE;
+
+  if (!gst_vaapi_plugin_base_set_caps (plugin, caps, NULL))
+    return FALSE;
+
+  format = GST_VIDEO_INFO_FORMAT (GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (ladder));
+  if (format == GST_VIDEO_FORMAT_ENCODED)
+    format = GST_VIDEO_FORMAT_NV12;
+  if (!gst_vaapi_filter_set_format (ladder->filter, format)) {
+    GST_ERROR_OBJECT (ladder, "unsupported format %s",
+        gst_video_format_to_string (format));
+    return FALSE;
+  }
+
+  /* Push the caps now, so that they precede the next sticky events */
+  gst_element_foreach_src_pad (GST_ELEMENT (ladder), _negotiate_srcpad, NULL);
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_scale_ladder_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+  gboolean ret;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:{
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      ret = gst_vaapi_scale_ladder_set_caps (ladder, caps);
+      gst_event_unref (event);
+      return ret;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (ladder);
+      gst_flow_combiner_reset (ladder->flow_combiner);
+      GST_OBJECT_UNLOCK (ladder);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CONTEXT:
+      if (gst_vaapi_handle_context_query (GST_ELEMENT (ladder), query)) {
+        GST_DEBUG_OBJECT (ladder, "sharing display %" GST_PTR_FORMAT,
+            GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+        return TRUE;
+      }
+      break;
+    case GST_QUERY_ALLOCATION:
+      return gst_vaapi_plugin_base_propose_allocation (GST_VAAPI_PLUGIN_BASE
+          (ladder), query);
+    case GST_QUERY_CAPS:{
+      GstCaps *caps, *filter = NULL;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *const tmp = caps;
+
+        caps = gst_caps_intersect_full (filter, tmp, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (tmp);
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    default:
+      break;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_CONTEXT) {
+    if (gst_vaapi_handle_context_query (GST_ELEMENT (ladder), query)) {
+      GST_DEBUG_OBJECT (ladder, "sharing display %" GST_PTR_FORMAT,
+          GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+      return TRUE;
+    }
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static GstFlowReturn
+gst_vaapi_scale_ladder_chain (GstPad * sinkpad, GstObject * parent,
+    GstBuffer * inbuf)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+  GstVaapiScaleLadderSrcPad *pad;
+  GstVaapiVideoMeta *inbuf_meta;
+  GstVaapiSurfaceProxy **proxies = NULL;
+  GstVaapiSurface **surfaces = NULL;
+  GstVaapiFilterStatus status;
+  GstFlowReturn ret;
+  GstBuffer *buf = NULL, *outbuf;
+  GPtrArray *pads;
+  GList *l;
+  guint i, flags;
+
+  gst_vaapi_trace_set_frame (plugin->trace_frame_number++);
+
+  /* Only the linked renditions are processed */
+  pads = g_ptr_array_new_with_free_func (gst_object_unref);
+  GST_OBJECT_LOCK (ladder);
+  for (l = GST_ELEMENT (ladder)->srcpads; l; l = l->next) {
+    if (gst_pad_is_linked (l->data))
+      g_ptr_array_add (pads, gst_object_ref (l->data));
+  }
+  GST_OBJECT_UNLOCK (ladder);
+
+  if (pads->len == 0) {
+    ret = GST_FLOW_NOT_LINKED;
+    goto done;
+  }
+
+  for (i = 0; i < pads->len; i++) {
+    pad = g_ptr_array_index (pads, i);
+    if (!gst_pad_check_reconfigure (GST_PAD (pad)) && pad->pool)
+      continue;
+    if (!gst_vaapi_scale_ladder_negotiate_pad (ladder, pad)) {
+      gst_pad_mark_reconfigure (GST_PAD (pad));
+      goto error_negotiate;
+    }
+  }
+
+  ret = gst_vaapi_plugin_base_get_input_buffer (plugin, inbuf, &buf);
+  if (ret != GST_FLOW_OK)
+    goto done;
+
+  inbuf_meta = gst_buffer_get_vaapi_video_meta (buf);
+  if (!inbuf_meta)
+    goto error_invalid_buffer;
+
+  proxies = g_new0 (GstVaapiSurfaceProxy *, pads->len);
+  surfaces = g_new0 (GstVaapiSurface *, pads->len);
+  for (i = 0; i < pads->len; i++) {
+    pad = g_ptr_array_index (pads, i);
+    proxies[i] = gst_vaapi_surface_proxy_new_from_pool
+        (GST_VAAPI_SURFACE_POOL (pad->pool));
+    if (!proxies[i])
+      goto error_create_proxy;
+    surfaces[i] = GST_VAAPI_SURFACE_PROXY_SURFACE (proxies[i]);
+  }
+
+  flags = gst_vaapi_video_meta_get_render_flags (inbuf_meta) &
+      ~GST_VAAPI_PICTURE_STRUCTURE_MASK;
+
+  gst_vaapi_filter_set_scaling (ladder->filter, ladder->scale_method);
+  gst_vaapi_filter_set_cropping_rectangle (ladder->filter,
+      gst_vaapi_video_meta_get_render_rect (inbuf_meta));
+
+  /* All the renditions in one go, the VA context is locked once */
+  status = gst_vaapi_filter_process_multiple (ladder->filter,
+      gst_vaapi_video_meta_get_surface (inbuf_meta), surfaces, pads->len,
+      flags);
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    goto error_process_vpp;
+
+  /* The renditions were submitted in order on the same context, so
+   * waiting for the last one is enough for all of them */
+  if (!gst_vaapi_surface_sync (surfaces[pads->len - 1]))
+    goto error_sync_surface;
+
+  ladder->num_frames++;
+  ladder->num_renditions += pads->len;
+
+  for (i = 0; i < pads->len; i++) {
+    pad = g_ptr_array_index (pads, i);
+
+    outbuf = gst_vaapi_video_buffer_new_with_surface_proxy (proxies[i]);
+    gst_vaapi_surface_proxy_replace (&proxies[i], NULL);
+    if (!outbuf)
+      goto error_create_buffer;
+    gst_buffer_copy_into (outbuf, inbuf,
+        GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+    ret = gst_pad_push (GST_PAD (pad), outbuf);
+
+    GST_OBJECT_LOCK (ladder);
+    ret = gst_flow_combiner_update_pad_flow (ladder->flow_combiner,
+        GST_PAD (pad), ret);
+    GST_OBJECT_UNLOCK (ladder);
+  }
+
+done:
+  if (proxies) {
+    for (i = 0; i < pads->len; i++)
+      gst_vaapi_surface_proxy_replace (&proxies[i], NULL);
+  }
+  g_free (proxies);
+  g_free (surfaces);
+  g_ptr_array_unref (pads);
+  gst_buffer_replace (&buf, NULL);
+  gst_buffer_unref (inbuf);
+  return ret;
+
+  /* ERRORS */
+error_negotiate:
+  {
+    GST_ELEMENT_ERROR (ladder, CORE, NEGOTIATION, (NULL),
+        ("failed to negotiate %s:%s", GST_DEBUG_PAD_NAME (pad)));
+    ret = GST_FLOW_NOT_NEGOTIATED;
+    goto done;
+  }
+error_invalid_buffer:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to validate source buffer");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_create_proxy:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to create surface proxy from pool");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_process_vpp:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to apply VPP filters (error %d)",
+        status);
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_sync_surface:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to sync the renditions");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_create_buffer:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to create output buffer");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+}
+
+static GstStateChangeReturn
+gst_vaapi_scale_ladder_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!gst_vaapi_scale_ladder_start (ladder))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      GST_OBJECT_LOCK (ladder);
+      gst_flow_combiner_reset (ladder->flow_combiner);
+      GST_OBJECT_UNLOCK (ladder);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_vaapi_scale_ladder_parent_class)->change_state
+      (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      gst_vaapi_scale_ladder_stop (ladder);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_vaapi_scale_ladder_finalize (GObject * object)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (object);
+
+  gst_vaapi_filter_replace (&ladder->filter, NULL);
+  gst_flow_combiner_free (ladder->flow_combiner);
+  gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (ladder));
+
+  G_OBJECT_CLASS (gst_vaapi_scale_ladder_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapi_scale_ladder_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (object);
+
+  switch (prop_id) {
+    case PROP_SCALE_METHOD:
+      ladder->scale_method = g_value_get_enum (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (object);
+
+  switch (prop_id) {
+    case PROP_SCALE_METHOD:
+      g_value_set_enum (value, ladder->scale_method);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_class_init (GstVaapiScaleLadderClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+  GstVaapiPluginBaseClass *plugin_class = GST_VAAPI_PLUGIN_BASE_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_vaapi_scale_ladder,
+      GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
+
+  gst_vaapi_plugin_base_class_init (plugin_class);
+
+  object_class->finalize = GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_finalize);
+  object_class->set_property = gst_vaapi_scale_ladder_set_property;
+  object_class->get_property = gst_vaapi_scale_ladder_get_property;
+
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_change_state);
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_request_new_pad);
+  element_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_release_pad);
+  element_class->set_context = GST_DEBUG_FUNCPTR (gst_vaapi_base_set_context);
+
+  /**
+   * GstVaapiScaleLadder:scale-method:
+   *
+   * The scaling method used for all the renditions.
+   */
+  g_object_class_install_property (object_class, PROP_SCALE_METHOD,
+      g_param_spec_enum ("scale-method", "Scale Method",
+          "Scaling method to use", GST_VAAPI_TYPE_SCALE_METHOD,
+          GST_VAAPI_SCALE_METHOD_DEFAULT,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaapi_scale_ladder_sink_factory);
+
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &gst_vaapi_scale_ladder_src_factory,
+      GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD);
+
+  gst_element_class_set_static_metadata (element_class,
+      "VA-API scaling ladder",
+      "Filter/Converter/Video/Scaler/Hardware",
+      GST_PLUGIN_DESC, "The GStreamer VA-API team");
+}
+
+static void
+gst_vaapi_scale_ladder_init (GstVaapiScaleLadder * ladder)
+{
+  GstPad *sinkpad;
+
+  sinkpad = gst_pad_new_from_static_template
+      (&gst_vaapi_scale_ladder_sink_factory, "sink");
+  gst_pad_set_chain_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_chain));
+  gst_pad_set_event_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_sink_event));
+  gst_pad_set_query_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_sink_query));
+  gst_element_add_pad (GST_ELEMENT (ladder), sinkpad);
+
+  /* after the sink pad was added, so that the base plugin tracks it */
+  gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (ladder), GST_CAT_DEFAULT);
+
+  ladder->scale_method = GST_VAAPI_SCALE_METHOD_DEFAULT;
+  ladder->flow_combiner = gst_flow_combiner_new ();
+}
+
+/* GstChildProxy implementation */
+static GObject *
+gst_vaapi_scale_ladder_child_proxy_get_child_by_index (GstChildProxy *
+    child_proxy, guint index)
+{
+  GstVaapiScaleLadder *ladder = GST_VAAPI_SCALE_LADDER (child_proxy);
+  GObject *obj = NULL;
+
+  GST_OBJECT_LOCK (ladder);
+  obj = g_list_nth_data (GST_ELEMENT_CAST (ladder)->srcpads, index);
+  if (obj)
+    gst_object_ref (obj);
+  GST_OBJECT_UNLOCK (ladder);
+
+  return obj;
+}
+
+static guint
+gst_vaapi_scale_ladder_child_proxy_get_children_count (GstChildProxy *
+    child_proxy)
+{
+  guint count = 0;
+  GstVaapiScaleLadder *ladder = GST_VAAPI_SCALE_LADDER (child_proxy);
+
+  GST_OBJECT_LOCK (ladder);
+  count = GST_ELEMENT_CAST (ladder)->numsrcpads;
+  GST_OBJECT_UNLOCK (ladder);
+
+  return count;
+}
+
+static void
+gst_vaapi_scale_ladder_child_proxy_init (gpointer g_iface, gpointer iface_data)
+{
+  GstChildProxyInterface *iface = g_iface;
+
+  iface->get_child_by_index =
+      gst_vaapi_scale_ladder_child_proxy_get_child_by_index;
+  iface->get_children_count =
+      gst_vaapi_scale_ladder_child_proxy_get_children_count;
+}
+
+gboolean
+gst_vaapiscaleladder_register (GstPlugin * plugin, GstVaapiDisplay * display)
+{
+  GstVaapiFilter *filter = NULL;
+
+  filter = gst_vaapi_filter_new (display);
+  if (!filter)
+    return FALSE;
+  gst_vaapi_filter_replace (&filter, NULL);
+
+  return gst_element_register (plugin, "vaapiscaleladder",
+      GST_RANK_NONE, GST_TYPE_VAAPI_SCALE_LADDER);
+}
@@ -0,0 +1,109 @@
+/*
+ *  gstvaapiscaleladder.h - VA-API scaling ladder
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#ifndef GST_VAAPI_SCALE_LADDER_H
+#define GST_VAAPI_SCALE_LADDER_H
+
+#include "gstvaapipluginbase.h"
+#include <gst/base/gstflowcombiner.h>
+#include <gst/vaapi/gstvaapisurfacepool.h>
+#include <gst/vaapi/gstvaapifilter.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAAPI_SCALE_LADDER (gst_vaapi_scale_ladder_get_type ())
+#define GST_VAAPI_SCALE_LADDER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_SCALE_LADDER, \
+      GstVaapiScaleLadder))
+#define GST_VAAPI_SCALE_LADDER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_VAAPI_SCALE_LADDER, \
+      GstVaapiScaleLadderClass))
+#define GST_IS_VAAPI_SCALE_LADDER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPI_SCALE_LADDER))
+#define GST_IS_VAAPI_SCALE_LADDER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_VAAPI_SCALE_LADDER))
+#define GST_VAAPI_SCALE_LADDER_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_VAAPI_SCALE_LADDER, \
+      GstVaapiScaleLadderClass))
+
+#define GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD \
+  (gst_vaapi_scale_ladder_src_pad_get_type ())
+#define GST_VAAPI_SCALE_LADDER_SRC_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD, \
+      GstVaapiScaleLadderSrcPad))
+#define GST_VAAPI_SCALE_LADDER_SRC_PAD_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD, \
+      GstVaapiScaleLadderSrcPadClass))
+#define GST_IS_VAAPI_SCALE_LADDER_SRC_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD))
+#define GST_IS_VAAPI_SCALE_LADDER_SRC_PAD_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD))
+
+typedef struct _GstVaapiScaleLadder GstVaapiScaleLadder;
+typedef struct _GstVaapiScaleLadderClass GstVaapiScaleLadderClass;
+
+typedef struct _GstVaapiScaleLadderSrcPad GstVaapiScaleLadderSrcPad;
+typedef struct _GstVaapiScaleLadderSrcPadClass GstVaapiScaleLadderSrcPadClass;
+
+struct _GstVaapiScaleLadder
+{
+  GstVaapiPluginBase parent_instance;
+
+  GstVaapiFilter *filter;
+  GstVaapiScaleMethod scale_method;
+  GstFlowCombiner *flow_combiner;
+  guint next_pad_index;
+
+  guint64 num_frames;
+  guint64 num_renditions;
+};
+
+struct _GstVaapiScaleLadderClass
+{
+  GstVaapiPluginBaseClass parent_class;
+};
+
+struct _GstVaapiScaleLadderSrcPad
+{
+  GstPad parent_instance;
+
+  guint width, height;
+
+  /* negotiated rendition, and the surfaces it is scaled into */
+  GstVideoInfo info;
+  GstVaapiVideoPool *pool;
+};
+
+struct _GstVaapiScaleLadderSrcPadClass
+{
+  GstPadClass parent_class;
+};
+
+GType
+gst_vaapi_scale_ladder_get_type (void) G_GNUC_CONST;
+
+GType
+gst_vaapi_scale_ladder_src_pad_get_type (void) G_GNUC_CONST;
+
+gboolean
+gst_vaapiscaleladder_register (GstPlugin * plugin, GstVaapiDisplay * display);
+
+G_END_DECLS
+
+#endif
@@ -1569,6 +1569,9 @@ gst_vaapisink_show_frame (GstVideoSink * video_sink, GstBuffer * src_buffer)
   GstVaapiSink *const sink = GST_VAAPISINK_CAST (video_sink);
   GstFlowReturn ret;
 
+  gst_vaapi_trace_set_frame
+      (GST_VAAPI_PLUGIN_BASE (sink)->trace_frame_number++);
+
   /* We need at least to protect the gst_vaapi_aplpy_composition()
    * call to prevent a race during subpicture destruction.
    * FIXME: a less coarse grained lock could be used, though */
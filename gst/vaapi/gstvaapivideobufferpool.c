@@ -322,7 +322,7 @@ vaapi_buffer_pool_cache_dma_mem (GstVaapiVideoBufferPool * pool,
 
   surface = GST_VAAPI_SURFACE_PROXY_SURFACE (proxy);
   g_assert (surface);
-  g_assert (gst_vaapi_surface_peek_buffer_proxy (surface));
+  g_assert (gst_vaapi_dmabuf_memory_peek_surface (mem) == surface);
 
   if (!priv->dma_mem_map)
     priv->dma_mem_map = g_hash_table_new_full (g_direct_hash,
@@ -341,7 +341,6 @@ vaapi_buffer_pool_lookup_dma_mem (GstVaapiVideoBufferPool * pool,
 {
   GstVaapiSurface *surface;
   GstVaapiVideoBufferPoolPrivate *const priv = pool->priv;
-  GstVaapiBufferProxy *buf_proxy;
   GstMemory *mem;
 
   g_assert (priv->use_dmabuf_memory);
@@ -352,15 +351,12 @@ vaapi_buffer_pool_lookup_dma_mem (GstVaapiVideoBufferPool * pool,
   surface = GST_VAAPI_SURFACE_PROXY_SURFACE (proxy);
   g_assert (surface);
 
-  buf_proxy = gst_vaapi_surface_peek_buffer_proxy (surface);
-  /* Have not exported yet */
-  if (!buf_proxy) {
-    g_assert (!g_hash_table_contains (priv->dma_mem_map, surface));
-    return NULL;
-  }
-
+  /* Not wrapped by this pool yet. The surface may still have been
+   * exported by another pool, whose memory gst_vaapi_dmabuf_memory_new()
+   * then returns */
   mem = g_hash_table_lookup (priv->dma_mem_map, surface);
-  g_assert (mem);
+  if (!mem)
+    return NULL;
 
   return gst_memory_ref (mem);
 }
@@ -525,10 +521,9 @@ gst_vaapi_video_buffer_pool_acquire_buffer (GstBufferPool * pool,
       return GST_FLOW_OK;
     }
   } else {
-    /* Should be an unexported surface */
+    /* Not wrapped by this pool yet */
     surface = GST_VAAPI_SURFACE_PROXY_SURFACE (priv_params->proxy);
     g_assert (surface);
-    g_assert (gst_vaapi_surface_peek_buffer_proxy (surface) == NULL);
     gst_vaapi_video_meta_set_surface_proxy (meta, priv_params->proxy);
     mem = gst_vaapi_dmabuf_memory_new (priv->allocator, meta);
     if (mem)
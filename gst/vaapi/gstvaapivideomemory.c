@@ -162,6 +162,44 @@ ensure_image_is_current (GstVaapiVideoMemory * mem)
   return TRUE;
 }
 
+static inline gboolean
+use_readback_shadow (GstVaapiVideoMemory * mem, GstMapFlags flags)
+{
+  GstVaapiVideoAllocator *const allocator =
+      GST_VAAPI_VIDEO_ALLOCATOR_CAST (GST_MEMORY_CAST (mem)->allocator);
+
+  return allocator->readback_shadow &&
+      (flags & GST_MAP_READWRITE) == GST_MAP_READ;
+}
+
+/* Copies the image into a cached system memory shadow, so that
+ * downstream reads don't hit uncached VA memory */
+static gboolean
+ensure_shadow_is_current (GstVaapiVideoMemory * mem)
+{
+  gsize size;
+
+  if (GST_VAAPI_VIDEO_MEMORY_FLAG_IS_SET (mem,
+          GST_VAAPI_VIDEO_MEMORY_FLAG_SHADOW_IS_CURRENT))
+    return TRUE;
+
+  if (!ensure_image_is_current (mem))
+    return FALSE;
+
+  size = gst_vaapi_image_get_data_size (mem->image);
+  if (mem->shadow_size < size) {
+    g_free (mem->shadow);
+    mem->shadow = g_malloc (size);
+    mem->shadow_size = size;
+  }
+  if (!gst_vaapi_image_read_data (mem->image, mem->shadow, size))
+    return FALSE;
+
+  GST_VAAPI_VIDEO_MEMORY_FLAG_SET (mem,
+      GST_VAAPI_VIDEO_MEMORY_FLAG_SHADOW_IS_CURRENT);
+  return TRUE;
+}
+
 static GstVaapiSurfaceProxy *
 new_surface_proxy (GstVaapiVideoMemory * mem)
 {
@@ -218,6 +256,14 @@ map_vaapi_memory (GstVaapiVideoMemory * mem, GstMapFlags flags)
   if (!ensure_image (mem))
     goto error_no_image;
 
+  /* Read-only maps may be served from the system memory shadow */
+  mem->shadow_mapped = use_readback_shadow (mem, flags);
+  if (mem->shadow_mapped) {
+    if (!ensure_shadow_is_current (mem))
+      goto error_no_current_shadow;
+    return TRUE;
+  }
+
   /* Load VA image from surface only for read flag since it returns
    * raw pixels */
   if ((flags & GST_MAP_READ) && !ensure_image_is_current (mem))
@@ -227,9 +273,12 @@ map_vaapi_memory (GstVaapiVideoMemory * mem, GstMapFlags flags)
     goto error_map_image;
 
   /* Mark surface as dirty and expect updates from image */
-  if (flags & GST_MAP_WRITE)
+  if (flags & GST_MAP_WRITE) {
     GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET (mem,
         GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT);
+    GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET (mem,
+        GST_VAAPI_VIDEO_MEMORY_FLAG_SHADOW_IS_CURRENT);
+  }
 
   return TRUE;
 
@@ -254,6 +303,12 @@ error_no_current_image:
     GST_ERROR ("failed to make image current");
     return FALSE;
   }
+error_no_current_shadow:
+  {
+    GST_ERROR ("failed to read back image %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (gst_vaapi_image_get_id (mem->image)));
+    return FALSE;
+  }
 error_map_image:
   {
     GST_ERROR ("failed to map image %" GST_VAAPI_ID_FORMAT,
@@ -265,7 +320,9 @@ error_map_image:
 static inline void
 unmap_vaapi_memory (GstVaapiVideoMemory * mem, GstMapFlags flags)
 {
-  gst_vaapi_image_unmap (mem->image);
+  if (!mem->shadow_mapped)
+    gst_vaapi_image_unmap (mem->image);
+  mem->shadow_mapped = FALSE;
 
   if (flags & GST_MAP_WRITE) {
     GST_VAAPI_VIDEO_MEMORY_FLAG_SET (mem,
@@ -302,11 +359,25 @@ gst_video_meta_map_vaapi_memory (GstVideoMeta * meta, guint plane,
     if (!map_vaapi_memory (mem, flags))
       goto out;
     mem->map_type = GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_PLANAR;
+  } else if (mem->shadow_mapped && (flags & GST_MAP_WRITE)) {
+    /* Writes to the read-only shadow would never reach the surface */
+    goto error_write_to_shadow;
   }
   mem->map_count++;
 
-  *data = gst_vaapi_image_get_plane (mem->image, plane);
-  *stride = gst_vaapi_image_get_pitch (mem->image, plane);
+  if (mem->shadow_mapped) {
+    VAImage va_image;
+
+    *data = NULL;
+    if (gst_vaapi_image_get_image (mem->image, &va_image)
+        && plane < va_image.num_planes) {
+      *data = mem->shadow + va_image.offsets[plane];
+      *stride = va_image.pitches[plane];
+    }
+  } else {
+    *data = gst_vaapi_image_get_plane (mem->image, plane);
+    *stride = gst_vaapi_image_get_pitch (mem->image, plane);
+  }
   info->flags = flags;
   ret = (*data != NULL);
 
@@ -320,6 +391,11 @@ error_incompatible_map:
     GST_ERROR ("incompatible map type (%d)", mem->map_type);
     goto out;
   }
+error_write_to_shadow:
+  {
+    GST_ERROR ("cannot map for writing while mapped for reading only");
+    goto out;
+  }
 }
 
 gboolean
@@ -380,6 +456,9 @@ gst_vaapi_video_memory_new (GstAllocator * base_allocator,
   mem->map_count = 0;
   mem->usage_flag = allocator->usage_flag;
   g_mutex_init (&mem->lock);
+  mem->shadow = NULL;
+  mem->shadow_size = 0;
+  mem->shadow_mapped = FALSE;
 
   GST_VAAPI_VIDEO_MEMORY_FLAG_SET (mem,
       GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT);
@@ -416,6 +495,8 @@ gst_vaapi_video_memory_reset_surface (GstVaapiVideoMemory * mem)
 
   GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET (mem,
       GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT);
+  GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET (mem,
+      GST_VAAPI_VIDEO_MEMORY_FLAG_SHADOW_IS_CURRENT);
 }
 
 gboolean
@@ -467,7 +548,7 @@ gst_vaapi_video_memory_map (GstMemory * base_mem, gsize maxsize, guint flags)
     case GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_LINEAR:
       if (!mem->image)
         goto error_no_image;
-      data = get_image_data (mem->image);
+      data = mem->shadow_mapped ? mem->shadow : get_image_data (mem->image);
       break;
     default:
       goto error_unsupported_map_type;
@@ -608,6 +689,7 @@ gst_vaapi_video_allocator_free (GstAllocator * allocator, GstMemory * base_mem)
   gst_vaapi_surface_proxy_replace (&mem->proxy, NULL);
   gst_vaapi_video_meta_replace (&mem->meta, NULL);
   g_mutex_clear (&mem->lock);
+  g_free (mem->shadow);
   g_slice_free (GstVaapiVideoMemory, mem);
 }
 
@@ -994,6 +1076,26 @@ gst_vaapi_video_allocator_new (GstVaapiDisplay * display,
   return GST_ALLOCATOR_CAST (allocator);
 }
 
+/**
+ * gst_vaapi_video_allocator_set_readback_shadow:
+ * @allocator: a #GstVaapiVideoAllocator
+ * @readback_shadow: %TRUE to serve read-only maps from system memory
+ *
+ * When enabled, mapping a memory for reading only copies the VA image
+ * into a cached system memory shadow, with streaming loads, and hands
+ * that shadow out instead of the mapped VA image. The shadow is kept
+ * until the memory gets a new surface or is mapped for writing.
+ */
+void
+gst_vaapi_video_allocator_set_readback_shadow (GstAllocator * allocator,
+    gboolean readback_shadow)
+{
+  g_return_if_fail (GST_VAAPI_IS_VIDEO_ALLOCATOR (allocator));
+
+  GST_VAAPI_VIDEO_ALLOCATOR_CAST (allocator)->readback_shadow =
+      readback_shadow;
+}
+
 /* ------------------------------------------------------------------------ */
 /* --- GstVaapiDmaBufMemory                                             --- */
 /* ------------------------------------------------------------------------ */
@@ -1011,6 +1113,130 @@ gst_vaapi_buffer_proxy_quark_get (void)
   return g_quark;
 }
 
+/* The memory exported for a surface is cached on the surface, so that
+ * every pool and element of the display wraps the surface once per
+ * allocator for its lifetime, and so that a downstream element can
+ * get the surface back instead of importing the DMABuf again. The
+ * memory holds a reference to its surface while the surface only
+ * lists its memories: a memory is detached when it is disposed. A
+ * lookup may take a memory whose last reference was just dropped, the
+ * dispose function then finds it alive again and keeps it, as both
+ * run under the cache lock. */
+static GMutex dmabuf_cache_lock;
+
+#define GST_VAAPI_DMABUF_MEMORY_QUARK gst_vaapi_dmabuf_memory_quark_get ()
+static GQuark
+gst_vaapi_dmabuf_memory_quark_get (void)
+{
+  static gsize g_quark;
+
+  if (g_once_init_enter (&g_quark)) {
+    gsize quark = (gsize) g_quark_from_static_string ("GstVaapiDmaBufMemory");
+    g_once_init_leave (&g_quark, quark);
+  }
+  return g_quark;
+}
+
+#define GST_VAAPI_DMABUF_SURFACE_QUARK gst_vaapi_dmabuf_surface_quark_get ()
+static GQuark
+gst_vaapi_dmabuf_surface_quark_get (void)
+{
+  static gsize g_quark;
+
+  if (g_once_init_enter (&g_quark)) {
+    gsize quark = (gsize) g_quark_from_static_string ("GstVaapiDmaBufSurface");
+    g_once_init_leave (&g_quark, quark);
+  }
+  return g_quark;
+}
+
+static gboolean
+dmabuf_cache_dispose_memory (GstMiniObject * mem)
+{
+  GstMiniObject *surface;
+  GSList *memories;
+
+  g_mutex_lock (&dmabuf_cache_lock);
+  /* A lookup took a new reference meanwhile */
+  if (g_atomic_int_get (&mem->refcount) > 0) {
+    g_mutex_unlock (&dmabuf_cache_lock);
+    return FALSE;
+  }
+  surface = gst_mini_object_get_qdata (mem, GST_VAAPI_DMABUF_SURFACE_QUARK);
+  memories = gst_mini_object_steal_qdata (surface,
+      GST_VAAPI_DMABUF_MEMORY_QUARK);
+  memories = g_slist_remove (memories, mem);
+  gst_mini_object_set_qdata (surface, GST_VAAPI_DMABUF_MEMORY_QUARK,
+      memories, (GDestroyNotify) g_slist_free);
+  g_mutex_unlock (&dmabuf_cache_lock);
+  return TRUE;
+}
+
+static GstMemory *
+dmabuf_cache_lookup (GstVaapiSurface * surface, GstAllocator * allocator)
+{
+  GstMemory *mem = NULL;
+  GSList *l;
+
+  g_mutex_lock (&dmabuf_cache_lock);
+  l = gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (surface),
+      GST_VAAPI_DMABUF_MEMORY_QUARK);
+  for (; l != NULL; l = l->next) {
+    GstMemory *const cached_mem = l->data;
+
+    if (cached_mem->allocator != allocator)
+      continue;
+    /* Possibly one being disposed, see dmabuf_cache_dispose_memory() */
+    mem = gst_memory_ref (cached_mem);
+    break;
+  }
+  g_mutex_unlock (&dmabuf_cache_lock);
+  return mem;
+}
+
+static void
+dmabuf_cache_insert (GstVaapiSurface * surface, GstMemory * mem)
+{
+  GstMiniObject *const mini_object = GST_MINI_OBJECT_CAST (mem);
+  GSList *memories;
+
+  gst_mini_object_set_qdata (mini_object, GST_VAAPI_DMABUF_SURFACE_QUARK,
+      gst_vaapi_surface_ref (surface),
+      (GDestroyNotify) gst_vaapi_surface_unref);
+  mini_object->dispose = dmabuf_cache_dispose_memory;
+
+  /* A memory of the same allocator being disposed is still listed,
+     but it is looked up after this one */
+  g_mutex_lock (&dmabuf_cache_lock);
+  memories = gst_mini_object_steal_qdata (GST_MINI_OBJECT_CAST (surface),
+      GST_VAAPI_DMABUF_MEMORY_QUARK);
+  memories = g_slist_prepend (memories, mem);
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (surface),
+      GST_VAAPI_DMABUF_MEMORY_QUARK, memories, (GDestroyNotify) g_slist_free);
+  g_mutex_unlock (&dmabuf_cache_lock);
+}
+
+/**
+ * gst_vaapi_dmabuf_memory_peek_surface:
+ * @mem: a #GstMemory
+ *
+ * Gets the VA surface @mem was exported from by
+ * gst_vaapi_dmabuf_memory_new(), so that an element can use the
+ * surface as is rather than importing the DMABuf. The surface lives
+ * as long as @mem.
+ *
+ * Return value: the #GstVaapiSurface of @mem, or %NULL if @mem was
+ *   not exported by a VA-API element
+ */
+GstVaapiSurface *
+gst_vaapi_dmabuf_memory_peek_surface (GstMemory * mem)
+{
+  g_return_val_if_fail (mem != NULL, NULL);
+
+  return gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (mem),
+      GST_VAAPI_DMABUF_SURFACE_QUARK);
+}
+
 /* Whether @mem holds an internal VA surface proxy created at
  * gst_vaapi_dmabuf_memory_new(). */
 gboolean
@@ -1069,8 +1295,16 @@ gst_vaapi_dmabuf_memory_new (GstAllocator * base_allocator,
     gst_vaapi_surface_unref (surface);
   } else {
     /* When exporting existing surfaces that come from decoder's
-     * context. */
+     * context. They may have been exported already, by this or
+     * another pool. */
     surface = GST_VAAPI_SURFACE_PROXY_SURFACE (proxy);
+    mem = dmabuf_cache_lookup (surface, base_allocator);
+    if (mem) {
+      GST_LOG ("reuse DMABuf memory %p of surface %" GST_VAAPI_ID_FORMAT,
+          mem, GST_VAAPI_ID_ARGS (gst_vaapi_surface_get_id (surface)));
+      dmabuf_proxy = gst_vaapi_surface_peek_buffer_proxy (surface);
+      goto done;
+    }
   }
 
   dmabuf_proxy = gst_vaapi_surface_peek_dma_buf_handle (surface);
@@ -1100,7 +1334,9 @@ gst_vaapi_dmabuf_memory_new (GstAllocator * base_allocator,
     gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (mem),
         GST_VAAPI_BUFFER_PROXY_QUARK, GINT_TO_POINTER (TRUE), NULL);
   }
+  dmabuf_cache_insert (surface, mem);
 
+done:
   /* When a VA surface is going to be filled by a VAAPI element
    * (decoder or VPP), it has _not_ be marked as busy in the driver.
    * Releasing the surface's derived image, held by the buffer proxy,
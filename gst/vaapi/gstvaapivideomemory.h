@@ -83,6 +83,8 @@ typedef enum
  *   #GstVaapiSurface has the up-to-date video frame contents.
  * @GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT: The embedded
  *   #GstVaapiImage has the up-to-date video frame contents.
+ * @GST_VAAPI_VIDEO_MEMORY_FLAG_SHADOW_IS_CURRENT: The system memory
+ *   shadow has the up-to-date video frame contents.
  *
  * The set of extended #GstMemory flags.
  */
@@ -90,6 +92,7 @@ typedef enum
 {
   GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT = GST_MEMORY_FLAG_LAST << 0,
   GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT = GST_MEMORY_FLAG_LAST << 1,
+  GST_VAAPI_VIDEO_MEMORY_FLAG_SHADOW_IS_CURRENT = GST_MEMORY_FLAG_LAST << 2,
 } GstVaapiVideoMemoryFlags;
 
 /**
@@ -130,6 +133,9 @@ struct _GstVaapiVideoMemory
   gint map_count;
   GstVaapiImageUsageFlags usage_flag;
   GMutex lock;
+  guchar *shadow;
+  gsize shadow_size;
+  gboolean shadow_mapped;
 };
 
 G_GNUC_INTERNAL
@@ -185,6 +191,7 @@ struct _GstVaapiVideoAllocator
   GstVideoInfo image_info;
   GstVaapiVideoPool *image_pool;
   GstVaapiImageUsageFlags usage_flag;
+  gboolean readback_shadow;
 };
 
 /**
@@ -207,6 +214,11 @@ gst_vaapi_video_allocator_new (GstVaapiDisplay * display,
     const GstVideoInfo * alloc_info, guint surface_alloc_flags,
     GstVaapiImageUsageFlags req_usage_flag);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_video_allocator_set_readback_shadow (GstAllocator * allocator,
+    gboolean readback_shadow);
+
 /* ------------------------------------------------------------------------ */
 /* --- GstVaapiDmaBufMemory                                             --- */
 /* ------------------------------------------------------------------------ */
@@ -220,6 +232,10 @@ G_GNUC_INTERNAL
 gboolean
 gst_vaapi_dmabuf_memory_holds_surface (GstMemory * mem);
 
+G_GNUC_INTERNAL
+GstVaapiSurface *
+gst_vaapi_dmabuf_memory_peek_surface (GstMemory * mem);
+
 /* ------------------------------------------------------------------------ */
 /* --- GstVaapiDmaBufAllocator                                          --- */
 /* ------------------------------------------------------------------------ */
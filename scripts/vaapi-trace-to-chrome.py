@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+#
+# vaapi-trace-to-chrome.py TRACE-FILE [OUTPUT-FILE]
+#
+# Convert a trace written with GST_VAAPI_TRACE=TRACE-FILE to the Chrome
+# trace event format, to be loaded in chrome://tracing or Perfetto
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Library General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Library General Public License for more details.
+#
+# You should have received a copy of the GNU Library General Public
+# License along with this library; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+import json
+import sys
+
+if len(sys.argv) not in (2, 3):
+  sys.exit('Usage: {} TRACE-FILE [OUTPUT-FILE]'.format(sys.argv[0]))
+
+events = []
+totals = {}
+
+with open(sys.argv[1]) as f:
+  for lineno, line in enumerate(f, 1):
+    if line.startswith('#') or not line.strip():
+      continue
+    try:
+      stage, thread, start, duration, surface, frame = line.split()
+      event = {
+        'name': stage,
+        'cat': 'vaapi',
+        'ph': 'X',
+        'pid': 1,
+        'tid': int(thread),
+        'ts': int(start),
+        'dur': int(duration),
+        'args': {'surface': surface, 'frame': int(frame)},
+      }
+    except ValueError:
+      sys.exit('{}:{}: invalid span'.format(sys.argv[1], lineno))
+    events.append(event)
+    count, total = totals.get(stage, (0, 0))
+    totals[stage] = (count + 1, total + event['dur'])
+
+events.sort(key=lambda e: e['ts'])
+trace = {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+if len(sys.argv) == 3:
+  with open(sys.argv[2], 'w') as f:
+    json.dump(trace, f)
+else:
+  json.dump(trace, sys.stdout)
+
+for stage, (count, total) in sorted(totals.items()):
+  sys.stderr.write('{:12} {:8} spans {:10.1f} us avg\n'.format(stage, count,
+      total / count))
@@ -0,0 +1,419 @@
+/*
+ *  bench-codecs.c - Benchmark the CPU cost of the codecs on a mock driver
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Runs every decoder and encoder on the mock VA driver, which does no
+   actual work, so that the CPU time per frame is the cost of the
+   library alone: bitstream parsing, DPB management, reordering,
+   bitstream writing, and VA buffer management. Decoders are fed the
+   test clips over and over, encoders are fed blank surfaces.
+
+   The results can be saved with --write-baseline, and compared with
+   --baseline: any codec slower than its baseline by more than the
+   tolerance fails the run. Baselines are only comparable on the same
+   machine and build type */
+
+#include "gst/vaapi/sysdeps.h"
+#include <dlfcn.h>
+#include <time.h>
+#include <gst/vaapi/gstvaapidisplay_drm.h>
+#include <gst/vaapi/gstvaapisurfacepool.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#if USE_ENCODERS
+#include <gst/vaapi/gstvaapiencoder_h264.h>
+#include <gst/vaapi/gstvaapiencoder_h265.h>
+#include <gst/vaapi/gstvaapiencoder_jpeg.h>
+#include <gst/vaapi/gstvaapiencoder_mpeg2.h>
+#include <gst/vaapi/gstvaapiencoder_vp8.h>
+#if USE_VP9_ENCODER
+#include <gst/vaapi/gstvaapiencoder_vp9.h>
+#endif
+#endif
+#include "decoder.h"
+#include "mockva/mockva.h"
+
+#define BASELINE_GROUP "us-per-frame"
+
+static gint g_num_frames = 300;
+static gint g_width = 1280;
+static gint g_height = 720;
+static gdouble g_tolerance = 20.0;
+static gchar *g_codec_str;
+static gchar *g_baseline;
+static gchar *g_write_baseline;
+
+static GOptionEntry g_options[] = {
+  {"frames", 'n', 0, G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames per codec", NULL},
+  {"width", 0, 0, G_OPTION_ARG_INT, &g_width,
+      "encoded frame width", NULL},
+  {"height", 0, 0, G_OPTION_ARG_INT, &g_height,
+      "encoded frame height", NULL},
+  {"codec", 'c', 0, G_OPTION_ARG_STRING, &g_codec_str,
+      "only run the benchmarks of this codec", NULL},
+  {"baseline", 'b', 0, G_OPTION_ARG_FILENAME, &g_baseline,
+      "compare with the baseline FILE", "FILE"},
+  {"write-baseline", 'w', 0, G_OPTION_ARG_FILENAME, &g_write_baseline,
+      "save the results as the baseline FILE", "FILE"},
+  {"tolerance", 't', 0, G_OPTION_ARG_DOUBLE, &g_tolerance,
+      "slowdown over the baseline tolerated, in percents", NULL},
+  {NULL,}
+};
+
+typedef struct
+{
+  gint64 cpu_time;
+  MockVaStats va_stats;
+} Sample;
+
+typedef struct
+{
+  GstVaapiDisplay *display;
+  MockVaGetStatsFunc get_va_stats;
+  GKeyFile *baseline;
+  GKeyFile *results;
+  guint num_regressions;
+} App;
+
+static gint64
+get_cpu_time (void)
+{
+  struct timespec ts;
+
+  /* All threads, since encoders output from another one */
+  clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static void
+sample_start (App * app, Sample * sample)
+{
+  app->get_va_stats (&sample->va_stats);
+  sample->cpu_time = get_cpu_time ();
+}
+
+static void
+sample_end (App * app, Sample * sample, const gchar * name, guint num_frames)
+{
+  MockVaStats va_stats;
+  gdouble us_per_frame, baseline;
+  guint64 num_va_calls = 0;
+  guint i;
+
+  sample->cpu_time = get_cpu_time () - sample->cpu_time;
+  app->get_va_stats (&va_stats);
+  for (i = 0; i < MOCK_VA_N_CALLS; i++)
+    num_va_calls += va_stats.calls[i] - sample->va_stats.calls[i];
+
+  if (num_frames == 0)
+    g_error ("%s: no frame was output", name);
+  us_per_frame = (gdouble) sample->cpu_time / num_frames;
+
+  g_print ("%-14s %6u frames %10.1f us/frame %6.1f VA calls/frame"
+      " %6.1f buffers/frame %8.1f KB/frame", name, num_frames, us_per_frame,
+      (gdouble) num_va_calls / num_frames,
+      (gdouble) (va_stats.calls[MOCK_VA_CALL_CREATE_BUFFER] -
+          sample->va_stats.calls[MOCK_VA_CALL_CREATE_BUFFER]) / num_frames,
+      (gdouble) (va_stats.buffer_bytes - sample->va_stats.buffer_bytes) /
+      num_frames / 1024);
+
+  g_key_file_set_double (app->results, BASELINE_GROUP, name, us_per_frame);
+  if (app->baseline && g_key_file_has_key (app->baseline, BASELINE_GROUP,
+          name, NULL)) {
+    baseline = g_key_file_get_double (app->baseline, BASELINE_GROUP, name,
+        NULL);
+    g_print ("  %+6.1f%%", (us_per_frame / baseline - 1) * 100);
+    if (us_per_frame > baseline * (1 + g_tolerance / 100)) {
+      g_print ("  REGRESSION");
+      app->num_regressions++;
+    }
+  }
+  g_print ("\n");
+}
+
+static gboolean
+match_codec (const gchar * codec)
+{
+  return !g_codec_str || strcmp (g_codec_str, codec) == 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Decoders                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+static guint
+drain_decoder (GstVaapiDecoder * decoder)
+{
+  GstVaapiSurfaceProxy *proxy;
+  guint num_frames = 0;
+
+  while (gst_vaapi_decoder_get_surface (decoder, &proxy) ==
+      GST_VAAPI_DECODER_STATUS_SUCCESS) {
+    gst_vaapi_surface_proxy_unref (proxy);
+    num_frames++;
+  }
+  return num_frames;
+}
+
+static void
+bench_decoder (App * app, const gchar * codec)
+{
+  GstVaapiDecoder *decoder;
+  Sample sample;
+  gchar *name;
+  guint num_frames = 0, num_rounds = 0;
+
+  if (!match_codec (codec))
+    return;
+
+  decoder = decoder_new (app->display, codec);
+  if (!decoder)
+    g_error ("could not create %s decoder", codec);
+
+  /* The clip is sent over and over, as one stream */
+  sample_start (app, &sample);
+  while (num_frames < g_num_frames) {
+    if (++num_rounds > g_num_frames)
+      g_error ("%s decoder outputs no frame", codec);
+    if (!decoder_put_clip (decoder))
+      g_error ("could not send %s data", codec);
+    num_frames += drain_decoder (decoder);
+  }
+  gst_vaapi_decoder_put_buffer (decoder, NULL);
+  num_frames += drain_decoder (decoder);
+
+  name = g_strdup_printf ("decode-%s", codec);
+  sample_end (app, &sample, name, num_frames);
+  g_free (name);
+  gst_object_unref (decoder);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Encoders                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+#if USE_ENCODERS
+typedef GstVaapiEncoder *(*EncoderNewFunc) (GstVaapiDisplay * display);
+
+static guint
+drain_encoder (GstVaapiEncoder * encoder)
+{
+  GstVaapiCodedBufferProxy *proxy;
+  guint num_frames = 0;
+
+  while (gst_vaapi_encoder_get_buffer_with_timeout (encoder, &proxy, 0) ==
+      GST_VAAPI_ENCODER_STATUS_SUCCESS) {
+    if (gst_vaapi_coded_buffer_get_size
+        (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (proxy)) <= 0)
+      g_error ("invalid coded buffer");
+    gst_vaapi_coded_buffer_proxy_unref (proxy);
+    num_frames++;
+  }
+  return num_frames;
+}
+
+static gboolean
+set_format (GstVaapiEncoder * encoder)
+{
+  GstVideoCodecState *state;
+  GstVaapiEncoderStatus status;
+
+  state = g_slice_new0 (GstVideoCodecState);
+  state->ref_count = 1;
+  gst_video_info_set_format (&state->info, GST_VIDEO_FORMAT_ENCODED, g_width,
+      g_height);
+  state->info.fps_n = 30;
+  state->info.fps_d = 1;
+
+  status = gst_vaapi_encoder_set_codec_state (encoder, state);
+  g_slice_free (GstVideoCodecState, state);
+  return status == GST_VAAPI_ENCODER_STATUS_SUCCESS;
+}
+
+static gboolean
+put_frame (GstVaapiEncoder * encoder, GstVaapiVideoPool * pool, guint n)
+{
+  GstVaapiSurfaceProxy *proxy;
+  GstVideoCodecFrame *frame;
+  GstVaapiEncoderStatus status;
+
+  proxy = gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
+      (pool));
+  if (!proxy)
+    return FALSE;
+
+  frame = g_slice_new0 (GstVideoCodecFrame);
+  frame->ref_count = 1;
+  frame->system_frame_number = n;
+  frame->pts = gst_util_uint64_scale (n, GST_SECOND, 30);
+  frame->duration = GST_SECOND / 30;
+  gst_video_codec_frame_set_user_data (frame, proxy,
+      (GDestroyNotify) gst_vaapi_surface_proxy_unref);
+
+  status = gst_vaapi_encoder_put_frame (encoder, frame);
+  gst_video_codec_frame_unref (frame);
+  return status == GST_VAAPI_ENCODER_STATUS_SUCCESS;
+}
+
+static void
+bench_encoder (App * app, const gchar * codec, EncoderNewFunc encoder_new)
+{
+  GstVaapiEncoder *encoder;
+  GstVaapiVideoPool *pool;
+  GstVideoInfo vi;
+  Sample sample;
+  gchar *name;
+  guint i, num_frames = 0;
+
+  if (!match_codec (codec))
+    return;
+
+  encoder = encoder_new (app->display);
+  if (!encoder || !set_format (encoder))
+    g_error ("could not create %s encoder", codec);
+
+  gst_video_info_set_format (&vi, GST_VIDEO_FORMAT_ENCODED, g_width,
+      g_height);
+  pool = gst_vaapi_surface_pool_new_full (app->display, &vi, 0);
+  if (!pool)
+    g_error ("could not create surface pool");
+
+  sample_start (app, &sample);
+  for (i = 0; i < g_num_frames; i++) {
+    if (!put_frame (encoder, pool, i))
+      g_error ("could not encode %s frame %u", codec, i);
+    num_frames += drain_encoder (encoder);
+  }
+  if (gst_vaapi_encoder_flush (encoder) != GST_VAAPI_ENCODER_STATUS_SUCCESS)
+    g_error ("could not flush %s encoder", codec);
+  num_frames += drain_encoder (encoder);
+
+  name = g_strdup_printf ("encode-%s", codec);
+  sample_end (app, &sample, name, num_frames);
+  g_free (name);
+  gst_vaapi_video_pool_replace (&pool, NULL);
+  gst_object_unref (encoder);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- Main                                                              --- */
+/* ------------------------------------------------------------------------- */
+
+static void
+app_init (App * app)
+{
+  GError *error = NULL;
+  gpointer handle;
+
+  memset (app, 0, sizeof (*app));
+
+  /* A real DRM device is not needed, nor touched */
+  app->display = gst_vaapi_display_drm_new ("/dev/null");
+  if (!app->display)
+    g_error ("could not open the mock VA driver from %s",
+        g_getenv ("LIBVA_DRIVERS_PATH"));
+
+  /* libva loads the driver with RTLD_GLOBAL */
+  handle = dlopen (NULL, RTLD_LAZY);
+  app->get_va_stats = handle ? (MockVaGetStatsFunc) dlsym (handle,
+      MOCK_VA_GET_STATS_SYMBOL) : NULL;
+  if (!app->get_va_stats)
+    g_error ("the VA driver is not the mock one (%s)",
+        gst_vaapi_display_get_vendor_string (app->display));
+
+  app->results = g_key_file_new ();
+  if (g_baseline) {
+    app->baseline = g_key_file_new ();
+    if (!g_key_file_load_from_file (app->baseline, g_baseline,
+            G_KEY_FILE_NONE, &error))
+      g_error ("could not load baseline %s: %s", g_baseline, error->message);
+  }
+}
+
+static void
+app_finalize (App * app)
+{
+  GError *error = NULL;
+
+  if (g_write_baseline && !g_key_file_save_to_file (app->results,
+          g_write_baseline, &error))
+    g_error ("could not save baseline %s: %s", g_write_baseline,
+        error->message);
+
+  if (app->baseline)
+    g_key_file_unref (app->baseline);
+  g_key_file_unref (app->results);
+  gst_object_unref (app->display);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  App app;
+  gboolean success;
+
+  ctx = g_option_context_new ("- codecs benchmark on a mock VA driver");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success)
+    return EXIT_FAILURE;
+
+  if (g_num_frames <= 0 || g_width <= 0 || g_height <= 0)
+    g_error ("invalid benchmark parameters");
+
+  /* The results must not depend on what a previous run cached */
+  g_setenv ("LIBVA_DRIVER_NAME", MOCK_VA_DRIVER_NAME, TRUE);
+  g_setenv ("LIBVA_DRIVERS_PATH", MOCK_VA_DRIVERS_PATH, FALSE);
+  g_setenv ("GST_VAAPI_DISABLE_DRIVER_CACHE", "1", TRUE);
+
+  app_init (&app);
+
+  bench_decoder (&app, "jpeg");
+  bench_decoder (&app, "mpeg2");
+  bench_decoder (&app, "mpeg4");
+  bench_decoder (&app, "h264");
+  bench_decoder (&app, "vc1");
+
+#if USE_ENCODERS
+  bench_encoder (&app, "jpeg", gst_vaapi_encoder_jpeg_new);
+  bench_encoder (&app, "mpeg2", gst_vaapi_encoder_mpeg2_new);
+  bench_encoder (&app, "h264", gst_vaapi_encoder_h264_new);
+  bench_encoder (&app, "h265", gst_vaapi_encoder_h265_new);
+  bench_encoder (&app, "vp8", gst_vaapi_encoder_vp8_new);
+#if USE_VP9_ENCODER
+  bench_encoder (&app, "vp9", gst_vaapi_encoder_vp9_new);
+#endif
+#endif
+
+  app_finalize (&app);
+  gst_deinit ();
+
+  if (app.num_regressions > 0) {
+    g_printerr ("%u codecs slower than the baseline by more than %.0f%%\n",
+        app.num_regressions, g_tolerance);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
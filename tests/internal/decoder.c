@@ -135,7 +135,7 @@ decoder_new (GstVaapiDisplay * display, const gchar * codec_name)
 }
 
 gboolean
-decoder_put_buffers (GstVaapiDecoder * decoder)
+decoder_put_clip (GstVaapiDecoder * decoder)
 {
   const CodecDefs *codec;
   VideoDecodeInfo info;
@@ -161,6 +161,14 @@ decoder_put_buffers (GstVaapiDecoder * decoder)
     GST_ERROR ("failed to send video data to the decoder");
     return FALSE;
   }
+  return TRUE;
+}
+
+gboolean
+decoder_put_buffers (GstVaapiDecoder * decoder)
+{
+  if (!decoder_put_clip (decoder))
+    return FALSE;
 
   if (!gst_vaapi_decoder_put_buffer (decoder, NULL)) {
     GST_ERROR ("failed to submit <end-of-stream> to the decoder");
@@ -28,6 +28,9 @@
 GstVaapiDecoder *
 decoder_new(GstVaapiDisplay *display, const gchar *codec_name);
 
+gboolean
+decoder_put_clip(GstVaapiDecoder *decoder);
+
 gboolean
 decoder_put_buffers(GstVaapiDecoder *decoder);
 
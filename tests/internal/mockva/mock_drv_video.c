@@ -0,0 +1,998 @@
+/*
+ *  mock_drv_video.c - Mock VA driver for hardware-free benchmarks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* A VA driver which accepts configs, contexts, surfaces, buffers and
+   images without touching any hardware: pictures are never decoded or
+   encoded, and every surface is ready at once. The buffers and images
+   are backed by system memory, so that the library fills and reads
+   them as with a real driver, and coded buffers always hold the same
+   few bytes. The calls are counted, see mockva.h.
+
+   This makes the CPU cost of the library itself (parsers, DPB
+   management, reordering, bitstream writers, buffer management)
+   measurable on any machine. Load it with LIBVA_DRIVER_NAME=mock and
+   LIBVA_DRIVERS_PATH set to the build directory */
+
+#include <string.h>
+#include <va/va.h>
+#include <va/va_backend.h>
+#include "mockva.h"
+
+#define MOCK_VENDOR "Mock VA driver for benchmarks"
+#define MOCK_MAX_WIDTH 8192
+#define MOCK_MAX_HEIGHT 8192
+#define MOCK_CODED_SIZE 64
+#define MOCK_NUM_CONFIG_ATTRIBUTES 1
+#define MOCK_NUM_DISPLAY_ATTRIBUTES 1
+
+typedef enum
+{
+  OBJECT_CONFIG = 1,
+  OBJECT_SURFACE,
+  OBJECT_CONTEXT,
+  OBJECT_BUFFER,
+  OBJECT_IMAGE,
+  OBJECT_SUBPICTURE,
+} ObjectType;
+
+typedef struct
+{
+  ObjectType type;
+  union
+  {
+    struct
+    {
+      VAProfile profile;
+      VAEntrypoint entrypoint;
+    } config;
+    struct
+    {
+      guint width;
+      guint height;
+    } surface;
+    struct
+    {
+      VABufferType type;
+      guint size;
+      guint num_elements;
+      guint8 *data;
+    } buffer;
+    VAImage image;
+  } u;
+} Object;
+
+typedef struct
+{
+  GMutex lock;
+  GHashTable *objects;          /* ID -> Object */
+  guint next_id;
+} MockDriver;
+
+typedef struct
+{
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+} ProfileMap;
+
+static const ProfileMap mock_profiles[] = {
+  {VAProfileMPEG2Simple, VAEntrypointVLD},
+  {VAProfileMPEG2Main, VAEntrypointVLD},
+  {VAProfileMPEG4Simple, VAEntrypointVLD},
+  {VAProfileMPEG4AdvancedSimple, VAEntrypointVLD},
+  {VAProfileMPEG4Main, VAEntrypointVLD},
+  {VAProfileH264ConstrainedBaseline, VAEntrypointVLD},
+  {VAProfileH264Main, VAEntrypointVLD},
+  {VAProfileH264High, VAEntrypointVLD},
+  {VAProfileVC1Simple, VAEntrypointVLD},
+  {VAProfileVC1Main, VAEntrypointVLD},
+  {VAProfileVC1Advanced, VAEntrypointVLD},
+  {VAProfileJPEGBaseline, VAEntrypointVLD},
+  {VAProfileHEVCMain, VAEntrypointVLD},
+  {VAProfileVP8Version0_3, VAEntrypointVLD},
+  {VAProfileVP9Profile0, VAEntrypointVLD},
+  {VAProfileMPEG2Simple, VAEntrypointEncSlice},
+  {VAProfileMPEG2Main, VAEntrypointEncSlice},
+  {VAProfileH264ConstrainedBaseline, VAEntrypointEncSlice},
+  {VAProfileH264Main, VAEntrypointEncSlice},
+  {VAProfileH264High, VAEntrypointEncSlice},
+  {VAProfileJPEGBaseline, VAEntrypointEncPicture},
+  {VAProfileHEVCMain, VAEntrypointEncSlice},
+  {VAProfileVP8Version0_3, VAEntrypointEncSlice},
+  {VAProfileVP9Profile0, VAEntrypointEncSlice},
+};
+
+static const VAImageFormat mock_image_formats[] = {
+  {VA_FOURCC_NV12, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_I420, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_YV12, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_YUY2, VA_LSB_FIRST, 16,},
+};
+
+static const VAImageFormat mock_subpicture_formats[] = {
+  {VA_FOURCC_BGRA, VA_LSB_FIRST, 32, 32, 0x00ff0000, 0x0000ff00,
+      0x000000ff, 0xff000000},
+};
+
+static const guint8 mock_coded_data[MOCK_CODED_SIZE] = { 0, 0, 0, 1, };
+
+static MockVaStats mock_stats;
+static GMutex mock_stats_lock;
+
+/* Exported for the benchmarks, see mockva.h */
+void mock_va_get_stats (MockVaStats * stats);
+
+void
+mock_va_get_stats (MockVaStats * stats)
+{
+  g_mutex_lock (&mock_stats_lock);
+  *stats = mock_stats;
+  g_mutex_unlock (&mock_stats_lock);
+}
+
+static void
+count_call (MockVaCall call)
+{
+  g_mutex_lock (&mock_stats_lock);
+  mock_stats.calls[call]++;
+  g_mutex_unlock (&mock_stats_lock);
+}
+
+static inline MockDriver *
+get_driver (VADriverContextP ctx)
+{
+  return ctx->pDriverData;
+}
+
+static void
+object_free (gpointer data)
+{
+  Object *const object = data;
+
+  if (object->type == OBJECT_BUFFER)
+    g_free (object->u.buffer.data);
+  g_slice_free (Object, object);
+}
+
+static Object *
+object_new (MockDriver * driver, ObjectType type, guint * id_ptr)
+{
+  Object *const object = g_slice_new0 (Object);
+
+  object->type = type;
+  g_mutex_lock (&driver->lock);
+  *id_ptr = ++driver->next_id;
+  g_hash_table_insert (driver->objects, GUINT_TO_POINTER (*id_ptr), object);
+  g_mutex_unlock (&driver->lock);
+  return object;
+}
+
+static Object *
+object_lookup (MockDriver * driver, ObjectType type, guint id)
+{
+  Object *object;
+
+  g_mutex_lock (&driver->lock);
+  object = g_hash_table_lookup (driver->objects, GUINT_TO_POINTER (id));
+  g_mutex_unlock (&driver->lock);
+  return object && object->type == type ? object : NULL;
+}
+
+static gboolean
+object_destroy (MockDriver * driver, ObjectType type, guint id)
+{
+  Object *object;
+  gboolean success = FALSE;
+
+  g_mutex_lock (&driver->lock);
+  object = g_hash_table_lookup (driver->objects, GUINT_TO_POINTER (id));
+  if (object && object->type == type)
+    success = g_hash_table_remove (driver->objects, GUINT_TO_POINTER (id));
+  g_mutex_unlock (&driver->lock);
+  return success;
+}
+
+static Object *
+buffer_new (MockDriver * driver, VABufferType type, guint size,
+    guint num_elements, VABufferID * buf_id)
+{
+  Object *const object = object_new (driver, OBJECT_BUFFER, buf_id);
+  gsize alloc_size = (gsize) size * num_elements;
+
+  if (type == VAEncCodedBufferType)
+    alloc_size += sizeof (VAEncCodedBufferSegment);
+
+  object->u.buffer.type = type;
+  object->u.buffer.size = size;
+  object->u.buffer.num_elements = num_elements;
+  object->u.buffer.data = g_malloc0 (MAX (alloc_size, 1));
+
+  g_mutex_lock (&mock_stats_lock);
+  mock_stats.calls[MOCK_VA_CALL_CREATE_BUFFER]++;
+  mock_stats.buffer_bytes += alloc_size;
+  g_mutex_unlock (&mock_stats_lock);
+  return object;
+}
+
+static VAStatus
+mock_Terminate (VADriverContextP ctx)
+{
+  MockDriver *const driver = get_driver (ctx);
+
+  g_hash_table_unref (driver->objects);
+  g_mutex_clear (&driver->lock);
+  g_free (driver);
+  ctx->pDriverData = NULL;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_QueryConfigProfiles (VADriverContextP ctx, VAProfile * profile_list,
+    int *num_profiles)
+{
+  guint i, j, n = 0;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  for (i = 0; i < G_N_ELEMENTS (mock_profiles); i++) {
+    for (j = 0; j < n; j++) {
+      if (profile_list[j] == mock_profiles[i].profile)
+        break;
+    }
+    if (j == n)
+      profile_list[n++] = mock_profiles[i].profile;
+  }
+  *num_profiles = n;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_QueryConfigEntrypoints (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint * entrypoint_list, int *num_entrypoints)
+{
+  guint i, n = 0;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  for (i = 0; i < G_N_ELEMENTS (mock_profiles); i++) {
+    if (mock_profiles[i].profile == profile)
+      entrypoint_list[n++] = mock_profiles[i].entrypoint;
+  }
+  *num_entrypoints = n;
+  return n > 0 ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+}
+
+/* Number of distinct profiles in mock_profiles */
+static guint
+get_num_profiles (void)
+{
+  guint i, j, n = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (mock_profiles); i++) {
+    for (j = 0; j < i; j++) {
+      if (mock_profiles[j].profile == mock_profiles[i].profile)
+        break;
+    }
+    if (j == i)
+      n++;
+  }
+  return n;
+}
+
+/* Largest number of entrypoints of a profile in mock_profiles */
+static guint
+get_max_entrypoints (void)
+{
+  guint i, j, n, max_n = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (mock_profiles); i++) {
+    for (j = 0, n = 0; j < G_N_ELEMENTS (mock_profiles); j++) {
+      if (mock_profiles[j].profile == mock_profiles[i].profile)
+        n++;
+    }
+    max_n = MAX (max_n, n);
+  }
+  return max_n;
+}
+
+static gboolean
+is_supported (VAProfile profile, VAEntrypoint entrypoint)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (mock_profiles); i++) {
+    if (mock_profiles[i].profile == profile &&
+        mock_profiles[i].entrypoint == entrypoint)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static guint
+get_attribute_value (VAEntrypoint entrypoint, VAConfigAttribType type)
+{
+  const gboolean encode = entrypoint != VAEntrypointVLD;
+
+  switch (type) {
+    case VAConfigAttribRTFormat:
+      return VA_RT_FORMAT_YUV420;
+    case VAConfigAttribRateControl:
+      return encode ? VA_RC_CQP | VA_RC_CBR | VA_RC_VBR :
+          VA_ATTRIB_NOT_SUPPORTED;
+    case VAConfigAttribEncPackedHeaders:
+      return encode ? VA_ENC_PACKED_HEADER_SEQUENCE |
+          VA_ENC_PACKED_HEADER_PICTURE | VA_ENC_PACKED_HEADER_SLICE |
+          VA_ENC_PACKED_HEADER_RAW_DATA : VA_ATTRIB_NOT_SUPPORTED;
+    case VAConfigAttribEncJPEG:
+      return entrypoint == VAEntrypointEncPicture ? 0 :
+          VA_ATTRIB_NOT_SUPPORTED;
+    case VAConfigAttribEncMaxRefFrames:
+      /* 4 references in L0, 1 in L1 */
+      return encode ? (1 << 16) | 4 : VA_ATTRIB_NOT_SUPPORTED;
+    case VAConfigAttribEncMaxSlices:
+      return encode ? 32 : VA_ATTRIB_NOT_SUPPORTED;
+    default:
+      return VA_ATTRIB_NOT_SUPPORTED;
+  }
+}
+
+static VAStatus
+mock_GetConfigAttributes (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attrib_list, int num_attribs)
+{
+  gint i;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!is_supported (profile, entrypoint))
+    return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+  for (i = 0; i < num_attribs; i++)
+    attrib_list[i].value = get_attribute_value (entrypoint,
+        attrib_list[i].type);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_CreateConfig (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attrib_list, int num_attribs,
+    VAConfigID * config_id)
+{
+  Object *object;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!is_supported (profile, entrypoint))
+    return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+  object = object_new (get_driver (ctx), OBJECT_CONFIG, config_id);
+  object->u.config.profile = profile;
+  object->u.config.entrypoint = entrypoint;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_DestroyConfig (VADriverContextP ctx, VAConfigID config_id)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!object_destroy (get_driver (ctx), OBJECT_CONFIG, config_id))
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_QueryConfigAttributes (VADriverContextP ctx, VAConfigID config_id,
+    VAProfile * profile, VAEntrypoint * entrypoint,
+    VAConfigAttrib * attrib_list, int *num_attribs)
+{
+  Object *object;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  object = object_lookup (get_driver (ctx), OBJECT_CONFIG, config_id);
+  if (!object)
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+
+  *profile = object->u.config.profile;
+  *entrypoint = object->u.config.entrypoint;
+  attrib_list[0].type = VAConfigAttribRTFormat;
+  attrib_list[0].value = VA_RT_FORMAT_YUV420;
+  *num_attribs = MOCK_NUM_CONFIG_ATTRIBUTES;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+create_surfaces (VADriverContextP ctx, guint width, guint height,
+    VASurfaceID * surfaces, guint num_surfaces)
+{
+  Object *object;
+  guint i;
+
+  count_call (MOCK_VA_CALL_CREATE_SURFACES);
+  if (width == 0 || height == 0 || width > MOCK_MAX_WIDTH ||
+      height > MOCK_MAX_HEIGHT)
+    return VA_STATUS_ERROR_RESOLUTION_NOT_SUPPORTED;
+
+  for (i = 0; i < num_surfaces; i++) {
+    object = object_new (get_driver (ctx), OBJECT_SURFACE, &surfaces[i]);
+    object->u.surface.width = width;
+    object->u.surface.height = height;
+  }
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_CreateSurfaces (VADriverContextP ctx, int width, int height, int format,
+    int num_surfaces, VASurfaceID * surfaces)
+{
+  return create_surfaces (ctx, width, height, surfaces, num_surfaces);
+}
+
+static VAStatus
+mock_CreateSurfaces2 (VADriverContextP ctx, unsigned int format,
+    unsigned int width, unsigned int height, VASurfaceID * surfaces,
+    unsigned int num_surfaces, VASurfaceAttrib * attrib_list,
+    unsigned int num_attribs)
+{
+  guint i;
+
+  /* Only VA memory, nothing is imported */
+  for (i = 0; i < num_attribs; i++) {
+    if (attrib_list[i].type == VASurfaceAttribMemoryType &&
+        attrib_list[i].value.value.i != VA_SURFACE_ATTRIB_MEM_TYPE_VA)
+      return VA_STATUS_ERROR_UNSUPPORTED_MEMORY_TYPE;
+  }
+  return create_surfaces (ctx, width, height, surfaces, num_surfaces);
+}
+
+static VAStatus
+mock_DestroySurfaces (VADriverContextP ctx, VASurfaceID * surface_list,
+    int num_surfaces)
+{
+  MockDriver *const driver = get_driver (ctx);
+  gint i;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  for (i = 0; i < num_surfaces; i++) {
+    if (!object_destroy (driver, OBJECT_SURFACE, surface_list[i]))
+      return VA_STATUS_ERROR_INVALID_SURFACE;
+  }
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_QuerySurfaceAttributes (VADriverContextP ctx, VAConfigID config_id,
+    VASurfaceAttrib * attrib_list, unsigned int *num_attribs)
+{
+  static const struct
+  {
+    VASurfaceAttribType type;
+    guint flags;
+    gint value;
+  } attribs[] = {
+    {VASurfaceAttribPixelFormat, VA_SURFACE_ATTRIB_GETTABLE |
+          VA_SURFACE_ATTRIB_SETTABLE, VA_FOURCC_NV12},
+    {VASurfaceAttribPixelFormat, VA_SURFACE_ATTRIB_GETTABLE |
+          VA_SURFACE_ATTRIB_SETTABLE, VA_FOURCC_I420},
+    {VASurfaceAttribMinWidth, VA_SURFACE_ATTRIB_GETTABLE, 1},
+    {VASurfaceAttribMinHeight, VA_SURFACE_ATTRIB_GETTABLE, 1},
+    {VASurfaceAttribMaxWidth, VA_SURFACE_ATTRIB_GETTABLE, MOCK_MAX_WIDTH},
+    {VASurfaceAttribMaxHeight, VA_SURFACE_ATTRIB_GETTABLE, MOCK_MAX_HEIGHT},
+    {VASurfaceAttribMemoryType, VA_SURFACE_ATTRIB_GETTABLE |
+          VA_SURFACE_ATTRIB_SETTABLE, VA_SURFACE_ATTRIB_MEM_TYPE_VA},
+  };
+  guint i;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!object_lookup (get_driver (ctx), OBJECT_CONFIG, config_id))
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+
+  if (!attrib_list) {
+    *num_attribs = G_N_ELEMENTS (attribs);
+    return VA_STATUS_SUCCESS;
+  }
+  if (*num_attribs < G_N_ELEMENTS (attribs)) {
+    *num_attribs = G_N_ELEMENTS (attribs);
+    return VA_STATUS_ERROR_MAX_NUM_EXCEEDED;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (attribs); i++) {
+    attrib_list[i].type = attribs[i].type;
+    attrib_list[i].flags = attribs[i].flags;
+    attrib_list[i].value.type = VAGenericValueTypeInteger;
+    attrib_list[i].value.value.i = attribs[i].value;
+  }
+  *num_attribs = G_N_ELEMENTS (attribs);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_CreateContext (VADriverContextP ctx, VAConfigID config_id,
+    int picture_width, int picture_height, int flag,
+    VASurfaceID * render_targets, int num_render_targets,
+    VAContextID * context)
+{
+  MockDriver *const driver = get_driver (ctx);
+
+  count_call (MOCK_VA_CALL_CREATE_CONTEXT);
+  if (!object_lookup (driver, OBJECT_CONFIG, config_id))
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+
+  object_new (driver, OBJECT_CONTEXT, context);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_DestroyContext (VADriverContextP ctx, VAContextID context)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!object_destroy (get_driver (ctx), OBJECT_CONTEXT, context))
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_CreateBuffer (VADriverContextP ctx, VAContextID context,
+    VABufferType type, unsigned int size, unsigned int num_elements,
+    void *data, VABufferID * buf_id)
+{
+  Object *object;
+
+  object = buffer_new (get_driver (ctx), type, size, num_elements, buf_id);
+  if (data && type != VAEncCodedBufferType)
+    memcpy (object->u.buffer.data, data, (gsize) size * num_elements);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_BufferSetNumElements (VADriverContextP ctx, VABufferID buf_id,
+    unsigned int num_elements)
+{
+  Object *object;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  object = object_lookup (get_driver (ctx), OBJECT_BUFFER, buf_id);
+  if (!object)
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  if (num_elements > object->u.buffer.num_elements)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+  object->u.buffer.num_elements = num_elements;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_MapBuffer (VADriverContextP ctx, VABufferID buf_id, void **pbuf)
+{
+  Object *object;
+
+  count_call (MOCK_VA_CALL_MAP_BUFFER);
+  object = object_lookup (get_driver (ctx), OBJECT_BUFFER, buf_id);
+  if (!object)
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+
+  /* Coded buffers always hold the same bytes */
+  if (object->u.buffer.type == VAEncCodedBufferType) {
+    VAEncCodedBufferSegment *const segment =
+        (VAEncCodedBufferSegment *) object->u.buffer.data;
+    const guint size = MIN (object->u.buffer.size, MOCK_CODED_SIZE);
+
+    memset (segment, 0, sizeof (*segment));
+    segment->size = size;
+    segment->buf = segment + 1;
+    memcpy (segment->buf, mock_coded_data, size);
+  }
+  *pbuf = object->u.buffer.data;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_UnmapBuffer (VADriverContextP ctx, VABufferID buf_id)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!object_lookup (get_driver (ctx), OBJECT_BUFFER, buf_id))
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_DestroyBuffer (VADriverContextP ctx, VABufferID buffer_id)
+{
+  count_call (MOCK_VA_CALL_DESTROY_BUFFER);
+  if (!object_destroy (get_driver (ctx), OBJECT_BUFFER, buffer_id))
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_BeginPicture (VADriverContextP ctx, VAContextID context,
+    VASurfaceID render_target)
+{
+  MockDriver *const driver = get_driver (ctx);
+
+  count_call (MOCK_VA_CALL_BEGIN_PICTURE);
+  if (!object_lookup (driver, OBJECT_CONTEXT, context))
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+  if (!object_lookup (driver, OBJECT_SURFACE, render_target))
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_RenderPicture (VADriverContextP ctx, VAContextID context,
+    VABufferID * buffers, int num_buffers)
+{
+  MockDriver *const driver = get_driver (ctx);
+  gint i;
+
+  count_call (MOCK_VA_CALL_RENDER_PICTURE);
+  if (!object_lookup (driver, OBJECT_CONTEXT, context))
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+  for (i = 0; i < num_buffers; i++) {
+    if (!object_lookup (driver, OBJECT_BUFFER, buffers[i]))
+      return VA_STATUS_ERROR_INVALID_BUFFER;
+  }
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_EndPicture (VADriverContextP ctx, VAContextID context)
+{
+  count_call (MOCK_VA_CALL_END_PICTURE);
+  if (!object_lookup (get_driver (ctx), OBJECT_CONTEXT, context))
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_SyncSurface (VADriverContextP ctx, VASurfaceID render_target)
+{
+  count_call (MOCK_VA_CALL_SYNC_SURFACE);
+  if (!object_lookup (get_driver (ctx), OBJECT_SURFACE, render_target))
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_QuerySurfaceStatus (VADriverContextP ctx, VASurfaceID render_target,
+    VASurfaceStatus * status)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!object_lookup (get_driver (ctx), OBJECT_SURFACE, render_target))
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  *status = VASurfaceReady;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_PutSurface (VADriverContextP ctx, VASurfaceID surface, void *draw,
+    short srcx, short srcy, unsigned short srcw, unsigned short srch,
+    short destx, short desty, unsigned short destw, unsigned short desth,
+    VARectangle * cliprects, unsigned int number_cliprects,
+    unsigned int flags)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+mock_QueryImageFormats (VADriverContextP ctx, VAImageFormat * format_list,
+    int *num_formats)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  memcpy (format_list, mock_image_formats, sizeof (mock_image_formats));
+  *num_formats = G_N_ELEMENTS (mock_image_formats);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_CreateImage (VADriverContextP ctx, VAImageFormat * format, int width,
+    int height, VAImage * image)
+{
+  MockDriver *const driver = get_driver (ctx);
+  const guint pitch = (width + 15) & ~15;
+  const guint height2 = (height + 1) & ~1;
+  Object *object;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  if (width <= 0 || height <= 0)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+  memset (image, 0, sizeof (*image));
+  image->format = *format;
+  image->width = width;
+  image->height = height;
+  switch (format->fourcc) {
+    case VA_FOURCC_NV12:
+      image->num_planes = 2;
+      image->pitches[0] = image->pitches[1] = pitch;
+      image->offsets[1] = pitch * height2;
+      image->data_size = pitch * height2 * 3 / 2;
+      break;
+    case VA_FOURCC_I420:
+    case VA_FOURCC_YV12:
+      image->num_planes = 3;
+      image->pitches[0] = pitch;
+      image->pitches[1] = image->pitches[2] = pitch / 2;
+      image->offsets[1] = pitch * height2;
+      image->offsets[2] = image->offsets[1] + pitch / 2 * height2 / 2;
+      image->data_size = pitch * height2 * 3 / 2;
+      break;
+    case VA_FOURCC_YUY2:
+      image->num_planes = 1;
+      image->pitches[0] = pitch * 2;
+      image->data_size = pitch * 2 * height;
+      break;
+    default:
+      return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+  }
+
+  object = object_new (driver, OBJECT_IMAGE, &image->image_id);
+  buffer_new (driver, VAImageBufferType, image->data_size, 1, &image->buf);
+  object->u.image = *image;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_DeriveImage (VADriverContextP ctx, VASurfaceID surface, VAImage * image)
+{
+  /* Surfaces have no storage, the library copies through images */
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+
+static VAStatus
+mock_DestroyImage (VADriverContextP ctx, VAImageID image)
+{
+  MockDriver *const driver = get_driver (ctx);
+  Object *object;
+  VABufferID buf;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  object = object_lookup (driver, OBJECT_IMAGE, image);
+  if (!object)
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  buf = object->u.image.buf;
+  object_destroy (driver, OBJECT_IMAGE, image);
+  object_destroy (driver, OBJECT_BUFFER, buf);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_SetImagePalette (VADriverContextP ctx, VAImageID image,
+    unsigned char *palette)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+mock_GetImage (VADriverContextP ctx, VASurfaceID surface, int x, int y,
+    unsigned int width, unsigned int height, VAImageID image)
+{
+  MockDriver *const driver = get_driver (ctx);
+
+  count_call (MOCK_VA_CALL_GET_IMAGE);
+  if (!object_lookup (driver, OBJECT_SURFACE, surface))
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  if (!object_lookup (driver, OBJECT_IMAGE, image))
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_PutImage (VADriverContextP ctx, VASurfaceID surface, VAImageID image,
+    int src_x, int src_y, unsigned int src_width, unsigned int src_height,
+    int dest_x, int dest_y, unsigned int dest_width,
+    unsigned int dest_height)
+{
+  MockDriver *const driver = get_driver (ctx);
+
+  count_call (MOCK_VA_CALL_PUT_IMAGE);
+  if (!object_lookup (driver, OBJECT_SURFACE, surface))
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  if (!object_lookup (driver, OBJECT_IMAGE, image))
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_QuerySubpictureFormats (VADriverContextP ctx,
+    VAImageFormat * format_list, unsigned int *flags,
+    unsigned int *num_formats)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  memcpy (format_list, mock_subpicture_formats,
+      sizeof (mock_subpicture_formats));
+  if (flags)
+    memset (flags, 0, sizeof (*flags) * G_N_ELEMENTS
+        (mock_subpicture_formats));
+  *num_formats = G_N_ELEMENTS (mock_subpicture_formats);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_CreateSubpicture (VADriverContextP ctx, VAImageID image,
+    VASubpictureID * subpicture)
+{
+  MockDriver *const driver = get_driver (ctx);
+
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!object_lookup (driver, OBJECT_IMAGE, image))
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  object_new (driver, OBJECT_SUBPICTURE, subpicture);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_DestroySubpicture (VADriverContextP ctx, VASubpictureID subpicture)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  if (!object_destroy (get_driver (ctx), OBJECT_SUBPICTURE, subpicture))
+    return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_SetSubpictureImage (VADriverContextP ctx, VASubpictureID subpicture,
+    VAImageID image)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_SetSubpictureChromakey (VADriverContextP ctx, VASubpictureID subpicture,
+    unsigned int chromakey_min, unsigned int chromakey_max,
+    unsigned int chromakey_mask)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_SetSubpictureGlobalAlpha (VADriverContextP ctx,
+    VASubpictureID subpicture, float global_alpha)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_AssociateSubpicture (VADriverContextP ctx, VASubpictureID subpicture,
+    VASurfaceID * target_surfaces, int num_surfaces, short src_x,
+    short src_y, unsigned short src_width, unsigned short src_height,
+    short dest_x, short dest_y, unsigned short dest_width,
+    unsigned short dest_height, unsigned int flags)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_DeassociateSubpicture (VADriverContextP ctx, VASubpictureID subpicture,
+    VASurfaceID * target_surfaces, int num_surfaces)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_QueryDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attr_list, int *num_attributes)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  memset (attr_list, 0, sizeof (*attr_list));
+  attr_list[0].type = VADisplayAttribRotation;
+  attr_list[0].max_value = VA_ROTATION_270;
+  attr_list[0].value = VA_ROTATION_NONE;
+  attr_list[0].flags = VA_DISPLAY_ATTRIB_GETTABLE;
+  *num_attributes = MOCK_NUM_DISPLAY_ATTRIBUTES;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_GetDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attr_list, int num_attributes)
+{
+  gint i;
+
+  count_call (MOCK_VA_CALL_OTHER);
+  for (i = 0; i < num_attributes; i++) {
+    if (attr_list[i].type != VADisplayAttribRotation)
+      return VA_STATUS_ERROR_ATTR_NOT_SUPPORTED;
+    attr_list[i].value = VA_ROTATION_NONE;
+  }
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_SetDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attr_list, int num_attributes)
+{
+  count_call (MOCK_VA_CALL_OTHER);
+  return VA_STATUS_ERROR_ATTR_NOT_SUPPORTED;
+}
+
+#define DRIVER_INIT_FUNC_(major, minor) __vaDriverInit_##major##_##minor
+#define DRIVER_INIT_FUNC(major, minor) DRIVER_INIT_FUNC_(major, minor)
+#define MOCK_DRIVER_INIT \
+  DRIVER_INIT_FUNC (VA_MAJOR_VERSION, VA_MINOR_VERSION)
+
+VAStatus MOCK_DRIVER_INIT (VADriverContextP ctx);
+
+VAStatus
+MOCK_DRIVER_INIT (VADriverContextP ctx)
+{
+  struct VADriverVTable *const vtable = ctx->vtable;
+  MockDriver *driver;
+
+  driver = g_new0 (MockDriver, 1);
+  g_mutex_init (&driver->lock);
+  driver->objects = g_hash_table_new_full (NULL, NULL, NULL, object_free);
+  ctx->pDriverData = driver;
+
+  ctx->version_major = VA_MAJOR_VERSION;
+  ctx->version_minor = VA_MINOR_VERSION;
+  /* libva sizes the lists given to the Query functions from these */
+  ctx->max_profiles = get_num_profiles ();
+  ctx->max_entrypoints = get_max_entrypoints ();
+  ctx->max_attributes = MOCK_NUM_CONFIG_ATTRIBUTES;
+  ctx->max_image_formats = G_N_ELEMENTS (mock_image_formats);
+  ctx->max_subpic_formats = G_N_ELEMENTS (mock_subpicture_formats);
+  ctx->max_display_attributes = MOCK_NUM_DISPLAY_ATTRIBUTES;
+  ctx->str_vendor = MOCK_VENDOR;
+
+  vtable->vaTerminate = mock_Terminate;
+  vtable->vaQueryConfigProfiles = mock_QueryConfigProfiles;
+  vtable->vaQueryConfigEntrypoints = mock_QueryConfigEntrypoints;
+  vtable->vaGetConfigAttributes = mock_GetConfigAttributes;
+  vtable->vaCreateConfig = mock_CreateConfig;
+  vtable->vaDestroyConfig = mock_DestroyConfig;
+  vtable->vaQueryConfigAttributes = mock_QueryConfigAttributes;
+  vtable->vaCreateSurfaces = mock_CreateSurfaces;
+  vtable->vaCreateSurfaces2 = mock_CreateSurfaces2;
+  vtable->vaDestroySurfaces = mock_DestroySurfaces;
+  vtable->vaQuerySurfaceAttributes = mock_QuerySurfaceAttributes;
+  vtable->vaCreateContext = mock_CreateContext;
+  vtable->vaDestroyContext = mock_DestroyContext;
+  vtable->vaCreateBuffer = mock_CreateBuffer;
+  vtable->vaBufferSetNumElements = mock_BufferSetNumElements;
+  vtable->vaMapBuffer = mock_MapBuffer;
+  vtable->vaUnmapBuffer = mock_UnmapBuffer;
+  vtable->vaDestroyBuffer = mock_DestroyBuffer;
+  vtable->vaBeginPicture = mock_BeginPicture;
+  vtable->vaRenderPicture = mock_RenderPicture;
+  vtable->vaEndPicture = mock_EndPicture;
+  vtable->vaSyncSurface = mock_SyncSurface;
+  vtable->vaQuerySurfaceStatus = mock_QuerySurfaceStatus;
+  vtable->vaPutSurface = mock_PutSurface;
+  vtable->vaQueryImageFormats = mock_QueryImageFormats;
+  vtable->vaCreateImage = mock_CreateImage;
+  vtable->vaDeriveImage = mock_DeriveImage;
+  vtable->vaDestroyImage = mock_DestroyImage;
+  vtable->vaSetImagePalette = mock_SetImagePalette;
+  vtable->vaGetImage = mock_GetImage;
+  vtable->vaPutImage = mock_PutImage;
+  vtable->vaQuerySubpictureFormats = mock_QuerySubpictureFormats;
+  vtable->vaCreateSubpicture = mock_CreateSubpicture;
+  vtable->vaDestroySubpicture = mock_DestroySubpicture;
+  vtable->vaSetSubpictureImage = mock_SetSubpictureImage;
+  vtable->vaSetSubpictureChromakey = mock_SetSubpictureChromakey;
+  vtable->vaSetSubpictureGlobalAlpha = mock_SetSubpictureGlobalAlpha;
+  vtable->vaAssociateSubpicture = mock_AssociateSubpicture;
+  vtable->vaDeassociateSubpicture = mock_DeassociateSubpicture;
+  vtable->vaQueryDisplayAttributes = mock_QueryDisplayAttributes;
+  vtable->vaGetDisplayAttributes = mock_GetDisplayAttributes;
+  vtable->vaSetDisplayAttributes = mock_SetDisplayAttributes;
+  return VA_STATUS_SUCCESS;
+}
@@ -0,0 +1,61 @@
+/*
+ *  mockva.h - Mock VA driver for hardware-free benchmarks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef MOCK_VA_H
+#define MOCK_VA_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The name the driver is loaded with, through LIBVA_DRIVER_NAME */
+#define MOCK_VA_DRIVER_NAME "mock"
+
+/* The entry points whose calls the driver counts */
+typedef enum
+{
+  MOCK_VA_CALL_CREATE_SURFACES,
+  MOCK_VA_CALL_CREATE_CONTEXT,
+  MOCK_VA_CALL_CREATE_BUFFER,
+  MOCK_VA_CALL_MAP_BUFFER,
+  MOCK_VA_CALL_DESTROY_BUFFER,
+  MOCK_VA_CALL_BEGIN_PICTURE,
+  MOCK_VA_CALL_RENDER_PICTURE,
+  MOCK_VA_CALL_END_PICTURE,
+  MOCK_VA_CALL_SYNC_SURFACE,
+  MOCK_VA_CALL_GET_IMAGE,
+  MOCK_VA_CALL_PUT_IMAGE,
+  MOCK_VA_CALL_OTHER,
+  MOCK_VA_N_CALLS
+} MockVaCall;
+
+typedef struct
+{
+  guint64 calls[MOCK_VA_N_CALLS];
+  guint64 buffer_bytes;         /* size of the buffers created */
+} MockVaStats;
+
+/* Exported by the driver, to be looked up once the driver is loaded */
+#define MOCK_VA_GET_STATS_SYMBOL "mock_va_get_stats"
+
+typedef void (*MockVaGetStatsFunc) (MockVaStats * stats);
+
+G_END_DECLS
+
+#endif /* MOCK_VA_H */
@@ -40,6 +40,8 @@
 
 static gchar *g_codec_str;
 static gboolean g_benchmark;
+static gint g_slice_threads;
+static gboolean g_pipelined;
 
 static GOptionEntry g_options[] = {
   {"codec", 'c',
@@ -50,6 +52,14 @@ static GOptionEntry g_options[] = {
         0,
         G_OPTION_ARG_NONE, &g_benchmark,
       "benchmark mode", NULL},
+  {"slice-threads", 0,
+        0,
+        G_OPTION_ARG_INT, &g_slice_threads,
+      "number of threads filling in H.264 slice parameters", NULL},
+  {"pipelined", 0,
+        0,
+        G_OPTION_ARG_NONE, &g_pipelined,
+      "parse the next frames while submitting the current one", NULL},
   {NULL,}
 };
 
@@ -339,6 +349,9 @@ start_decoder (App * app)
   switch (app->codec) {
     case GST_VAAPI_CODEC_H264:
       app->decoder = gst_vaapi_decoder_h264_new (app->display, caps);
+      if (app->decoder)
+        gst_vaapi_decoder_h264_set_slice_threads (GST_VAAPI_DECODER_H264
+            (app->decoder), MAX (g_slice_threads, 0));
       break;
     case GST_VAAPI_CODEC_JPEG:
       app->decoder = gst_vaapi_decoder_jpeg_new (app->display, caps);
@@ -359,6 +372,9 @@ start_decoder (App * app)
   if (!app->decoder)
     return FALSE;
 
+  if (g_pipelined && !gst_vaapi_decoder_set_pipelined (app->decoder, TRUE))
+    g_message ("pipelining is not supported for this codec");
+
   gst_vaapi_decoder_set_codec_state_changed_func (app->decoder,
       handle_decoder_state_changes, app);
 
@@ -662,8 +678,22 @@ app_run (App * app, int argc, char *argv[])
   g_print ("Decoded %u frames", app->num_frames);
   if (g_benchmark) {
     const gdouble elapsed = g_timer_elapsed (app->timer, NULL);
+    GstVaapiDecoderStats stats;
+
     g_print (" in %.2f sec (%.1f fps)\n",
         elapsed, (gdouble) app->num_frames / elapsed);
+
+    gst_vaapi_decoder_get_stats (app->decoder, &stats);
+    g_print ("parse  %8.3f ms/frame (stalled %8.3f ms/frame)\n"
+        "submit %8.3f ms/frame (stalled %8.3f ms/frame)",
+        (gdouble) stats.parse_time / 1000 / MAX (stats.num_frames, 1),
+        (gdouble) stats.parse_stall_time / 1000 / MAX (stats.num_frames, 1),
+        (gdouble) stats.submit_time / 1000 / MAX (stats.num_frames, 1),
+        (gdouble) stats.submit_stall_time / 1000 /
+        MAX (stats.num_frames, 1));
+    g_print ("\nobjects %8.1f allocs/frame (%.1f recycled/frame)",
+        (gdouble) stats.num_object_allocs / MAX (stats.num_frames, 1),
+        (gdouble) stats.num_object_reuses / MAX (stats.num_frames, 1));
   }
   g_print ("\n");
   return TRUE;
@@ -0,0 +1,356 @@
+/*
+ *  test-buffercache.c - Test GstVaapiBufferCache against a stub VA backend
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Checks the buffer recycling rules with a stub VA backend, then
+   replays the buffer pattern of a multi-slice decode: one picture
+   parameter buffer, one IQ matrix and a slice parameter buffer per
+   slice, submitted once per frame */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapibuffercache.h>
+
+static gint g_num_frames = 1000;
+static gint g_num_slices = 8;
+
+static GOptionEntry g_options[] = {
+  {"frames", 'n', 0, G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames to submit", NULL},
+  {"slices", 's', 0, G_OPTION_ARG_INT, &g_num_slices,
+      "number of slices per frame", NULL},
+  {NULL,}
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- Stub VA backend                                                   --- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  GHashTable *buffers;          /* VABufferID -> guint8[] */
+  VABufferID next_id;
+  guint num_creates;
+  guint num_destroys;
+  guint num_maps;
+  guint num_unmaps;
+} StubBackend;
+
+static StubBackend g_stub;
+
+static void
+stub_init (void)
+{
+  g_stub.buffers = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  g_stub.next_id = 1;
+  g_stub.num_creates = g_stub.num_destroys = 0;
+  g_stub.num_maps = g_stub.num_unmaps = 0;
+}
+
+static void
+stub_finish (void)
+{
+  if (g_hash_table_size (g_stub.buffers) != 0)
+    g_error ("%u VA buffers leaked", g_hash_table_size (g_stub.buffers));
+  g_hash_table_unref (g_stub.buffers);
+}
+
+static VAStatus
+stub_create_buffer (VADisplay dpy, VAContextID context, VABufferType type,
+    unsigned int size, unsigned int num_elements, void *data,
+    VABufferID * buf_id)
+{
+  guint8 *const mem = g_malloc0 (size * num_elements);
+
+  if (data)
+    memcpy (mem, data, size * num_elements);
+  *buf_id = g_stub.next_id++;
+  g_hash_table_insert (g_stub.buffers, GUINT_TO_POINTER (*buf_id), mem);
+  g_stub.num_creates++;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_destroy_buffer (VADisplay dpy, VABufferID buf_id)
+{
+  if (!g_hash_table_remove (g_stub.buffers, GUINT_TO_POINTER (buf_id)))
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  g_stub.num_destroys++;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_map_buffer (VADisplay dpy, VABufferID buf_id, void **pbuf)
+{
+  *pbuf = g_hash_table_lookup (g_stub.buffers, GUINT_TO_POINTER (buf_id));
+  if (!*pbuf)
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  g_stub.num_maps++;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_unmap_buffer (VADisplay dpy, VABufferID buf_id)
+{
+  if (!g_hash_table_contains (g_stub.buffers, GUINT_TO_POINTER (buf_id)))
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  g_stub.num_unmaps++;
+  return VA_STATUS_SUCCESS;
+}
+
+static const GstVaapiBufferCacheVTable stub_vtable = {
+  .create_buffer = stub_create_buffer,
+  .destroy_buffer = stub_destroy_buffer,
+  .map_buffer = stub_map_buffer,
+  .unmap_buffer = stub_unmap_buffer,
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- Tests                                                             --- */
+/* ------------------------------------------------------------------------- */
+
+static GstVaapiBufferCache *
+new_cache (guint max_buffers)
+{
+  GstVaapiBufferCache *const cache =
+      gst_vaapi_buffer_cache_new (NULL, 1, max_buffers, &stub_vtable);
+
+  if (!cache)
+    g_error ("failed to create buffer cache");
+  return cache;
+}
+
+static VABufferID
+create_buffer (GstVaapiBufferCache * cache, VABufferType type, guint size,
+    gconstpointer data, gpointer * mapped_data)
+{
+  VABufferID buf_id = VA_INVALID_ID;
+
+  if (!gst_vaapi_buffer_cache_create_buffer (cache, type, size, data,
+          &buf_id, mapped_data))
+    g_error ("failed to create buffer");
+  g_assert (buf_id != VA_INVALID_ID);
+  return buf_id;
+}
+
+static void
+check_stats (GstVaapiBufferCache * cache, guint64 hits, guint64 misses,
+    guint64 evictions, guint cached)
+{
+  GstVaapiBufferCacheStats stats;
+
+  gst_vaapi_buffer_cache_get_stats (cache, &stats);
+  g_assert_cmpuint (stats.num_hits, ==, hits);
+  g_assert_cmpuint (stats.num_misses, ==, misses);
+  g_assert_cmpuint (stats.num_evictions, ==, evictions);
+  g_assert_cmpuint (stats.num_cached, ==, cached);
+}
+
+/* A buffer is recycled for the same type and size, only after commit */
+static void
+test_reuse (void)
+{
+  GstVaapiBufferCache *cache;
+  VABufferID id, id2;
+  gpointer mem = NULL;
+  guint8 data[64];
+
+  stub_init ();
+  cache = new_cache (8);
+  memset (data, 0x5a, sizeof (data));
+
+  id = create_buffer (cache, VAPictureParameterBufferType, 64, NULL, &mem);
+  g_assert (mem != NULL);
+  memset (mem, 0xff, 64);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id, &mem);
+  g_assert (id == VA_INVALID_ID && mem == NULL);
+  g_assert_cmpuint (g_stub.num_unmaps, ==, 1);
+  check_stats (cache, 0, 1, 0, 1);
+
+  /* Not committed yet: the driver may still read the buffer */
+  id2 = create_buffer (cache, VAPictureParameterBufferType, 64, NULL, NULL);
+  g_assert_cmpuint (g_stub.num_creates, ==, 2);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id2, NULL);
+  check_stats (cache, 0, 2, 0, 2);
+
+  gst_vaapi_buffer_cache_commit (cache);
+  check_stats (cache, 0, 2, 0, 2);
+
+  /* Different size or type miss */
+  id = create_buffer (cache, VAPictureParameterBufferType, 32, NULL, NULL);
+  id2 = create_buffer (cache, VAIQMatrixBufferType, 64, NULL, NULL);
+  g_assert_cmpuint (g_stub.num_creates, ==, 4);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id, NULL);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id2, NULL);
+  check_stats (cache, 0, 4, 0, 4);
+
+  /* A hit gets the new contents, or zeroes */
+  id = create_buffer (cache, VAPictureParameterBufferType, 64, NULL, &mem);
+  g_assert_cmpuint (g_stub.num_creates, ==, 4);
+  g_assert_cmpuint (((guint8 *) mem)[0], ==, 0);
+  g_assert_cmpuint (((guint8 *) mem)[63], ==, 0);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id, &mem);
+
+  id = create_buffer (cache, VAPictureParameterBufferType, 64, data, NULL);
+  g_assert_cmpuint (g_stub.num_creates, ==, 4);
+  g_assert_cmpuint (g_stub.num_maps, ==, g_stub.num_unmaps);
+  mem = g_hash_table_lookup (g_stub.buffers, GUINT_TO_POINTER (id));
+  g_assert (memcmp (mem, data, sizeof (data)) == 0);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id, NULL);
+  check_stats (cache, 2, 4, 0, 4);
+
+  gst_vaapi_buffer_cache_free (cache);
+  g_assert_cmpuint (g_stub.num_destroys, ==, g_stub.num_creates);
+  stub_finish ();
+}
+
+/* Slice data is never cached, and unknown buffers are destroyed */
+static void
+test_uncacheable (void)
+{
+  GstVaapiBufferCache *cache;
+  VABufferID id;
+
+  stub_init ();
+  cache = new_cache (8);
+
+  id = create_buffer (cache, VASliceDataBufferType, 4096, NULL, NULL);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id, NULL);
+  g_assert_cmpuint (g_stub.num_destroys, ==, 1);
+  gst_vaapi_buffer_cache_commit (cache);
+  id = create_buffer (cache, VASliceDataBufferType, 4096, NULL, NULL);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id, NULL);
+  g_assert_cmpuint (g_stub.num_creates, ==, 2);
+  g_assert_cmpuint (g_stub.num_destroys, ==, 2);
+
+  stub_create_buffer (NULL, 1, VAPictureParameterBufferType, 64, 1, NULL,
+      &id);
+  gst_vaapi_buffer_cache_release_buffer (cache, &id, NULL);
+  g_assert_cmpuint (g_stub.num_destroys, ==, 3);
+  check_stats (cache, 0, 0, 0, 0);
+
+  gst_vaapi_buffer_cache_free (cache);
+  stub_finish ();
+}
+
+/* The least recently released buffers are evicted beyond capacity */
+static void
+test_eviction (void)
+{
+  GstVaapiBufferCache *cache;
+  VABufferID ids[4];
+  guint i;
+
+  stub_init ();
+  cache = new_cache (2);
+
+  for (i = 0; i < G_N_ELEMENTS (ids); i++)
+    ids[i] = create_buffer (cache, VASliceParameterBufferType, 16 * (i + 1),
+        NULL, NULL);
+  for (i = 0; i < G_N_ELEMENTS (ids); i++)
+    gst_vaapi_buffer_cache_release_buffer (cache, &ids[i], NULL);
+  gst_vaapi_buffer_cache_commit (cache);
+  check_stats (cache, 0, 4, 2, 2);
+  g_assert_cmpuint (g_stub.num_destroys, ==, 2);
+
+  /* The last two released buffers are the ones kept */
+  ids[0] = create_buffer (cache, VASliceParameterBufferType, 64, NULL, NULL);
+  ids[1] = create_buffer (cache, VASliceParameterBufferType, 48, NULL, NULL);
+  ids[2] = create_buffer (cache, VASliceParameterBufferType, 16, NULL, NULL);
+  check_stats (cache, 2, 5, 2, 0);
+  for (i = 0; i < 3; i++)
+    gst_vaapi_buffer_cache_release_buffer (cache, &ids[i], NULL);
+
+  /* Released but uncommitted buffers are destroyed too */
+  gst_vaapi_buffer_cache_free (cache);
+  g_assert_cmpuint (g_stub.num_destroys, ==, g_stub.num_creates);
+  stub_finish ();
+}
+
+static void
+run_bench (const gchar * name, guint max_buffers)
+{
+  GstVaapiBufferCache *cache;
+  GstVaapiBufferCacheStats stats;
+  VABufferID pic_id, iq_id, *slice_ids;
+  gpointer pic_param, slice_param;
+  gint64 start, elapsed;
+  gint i, j;
+
+  stub_init ();
+  cache = new_cache (max_buffers);
+  slice_ids = g_new (VABufferID, g_num_slices);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < g_num_frames; i++) {
+    pic_id = create_buffer (cache, VAPictureParameterBufferType, 648, NULL,
+        &pic_param);
+    iq_id = create_buffer (cache, VAIQMatrixBufferType, 480, NULL, NULL);
+    gst_vaapi_buffer_cache_release_buffer (cache, &pic_id, &pic_param);
+    gst_vaapi_buffer_cache_release_buffer (cache, &iq_id, NULL);
+
+    for (j = 0; j < g_num_slices; j++) {
+      slice_ids[j] = create_buffer (cache, VASliceParameterBufferType, 3160,
+          NULL, &slice_param);
+      gst_vaapi_buffer_cache_release_buffer (cache, &slice_ids[j],
+          &slice_param);
+    }
+    gst_vaapi_buffer_cache_commit (cache);
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  gst_vaapi_buffer_cache_get_stats (cache, &stats);
+  g_print ("%-10s %8.1f ns/frame  %6.2f vaCreateBuffer/frame  "
+      "%6.2f hits/frame\n", name, (gdouble) elapsed * 1000 / g_num_frames,
+      (gdouble) g_stub.num_creates / g_num_frames,
+      (gdouble) stats.num_hits / g_num_frames);
+
+  gst_vaapi_buffer_cache_free (cache);
+  g_free (slice_ids);
+  stub_finish ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  gboolean success;
+
+  ctx = g_option_context_new ("- GstVaapiBufferCache test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success || g_num_frames <= 0 || g_num_slices <= 0)
+    return EXIT_FAILURE;
+
+  test_reuse ();
+  test_uncacheable ();
+  test_eviction ();
+
+  /* A cache that keeps nothing behaves like plain vaCreateBuffer() */
+  run_bench ("no-cache", 0);
+  run_bench ("cache", 64);
+
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/*
+ *  test-codedbuffersizer.c - Test the coded buffer size prediction
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Feeds GstVaapiCodedBufferSizer with the frame sizes of a synthetic
+   8K stream: a rate controlled scene with an intra frame every second,
+   then a burst of much larger frames, then the first scene again. The
+   frames which do not fit shall only be found at the start of the
+   burst, and the predicted size shall go back down afterwards */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/vaapi/gstvaapicodedbuffersizer.h>
+
+/* Worst case of an 8K NV12 frame, as the encoders compute it */
+#define MAX_SIZE (7680 * 4320 * 3 / 2)
+
+#define FRAMERATE 30
+#define BITRATE (40 * 1000 * 1000)
+#define SCENE_LENGTH (20 * FRAMERATE)
+#define NUM_FRAMES (3 * SCENE_LENGTH)
+
+/* Number of coded buffers in the encoder pool */
+#define POOL_CAPACITY 7
+
+static gboolean g_verbose;
+
+static GOptionEntry g_options[] = {
+  {"verbose", 'v', 0, G_OPTION_ARG_NONE, &g_verbose,
+      "print the predicted size for every frame", NULL},
+  {NULL,}
+};
+
+/* Intra frames are five times larger than the others, and the burst
+   frames hold a tenth of the worst case */
+static guint
+get_frame_size (guint n)
+{
+  const guint frame_size = BITRATE / 8 / FRAMERATE;
+  const gboolean is_intra = n % FRAMERATE == 0;
+
+  if (n / SCENE_LENGTH == 1)
+    return MAX_SIZE / 10 + (n % 7) * 1024;
+  return (is_intra ? 5 * frame_size : frame_size / 2) + (n % 13) * 1024;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstVaapiCodedBufferSizer *sizer;
+  GstVaapiCodedBufferSizerStats stats;
+  GOptionContext *ctx;
+  guint64 size_sum = 0;
+  guint n, size, coded_size, num_overflows = 0;
+  gboolean success;
+
+  ctx = g_option_context_new ("- coded buffer size prediction test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success)
+    return EXIT_FAILURE;
+
+  sizer = gst_vaapi_coded_buffer_sizer_new (MAX_SIZE);
+  if (!sizer)
+    g_error ("failed to create coded buffer sizer");
+  g_assert_cmpuint (gst_vaapi_coded_buffer_sizer_get_size (sizer), ==,
+      MAX_SIZE);
+
+  gst_vaapi_coded_buffer_sizer_set_target (sizer, BITRATE / 8 / FRAMERATE);
+  size = gst_vaapi_coded_buffer_sizer_get_size (sizer);
+  g_assert_cmpuint (size, <, MAX_SIZE / 10);
+  g_assert_cmpuint (size, >=, get_frame_size (0));
+
+  for (n = 0; n < NUM_FRAMES; n++) {
+    size = gst_vaapi_coded_buffer_sizer_get_size (sizer);
+    coded_size = get_frame_size (n);
+
+    /* The encoder falls back to a worst-case buffer */
+    if (coded_size > size) {
+      if (n != SCENE_LENGTH)
+        g_error ("frame %u: %u bytes did not fit into %u", n, coded_size,
+            size);
+      gst_vaapi_coded_buffer_sizer_overflow (sizer);
+      g_assert_cmpuint (gst_vaapi_coded_buffer_sizer_get_size (sizer), ==,
+          MAX_SIZE);
+      num_overflows++;
+    }
+    gst_vaapi_coded_buffer_sizer_push (sizer, coded_size);
+    size_sum += gst_vaapi_coded_buffer_sizer_get_size (sizer);
+
+    if (g_verbose)
+      g_print ("frame %4u: %8u bytes, buffer %8u bytes\n", n, coded_size,
+          gst_vaapi_coded_buffer_sizer_get_size (sizer));
+  }
+
+  /* The burst is forgotten within the third scene */
+  size = gst_vaapi_coded_buffer_sizer_get_size (sizer);
+  g_assert_cmpuint (size, <, MAX_SIZE / 10);
+
+  gst_vaapi_coded_buffer_sizer_get_stats (sizer, &stats);
+  g_assert_cmpuint (stats.num_frames, ==, NUM_FRAMES);
+  g_assert_cmpuint (stats.num_overflows, ==, num_overflows);
+  g_assert_cmpuint (stats.max_coded_size, ==, MAX_SIZE / 10 + 6 * 1024);
+
+  g_print ("%u frames, %u resizes, %u overflows, average buffer %"
+      G_GUINT64_FORMAT " bytes of %u, %" G_GUINT64_FORMAT
+      " bytes saved at the end\n", NUM_FRAMES, stats.num_resizes,
+      stats.num_overflows, size_sum / NUM_FRAMES, MAX_SIZE,
+      (guint64) (MAX_SIZE - size) * POOL_CAPACITY);
+
+  gst_vaapi_coded_buffer_sizer_free (sizer);
+  return EXIT_SUCCESS;
+}
@@ -226,6 +226,35 @@ main (int argc, char *argv[])
   }
   g_print ("\n");
 
+  g_print ("#\n");
+  g_print ("# Create display with gst_vaapi_display_drm_new_shared()\n");
+  g_print ("#\n");
+  {
+    GstVaapiDisplay *display2;
+    GstVaapiDisplayDRMSharedStats stats;
+
+    display = gst_vaapi_display_drm_new_shared (NULL);
+    if (!display)
+      g_error ("could not create Gst/VA display");
+    display2 = gst_vaapi_display_drm_new_shared (NULL);
+    if (display2 != display)
+      g_error ("the display of the default device was not shared");
+
+    gst_vaapi_display_drm_get_shared_stats (&stats);
+    g_print ("%u live shared displays, %" G_GUINT64_FORMAT " hits, %"
+        G_GUINT64_FORMAT " misses\n", stats.num_displays, stats.num_hits,
+        stats.num_misses);
+    if (stats.num_displays != 1 || stats.num_hits != 1)
+      g_error ("unexpected shared display statistics");
+
+    gst_object_unref (display2);
+    gst_object_unref (display);
+    gst_vaapi_display_drm_get_shared_stats (&stats);
+    if (stats.num_displays != 0)
+      g_error ("shared display still registered after release");
+  }
+  g_print ("\n");
+
   g_print ("#\n");
   g_print ("# Create display with gst_vaapi_display_drm_new_with_device()\n");
   g_print ("#\n");
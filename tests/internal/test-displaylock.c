@@ -0,0 +1,160 @@
+/*
+ *  test-displaylock.c - Benchmark concurrent streams on one VA display
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Runs 1 to N threads sharing one display, each doing the per-frame
+   VA traffic of an encoder input: upload a frame to its own surface,
+   sync it, and read it back through a mapped image. Every run is made
+   with the global and the fine display lock modes, and reports the
+   throughput along with the display lock statistics */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapidisplay_priv.h>
+#include "image.h"
+#include "output.h"
+
+static gint g_width = 1280;
+static gint g_height = 720;
+static gint g_num_frames = 200;
+static gint g_max_threads = 8;
+
+static GOptionEntry g_options[] = {
+  {"width", 0, 0, G_OPTION_ARG_INT, &g_width,
+      "frame width", NULL},
+  {"height", 0, 0, G_OPTION_ARG_INT, &g_height,
+      "frame height", NULL},
+  {"frames", 'n', 0, G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames per stream", NULL},
+  {"threads", 't', 0, G_OPTION_ARG_INT, &g_max_threads,
+      "maximal number of concurrent streams", NULL},
+  {NULL,}
+};
+
+typedef struct
+{
+  GstVaapiDisplay *display;
+  gboolean success;
+} Stream;
+
+static gpointer
+run_stream (gpointer data)
+{
+  Stream *const stream = data;
+  GstVaapiSurface *surface;
+  GstVaapiImage *src_image, *dst_image;
+  gint i;
+
+  surface = gst_vaapi_surface_new_with_format (stream->display,
+      GST_VIDEO_FORMAT_NV12, g_width, g_height, 0);
+  src_image = image_generate (stream->display, GST_VIDEO_FORMAT_NV12,
+      g_width, g_height);
+  dst_image = gst_vaapi_image_new (stream->display, GST_VIDEO_FORMAT_NV12,
+      g_width, g_height);
+  if (!surface || !src_image || !dst_image)
+    goto bail;
+
+  for (i = 0; i < g_num_frames; i++) {
+    if (!gst_vaapi_surface_put_image (surface, src_image))
+      goto bail;
+    if (!gst_vaapi_surface_sync (surface))
+      goto bail;
+    if (!gst_vaapi_surface_get_image (surface, dst_image))
+      goto bail;
+    if (!gst_vaapi_image_map (dst_image))
+      goto bail;
+    gst_vaapi_image_unmap (dst_image);
+  }
+  stream->success = TRUE;
+
+bail:
+  if (dst_image)
+    gst_vaapi_image_unref (dst_image);
+  if (src_image)
+    gst_vaapi_image_unref (src_image);
+  if (surface)
+    gst_vaapi_surface_unref (surface);
+  return NULL;
+}
+
+static void
+run_bench (const gchar * mode, gint num_threads)
+{
+  GstVaapiDisplay *display;
+  GstVaapiDisplayLockStats stats;
+  Stream *streams;
+  GThread **threads;
+  gint64 start, elapsed;
+  gint i;
+
+  g_setenv ("GST_VAAPI_DISPLAY_LOCK_MODE", mode, TRUE);
+  display = video_output_create_display (NULL);
+  if (!display)
+    g_error ("could not create VA display");
+
+  streams = g_new0 (Stream, num_threads);
+  threads = g_new0 (GThread *, num_threads);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num_threads; i++) {
+    streams[i].display = display;
+    threads[i] = g_thread_new ("stream", run_stream, &streams[i]);
+  }
+  for (i = 0; i < num_threads; i++) {
+    g_thread_join (threads[i]);
+    if (!streams[i].success)
+      g_error ("stream %d failed", i);
+  }
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  gst_vaapi_display_get_lock_stats (display, &stats, NULL);
+  g_print ("%-6s %2d streams  %8.1f fps  locks %8" G_GUINT64_FORMAT
+      "  contended %8" G_GUINT64_FORMAT "  wait %8.1f ms  hold %8.1f ms\n",
+      mode, num_threads,
+      (gdouble) num_threads * g_num_frames * G_USEC_PER_SEC / elapsed,
+      stats.num_locks, stats.num_contended, stats.wait_time / 1000.0,
+      stats.hold_time / 1000.0);
+
+  g_free (threads);
+  g_free (streams);
+  gst_object_unref (display);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint num_threads;
+
+  if (!video_output_init (&argc, argv, g_options))
+    g_error ("failed to initialize video output subsystem");
+
+  if (g_width <= 0 || g_height <= 0 || g_num_frames <= 0 ||
+      g_max_threads <= 0)
+    g_error ("invalid benchmark parameters");
+
+  g_print ("%dx%d NV12, %d frames per stream\n", g_width, g_height,
+      g_num_frames);
+
+  for (num_threads = 1; num_threads <= g_max_threads; num_threads *= 2) {
+    run_bench ("global", num_threads);
+    run_bench ("fine", num_threads);
+  }
+
+  video_output_exit ();
+  return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ *  test-dmabufimportcache.c - Test GstVaapiDmaBufImportCache with a
+ *                             recycling upstream pool
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Imports frames from a small pool of buffer objects, each frame
+   through a new fd as upstream pools do, and checks that the steady
+   state imports nothing, that a layout change imports again, and that
+   the least recently used surface is evicted first. Pipes stand in
+   for the DMABufs, which are only identified by their inode, so the
+   keys skip the check that the fds live on the DMABuf filesystem */
+
+#include "gst/vaapi/sysdeps.h"
+#include <unistd.h>
+#include <gst/vaapi/gstvaapidmabufimportcache.h>
+
+#define NUM_BUFFERS 4
+#define NUM_FRAMES 100
+#define CACHE_SIZE (NUM_BUFFERS + 1)
+
+static gint g_pipes[NUM_BUFFERS + 2][2];
+static guint g_num_imports;
+
+static void
+init_key (GstVaapiDmaBufImportKey * key, gint fd, const GstVideoInfo * vip)
+{
+  if (!gst_vaapi_dmabuf_import_key_init_unchecked (key, fd, vip))
+    g_error ("failed to identify fd %d", fd);
+}
+
+/* What the plugin base does for each upstream buffer */
+static GstMiniObject *
+import (GstVaapiDmaBufImportCache * cache, guint buffer,
+    const GstVideoInfo * vip)
+{
+  GstVaapiDmaBufImportKey key;
+  GstMiniObject *surface;
+  gint fd;
+
+  fd = dup (g_pipes[buffer][0]);
+  if (fd < 0)
+    g_error ("failed to duplicate fd");
+  init_key (&key, fd, vip);
+  close (fd);
+
+  surface = gst_vaapi_dmabuf_import_cache_lookup (cache, &key);
+  if (!surface) {
+    surface = GST_MINI_OBJECT_CAST (gst_buffer_new ());
+    gst_vaapi_dmabuf_import_cache_insert (cache, &key, surface);
+    g_num_imports++;
+  }
+  return surface;
+}
+
+static void
+test_keys (const GstVideoInfo * vip)
+{
+  GstVaapiDmaBufImportKey key, other_key;
+
+  /* Both ends of a pipe share its inode, like fds of a buffer object */
+  init_key (&key, g_pipes[0][0], vip);
+  init_key (&other_key, g_pipes[0][1], vip);
+  g_assert (memcmp (&key, &other_key, sizeof (key)) == 0);
+  g_assert_cmpuint (key.n_planes, ==, GST_VIDEO_INFO_N_PLANES (vip));
+  g_assert_cmpuint (key.offset[1], ==, GST_VIDEO_INFO_PLANE_OFFSET (vip, 1));
+  g_assert_cmpint (key.stride[1], ==, GST_VIDEO_INFO_PLANE_STRIDE (vip, 1));
+
+  init_key (&other_key, g_pipes[1][0], vip);
+  g_assert (memcmp (&key, &other_key, sizeof (key)) != 0);
+}
+
+static void
+test_steady_state (GstVaapiDmaBufImportCache * cache,
+    const GstVideoInfo * vip)
+{
+  GstMiniObject *surfaces[NUM_BUFFERS] = { NULL, };
+  GstMiniObject *surface;
+  guint i, buffer;
+
+  g_num_imports = 0;
+  for (i = 0; i < NUM_FRAMES; i++) {
+    buffer = i % NUM_BUFFERS;
+    surface = import (cache, buffer, vip);
+    if (surfaces[buffer])
+      g_assert (surface == surfaces[buffer]);
+    else
+      surfaces[buffer] = surface;
+    gst_mini_object_unref (surface);
+  }
+  g_assert_cmpuint (g_num_imports, ==, NUM_BUFFERS);
+  g_print ("steady state: %u imports for %u frames\n", g_num_imports,
+      NUM_FRAMES);
+}
+
+static void
+test_layout (GstVaapiDmaBufImportCache * cache, const GstVideoInfo * vip)
+{
+  GstVideoInfo info = *vip;
+
+  /* Same buffer object, another stride */
+  GST_VIDEO_INFO_PLANE_STRIDE (&info, 0) += 64;
+  g_num_imports = 0;
+  gst_mini_object_unref (import (cache, 0, &info));
+  gst_mini_object_unref (import (cache, 0, &info));
+  g_assert_cmpuint (g_num_imports, ==, 1);
+}
+
+static void
+test_eviction (GstVaapiDmaBufImportCache * cache, const GstVideoInfo * vip)
+{
+  GstVaapiDmaBufImportCacheStats stats;
+  guint i;
+
+  /* The cache is full: touch every buffer but the first one, so that
+     the next import evicts the first buffer only */
+  gst_vaapi_dmabuf_import_cache_get_stats (cache, &stats);
+  g_assert_cmpuint (stats.num_cached, ==, CACHE_SIZE);
+  for (i = 1; i < NUM_BUFFERS; i++)
+    gst_mini_object_unref (import (cache, i, vip));
+  g_num_imports = 0;
+  gst_mini_object_unref (import (cache, NUM_BUFFERS + 1, vip));
+  g_assert_cmpuint (g_num_imports, ==, 1);
+  for (i = 1; i < NUM_BUFFERS; i++)
+    gst_mini_object_unref (import (cache, i, vip));
+  g_assert_cmpuint (g_num_imports, ==, 1);
+  gst_mini_object_unref (import (cache, 0, vip));
+  g_assert_cmpuint (g_num_imports, ==, 2);
+
+  gst_vaapi_dmabuf_import_cache_get_stats (cache, &stats);
+  g_assert_cmpuint (stats.num_cached, ==, CACHE_SIZE);
+  g_print ("%" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %"
+      G_GUINT64_FORMAT " evictions\n", stats.num_hits, stats.num_misses,
+      stats.num_evictions);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GstVaapiDmaBufImportCache *cache;
+  GstVideoInfo info;
+  gboolean success;
+  guint i;
+
+  ctx = g_option_context_new ("- GstVaapiDmaBufImportCache test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success)
+    return EXIT_FAILURE;
+
+  for (i = 0; i < G_N_ELEMENTS (g_pipes); i++) {
+    if (pipe (g_pipes[i]) != 0)
+      g_error ("failed to create pipe");
+  }
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_NV12, 1280, 720);
+
+  cache = gst_vaapi_dmabuf_import_cache_new (CACHE_SIZE);
+  if (!cache)
+    g_error ("failed to create import cache");
+
+  /* Not a DMABuf, so not a unique inode either */
+  {
+    GstVaapiDmaBufImportKey key;
+
+    g_assert (!gst_vaapi_dmabuf_import_key_init (&key, g_pipes[0][0],
+            &info));
+  }
+
+  test_keys (&info);
+  test_steady_state (cache, &info);
+  test_layout (cache, &info);
+  test_eviction (cache, &info);
+
+  gst_vaapi_dmabuf_import_cache_free (cache);
+  for (i = 0; i < G_N_ELEMENTS (g_pipes); i++) {
+    close (g_pipes[i][0]);
+    close (g_pipes[i][1]);
+  }
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
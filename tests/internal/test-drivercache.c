@@ -0,0 +1,413 @@
+/*
+ *  test-drivercache.c - Test GstVaapiDriverCache against a mock VA driver
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Fills a driver cache from a mock VA driver and saves it, then
+   checks that a cache loaded for the same driver answers every query
+   without calling into VA, and that a cache file written for another
+   driver, another file version or a corrupted one is ignored */
+
+#include "gst/vaapi/sysdeps.h"
+#include <glib/gstdio.h>
+#include <gst/vaapi/gstvaapidrivercache.h>
+
+#define MOCK_VENDOR "Mock VA driver 1.0"
+#define MOCK_VA_VERSION "1.7"
+#define MOCK_DEVICE "/dev/dri/renderD128"
+
+/* ------------------------------------------------------------------------- */
+/* --- Mock VA driver                                                    --- */
+/* ------------------------------------------------------------------------- */
+
+static guint g_num_va_calls;
+static guint g_num_live_configs;
+
+static const VAProfile g_mock_profiles[] = {
+  VAProfileH264Main, VAProfileHEVCMain, VAProfileNone,
+};
+
+static const VAImageFormat g_mock_image_formats[] = {
+  {VA_FOURCC_NV12, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_I420, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_BGRA, VA_LSB_FIRST, 32, 32, 0x00ff0000, 0x0000ff00,
+      0x000000ff, 0xff000000},
+};
+
+static const VAImageFormat g_mock_subpicture_formats[] = {
+  {VA_FOURCC_BGRA, VA_LSB_FIRST, 32, 32, 0x00ff0000, 0x0000ff00,
+      0x000000ff, 0xff000000},
+};
+
+static int
+mock_max_num_profiles (VADisplay dpy)
+{
+  return 16;
+}
+
+static int
+mock_max_num_entrypoints (VADisplay dpy)
+{
+  return 16;
+}
+
+static int
+mock_max_num_image_formats (VADisplay dpy)
+{
+  return 16;
+}
+
+static int
+mock_max_num_subpicture_formats (VADisplay dpy)
+{
+  return 16;
+}
+
+static VAStatus
+mock_query_config_profiles (VADisplay dpy, VAProfile * profiles,
+    int *num_profiles)
+{
+  g_num_va_calls++;
+  memcpy (profiles, g_mock_profiles, sizeof (g_mock_profiles));
+  *num_profiles = G_N_ELEMENTS (g_mock_profiles);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_query_config_entrypoints (VADisplay dpy, VAProfile profile,
+    VAEntrypoint * entrypoints, int *num_entrypoints)
+{
+  g_num_va_calls++;
+  *num_entrypoints = 0;
+  switch (profile) {
+    case VAProfileH264Main:
+      entrypoints[(*num_entrypoints)++] = VAEntrypointVLD;
+      entrypoints[(*num_entrypoints)++] = VAEntrypointEncSlice;
+      break;
+    case VAProfileHEVCMain:
+      entrypoints[(*num_entrypoints)++] = VAEntrypointVLD;
+      break;
+    case VAProfileNone:
+      entrypoints[(*num_entrypoints)++] = VAEntrypointVideoProc;
+      break;
+    default:
+      return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+  }
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_get_config_attributes (VADisplay dpy, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attribs, int num_attribs)
+{
+  int i;
+
+  g_num_va_calls++;
+  for (i = 0; i < num_attribs; i++) {
+    if (attribs[i].type == VAConfigAttribRTFormat &&
+        entrypoint == VAEntrypointVLD)
+      attribs[i].value = VA_RT_FORMAT_YUV420;
+    else
+      attribs[i].value = VA_ATTRIB_NOT_SUPPORTED;
+  }
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_create_config (VADisplay dpy, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attribs, int num_attribs,
+    VAConfigID * config)
+{
+  g_num_va_calls++;
+  g_assert_cmpint (num_attribs, ==, 1);
+  g_assert_cmpuint (attribs[0].value, ==, VA_RT_FORMAT_YUV420);
+  *config = profile;
+  g_num_live_configs++;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_destroy_config (VADisplay dpy, VAConfigID config)
+{
+  g_num_va_calls++;
+  g_num_live_configs--;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_query_surface_attributes (VADisplay dpy, VAConfigID config,
+    VASurfaceAttrib * attribs, unsigned int *num_attribs)
+{
+  const gint max_size = config == VAProfileHEVCMain ? 8192 : 4096;
+  VASurfaceAttrib mock_attribs[6];
+  guint i = 0;
+
+  g_num_va_calls++;
+
+#define ADD_ATTRIB(t, f, v) G_STMT_START {                \
+    mock_attribs[i].type = (t);                           \
+    mock_attribs[i].flags = (f);                          \
+    mock_attribs[i].value.type = VAGenericValueTypeInteger; \
+    mock_attribs[i].value.value.i = (v);                  \
+    i++;                                                  \
+  } G_STMT_END
+
+  ADD_ATTRIB (VASurfaceAttribPixelFormat, VA_SURFACE_ATTRIB_SETTABLE,
+      VA_FOURCC_NV12);
+  ADD_ATTRIB (VASurfaceAttribMinWidth, VA_SURFACE_ATTRIB_GETTABLE, 16);
+  ADD_ATTRIB (VASurfaceAttribMinHeight, VA_SURFACE_ATTRIB_GETTABLE, 16);
+  ADD_ATTRIB (VASurfaceAttribMaxWidth, VA_SURFACE_ATTRIB_GETTABLE, max_size);
+  ADD_ATTRIB (VASurfaceAttribMaxHeight, VA_SURFACE_ATTRIB_GETTABLE, max_size);
+  ADD_ATTRIB (VASurfaceAttribMemoryType, VA_SURFACE_ATTRIB_GETTABLE,
+      VA_SURFACE_ATTRIB_MEM_TYPE_VA);
+#undef ADD_ATTRIB
+
+  if (attribs) {
+    if (*num_attribs < i)
+      return VA_STATUS_ERROR_MAX_NUM_EXCEEDED;
+    memcpy (attribs, mock_attribs, i * sizeof (*attribs));
+  }
+  *num_attribs = i;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_query_image_formats (VADisplay dpy, VAImageFormat * formats,
+    int *num_formats)
+{
+  g_num_va_calls++;
+  memcpy (formats, g_mock_image_formats, sizeof (g_mock_image_formats));
+  *num_formats = G_N_ELEMENTS (g_mock_image_formats);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+mock_query_subpicture_formats (VADisplay dpy, VAImageFormat * formats,
+    unsigned int *flags, unsigned int *num_formats)
+{
+  g_num_va_calls++;
+  memcpy (formats, g_mock_subpicture_formats,
+      sizeof (g_mock_subpicture_formats));
+  flags[0] = VA_SUBPICTURE_GLOBAL_ALPHA;
+  *num_formats = G_N_ELEMENTS (g_mock_subpicture_formats);
+  return VA_STATUS_SUCCESS;
+}
+
+static const GstVaapiDriverCacheVTable mock_vtable = {
+  .max_num_profiles = mock_max_num_profiles,
+  .max_num_entrypoints = mock_max_num_entrypoints,
+  .max_num_image_formats = mock_max_num_image_formats,
+  .max_num_subpicture_formats = mock_max_num_subpicture_formats,
+  .query_config_profiles = mock_query_config_profiles,
+  .query_config_entrypoints = mock_query_config_entrypoints,
+  .get_config_attributes = mock_get_config_attributes,
+  .create_config = mock_create_config,
+  .destroy_config = mock_destroy_config,
+  .query_surface_attributes = mock_query_surface_attributes,
+  .query_image_formats = mock_query_image_formats,
+  .query_subpicture_formats = mock_query_subpicture_formats,
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- Tests                                                             --- */
+/* ------------------------------------------------------------------------- */
+
+static GstVaapiDriverCache *
+new_cache (const gchar * vendor)
+{
+  GstVaapiDriverCache *const cache = gst_vaapi_driver_cache_new (NULL,
+      &mock_vtable, vendor, MOCK_VA_VERSION, MOCK_DEVICE);
+
+  if (!cache)
+    g_error ("failed to create driver cache");
+  return cache;
+}
+
+/* Queries everything the display and the caps negotiation need, and
+   checks the answers of the mock driver */
+static void
+query_all (GstVaapiDriverCache * cache)
+{
+  const GstVaapiDriverConfig *configs;
+  const VAImageFormat *formats;
+  const guint *flags;
+  GstVaapiDriverConfigInfo info;
+  guint n, rt_formats;
+
+  configs = gst_vaapi_driver_cache_get_configs (cache, &n);
+  g_assert (configs != NULL);
+  g_assert_cmpuint (n, ==, 3);
+  g_assert_cmpint (configs[0].profile, ==, VAProfileH264Main);
+  g_assert_cmpuint (configs[0].entrypoints, ==,
+      (1U << VAEntrypointVLD) | (1U << VAEntrypointEncSlice));
+  g_assert_cmpint (configs[1].profile, ==, VAProfileHEVCMain);
+  g_assert_cmpuint (configs[1].entrypoints, ==, 1U << VAEntrypointVLD);
+  g_assert_cmpint (configs[2].profile, ==, VAProfileNone);
+  g_assert_cmpuint (configs[2].entrypoints, ==, 1U << VAEntrypointVideoProc);
+
+  formats = gst_vaapi_driver_cache_get_image_formats (cache, &n);
+  g_assert (formats != NULL);
+  g_assert_cmpuint (n, ==, G_N_ELEMENTS (g_mock_image_formats));
+  g_assert (memcmp (formats, g_mock_image_formats,
+          sizeof (g_mock_image_formats)) == 0);
+
+  formats = gst_vaapi_driver_cache_get_subpicture_formats (cache, &flags, &n);
+  g_assert (formats != NULL);
+  g_assert_cmpuint (n, ==, 1);
+  g_assert_cmpuint (formats[0].fourcc, ==, VA_FOURCC_BGRA);
+  g_assert_cmpuint (formats[0].alpha_mask, ==, 0xff000000);
+  g_assert_cmpuint (flags[0], ==, VA_SUBPICTURE_GLOBAL_ALPHA);
+
+  g_assert (gst_vaapi_driver_cache_get_config_info (cache, VAProfileHEVCMain,
+          VAEntrypointVLD, &info));
+  g_assert_cmpuint (info.rt_formats, ==, VA_RT_FORMAT_YUV420);
+  g_assert_cmpint (info.min_width, ==, 16);
+  g_assert_cmpint (info.min_height, ==, 16);
+  g_assert_cmpint (info.max_width, ==, 8192);
+  g_assert_cmpint (info.max_height, ==, 8192);
+  g_assert_cmpuint (info.mem_types, ==, VA_SURFACE_ATTRIB_MEM_TYPE_VA);
+  g_assert_cmpuint (info.num_formats, ==, 1);
+  g_assert_cmpuint (info.formats[0], ==, VA_FOURCC_NV12);
+
+  /* The RT formats alone do not create a config */
+  g_assert (gst_vaapi_driver_cache_get_rt_formats (cache, VAProfileH264Main,
+          VAEntrypointVLD, &rt_formats));
+  g_assert_cmpuint (rt_formats, ==, VA_RT_FORMAT_YUV420);
+
+  /* Unsupported configs are remembered too */
+  g_assert (!gst_vaapi_driver_cache_get_config_info (cache, VAProfileH264Main,
+          VAEntrypointEncSlice, &info));
+  g_assert (!gst_vaapi_driver_cache_get_rt_formats (cache, VAProfileH264Main,
+          VAEntrypointEncSlice, &rt_formats));
+  g_assert_cmpuint (g_num_live_configs, ==, 0);
+}
+
+static void
+test_miss_then_hit (const gchar * filename)
+{
+  GstVaapiDriverCache *cache;
+
+  /* Nothing saved yet: every item comes from the driver */
+  g_num_va_calls = 0;
+  cache = new_cache (MOCK_VENDOR);
+  g_assert (!gst_vaapi_driver_cache_load (cache, filename));
+  query_all (cache);
+  g_assert_cmpuint (g_num_va_calls, >, 0);
+  g_print ("miss: %u VA calls\n", g_num_va_calls);
+
+  /* Asking again is answered from memory */
+  g_num_va_calls = 0;
+  query_all (cache);
+  g_assert_cmpuint (g_num_va_calls, ==, 0);
+  g_assert (gst_vaapi_driver_cache_save (cache, filename));
+  gst_vaapi_driver_cache_free (cache);
+
+  /* Same driver in another process: zero VA queries */
+  cache = new_cache (MOCK_VENDOR);
+  g_assert (gst_vaapi_driver_cache_load (cache, filename));
+  query_all (cache);
+  g_assert_cmpuint (g_num_va_calls, ==, 0);
+  g_print ("hit: %u VA calls\n", g_num_va_calls);
+  gst_vaapi_driver_cache_free (cache);
+}
+
+/* A driver update changes the vendor string */
+static void
+test_stale (const gchar * filename)
+{
+  GstVaapiDriverCache *cache;
+
+  g_num_va_calls = 0;
+  cache = new_cache (MOCK_VENDOR " (updated)");
+  g_assert (!gst_vaapi_driver_cache_load (cache, filename));
+  query_all (cache);
+  g_assert_cmpuint (g_num_va_calls, >, 0);
+  gst_vaapi_driver_cache_free (cache);
+}
+
+/* Files of another version, or which fail to parse, are ignored */
+static void
+test_invalid (const gchar * filename)
+{
+  GstVaapiDriverCache *cache;
+  gchar *contents, *data;
+  gsize length;
+
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
+    g_error ("failed to read %s", filename);
+
+  data = g_strdup (contents);
+  g_assert (strstr (data, "version=1") != NULL);
+  strstr (data, "version=1")[8] = '9';
+  if (!g_file_set_contents (filename, data, -1, NULL))
+    g_error ("failed to write %s", filename);
+  g_free (data);
+
+  cache = new_cache (MOCK_VENDOR);
+  g_assert (!gst_vaapi_driver_cache_load (cache, filename));
+  gst_vaapi_driver_cache_free (cache);
+
+  /* Truncated in the middle of the image formats */
+  data = g_strndup (contents, strstr (contents, "[image-formats]") -
+      contents + 40);
+  if (!g_file_set_contents (filename, data, -1, NULL))
+    g_error ("failed to write %s", filename);
+  g_free (data);
+
+  g_num_va_calls = 0;
+  cache = new_cache (MOCK_VENDOR);
+  g_assert (!gst_vaapi_driver_cache_load (cache, filename));
+  query_all (cache);
+  g_assert_cmpuint (g_num_va_calls, >, 0);
+  gst_vaapi_driver_cache_free (cache);
+
+  g_free (contents);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  gchar *filename = NULL;
+  gboolean success;
+  gint fd;
+
+  ctx = g_option_context_new ("- GstVaapiDriverCache test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success)
+    return EXIT_FAILURE;
+
+  fd = g_file_open_tmp ("test-drivercache-XXXXXX", &filename, NULL);
+  if (fd < 0)
+    g_error ("failed to create temporary file");
+  g_close (fd, NULL);
+  g_unlink (filename);
+
+  test_miss_then_hit (filename);
+  test_stale (filename);
+  test_invalid (filename);
+
+  g_unlink (filename);
+  g_free (filename);
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
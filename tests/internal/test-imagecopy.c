@@ -0,0 +1,362 @@
+/*
+ *  test-imagecopy.c - Test and benchmark the raw image copy kernels
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* This program does not need any VA display: the copies are checked
+   against the scalar kernel on images held in system memory */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapiimage_priv.h>
+
+static gchar *g_format_str;
+static gint g_width = 1920;
+static gint g_height = 1080;
+static gint g_iterations = 200;
+static gint g_num_rects = 64;
+
+static GOptionEntry g_options[] = {
+  {"format", 'f', 0, G_OPTION_ARG_STRING, &g_format_str,
+      "benchmarked image format (default: all)", NULL},
+  {"width", 0, 0, G_OPTION_ARG_INT, &g_width,
+      "benchmarked image width", NULL},
+  {"height", 0, 0, G_OPTION_ARG_INT, &g_height,
+      "benchmarked image height", NULL},
+  {"iterations", 'n', 0, G_OPTION_ARG_INT, &g_iterations,
+      "number of copies per benchmark (0 to skip benchmarks)", NULL},
+  {"rects", 'r', 0, G_OPTION_ARG_INT, &g_num_rects,
+      "number of random regions checked per format", NULL},
+  {NULL,}
+};
+
+/* Keep in sync with gst_vaapi_video_default_formats[] */
+static const GstVideoFormat g_formats[] = {
+  GST_VIDEO_FORMAT_NV12,
+  GST_VIDEO_FORMAT_YV12,
+  GST_VIDEO_FORMAT_I420,
+  GST_VIDEO_FORMAT_YUY2,
+  GST_VIDEO_FORMAT_UYVY,
+  GST_VIDEO_FORMAT_Y444,
+  GST_VIDEO_FORMAT_GRAY8,
+  GST_VIDEO_FORMAT_P010_10LE,
+  GST_VIDEO_FORMAT_P012_LE,
+  GST_VIDEO_FORMAT_VUYA,
+  GST_VIDEO_FORMAT_Y210,
+  GST_VIDEO_FORMAT_Y410,
+  GST_VIDEO_FORMAT_ARGB,
+  GST_VIDEO_FORMAT_xRGB,
+  GST_VIDEO_FORMAT_RGBA,
+  GST_VIDEO_FORMAT_RGBx,
+  GST_VIDEO_FORMAT_ABGR,
+  GST_VIDEO_FORMAT_xBGR,
+  GST_VIDEO_FORMAT_BGRA,
+  GST_VIDEO_FORMAT_BGRx,
+  GST_VIDEO_FORMAT_RGB16,
+  GST_VIDEO_FORMAT_RGB,
+  GST_VIDEO_FORMAT_BGR10A2_LE,
+};
+
+static const guint g_flags[] = {
+  0,
+  GST_VAAPI_COPY_FLAG_SRC_UNCACHED,
+  GST_VAAPI_COPY_FLAG_DST_UNCACHED,
+  GST_VAAPI_COPY_FLAG_SRC_UNCACHED | GST_VAAPI_COPY_FLAG_DST_UNCACHED,
+};
+
+typedef struct
+{
+  GstVaapiImageRaw raw;
+  guint8 *data;
+  gsize size;
+} TestImage;
+
+static guint
+get_plane_height (const GstVideoInfo * vip, guint plane)
+{
+  guint c;
+
+  for (c = 0; c < GST_VIDEO_INFO_N_COMPONENTS (vip); c++) {
+    if (GST_VIDEO_INFO_COMP_PLANE (vip, c) == plane)
+      return GST_VIDEO_INFO_COMP_HEIGHT (vip, c);
+  }
+  return 0;
+}
+
+/* Lays out the planes with a padded stride, like VA images have, and
+   shifts them by @misalign bytes to exercise the unaligned paths */
+static gboolean
+test_image_init (TestImage * image, GstVideoFormat format, guint width,
+    guint height, guint misalign)
+{
+  GstVideoInfo vi;
+  gsize offsets[G_N_ELEMENTS (image->raw.pixels)];
+  gsize offset;
+  guint i;
+
+  memset (image, 0, sizeof (*image));
+  if (!gst_video_info_set_format (&vi, format, width, height))
+    return FALSE;
+  if (GST_VIDEO_INFO_N_PLANES (&vi) > G_N_ELEMENTS (image->raw.pixels))
+    return FALSE;
+
+  image->raw.format = format;
+  image->raw.width = width;
+  image->raw.height = height;
+  image->raw.num_planes = GST_VIDEO_INFO_N_PLANES (&vi);
+
+  offset = misalign;
+  for (i = 0; i < image->raw.num_planes; i++) {
+    image->raw.stride[i] = GST_ROUND_UP_64 (GST_VIDEO_INFO_PLANE_STRIDE (&vi,
+            i)) + 64 + misalign;
+    offsets[i] = offset;
+    offset += (gsize) image->raw.stride[i] * get_plane_height (&vi, i) +
+        misalign;
+  }
+
+  image->size = offset;
+  image->data = g_malloc (image->size);
+  for (i = 0; i < image->raw.num_planes; i++)
+    image->raw.pixels[i] = image->data + offsets[i];
+  return TRUE;
+}
+
+static void
+test_image_clear (TestImage * image)
+{
+  g_free (image->data);
+  image->data = NULL;
+}
+
+static void
+test_image_fill_random (TestImage * image, GRand * rand)
+{
+  gsize i;
+
+  for (i = 0; i < image->size; i++)
+    image->data[i] = g_rand_int (rand);
+}
+
+static void
+get_random_rect (GstVaapiRectangle * rect, guint width, guint height,
+    GRand * rand)
+{
+  rect->x = g_rand_int_range (rand, 0, width);
+  rect->y = g_rand_int_range (rand, 0, height);
+  rect->width = g_rand_int_range (rand, 1, width - rect->x + 1);
+  rect->height = g_rand_int_range (rand, 1, height - rect->y + 1);
+}
+
+/* Checks that a full copy with the scalar kernel reproduces every line
+   of every plane, to validate the region computations themselves */
+static gboolean
+check_full_copy (GstVideoFormat format, TestImage * src, TestImage * dst)
+{
+  GstVideoInfo vi;
+  guint i, y, c, row_size;
+
+  if (!gst_vaapi_image_raw_copy (&dst->raw, &src->raw, NULL,
+          GST_VAAPI_COPY_KERNEL_SCALAR, 0))
+    return FALSE;
+
+  gst_video_info_set_format (&vi, format, src->raw.width, src->raw.height);
+  for (i = 0; i < src->raw.num_planes; i++) {
+    row_size = 0;
+    for (c = 0; c < GST_VIDEO_INFO_N_COMPONENTS (&vi); c++) {
+      if (GST_VIDEO_INFO_COMP_PLANE (&vi, c) != i)
+        continue;
+      row_size = MAX (row_size, GST_VIDEO_INFO_COMP_WIDTH (&vi, c) *
+          GST_VIDEO_INFO_COMP_PSTRIDE (&vi, c));
+    }
+    for (y = 0; y < get_plane_height (&vi, i); y++) {
+      if (memcmp (dst->raw.pixels[i] + y * dst->raw.stride[i],
+              src->raw.pixels[i] + y * src->raw.stride[i], row_size) != 0)
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static gboolean
+check_format (GstVideoFormat format, GRand * rand)
+{
+  const gchar *const name = gst_video_format_to_string (format);
+  TestImage src, ref, dst;
+  GstVaapiRectangle rect;
+  guint width, height, kernel, i, j;
+  gboolean success = FALSE;
+
+  /* Odd sizes exercise the rounding of subsampled planes */
+  width = g_rand_int_range (rand, 64, 400) | 1;
+  height = g_rand_int_range (rand, 16, 64) | 1;
+
+  if (!test_image_init (&src, format, width, height, 0))
+    goto error_init;
+  if (!test_image_init (&ref, format, width, height, 7)) {
+    test_image_clear (&src);
+    goto error_init;
+  }
+  if (!test_image_init (&dst, format, width, height, 7)) {
+    test_image_clear (&ref);
+    test_image_clear (&src);
+    goto error_init;
+  }
+  test_image_fill_random (&src, rand);
+
+  if (!check_full_copy (format, &src, &ref)) {
+    g_printerr ("%s: full copy mismatch\n", name);
+    goto end;
+  }
+
+  for (i = 0; i < (guint) g_num_rects; i++) {
+    get_random_rect (&rect, width, height, rand);
+
+    memset (ref.data, 0xa5, ref.size);
+    if (!gst_vaapi_image_raw_copy (&ref.raw, &src.raw, &rect,
+            GST_VAAPI_COPY_KERNEL_SCALAR, 0)) {
+      g_printerr ("%s: copy failed\n", name);
+      goto end;
+    }
+
+    for (kernel = GST_VAAPI_COPY_KERNEL_SCALAR;
+        kernel < GST_VAAPI_COPY_KERNEL_COUNT; kernel++) {
+      if (!gst_vaapi_copy_kernel_is_supported (kernel))
+        continue;
+
+      for (j = 0; j < G_N_ELEMENTS (g_flags); j++) {
+        memset (dst.data, 0xa5, dst.size);
+        gst_vaapi_image_raw_copy (&dst.raw, &src.raw, &rect, kernel,
+            g_flags[j]);
+        if (memcmp (dst.data, ref.data, dst.size) != 0) {
+          g_printerr ("%s: %s kernel mismatch (flags 0x%x, rect %ux%u at "
+              "%u,%u)\n", name, gst_vaapi_copy_kernel_get_name (kernel),
+              g_flags[j], rect.width, rect.height, rect.x, rect.y);
+          goto end;
+        }
+      }
+    }
+  }
+  g_print ("%-12s OK\n", name);
+  success = TRUE;
+
+end:
+  test_image_clear (&dst);
+  test_image_clear (&ref);
+  test_image_clear (&src);
+  return success;
+
+  /* ERRORS */
+error_init:
+  {
+    g_printerr ("%s: failed to allocate test images\n", name);
+    return FALSE;
+  }
+}
+
+/* Note the images live in regular cached memory here, so this measures
+   the overhead of the kernels rather than actual write-combining reads */
+static void
+bench_format (GstVideoFormat format)
+{
+  TestImage src, dst;
+  guint kernel, j, n;
+  gint64 start, elapsed;
+  gsize frame_size;
+
+  if (!test_image_init (&src, format, g_width, g_height, 0))
+    return;
+  if (!test_image_init (&dst, format, g_width, g_height, 0)) {
+    test_image_clear (&src);
+    return;
+  }
+  memset (src.data, 0x80, src.size);
+
+  frame_size = src.size;
+
+  for (kernel = GST_VAAPI_COPY_KERNEL_SCALAR;
+      kernel < GST_VAAPI_COPY_KERNEL_COUNT; kernel++) {
+    if (!gst_vaapi_copy_kernel_is_supported (kernel))
+      continue;
+
+    for (j = 0; j < G_N_ELEMENTS (g_flags); j++) {
+      start = g_get_monotonic_time ();
+      for (n = 0; n < (guint) g_iterations; n++)
+        gst_vaapi_image_raw_copy (&dst.raw, &src.raw, NULL, kernel,
+            g_flags[j]);
+      elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+      g_print ("%-12s %-7s flags 0x%x  %8.1f MB/s  %7.1f frames/s\n",
+          gst_video_format_to_string (format),
+          gst_vaapi_copy_kernel_get_name (kernel), g_flags[j],
+          (gdouble) frame_size * g_iterations / elapsed,
+          (gdouble) g_iterations * G_USEC_PER_SEC / elapsed);
+    }
+  }
+
+  test_image_clear (&dst);
+  test_image_clear (&src);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GstVideoFormat format = GST_VIDEO_FORMAT_UNKNOWN;
+  GRand *rand;
+  gboolean success;
+  guint i;
+
+  ctx = g_option_context_new ("- raw image copy test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success || g_width <= 0 || g_height <= 0)
+    return EXIT_FAILURE;
+
+  if (g_format_str) {
+    format = gst_video_format_from_string (g_format_str);
+    if (format == GST_VIDEO_FORMAT_UNKNOWN) {
+      g_printerr ("unknown format %s\n", g_format_str);
+      return EXIT_FAILURE;
+    }
+  }
+
+  g_print ("default kernel: %s\n",
+      gst_vaapi_copy_kernel_get_name (gst_vaapi_copy_get_default_kernel ()));
+
+  rand = g_rand_new_with_seed (0x76617069);
+  for (i = 0; i < G_N_ELEMENTS (g_formats); i++) {
+    if (!check_format (g_formats[i], rand))
+      success = FALSE;
+  }
+  g_rand_free (rand);
+
+  if (g_iterations > 0) {
+    for (i = 0; i < G_N_ELEMENTS (g_formats); i++) {
+      if (format == GST_VIDEO_FORMAT_UNKNOWN || format == g_formats[i])
+        bench_format (g_formats[i]);
+    }
+  }
+
+  g_free (g_format_str);
+  gst_deinit ();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
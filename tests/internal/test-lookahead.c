@@ -0,0 +1,229 @@
+/*
+ *  test-lookahead.c - Test the encoder look-ahead decisions
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Runs GstVaapiLookahead on a synthetic Y4M stream made of three
+   scenes: a slowly panning gradient, fast moving bars, then the
+   gradient again. The scene cuts shall be found at the scene
+   boundaries only, and the B-frames shall be dropped in the fast
+   scene. With --input, the decisions for a real Y4M file are
+   printed instead */
+
+#include "gst/vaapi/sysdeps.h"
+#include <glib/gstdio.h>
+#include <gst/vaapi/gstvaapilookahead.h>
+#include "y4mreader.h"
+
+#define WIDTH 320
+#define HEIGHT 240
+#define SCENE_LENGTH 40
+#define NUM_FRAMES (3 * SCENE_LENGTH)
+
+static gchar *g_input_filename;
+static gint g_depth = 8;
+static gint g_max_bframes = 3;
+static gboolean g_verbose;
+
+static GOptionEntry g_options[] = {
+  {"input", 'i', 0, G_OPTION_ARG_STRING, &g_input_filename,
+      "Y4M file to analyze instead of the synthetic stream", NULL},
+  {"depth", 'd', 0, G_OPTION_ARG_INT, &g_depth,
+      "number of frames in the look-ahead window", NULL},
+  {"max-bframes", 'b', 0, G_OPTION_ARG_INT, &g_max_bframes,
+      "maximum number of consecutive B-frames", NULL},
+  {"verbose", 'v', 0, G_OPTION_ARG_NONE, &g_verbose,
+      "print the decisions for every frame", NULL},
+  {NULL,}
+};
+
+/* Diagonal gradient, panning by one pixel per frame */
+static guint8
+gradient_sample (guint x, guint y, guint n)
+{
+  return 96 + (x + y + n) * 64 / (WIDTH + HEIGHT + NUM_FRAMES);
+}
+
+/* Full range vertical bars, moving by 16 pixels per frame */
+static guint8
+bars_sample (guint x, guint y, guint n)
+{
+  const guint phase = (x + 16 * n) % 64;
+
+  return phase < 32 ? phase * 255 / 31 : (63 - phase) * 255 / 31;
+}
+
+static gboolean
+write_synthetic_stream (const gchar * filename)
+{
+  guint8 *const frame = g_malloc (WIDTH * HEIGHT * 3 / 2);
+  FILE *fp;
+  guint n, x, y;
+  gboolean success = FALSE;
+
+  fp = fopen (filename, "wb");
+  if (!fp)
+    goto bail;
+
+  fprintf (fp, "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 C420jpeg\n", WIDTH, HEIGHT);
+  memset (frame + WIDTH * HEIGHT, 128, WIDTH * HEIGHT / 2);
+  for (n = 0; n < NUM_FRAMES; n++) {
+    const gboolean is_bars = n / SCENE_LENGTH == 1;
+
+    for (y = 0; y < HEIGHT; y++) {
+      for (x = 0; x < WIDTH; x++)
+        frame[y * WIDTH + x] = is_bars ? bars_sample (x, y, n) :
+            gradient_sample (x, y, n);
+    }
+    if (fprintf (fp, "FRAME\n") < 0 ||
+        fwrite (frame, 1, WIDTH * HEIGHT * 3 / 2, fp) != WIDTH * HEIGHT * 3 / 2)
+      goto bail;
+  }
+  success = TRUE;
+
+bail:
+  if (fp && fclose (fp) != 0)
+    success = FALSE;
+  g_free (frame);
+  return success;
+}
+
+static void
+print_decision (guint n, const GstVaapiLookaheadInfo * info)
+{
+  g_print ("frame %4u: complexity %6.2f motion %6.2f histogram %4.2f "
+      "bframes %u%s\n", n, info->complexity, info->motion,
+      info->histogram_delta, info->num_bframes,
+      info->scene_cut ? " scene-cut" : "");
+}
+
+/* Checks the decisions made for the synthetic stream */
+static void
+check_decision (guint n, const GstVaapiLookaheadInfo * info)
+{
+  const guint scene_start = n - n % SCENE_LENGTH;
+
+  g_assert (info->analyzed);
+
+  if (info->scene_cut != (n > 0 && n == scene_start))
+    g_error ("frame %u: unexpected scene cut decision", n);
+
+  /* Frames whose next anchor is past a scene cut use the B-frame
+     count of their own scene only, so every frame is checked */
+  if (n / SCENE_LENGTH == 1) {
+    if (info->num_bframes != 0)
+      g_error ("frame %u: %u B-frames in fast motion", n, info->num_bframes);
+  } else if (info->num_bframes != (guint) g_max_bframes) {
+    g_error ("frame %u: %u B-frames in slow motion", n, info->num_bframes);
+  }
+}
+
+static void
+handle_frame (GstVaapiLookahead * lookahead, gboolean drain,
+    gboolean synthetic)
+{
+  GstVaapiLookaheadInfo info;
+  gpointer data;
+  guint n;
+
+  while ((data = gst_vaapi_lookahead_pop (lookahead, drain, &info))) {
+    n = GPOINTER_TO_UINT (data) - 1;
+    if (g_verbose || !synthetic)
+      print_decision (n, &info);
+    if (synthetic)
+      check_decision (n, &info);
+  }
+}
+
+static guint
+run (Y4MReader * file, gboolean synthetic)
+{
+  GstVaapiLookahead *lookahead;
+  guint8 *frame;
+  guint n;
+
+  lookahead = gst_vaapi_lookahead_new (g_depth, g_max_bframes);
+  if (!lookahead)
+    g_error ("failed to create look-ahead");
+
+  frame = g_malloc (file->width * file->height * 3 / 2);
+  for (n = 0; y4m_reader_read_frame (file, frame); n++) {
+    /* The user data has to be non-NULL */
+    gst_vaapi_lookahead_push (lookahead, GUINT_TO_POINTER (n + 1), frame,
+        file->width, file->width, file->height);
+    handle_frame (lookahead, FALSE, synthetic);
+    g_assert_cmpuint (gst_vaapi_lookahead_get_length (lookahead), <=,
+        g_depth);
+  }
+  handle_frame (lookahead, TRUE, synthetic);
+  g_assert_cmpuint (gst_vaapi_lookahead_get_length (lookahead), ==, 0);
+
+  gst_vaapi_lookahead_free (lookahead);
+  g_free (frame);
+  return n;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  Y4MReader *file;
+  gchar *filename = NULL;
+  gboolean success;
+  guint num_frames;
+  gint fd;
+
+  ctx = g_option_context_new ("- encoder look-ahead test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success || g_depth <= 0 || g_max_bframes < 0)
+    return EXIT_FAILURE;
+
+  if (!g_input_filename) {
+    fd = g_file_open_tmp ("test-lookahead-XXXXXX.y4m", &filename, NULL);
+    if (fd < 0)
+      g_error ("failed to create temporary file");
+    g_close (fd, NULL);
+    if (!write_synthetic_stream (filename))
+      g_error ("failed to write synthetic stream");
+  }
+
+  file = y4m_reader_open (filename ? filename : g_input_filename);
+  if (!file)
+    g_error ("failed to open Y4M stream");
+
+  num_frames = run (file, filename != NULL);
+  y4m_reader_close (file);
+
+  if (filename) {
+    if (num_frames != NUM_FRAMES)
+      g_error ("read %u frames out of %u", num_frames, NUM_FRAMES);
+    g_print ("%u frames, depth %d, max B-frames %d: OK\n", num_frames,
+        g_depth, g_max_bframes);
+    g_unlink (filename);
+    g_free (filename);
+  }
+
+  g_free (g_input_filename);
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
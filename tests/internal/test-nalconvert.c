@@ -0,0 +1,383 @@
+/*
+ *  test-nalconvert.c - Test the byte-stream to avc/hvc1 conversion
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* This program does not need any VA display: random byte-streams are
+   converted as gst_vaapi_coded_buffer_copy_nal_units_into() does, a
+   chunk at a time, and checked against the conversion the encoders
+   used to do in a second pass over the copied data. The benchmarks
+   compare both ways, from copy to converted buffer */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/vaapi/gstvaapiutils_h26x_priv.h>
+
+#define CHUNK_SIZE 16384        /* as gstvaapicodedbuffer.c */
+
+static gint g_size = 1024 * 1024;
+static gint g_nal_size = 16384;
+static gint g_iterations = 200;
+static gint g_num_streams = 64;
+
+static GOptionEntry g_options[] = {
+  {"size", 's', 0, G_OPTION_ARG_INT, &g_size,
+      "benchmarked byte-stream size", NULL},
+  {"nal-size", 0, 0, G_OPTION_ARG_INT, &g_nal_size,
+      "maximum NAL unit size", NULL},
+  {"iterations", 'n', 0, G_OPTION_ARG_INT, &g_iterations,
+      "number of conversions per benchmark (0 to skip benchmarks)", NULL},
+  {"streams", 'r', 0, G_OPTION_ARG_INT, &g_num_streams,
+      "number of random byte-streams checked", NULL},
+  {NULL,}
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- Reference two-pass conversion                                     --- */
+/* ------------------------------------------------------------------------- */
+
+static guint8 *
+ref_byte_stream_next_nal (guint8 * buffer, guint32 len, guint32 * nal_size)
+{
+  const guint8 *cur = buffer;
+  const guint8 *const end = buffer + len;
+  guint8 *nal_start = NULL;
+  guint32 flag = 0xFFFFFFFF;
+  guint32 nal_start_len = 0;
+
+  if (len < 3) {
+    *nal_size = len;
+    nal_start = (len ? buffer : NULL);
+    return nal_start;
+  }
+
+  if (!buffer[0] && !buffer[1]) {
+    if (buffer[2] == 1) {
+      nal_start_len = 3;
+    } else if (!buffer[2] && len >= 4 && buffer[3] == 1) {
+      nal_start_len = 4;
+    }
+  }
+  nal_start = buffer + nal_start_len;
+  cur = nal_start;
+
+  while (cur < end) {
+    flag = ((flag << 8) | ((*cur++) & 0xFF));
+    if ((flag & 0x00FFFFFF) == 0x00000001) {
+      if (flag == 0x00000001)
+        *nal_size = cur - 4 - nal_start;
+      else
+        *nal_size = cur - 3 - nal_start;
+      break;
+    }
+  }
+  if (cur >= end) {
+    *nal_size = end - nal_start;
+    if (nal_start >= end) {
+      nal_start = NULL;
+    }
+  }
+  return nal_start;
+}
+
+static gboolean
+ref_convert (guint8 * data, gsize size)
+{
+  guint8 *nal_start_code, *nal_body;
+  guint8 *const frame_end = data + size;
+  guint32 nal_size = 0;
+
+  nal_start_code = data;
+  while ((frame_end > nal_start_code) &&
+      (nal_body = ref_byte_stream_next_nal (nal_start_code,
+              frame_end - nal_start_code, &nal_size)) != NULL) {
+    if (!nal_size || nal_body - nal_start_code != 4)
+      return FALSE;
+    GST_WRITE_UINT32_BE (nal_start_code, nal_size);
+    nal_start_code = nal_body + nal_size;
+  }
+  return TRUE;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Single-pass conversion                                            --- */
+/* ------------------------------------------------------------------------- */
+
+/* Copies @src as if it were made of segments of @segment_size bytes,
+   converting @chunk_size bytes at a time */
+static gboolean
+copy_and_convert (guint8 * dst, const guint8 * src, gsize size,
+    gsize segment_size, gsize chunk_size)
+{
+  GstVaapiH26xConverter conv;
+  gsize offset, pos, n;
+
+  gst_vaapi_utils_h26x_converter_init (&conv, dst);
+  for (offset = 0; offset < size; offset += segment_size) {
+    segment_size = MIN (segment_size, size - offset);
+    for (pos = 0; pos < segment_size; pos += n) {
+      n = MIN (segment_size - pos, chunk_size);
+      memcpy (dst + offset + pos, src + offset + pos, n);
+      if (!gst_vaapi_utils_h26x_converter_push (&conv, n))
+        return FALSE;
+    }
+  }
+  return gst_vaapi_utils_h26x_converter_finish (&conv);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Checks                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+/* Appends a NAL unit of up to @max_size bytes, with emulation
+   prevention bytes. Slice data is mostly random, while @many_zeros
+   makes the scanner see many candidate start codes */
+static void
+append_nal_unit (GByteArray * stream, GRand * rand, guint max_size,
+    gboolean many_zeros)
+{
+  static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+  guint i, size, num_zeros = 0;
+  guint8 byte;
+
+  g_byte_array_append (stream, start_code, sizeof (start_code));
+  byte = g_rand_int_range (rand, 1, 256);
+  g_byte_array_append (stream, &byte, 1);
+
+  size = g_rand_int_range (rand, 0, max_size);
+  for (i = 0; i < size; i++) {
+    if (many_zeros && g_rand_boolean (rand))
+      byte = 0;
+    else
+      byte = g_rand_int_range (rand, 0, 256);
+    if (num_zeros == 2 && byte <= 3) {
+      const guint8 epb = 0x03;
+      g_byte_array_append (stream, &epb, 1);
+      num_zeros = 0;
+    }
+    g_byte_array_append (stream, &byte, 1);
+    num_zeros = byte ? 0 : num_zeros + 1;
+  }
+
+  /* rbsp_stop_one_bit */
+  if (num_zeros > 0) {
+    byte = 0x80;
+    g_byte_array_append (stream, &byte, 1);
+  }
+}
+
+static GByteArray *
+make_stream (GRand * rand, gsize size, guint max_nal_size,
+    gboolean many_zeros)
+{
+  GByteArray *const stream = g_byte_array_sized_new (size + max_nal_size);
+
+  do {
+    append_nal_unit (stream, rand, max_nal_size, many_zeros);
+  } while (stream->len < size);
+  return stream;
+}
+
+static gsize
+find_start_code_naive (const guint8 * data, gsize size)
+{
+  gsize i;
+
+  for (i = 0; i + 3 <= size; i++) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+      return i;
+  }
+  return size;
+}
+
+static gboolean
+check_scanner (GRand * rand)
+{
+  guint8 data[256];
+  gsize i, j, size, offset;
+
+  for (i = 0; i < 1000; i++) {
+    size = g_rand_int_range (rand, 0, sizeof (data));
+    for (j = 0; j < size; j++)
+      data[j] = g_rand_int_range (rand, 0, 3);
+    offset = g_rand_int_range (rand, 0, size + 1);
+    if (gst_vaapi_utils_h26x_find_start_code (data + offset, size - offset)
+        != find_start_code_naive (data + offset, size - offset)) {
+      g_printerr ("start code scanner mismatch\n");
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static gboolean
+check_stream (GRand * rand)
+{
+  static const gsize chunk_sizes[] = { 1, 2, 3, 5, 16, 17, 4096, G_MAXSIZE };
+  GByteArray *stream;
+  guint8 *ref, *dst;
+  gsize segment_size;
+  gboolean success = TRUE;
+  guint i;
+
+  stream = make_stream (rand, g_rand_int_range (rand, 1, 65536),
+      g_rand_int_range (rand, 1, 4096), TRUE);
+  ref = g_malloc (stream->len);
+  dst = g_malloc (stream->len);
+  memcpy (ref, stream->data, stream->len);
+  if (!ref_convert (ref, stream->len))
+    g_error ("invalid random byte-stream");
+
+  for (i = 0; i < G_N_ELEMENTS (chunk_sizes); i++) {
+    segment_size = g_rand_boolean (rand) ? G_MAXSIZE :
+        g_rand_int_range (rand, 1, stream->len + 1);
+    if (!copy_and_convert (dst, stream->data, stream->len, segment_size,
+            chunk_sizes[i]) || memcmp (dst, ref, stream->len) != 0) {
+      g_printerr ("conversion mismatch (%u bytes, chunks of %"
+          G_GSIZE_FORMAT ")\n", stream->len, chunk_sizes[i]);
+      success = FALSE;
+    }
+  }
+
+  g_free (dst);
+  g_free (ref);
+  g_byte_array_unref (stream);
+  return success;
+}
+
+/* Byte-streams that cannot be converted in place */
+static gboolean
+check_invalid_streams (void)
+{
+  static const guint8 three_byte_start_code[] = {
+    0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x00, 0x00, 0x01, 0x41, 0x9a,
+  };
+  static const guint8 leading_garbage[] = {
+    0x42, 0x00, 0x00, 0x00, 0x01, 0x65, 0x88,
+  };
+  static const guint8 empty_nal_unit[] = {
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x65, 0x88,
+  };
+  static const guint8 no_start_code[] = { 0x65, 0x88, 0x84, 0x00 };
+  static const struct
+  {
+    const guint8 *data;
+    gsize size;
+  } streams[] = {
+    {three_byte_start_code, sizeof (three_byte_start_code)},
+    {leading_garbage, sizeof (leading_garbage)},
+    {empty_nal_unit, sizeof (empty_nal_unit)},
+    {no_start_code, sizeof (no_start_code)},
+  };
+  guint8 dst[16];
+  gboolean success = TRUE;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (streams); i++) {
+    if (copy_and_convert (dst, streams[i].data, streams[i].size, G_MAXSIZE,
+            CHUNK_SIZE)) {
+      g_printerr ("invalid byte-stream %u was converted\n", i);
+      success = FALSE;
+    }
+  }
+  return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Benchmarks                                                        --- */
+/* ------------------------------------------------------------------------- */
+
+static void
+print_bench (const gchar * name, gint64 elapsed, gsize size)
+{
+  g_print ("%-12s %8.1f us/stream %8.1f MB/s\n", name,
+      (gdouble) elapsed / g_iterations,
+      (gdouble) size * g_iterations / MAX (elapsed, 1));
+}
+
+static void
+bench_conversion (void)
+{
+  GByteArray *stream;
+  GRand *rand;
+  guint8 *dst;
+  gint64 start;
+  gint i;
+
+  rand = g_rand_new_with_seed (0x6e616c73);
+  stream = make_stream (rand, g_size, g_nal_size, FALSE);
+  dst = g_malloc (stream->len);
+  g_rand_free (rand);
+
+  g_print ("%u bytes byte-stream, NAL units of up to %d bytes\n",
+      stream->len, g_nal_size);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < g_iterations; i++) {
+    memcpy (dst, stream->data, stream->len);
+    if (!ref_convert (dst, stream->len))
+      g_error ("two-pass conversion failed");
+  }
+  print_bench ("two-pass", g_get_monotonic_time () - start, stream->len);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < g_iterations; i++) {
+    if (!copy_and_convert (dst, stream->data, stream->len, G_MAXSIZE,
+            CHUNK_SIZE))
+      g_error ("single-pass conversion failed");
+  }
+  print_bench ("single-pass", g_get_monotonic_time () - start, stream->len);
+
+  g_free (dst);
+  g_byte_array_unref (stream);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GRand *rand;
+  gboolean success;
+  gint i;
+
+  ctx = g_option_context_new ("- byte-stream to avc/hvc1 conversion test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success || g_size <= 0 || g_nal_size <= 0)
+    return EXIT_FAILURE;
+
+  rand = g_rand_new_with_seed (0x76617069);
+  if (!check_scanner (rand))
+    success = FALSE;
+  for (i = 0; i < g_num_streams; i++) {
+    if (!check_stream (rand))
+      success = FALSE;
+  }
+  if (!check_invalid_streams ())
+    success = FALSE;
+  g_rand_free (rand);
+
+  if (g_iterations > 0)
+    bench_conversion ();
+
+  gst_deinit ();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,145 @@
+/*
+ *  test-objectcache.c - Benchmark GstVaapiMiniObjectCache
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Replays the object allocation pattern of a multi-slice H.264 stream
+   decode: one parser frame, picture and frame store per frame, plus a
+   parser info and a slice per slice. Pictures are kept alive by a DPB
+   of a few frames, as they are in the real decoder */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiminiobject.h>
+
+static gint g_num_frames = 100000;
+static gint g_num_slices = 8;
+static gint g_dpb_size = 4;
+
+static GOptionEntry g_options[] = {
+  {"frames", 'n', 0, G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames to decode", NULL},
+  {"slices", 's', 0, G_OPTION_ARG_INT, &g_num_slices,
+      "number of slices per frame", NULL},
+  {"dpb-size", 'd', 0, G_OPTION_ARG_INT, &g_dpb_size,
+      "number of pictures kept alive as references", NULL},
+  {NULL,}
+};
+
+/* Sizes roughly matching the 64-bit H.264 decoder objects */
+static const GstVaapiMiniObjectClass parser_frame_class = { 56, };
+static const GstVaapiMiniObjectClass parser_info_class = { 1416, };
+static const GstVaapiMiniObjectClass slice_class = { 104, };
+static const GstVaapiMiniObjectClass picture_class = { 336, };
+static const GstVaapiMiniObjectClass frame_store_class = { 64, };
+
+typedef struct
+{
+  const gchar *name;
+  GstVaapiMiniObjectCache *cache;
+} Bench;
+
+static GstVaapiMiniObject *
+new_object (Bench * bench, const GstVaapiMiniObjectClass * klass)
+{
+  GstVaapiMiniObject *const object =
+      gst_vaapi_mini_object_new0_with_cache (klass, bench->cache);
+
+  if (!object)
+    g_error ("failed to allocate object");
+  return object;
+}
+
+static void
+run_bench (Bench * bench)
+{
+  GstVaapiMiniObject **const dpb = g_new0 (GstVaapiMiniObject *,
+      g_dpb_size);
+  GstVaapiMiniObject **const slices = g_new0 (GstVaapiMiniObject *,
+      g_num_slices * 2);
+  GstVaapiMiniObjectCacheStats stats = { 0, };
+  GstVaapiMiniObject *frame, *picture, *fs;
+  gint64 start, elapsed;
+  gint i, j;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < g_num_frames; i++) {
+    frame = new_object (bench, &parser_frame_class);
+    for (j = 0; j < g_num_slices; j++)
+      slices[2 * j] = new_object (bench, &parser_info_class);
+
+    picture = new_object (bench, &picture_class);
+    for (j = 0; j < g_num_slices; j++)
+      slices[2 * j + 1] = new_object (bench, &slice_class);
+
+    fs = new_object (bench, &frame_store_class);
+    gst_vaapi_mini_object_replace (&dpb[i % g_dpb_size], picture);
+    gst_vaapi_mini_object_unref (fs);
+    gst_vaapi_mini_object_unref (picture);
+
+    for (j = 0; j < g_num_slices * 2; j++)
+      gst_vaapi_mini_object_unref (slices[j]);
+    gst_vaapi_mini_object_unref (frame);
+  }
+  for (i = 0; i < g_dpb_size; i++)
+    gst_vaapi_mini_object_replace (&dpb[i], NULL);
+  elapsed = g_get_monotonic_time () - start;
+
+  if (bench->cache)
+    gst_vaapi_mini_object_cache_get_stats (bench->cache, &stats);
+  g_print ("%-10s %8.1f ns/frame  %6.2f allocs/frame  %6.2f recycled/frame\n",
+      bench->name, (gdouble) elapsed * 1000 / g_num_frames,
+      (gdouble) stats.num_allocs / g_num_frames,
+      (gdouble) stats.num_reuses / g_num_frames);
+
+  g_free (slices);
+  g_free (dpb);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  Bench bench;
+  gboolean success;
+
+  ctx = g_option_context_new ("- GstVaapiMiniObjectCache benchmark");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success || g_num_frames <= 0 || g_num_slices <= 0 || g_dpb_size <= 0)
+    return EXIT_FAILURE;
+
+  /* A cache without free-lists counts the allocations of the slice
+     allocator path, i.e. what the decoder did before */
+  bench.name = "no-cache";
+  bench.cache = gst_vaapi_mini_object_cache_new (0);
+  run_bench (&bench);
+  gst_vaapi_mini_object_cache_unref (bench.cache);
+
+  bench.name = "cache";
+  bench.cache = gst_vaapi_mini_object_cache_new_default ();
+  run_bench (&bench);
+  gst_vaapi_mini_object_cache_unref (bench.cache);
+
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,239 @@
+/*
+ *  test-readback.c - Benchmark reads from mapped VA images
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Compares a CPU consumer reading the pixels straight from the mapped
+   VA image with one reading them from a system memory shadow filled
+   by gst_vaapi_image_read_data(), which is what the video memory does
+   when GST_VAAPI_ENABLE_READBACK_SHADOW is set */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapisurface.h>
+#include "image.h"
+#include "output.h"
+
+static gchar *g_format_str;
+static gint g_width = 1920;
+static gint g_height = 1080;
+static gint g_num_frames = 100;
+static gint g_num_passes = 1;
+static gboolean g_derive;
+
+static GOptionEntry g_options[] = {
+  {"format", 0, 0, G_OPTION_ARG_STRING, &g_format_str,
+      "image format (default: NV12)", NULL},
+  {"width", 0, 0, G_OPTION_ARG_INT, &g_width,
+      "image width", NULL},
+  {"height", 0, 0, G_OPTION_ARG_INT, &g_height,
+      "image height", NULL},
+  {"frames", 'n', 0, G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames read back", NULL},
+  {"passes", 'p', 0, G_OPTION_ARG_INT, &g_num_passes,
+      "number of times each frame is read by the consumer", NULL},
+  {"derive", 'd', 0, G_OPTION_ARG_NONE, &g_derive,
+      "derive images from the surface, as with direct rendering", NULL},
+  {NULL,}
+};
+
+typedef struct
+{
+  const gchar *name;
+  gboolean use_shadow;
+  gint64 readback_time;
+  gint64 consume_time;
+  guint64 checksum;
+} Bench;
+
+/* Stands for the CPU consumer: reads every visible byte of the frame */
+static guint64
+consume_frame (const GstVideoInfo * vip, const guchar * data,
+    const VAImage * va_image)
+{
+  guint64 sum = 0;
+  guint i, c, x, y, row_size, num_rows;
+
+  for (i = 0; i < va_image->num_planes; i++) {
+    row_size = num_rows = 0;
+    for (c = 0; c < GST_VIDEO_INFO_N_COMPONENTS (vip); c++) {
+      if (GST_VIDEO_INFO_COMP_PLANE (vip, c) != i)
+        continue;
+      row_size = MAX (row_size, GST_VIDEO_INFO_COMP_WIDTH (vip, c) *
+          GST_VIDEO_INFO_COMP_PSTRIDE (vip, c));
+      num_rows = MAX (num_rows, GST_VIDEO_INFO_COMP_HEIGHT (vip, c));
+    }
+
+    for (y = 0; y < num_rows; y++) {
+      const guchar *const row =
+          data + va_image->offsets[i] + y * va_image->pitches[i];
+
+      for (x = 0; x < row_size; x++)
+        sum += row[x];
+    }
+  }
+  return sum;
+}
+
+static GstVaapiImage *
+get_image (GstVaapiSurface * surface, const GstVideoInfo * vip)
+{
+  GstVaapiImage *image;
+
+  if (g_derive) {
+    image = gst_vaapi_surface_derive_image (surface);
+    if (image)
+      return image;
+    g_printerr ("could not derive image, falling back to vaGetImage()\n");
+    g_derive = FALSE;
+  }
+
+  image = gst_vaapi_image_new (gst_vaapi_surface_get_display (surface),
+      GST_VIDEO_INFO_FORMAT (vip), GST_VIDEO_INFO_WIDTH (vip),
+      GST_VIDEO_INFO_HEIGHT (vip));
+  if (!image)
+    return NULL;
+  if (!gst_vaapi_surface_get_image (surface, image)) {
+    gst_vaapi_image_unref (image);
+    return NULL;
+  }
+  return image;
+}
+
+static gboolean
+run_bench (Bench * bench, GstVaapiSurface * surface, const GstVideoInfo * vip)
+{
+  GstVaapiImage *image;
+  VAImage va_image;
+  guchar *data, *shadow = NULL;
+  gsize shadow_size = 0;
+  gint64 start;
+  gint i, j;
+
+  for (i = 0; i < g_num_frames; i++) {
+    image = get_image (surface, vip);
+    if (!image)
+      return FALSE;
+    gst_vaapi_image_get_image (image, &va_image);
+
+    start = g_get_monotonic_time ();
+    if (bench->use_shadow) {
+      if (shadow_size < va_image.data_size) {
+        g_free (shadow);
+        shadow_size = va_image.data_size;
+        shadow = g_malloc (shadow_size);
+      }
+      if (!gst_vaapi_image_read_data (image, shadow, shadow_size))
+        goto error_readback;
+      data = shadow;
+    } else {
+      if (!gst_vaapi_image_map (image))
+        goto error_readback;
+      data = gst_vaapi_image_get_plane (image, 0) - va_image.offsets[0];
+    }
+    bench->readback_time += g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    for (j = 0; j < g_num_passes; j++)
+      bench->checksum = consume_frame (vip, data, &va_image);
+    bench->consume_time += g_get_monotonic_time () - start;
+
+    if (!bench->use_shadow)
+      gst_vaapi_image_unmap (image);
+    gst_vaapi_image_unref (image);
+  }
+
+  g_free (shadow);
+  g_print ("%-8s readback %7.3f ms/frame  consume %7.3f ms/frame  "
+      "total %7.3f ms/frame\n", bench->name,
+      (gdouble) bench->readback_time / 1000 / g_num_frames,
+      (gdouble) bench->consume_time / 1000 / g_num_frames,
+      (gdouble) (bench->readback_time + bench->consume_time) / 1000 /
+      g_num_frames);
+  return TRUE;
+
+  /* ERRORS */
+error_readback:
+  {
+    g_printerr ("failed to read back image\n");
+    gst_vaapi_image_unref (image);
+    g_free (shadow);
+    return FALSE;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstVaapiDisplay *display;
+  GstVaapiSurface *surface;
+  GstVaapiImage *image;
+  GstVideoFormat format = GST_VIDEO_FORMAT_NV12;
+  GstVideoInfo vi;
+  Bench direct = { "direct", FALSE, };
+  Bench shadow = { "shadow", TRUE, };
+
+  if (!video_output_init (&argc, argv, g_options))
+    g_error ("failed to initialize video output subsystem");
+
+  if (g_format_str) {
+    format = gst_video_format_from_string (g_format_str);
+    if (format == GST_VIDEO_FORMAT_UNKNOWN)
+      g_error ("invalid format %s", g_format_str);
+  }
+  if (g_width <= 0 || g_height <= 0 || g_num_frames <= 0 || g_num_passes <= 0)
+    g_error ("invalid benchmark parameters");
+  gst_video_info_set_format (&vi, format, g_width, g_height);
+
+  display = video_output_create_display (NULL);
+  if (!display)
+    g_error ("could not create VA display");
+
+  surface = gst_vaapi_surface_new_with_format (display, format, g_width,
+      g_height, 0);
+  if (!surface)
+    g_error ("could not create %s surface", g_format_str ? g_format_str :
+        "NV12");
+
+  image = image_generate (display, format, g_width, g_height);
+  if (!image)
+    g_error ("could not create image");
+  if (!image_upload (image, surface))
+    g_error ("could not upload image");
+  gst_vaapi_image_unref (image);
+
+  g_print ("%dx%d %s, %d frames, %d consumer passes, %s\n", g_width,
+      g_height, gst_video_format_to_string (format), g_num_frames,
+      g_num_passes, g_derive ? "derived images" : "vaGetImage()");
+
+  if (!run_bench (&direct, surface, &vi) || !run_bench (&shadow, surface, &vi))
+    g_error ("benchmark failed");
+
+  if (direct.checksum != shadow.checksum)
+    g_error ("checksum mismatch: %" G_GUINT64_FORMAT " != %" G_GUINT64_FORMAT,
+        direct.checksum, shadow.checksum);
+
+  g_print ("speedup  %.2fx\n",
+      (gdouble) (direct.readback_time + direct.consume_time) /
+      MAX (shadow.readback_time + shadow.consume_time, 1));
+
+  gst_vaapi_surface_unref (surface);
+  gst_object_unref (display);
+  g_free (g_format_str);
+  video_output_exit ();
+  return 0;
+}
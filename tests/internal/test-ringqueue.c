@@ -0,0 +1,194 @@
+/*
+ *  test-ringqueue.c - Benchmark GstVaapiRingQueue against GAsyncQueue
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiringqueue.h>
+
+static gint g_num_items = 1000000;
+static gint g_capacity = 32;
+
+static GOptionEntry g_options[] = {
+  {"items", 'n', 0, G_OPTION_ARG_INT, &g_num_items,
+      "number of items to transfer", NULL},
+  {"capacity", 'c', 0, G_OPTION_ARG_INT, &g_capacity,
+      "maximum number of queued items", NULL},
+  {NULL,}
+};
+
+typedef struct
+{
+  gint64 push_time;
+} Item;
+
+typedef struct
+{
+  const gchar *name;
+  gpointer queue;
+  gboolean (*push) (gpointer queue, gpointer data);
+  gpointer (*pop) (gpointer queue, guint64 timeout);
+  guint (*length) (gpointer queue);
+
+  Item *items;
+  gint64 *latencies;
+} Bench;
+
+static gboolean
+async_queue_push (gpointer queue, gpointer data)
+{
+  g_async_queue_push (queue, data);
+  return TRUE;
+}
+
+static gpointer
+async_queue_pop (gpointer queue, guint64 timeout)
+{
+  return g_async_queue_timeout_pop (queue, timeout);
+}
+
+static guint
+async_queue_length (gpointer queue)
+{
+  return MAX (g_async_queue_length (queue), 0);
+}
+
+static gboolean
+ring_queue_push (gpointer queue, gpointer data)
+{
+  return gst_vaapi_ring_queue_push (queue, data);
+}
+
+static gpointer
+ring_queue_pop (gpointer queue, guint64 timeout)
+{
+  return gst_vaapi_ring_queue_timeout_pop (queue, timeout);
+}
+
+static guint
+ring_queue_length (gpointer queue)
+{
+  return gst_vaapi_ring_queue_length (queue);
+}
+
+static gpointer
+producer_func (gpointer data)
+{
+  Bench *const bench = data;
+  gint i;
+
+  for (i = 0; i < g_num_items; i++) {
+    Item *const item = &bench->items[i];
+
+    /* Both queues are bounded to the same capacity */
+    while (bench->length (bench->queue) >= (guint) g_capacity)
+      g_thread_yield ();
+
+    item->push_time = g_get_monotonic_time ();
+    while (!bench->push (bench->queue, item))
+      g_thread_yield ();
+  }
+  return NULL;
+}
+
+static gint
+compare_gint64 (gconstpointer a, gconstpointer b)
+{
+  const gint64 va = *(const gint64 *) a;
+  const gint64 vb = *(const gint64 *) b;
+
+  return (va > vb) - (va < vb);
+}
+
+static void
+run_bench (Bench * bench)
+{
+  GThread *producer;
+  gint64 start, elapsed;
+  gint i;
+
+  start = g_get_monotonic_time ();
+  producer = g_thread_new ("producer", producer_func, bench);
+
+  for (i = 0; i < g_num_items; i++) {
+    Item *item;
+
+    do {
+      item = bench->pop (bench->queue, 50000);
+    } while (!item);
+    bench->latencies[i] = g_get_monotonic_time () - item->push_time;
+  }
+
+  g_thread_join (producer);
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  qsort (bench->latencies, g_num_items, sizeof (gint64), compare_gint64);
+  g_print ("%-12s %10.0f items/s  latency p50 %4" G_GINT64_FORMAT
+      " us  p99 %4" G_GINT64_FORMAT " us  p99.9 %5" G_GINT64_FORMAT
+      " us  max %6" G_GINT64_FORMAT " us\n", bench->name,
+      (gdouble) g_num_items * G_USEC_PER_SEC / elapsed,
+      bench->latencies[g_num_items / 2],
+      bench->latencies[(gint64) g_num_items * 99 / 100],
+      bench->latencies[(gint64) g_num_items * 999 / 1000],
+      bench->latencies[g_num_items - 1]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  Bench bench;
+  gboolean success;
+
+  ctx = g_option_context_new ("- GstVaapiRingQueue benchmark");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_main_entries (ctx, g_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success || g_num_items <= 0 || g_capacity <= 0)
+    return EXIT_FAILURE;
+
+  memset (&bench, 0, sizeof (bench));
+  bench.items = g_new0 (Item, g_num_items);
+  bench.latencies = g_new0 (gint64, g_num_items);
+
+  bench.name = "GAsyncQueue";
+  bench.queue = g_async_queue_new ();
+  bench.push = async_queue_push;
+  bench.pop = async_queue_pop;
+  bench.length = async_queue_length;
+  run_bench (&bench);
+  g_async_queue_unref (bench.queue);
+
+  bench.name = "RingQueue";
+  bench.queue = gst_vaapi_ring_queue_new (g_capacity, NULL);
+  bench.push = ring_queue_push;
+  bench.pop = ring_queue_pop;
+  bench.length = ring_queue_length;
+  run_bench (&bench);
+  gst_vaapi_ring_queue_free (bench.queue);
+
+  g_free (bench.latencies);
+  g_free (bench.items);
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
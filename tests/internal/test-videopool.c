@@ -0,0 +1,261 @@
+/*
+ *  test-videopool.c - Test GstVaapiVideoPool watermarks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Runs a pool whose objects are plain mini objects, so that no VA
+   driver is needed, and checks that it grows ahead up to the low
+   watermark within its capacity, and that it releases the objects
+   which stay free for an idle timeout down to the high watermark,
+   without touching the ones in use, even once it is not used anymore */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/vaapi/gstvaapivideopool_priv.h>
+
+#define IDLE_TIMEOUT 50         /* ms */
+
+static gint g_num_live;
+static gint g_num_allocs;
+
+static void
+object_freed (gpointer data, GstMiniObject * object)
+{
+  g_atomic_int_add (&g_num_live, -1);
+}
+
+static gpointer
+fake_pool_alloc_object (GstVaapiVideoPool * pool)
+{
+  GstMiniObject *const object = GST_MINI_OBJECT_CAST (gst_buffer_new ());
+
+  gst_mini_object_weak_ref (object, object_freed, NULL);
+  g_atomic_int_inc (&g_num_live);
+  g_atomic_int_inc (&g_num_allocs);
+  return object;
+}
+
+static const GstVaapiVideoPoolClass fake_pool_class = {
+  {sizeof (GstVaapiVideoPool),
+      (GDestroyNotify) gst_vaapi_video_pool_finalize}
+  ,
+  .alloc_object = fake_pool_alloc_object
+};
+
+static GstVaapiVideoPool *
+fake_pool_new (GstVaapiDisplay * display)
+{
+  GstVaapiVideoPool *pool;
+
+  pool = (GstVaapiVideoPool *)
+      gst_vaapi_mini_object_new (GST_VAAPI_MINI_OBJECT_CLASS
+      (&fake_pool_class));
+  if (!pool)
+    g_error ("failed to create pool");
+  gst_vaapi_video_pool_init (pool, display,
+      GST_VAAPI_VIDEO_POOL_OBJECT_TYPE_IMAGE);
+  return pool;
+}
+
+/* Waits for the pool to grow ahead */
+static void
+wait_for_free_objects (GstVaapiVideoPool * pool, guint n)
+{
+  GstVaapiVideoPoolStats stats;
+  guint i;
+
+  for (i = 0; i < 1000; i++) {
+    gst_vaapi_video_pool_get_stats (pool, &stats);
+    if (stats.num_free == n)
+      return;
+    g_usleep (1000);
+  }
+  g_error ("pool has %u free objects, expected %u", stats.num_free, n);
+}
+
+/* Waits for the pool to be finalized, possibly from the worker thread */
+static void
+wait_for_live_objects (gint n)
+{
+  guint i;
+
+  for (i = 0; i < 1000; i++) {
+    if (g_atomic_int_get (&g_num_live) == n)
+      return;
+    g_usleep (1000);
+  }
+  g_error ("%d live objects, expected %d", g_atomic_int_get (&g_num_live), n);
+}
+
+static void
+test_default (GstVaapiDisplay * display)
+{
+  GstVaapiVideoPool *const pool = fake_pool_new (display);
+  GstVaapiVideoPoolStats stats;
+  gpointer objects[4];
+  guint i;
+
+  /* Objects are allocated on demand only, and kept */
+  for (i = 0; i < G_N_ELEMENTS (objects); i++)
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+  for (i = 0; i < G_N_ELEMENTS (objects); i++)
+    gst_vaapi_video_pool_put_object (pool, objects[i]);
+  g_usleep (IDLE_TIMEOUT * 1000);
+  gst_vaapi_video_pool_put_object (pool,
+      gst_vaapi_video_pool_get_object (pool));
+
+  gst_vaapi_video_pool_get_stats (pool, &stats);
+  g_assert_cmpuint (stats.num_free, ==, G_N_ELEMENTS (objects));
+  g_assert_cmpuint (stats.num_used, ==, 0);
+  g_assert_cmpuint (stats.max_used, ==, G_N_ELEMENTS (objects));
+  g_assert_cmpuint (stats.num_allocs, ==, G_N_ELEMENTS (objects));
+  g_assert_cmpuint (stats.num_preallocs, ==, 0);
+  g_assert_cmpuint (stats.num_trims, ==, 0);
+  gst_vaapi_video_pool_unref (pool);
+}
+
+static void
+test_low_watermark (GstVaapiDisplay * display)
+{
+  GstVaapiVideoPool *const pool = fake_pool_new (display);
+  GstVaapiVideoPoolStats stats;
+  gpointer objects[6];
+  guint i;
+
+  gst_vaapi_video_pool_set_capacity (pool, G_N_ELEMENTS (objects));
+  gst_vaapi_video_pool_set_watermarks (pool, 4, 8, 0);
+  wait_for_free_objects (pool, 4);
+
+  /* The requests are served from the objects allocated ahead */
+  for (i = 0; i < 4; i++) {
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+    g_assert (objects[i] != NULL);
+  }
+  gst_vaapi_video_pool_get_stats (pool, &stats);
+  g_assert_cmpuint (stats.num_allocs, ==, 0);
+
+  /* The pool then grows up to its capacity, not up to the watermark */
+  wait_for_free_objects (pool, 2);
+  for (; i < G_N_ELEMENTS (objects); i++) {
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+    g_assert (objects[i] != NULL);
+  }
+  g_assert (gst_vaapi_video_pool_get_object (pool) == NULL);
+
+  gst_vaapi_video_pool_get_stats (pool, &stats);
+  g_assert_cmpuint (stats.num_allocs, ==, 0);
+  g_assert_cmpuint (stats.num_preallocs, ==, G_N_ELEMENTS (objects));
+  g_assert_cmpuint (stats.num_exhausted, ==, 1);
+
+  for (i = 0; i < G_N_ELEMENTS (objects); i++)
+    gst_vaapi_video_pool_put_object (pool, objects[i]);
+  gst_vaapi_video_pool_unref (pool);
+}
+
+static void
+test_high_watermark (GstVaapiDisplay * display)
+{
+  GstVaapiVideoPool *const pool = fake_pool_new (display);
+  GstVaapiVideoPoolStats stats;
+  gpointer objects[8], object;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (objects); i++)
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+  for (i = 2; i < G_N_ELEMENTS (objects); i++)
+    gst_vaapi_video_pool_put_object (pool, objects[i]);
+
+  /* Two objects stay in use, and one free object is used now and then:
+     in the end, all the free objects but the two of the high watermark
+     are released */
+  gst_vaapi_video_pool_set_watermarks (pool, 0, 2, IDLE_TIMEOUT);
+  for (i = 0; i < 3; i++) {
+    object = gst_vaapi_video_pool_get_object (pool);
+    g_usleep (IDLE_TIMEOUT * 1000 / 2);
+    gst_vaapi_video_pool_put_object (pool, object);
+  }
+  wait_for_free_objects (pool, 2);
+
+  gst_vaapi_video_pool_get_stats (pool, &stats);
+  g_assert_cmpuint (stats.num_free, ==, 2);
+  g_assert_cmpuint (stats.num_used, ==, 2);
+  g_assert_cmpuint (stats.num_trims, ==, 4);
+  g_assert_cmpint (g_atomic_int_get (&g_num_live), ==, 4);
+
+  gst_vaapi_video_pool_put_object (pool, objects[0]);
+  gst_vaapi_video_pool_put_object (pool, objects[1]);
+  gst_vaapi_video_pool_unref (pool);
+}
+
+static void
+test_idle_pool (GstVaapiDisplay * display)
+{
+  GstVaapiVideoPool *const pool = fake_pool_new (display);
+  GstVaapiVideoPoolStats stats;
+  gpointer objects[4];
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (objects); i++)
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+  for (i = 0; i < G_N_ELEMENTS (objects); i++)
+    gst_vaapi_video_pool_put_object (pool, objects[i]);
+
+  /* Nothing is requested anymore, the timer releases the free objects */
+  gst_vaapi_video_pool_set_watermarks (pool, 0, 1, IDLE_TIMEOUT);
+  wait_for_free_objects (pool, 1);
+
+  gst_vaapi_video_pool_get_stats (pool, &stats);
+  g_assert_cmpuint (stats.num_trims, ==, G_N_ELEMENTS (objects) - 1);
+  g_assert_cmpint (g_atomic_int_get (&g_num_live), ==, 1);
+
+  /* The timer releases the pool along with its last reference */
+  gst_vaapi_video_pool_unref (pool);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GstVaapiDisplay *display;
+  gboolean success;
+
+  ctx = g_option_context_new ("- GstVaapiVideoPool watermarks test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success)
+    return EXIT_FAILURE;
+
+  /* The pool only keeps a reference to the display */
+  display = g_object_new (GST_TYPE_VAAPI_DISPLAY, NULL);
+
+  test_default (display);
+  wait_for_live_objects (0);
+  test_low_watermark (display);
+  wait_for_live_objects (0);
+  test_high_watermark (display);
+  wait_for_live_objects (0);
+  test_idle_pool (display);
+  wait_for_live_objects (0);
+  g_print ("%d objects allocated\n", g_atomic_int_get (&g_num_allocs));
+
+  gst_object_unref (display);
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
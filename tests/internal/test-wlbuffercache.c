@@ -0,0 +1,248 @@
+/*
+ *  test-wlbuffercache.c - Test GstVaapiWlBufferCache against a fake
+ *                         compositor
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Renders frames from a small surface pool the way the Wayland window
+   does, and checks that the steady state exports nothing, and that
+   destroyed surfaces, resizes and format changes drop the buffers */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/vaapi/gstvaapiwlbuffercache.h>
+
+#define NUM_SURFACES 4
+#define NUM_FRAMES 100
+
+/* ------------------------------------------------------------------------- */
+/* --- Fake compositor                                                   --- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  GstMiniObject *surface;
+  guint width;
+  guint height;
+} FakeBuffer;
+
+static guint g_num_exports;
+static guint g_num_live_buffers;
+
+/* The buffer the compositor shows, released when the next one is
+   attached */
+static FakeBuffer *g_attached_buffer;
+static gboolean g_attached_cached;
+
+static void
+fake_buffer_destroy (gpointer data)
+{
+  g_assert (data != g_attached_buffer);
+  g_num_live_buffers--;
+  g_slice_free (FakeBuffer, data);
+}
+
+static FakeBuffer *
+fake_export (GstMiniObject * surface, guint width, guint height)
+{
+  FakeBuffer *const buffer = g_slice_new (FakeBuffer);
+
+  buffer->surface = surface;
+  buffer->width = width;
+  buffer->height = height;
+  g_num_exports++;
+  g_num_live_buffers++;
+  return buffer;
+}
+
+static void
+fake_release (GstVaapiWlBufferCache * cache)
+{
+  FakeBuffer *const buffer = g_attached_buffer;
+
+  if (!buffer)
+    return;
+
+  g_attached_buffer = NULL;
+  if (g_attached_cached)
+    g_assert (gst_vaapi_wl_buffer_cache_release (cache, buffer));
+  else {
+    g_assert (!gst_vaapi_wl_buffer_cache_release (cache, buffer));
+    fake_buffer_destroy (buffer);
+  }
+}
+
+/* What gst_vaapi_window_wayland_render() does with the cache */
+static void
+render (GstVaapiWlBufferCache * cache, GstMiniObject * surface,
+    guint format, guint width, guint height, gboolean release)
+{
+  FakeBuffer *buffer;
+  gboolean cached = TRUE;
+
+  buffer = gst_vaapi_wl_buffer_cache_acquire (cache, surface, format, width,
+      height);
+  if (!buffer) {
+    buffer = fake_export (surface, width, height);
+    cached = gst_vaapi_wl_buffer_cache_insert (cache, surface, format, width,
+        height, buffer);
+  }
+  g_assert (buffer->surface == surface);
+  g_assert_cmpuint (buffer->width, ==, width);
+  g_assert_cmpuint (buffer->height, ==, height);
+
+  if (release)
+    fake_release (cache);
+  else
+    g_assert (g_attached_buffer == NULL);
+  g_attached_buffer = buffer;
+  g_attached_cached = cached;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Tests                                                             --- */
+/* ------------------------------------------------------------------------- */
+
+static void
+new_surfaces (GstMiniObject ** surfaces)
+{
+  guint i;
+
+  for (i = 0; i < NUM_SURFACES; i++)
+    surfaces[i] = GST_MINI_OBJECT_CAST (gst_buffer_new ());
+}
+
+static void
+test_steady_state (GstVaapiWlBufferCache * cache, GstMiniObject ** surfaces)
+{
+  GstVaapiWlBufferCacheStats stats;
+  guint i;
+
+  g_num_exports = 0;
+  for (i = 0; i < NUM_FRAMES; i++)
+    render (cache, surfaces[i % NUM_SURFACES], 1, 640, 480, TRUE);
+
+  gst_vaapi_wl_buffer_cache_get_stats (cache, &stats);
+  g_assert_cmpuint (g_num_exports, ==, NUM_SURFACES);
+  g_assert_cmpuint (stats.num_misses, ==, NUM_SURFACES);
+  g_assert_cmpuint (stats.num_hits, ==, NUM_FRAMES - NUM_SURFACES);
+  g_assert_cmpuint (stats.num_cached, ==, NUM_SURFACES);
+  g_print ("steady state: %u exports for %u frames\n", g_num_exports,
+      NUM_FRAMES);
+}
+
+/* The same surface is rendered again before the compositor released
+   it: it gets a one-time buffer */
+static void
+test_busy (GstVaapiWlBufferCache * cache, GstMiniObject ** surfaces)
+{
+  const guint live_buffers = g_num_live_buffers;
+
+  g_num_exports = 0;
+  render (cache, surfaces[0], 1, 640, 480, TRUE);
+  g_assert (g_attached_cached);
+  fake_release (cache);
+  render (cache, surfaces[0], 1, 640, 480, FALSE);
+  g_assert (g_attached_cached);
+  render (cache, surfaces[0], 1, 640, 480, TRUE);
+  g_assert (!g_attached_cached);
+  g_assert_cmpuint (g_num_exports, ==, 1);
+
+  fake_release (cache);
+  g_assert_cmpuint (g_num_live_buffers, ==, live_buffers);
+}
+
+static void
+test_invalidation (GstVaapiWlBufferCache * cache, GstMiniObject ** surfaces)
+{
+  GstVaapiWlBufferCacheStats stats;
+  guint i;
+
+  /* Destroying an idle surface destroys its buffer right away */
+  gst_mini_object_unref (surfaces[1]);
+  surfaces[1] = GST_MINI_OBJECT_CAST (gst_buffer_new ());
+  gst_vaapi_wl_buffer_cache_get_stats (cache, &stats);
+  g_assert_cmpuint (stats.num_cached, ==, NUM_SURFACES - 1);
+  g_assert_cmpuint (g_num_live_buffers, ==, NUM_SURFACES - 1);
+
+  /* ... and a busy one once the compositor released it */
+  render (cache, surfaces[2], 1, 640, 480, TRUE);
+  gst_mini_object_unref (surfaces[2]);
+  surfaces[2] = GST_MINI_OBJECT_CAST (gst_buffer_new ());
+  g_assert_cmpuint (g_num_live_buffers, ==, NUM_SURFACES - 1);
+  fake_release (cache);
+  g_assert_cmpuint (g_num_live_buffers, ==, NUM_SURFACES - 2);
+
+  /* A new format is exported again */
+  g_num_exports = 0;
+  render (cache, surfaces[0], 2, 640, 480, TRUE);
+  g_assert_cmpuint (g_num_exports, ==, 1);
+
+  /* So is every surface after a resize */
+  gst_vaapi_wl_buffer_cache_invalidate (cache);
+  g_num_exports = 0;
+  for (i = 0; i < 2 * NUM_SURFACES; i++)
+    render (cache, surfaces[i % NUM_SURFACES], 2, 800, 600, TRUE);
+  g_assert_cmpuint (g_num_exports, ==, NUM_SURFACES);
+  fake_release (cache);
+  g_assert_cmpuint (g_num_live_buffers, ==, NUM_SURFACES);
+
+  gst_vaapi_wl_buffer_cache_get_stats (cache, &stats);
+  g_assert_cmpuint (stats.num_cached, ==, NUM_SURFACES);
+  g_print ("%" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %"
+      G_GUINT64_FORMAT " invalidations\n", stats.num_hits, stats.num_misses,
+      stats.num_invalidations);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GstVaapiWlBufferCache *cache;
+  GstMiniObject *surfaces[NUM_SURFACES];
+  gboolean success;
+  guint i;
+
+  ctx = g_option_context_new ("- GstVaapiWlBufferCache test");
+  if (!ctx)
+    return EXIT_FAILURE;
+
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  success = g_option_context_parse (ctx, &argc, &argv, NULL);
+  g_option_context_free (ctx);
+  if (!success)
+    return EXIT_FAILURE;
+
+  cache = gst_vaapi_wl_buffer_cache_new (fake_buffer_destroy);
+  if (!cache)
+    g_error ("failed to create buffer cache");
+  new_surfaces (surfaces);
+
+  test_steady_state (cache, surfaces);
+  fake_release (cache);
+  test_busy (cache, surfaces);
+  test_invalidation (cache, surfaces);
+
+  /* The cache destroys its buffers, whether the surfaces live or not */
+  gst_mini_object_unref (surfaces[0]);
+  gst_vaapi_wl_buffer_cache_free (cache);
+  g_assert_cmpuint (g_num_live_buffers, ==, 0);
+
+  for (i = 1; i < NUM_SURFACES; i++)
+    gst_mini_object_unref (surfaces[i]);
+  gst_deinit ();
+  return EXIT_SUCCESS;
+}
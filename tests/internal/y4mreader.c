@@ -259,3 +259,20 @@ y4m_reader_load_image (Y4MReader * file, GstVaapiImage * image)
 
   return TRUE;
 }
+
+/* Reads the next I420 frame as contiguous planes, i.e. @data holds
+   width * height * 3 / 2 bytes */
+gboolean
+y4m_reader_read_frame (Y4MReader * file, guint8 * data)
+{
+  size_t frame_size;
+
+  g_return_val_if_fail (file && file->fp, FALSE);
+  g_return_val_if_fail (data, FALSE);
+
+  if (!skip_frame_header (file))
+    return FALSE;
+
+  frame_size = file->height * file->width * 3 / 2;
+  return fread (data, 1, frame_size, file->fp) == frame_size;
+}
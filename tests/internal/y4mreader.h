@@ -39,3 +39,5 @@ Y4MReader *y4m_reader_open (const gchar * filename);
 void y4m_reader_close (Y4MReader * file);
 
 gboolean y4m_reader_load_image (Y4MReader * file, GstVaapiImage * image);
+
+gboolean y4m_reader_read_frame (Y4MReader * file, guint8 * data);